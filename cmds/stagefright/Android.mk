@@ -238,3 +238,79 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE:= muxer
 
 include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        remux.cpp               \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libbinder libstagefright_foundation \
+        libmedia libgui libcutils libui libc
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= remux
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        writerbench.cpp         \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_STATIC_LIBRARIES := \
+	libstagefright_synthetic_source
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= writerbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        webmbench.cpp           \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_STATIC_LIBRARIES := \
+	libstagefright_synthetic_source
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= webmbench
+
+include $(BUILD_EXECUTABLE)
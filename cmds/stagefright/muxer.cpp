@@ -37,12 +37,15 @@
 #include <media/stagefright/NuMediaExtractor.h>
 
 static void usage(const char *me) {
-    fprintf(stderr, "usage: %s [-a] [-v] [-s <trim start time>]"
+    fprintf(stderr, "usage: %s [-a] [-v] [-f] [-q <samples>] [-s <trim start time>]"
                     " [-e <trim end time>] [-o <output file>]"
                     " <input video file>\n", me);
     fprintf(stderr, "       -h help\n");
     fprintf(stderr, "       -a use audio\n");
     fprintf(stderr, "       -v use video\n");
+    fprintf(stderr, "       -f write a fragmented mp4 file\n");
+    fprintf(stderr, "       -q queue up to this many samples per track instead of\n"
+                    "          waiting for the muxer to consume each one\n");
     fprintf(stderr, "       -s Time in milli-seconds when the trim should start\n");
     fprintf(stderr, "       -e Time in milli-seconds when the trim should end\n");
     fprintf(stderr, "       -o output file name. Default is /sdcard/muxeroutput.mp4\n");
@@ -60,7 +63,9 @@ static int muxing(
         bool enableTrim,
         int trimStartTimeMs,
         int trimEndTimeMs,
-        int rotationDegrees) {
+        int rotationDegrees,
+        bool fragmented,
+        size_t maxQueuedSamples) {
     sp<NuMediaExtractor> extractor = new NuMediaExtractor;
     if (extractor->setDataSource(NULL /* httpService */, path) != OK) {
         fprintf(stderr, "unable to instantiate extractor. %s\n", path);
@@ -81,7 +86,8 @@ static int muxing(
         return fd;
     }
     sp<MediaMuxer> muxer = new MediaMuxer(fd,
-                                          MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+            fragmented ? MediaMuxer::OUTPUT_FORMAT_MPEG_4_FRAGMENTED
+                       : MediaMuxer::OUTPUT_FORMAT_MPEG_4);
     close(fd);
 
     size_t trackCount = extractor->countTracks();
@@ -157,8 +163,10 @@ static int muxing(
 
     size_t trackIndex = -1;
     sp<ABuffer> newBuffer = new ABuffer(bufferSize);
+    size_t numSamplesWritten = 0;
 
     muxer->setOrientationHint(rotationDegrees);
+    CHECK_EQ(muxer->setMaxQueuedSamples(maxQueuedSamples), (status_t)OK);
     muxer->start();
 
     while (!sawInputEOS) {
@@ -205,9 +213,19 @@ static int muxing(
             }
 
             if (!enableTrim || (enableTrim && trimStarted)) {
-                err = muxer->writeSampleData(newBuffer,
+                sp<ABuffer> sample = newBuffer;
+                if (maxQueuedSamples > 0) {
+                    // the muxer holds on to queued samples, so they can't
+                    // share the read buffer
+                    sample = new ABuffer(newBuffer->size());
+                    memcpy(sample->data(), newBuffer->data(), newBuffer->size());
+                }
+                err = muxer->writeSampleData(sample,
                                              trackIndexMap.valueFor(trackIndex),
                                              timeUs - trimOffsetTimeUs, sampleFlags);
+                if (err == OK) {
+                    ++numSamplesWritten;
+                }
             }
 
             extractor->advance();
@@ -221,6 +239,11 @@ static int muxing(
     int64_t elapsedTimeUs = ALooper::GetNowUs() - muxerStartTimeUs;
     fprintf(stderr, "SUCCESS: muxer generate the video in %" PRId64 " ms\n",
             elapsedTimeUs / 1000);
+    if (elapsedTimeUs > 0) {
+        fprintf(stderr, "%zu samples, %" PRId64 " samples/sec%s\n",
+                numSamplesWritten, numSamplesWritten * 1000000ll / elapsedTimeUs,
+                maxQueuedSamples > 0 ? " (queued)" : "");
+    }
 
     return 0;
 }
@@ -234,12 +257,14 @@ int main(int argc, char **argv) {
     int trimStartTimeMs = -1;
     int trimEndTimeMs = -1;
     int rotationDegrees = 0;
+    bool fragmented = false;
+    int maxQueuedSamples = 0;
     // When trimStartTimeMs and trimEndTimeMs seems valid, we turn this switch
     // to true.
     bool enableTrim = false;
 
     int res;
-    while ((res = getopt(argc, argv, "h?avo:s:e:r:")) >= 0) {
+    while ((res = getopt(argc, argv, "h?avfq:o:s:e:r:")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -253,6 +278,18 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'f':
+            {
+                fragmented = true;
+                break;
+            }
+
+            case 'q':
+            {
+                maxQueuedSamples = atoi(optarg);
+                break;
+            }
+
             case 'o':
             {
                 outputFileName = optarg;
@@ -305,6 +342,10 @@ int main(int argc, char **argv) {
         enableTrim = true;
     }
 
+    if (maxQueuedSamples < 0) {
+        usage(me);
+    }
+
     if (!useAudio && !useVideo) {
         fprintf(stderr, "ERROR: Missing both -a and -v, no track to mux then.\n");
         return 1;
@@ -318,7 +359,8 @@ int main(int argc, char **argv) {
     looper->start();
 
     int result = muxing(argv[0], useAudio, useVideo, outputFileName,
-                        enableTrim, trimStartTimeMs, trimEndTimeMs, rotationDegrees);
+                        enableTrim, trimStartTimeMs, trimEndTimeMs, rotationDegrees,
+                        fragmented, maxQueuedSamples);
 
     looper->stop();
 
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "remux"
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/MediaRemuxer.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-a] [-v] [-f] [-q <samples>] [-o <output file>]"
+                    " <input file>[,<start time>[,<end time>]] ...\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -a use audio\n");
+    fprintf(stderr, "       -v use video\n");
+    fprintf(stderr, "       -f write a fragmented mp4 file\n");
+    fprintf(stderr, "       -q queue up to this many samples per track, at the cost\n"
+                    "          of copying each sample once\n");
+    fprintf(stderr, "       -o output file name. Default is /sdcard/remuxoutput.mp4\n");
+    fprintf(stderr, "       The time range of each input file, in milli-seconds,\n"
+                    "       is appended to the output without re-encoding it.\n"
+                    "       Files can only be joined if their tracks match.\n");
+
+    exit(1);
+}
+
+using namespace android;
+
+// Splits "<path>[,<start ms>[,<end ms>]]".
+static bool parseSegment(
+        const char *arg, AString *path, int64_t *startUs, int64_t *endUs) {
+    *startUs = 0;
+    *endUs = -1;
+
+    const char *comma = strchr(arg, ',');
+    if (comma == NULL) {
+        path->setTo(arg);
+        return true;
+    }
+    path->setTo(arg, comma - arg);
+
+    char *end;
+    *startUs = strtoll(comma + 1, &end, 10) * 1000ll;
+    if (end == comma + 1 || *startUs < 0) {
+        return false;
+    }
+    if (*end == ',') {
+        const char *endTime = end + 1;
+        *endUs = strtoll(endTime, &end, 10) * 1000ll;
+        if (end == endTime || *endUs <= *startUs) {
+            return false;
+        }
+    }
+    return *end == '\0';
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    bool useAudio = false;
+    bool useVideo = false;
+    bool fragmented = false;
+    int maxQueuedSamples = 0;
+    const char *outputFileName = "/sdcard/remuxoutput.mp4";
+
+    int res;
+    while ((res = getopt(argc, argv, "h?avfq:o:")) >= 0) {
+        switch (res) {
+            case 'a':
+            {
+                useAudio = true;
+                break;
+            }
+
+            case 'v':
+            {
+                useVideo = true;
+                break;
+            }
+
+            case 'f':
+            {
+                fragmented = true;
+                break;
+            }
+
+            case 'q':
+            {
+                maxQueuedSamples = atoi(optarg);
+                break;
+            }
+
+            case 'o':
+            {
+                outputFileName = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || maxQueuedSamples < 0) {
+        usage(me);
+    }
+
+    if (!useAudio && !useVideo) {
+        fprintf(stderr, "ERROR: Missing both -a and -v, no track to remux then.\n");
+        return 1;
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    // Make sure setDataSource() works.
+    DataSource::RegisterDefaultSniffers();
+
+    sp<ALooper> looper = new ALooper;
+    looper->start();
+
+    int fd = open(outputFileName, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "couldn't open file %s\n", outputFileName);
+        return 1;
+    }
+    sp<MediaRemuxer> remuxer = new MediaRemuxer(fd,
+            fragmented ? MediaMuxer::OUTPUT_FORMAT_MPEG_4_FRAGMENTED
+                       : MediaMuxer::OUTPUT_FORMAT_MPEG_4,
+            useAudio, useVideo);
+    close(fd);
+
+    for (int i = 0; i < argc; ++i) {
+        AString path;
+        int64_t startUs, endUs;
+        if (!parseSegment(argv[i], &path, &startUs, &endUs)) {
+            fprintf(stderr, "ERROR: can't make out the time range in %s\n", argv[i]);
+            return 1;
+        }
+
+        status_t err = remuxer->addSegment(path.c_str(), startUs, endUs);
+        if (err != OK) {
+            fprintf(stderr, "ERROR: can't add %s (%d)\n", argv[i], err);
+            return 1;
+        }
+    }
+
+    CHECK_EQ(remuxer->setMaxQueuedSamples(maxQueuedSamples), (status_t)OK);
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+    status_t err = remuxer->remux();
+    int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    looper->stop();
+
+    if (err != OK) {
+        fprintf(stderr, "ERROR: remuxing failed (%d)\n", err);
+        return 1;
+    }
+
+    size_t numSamples = remuxer->getNumSamplesWritten();
+    fprintf(stderr, "SUCCESS: remuxed %zu samples in %" PRId64 " ms\n",
+            numSamples, elapsedTimeUs / 1000);
+    if (elapsedTimeUs > 0) {
+        fprintf(stderr, "%" PRId64 " samples/sec%s\n",
+                numSamples * 1000000ll / elapsedTimeUs,
+                maxQueuedSamples > 0 ? " (queued)" : "");
+    }
+
+    return 0;
+}
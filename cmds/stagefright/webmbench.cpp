@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "webmbench"
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+#include "SyntheticSource.h"
+#include "webm/WebmWriter.h"
+
+using namespace android;
+
+// Measures WebmWriter's frame pipeline: VP8 and Vorbis looking packets are
+// handed to the writer as fast as it accepts them, and the CPU time and
+// write system calls it took are reported per second of recorded media.
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d <seconds>] [-f <fps>] [-b <bitrate>] [-c]"
+                    " [-o <output file>]\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -d seconds of media to record (default: 60)\n");
+    fprintf(stderr, "       -f video frame rate (default: 30)\n");
+    fprintf(stderr, "       -b video bit rate in bits per second (default: 8000000)\n");
+    fprintf(stderr, "       -c record as a non real time client, which makes the\n"
+                    "          writer copy every frame as it does for MediaMuxer\n");
+    fprintf(stderr, "       -o output file name. Default is /sdcard/webmbench.webm\n");
+    exit(1);
+}
+
+// Number of write-type system calls this process issued so far, or -1 if
+// the kernel doesn't provide task I/O accounting.
+static int64_t getWriteSyscalls() {
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int64_t syscw = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "syscw: %" SCNd64, &syscw) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+
+    return syscw;
+}
+
+static int64_t getCpuTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+    return usage.ru_utime.tv_sec * 1000000ll + usage.ru_utime.tv_usec
+            + usage.ru_stime.tv_sec * 1000000ll + usage.ru_stime.tv_usec;
+}
+
+int main(int argc, char **argv) {
+    int32_t durationSecs = 60;
+    int32_t frameRate = 30;
+    int32_t bitRate = 8000000;
+    bool copyFrames = false;
+    const char *fileName = "/sdcard/webmbench.webm";
+
+    int res;
+    while ((res = getopt(argc, argv, "d:f:b:co:h")) >= 0) {
+        switch (res) {
+            case 'd':
+                durationSecs = atoi(optarg);
+                break;
+
+            case 'f':
+                frameRate = atoi(optarg);
+                break;
+
+            case 'b':
+                bitRate = atoi(optarg);
+                break;
+
+            case 'c':
+                copyFrames = true;
+                break;
+
+            case 'o':
+                fileName = optarg;
+                break;
+
+            case 'h':
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (durationSecs <= 0 || frameRate <= 0 || bitRate < frameRate * 8 * 16) {
+        usage(argv[0]);
+    }
+
+    int fd = open(fileName, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "couldn't open file %s\n", fileName);
+        return 1;
+    }
+
+    sp<WebmWriter> writer = new WebmWriter(fd);
+    close(fd);
+
+    // 128 kbps Vorbis in 1024 sample packets
+    const int32_t kAudioPacketRate = 44100 / 1024;
+    // a fresh buffer per frame, like an encoder hands them out; the writer
+    // may hold on to it until the frame's cluster is written
+    writer->addSource(new SyntheticSource(
+            MEDIA_MIMETYPE_VIDEO_VP8, durationSecs * frameRate, frameRate,
+            bitRate / 8 / frameRate));
+    writer->addSource(new SyntheticSource(
+            MEDIA_MIMETYPE_AUDIO_VORBIS, durationSecs * kAudioPacketRate, kAudioPacketRate,
+            128000 / 8 / kAudioPacketRate));
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyRealTimeRecording, !copyFrames);
+    params->setInt32(kKeyBitRate, bitRate);
+
+    int64_t syscallsBefore = getWriteSyscalls();
+    int64_t cpuBeforeUs = getCpuTimeUs();
+    int64_t startUs = systemTime() / 1000;
+
+    CHECK_EQ((status_t)OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    status_t err = writer->stop();
+
+    int64_t elapsedUs = systemTime() / 1000 - startUs;
+    int64_t cpuUs = getCpuTimeUs() - cpuBeforeUs;
+    int64_t syscallsAfter = getWriteSyscalls();
+
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "recording failed: %d\n", err);
+        return 1;
+    }
+
+    printf("%d s of %d fps VP8 at %d bps with Vorbis%s in %" PRId64 " ms\n",
+            durationSecs, frameRate, bitRate, copyFrames ? " (copied)" : "",
+            elapsedUs / 1000);
+    printf("cpu: %" PRId64 " us per second of media\n", cpuUs / durationSecs);
+    if (syscallsBefore >= 0 && syscallsAfter >= 0) {
+        printf("write syscalls: %" PRId64 " per second of media\n",
+                (syscallsAfter - syscallsBefore) / durationSecs);
+    } else {
+        printf("write syscalls: not available (no /proc/self/io)\n");
+    }
+
+    return 0;
+}
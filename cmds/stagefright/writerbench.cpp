@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "writerbench"
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/MPEG4Writer.h>
+
+#include "SyntheticSource.h"
+
+using namespace android;
+
+// Measures the cost of MPEG4Writer's file output: pre-encoded looking AVC
+// (and optionally AMR) samples are handed to the writer as fast as it
+// accepts them, and the CPU time and write system calls it took are
+// reported per second of recorded media.
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d <seconds>] [-f <fps>] [-b <bitrate>] [-a] [-s]"
+                    " [-o <output file>]\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -d seconds of media to record (default: 60)\n");
+    fprintf(stderr, "       -f video frame rate (default: 60)\n");
+    fprintf(stderr, "       -b video bit rate in bits per second (default: 48000000)\n");
+    fprintf(stderr, "       -a add an AMR-NB audio track\n");
+    fprintf(stderr, "       -s put the moov box in front of the media data (faststart)\n");
+    fprintf(stderr, "       -o output file name. Default is /sdcard/writerbench.mp4\n");
+    fprintf(stderr, "The output buffer size can be changed with the\n"
+                    "media.mp4writer.buffer-kb property, 0 disables buffering.\n"
+                    "media.mp4writer.io-buffers sets how many of them can be in\n"
+                    "flight, 1 writes synchronously.\n");
+    exit(1);
+}
+
+// Number of write-type system calls this process issued so far, or -1 if
+// the kernel doesn't provide task I/O accounting.
+static int64_t getWriteSyscalls() {
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int64_t syscw = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "syscw: %" SCNd64, &syscw) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+
+    return syscw;
+}
+
+static int64_t getCpuTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+    return usage.ru_utime.tv_sec * 1000000ll + usage.ru_utime.tv_usec
+            + usage.ru_stime.tv_sec * 1000000ll + usage.ru_stime.tv_usec;
+}
+
+int main(int argc, char **argv) {
+    int32_t durationSecs = 60;
+    int32_t frameRate = 60;
+    int32_t bitRate = 48000000;
+    bool useAudio = false;
+    bool fastStart = false;
+    const char *fileName = "/sdcard/writerbench.mp4";
+
+    int res;
+    while ((res = getopt(argc, argv, "d:f:b:aso:h")) >= 0) {
+        switch (res) {
+            case 'd':
+                durationSecs = atoi(optarg);
+                break;
+
+            case 'f':
+                frameRate = atoi(optarg);
+                break;
+
+            case 'b':
+                bitRate = atoi(optarg);
+                break;
+
+            case 'a':
+                useAudio = true;
+                break;
+
+            case 's':
+                fastStart = true;
+                break;
+
+            case 'o':
+                fileName = optarg;
+                break;
+
+            case 'h':
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (durationSecs <= 0 || frameRate <= 0 || bitRate < frameRate * 8 * 16) {
+        usage(argv[0]);
+    }
+
+    int fd = open(fileName, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "couldn't open file %s\n", fileName);
+        return 1;
+    }
+
+    sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+    close(fd);
+
+    // The writer copies the frames, so a few buffers are enough.
+    sp<MediaSource> video = new SyntheticSource(
+            MEDIA_MIMETYPE_VIDEO_AVC, durationSecs * frameRate, frameRate,
+            bitRate / 8 / frameRate, SyntheticSource::kFlagReuseBuffers);
+    video->getFormat()->setInt32(kKeyWidth, 1920);
+    video->getFormat()->setInt32(kKeyHeight, 1080);
+    writer->addSource(video);
+    if (useAudio) {
+        writer->addSource(new SyntheticSource(
+                MEDIA_MIMETYPE_AUDIO_AMR_NB, durationSecs * 50, 50, 32,
+                SyntheticSource::kFlagReuseBuffers));
+    }
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyRealTimeRecording, false);
+    params->setInt32(kKeyBitRate, bitRate);
+    params->setInt32(kKeyFastStart, fastStart);
+
+    int64_t syscallsBefore = getWriteSyscalls();
+    int64_t cpuBeforeUs = getCpuTimeUs();
+    int64_t startUs = systemTime() / 1000;
+
+    CHECK_EQ((status_t)OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    int64_t stopUs = systemTime() / 1000;
+    status_t err = writer->stop();
+
+    int64_t elapsedUs = systemTime() / 1000 - startUs;
+    int64_t finalizeUs = systemTime() / 1000 - stopUs;
+    int64_t cpuUs = getCpuTimeUs() - cpuBeforeUs;
+    int64_t syscallsAfter = getWriteSyscalls();
+
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "recording failed: %d\n", err);
+        return 1;
+    }
+
+    printf("%d s of %d fps video at %d bps%s in %" PRId64 " ms\n",
+            durationSecs, frameRate, bitRate, useAudio ? " with audio" : "",
+            elapsedUs / 1000);
+    printf("stop: %" PRId64 " ms to write the moov box%s\n",
+            finalizeUs / 1000, fastStart ? " in front" : "");
+    printf("cpu: %" PRId64 " us per second of media\n", cpuUs / durationSecs);
+    if (syscallsBefore >= 0 && syscallsAfter >= 0) {
+        printf("write syscalls: %" PRId64 " per second of media\n",
+                (syscallsAfter - syscallsBefore) / durationSecs);
+    } else {
+        printf("write syscalls: not available (no /proc/self/io)\n");
+    }
+
+    return 0;
+}
@@ -22,6 +22,7 @@
 #include <utils/List.h>
 #include <utils/Errors.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 #include <pthread.h>
 
 struct dirent;
@@ -75,9 +76,25 @@ struct MediaScanner {
     virtual MediaScanResult processFile(
             const char *path, const char *mimeType, MediaScannerClient &client) = 0;
 
+    // Reports the directories and regular files below |path| to |client|.
+    // Regular files the client wants batched, see
+    // MediaScannerClient::wantsBatchedScan(), are passed to processFiles()
+    // up to kMaxBatchSize at a time, the others to scanFile().
     virtual MediaScanResult processDirectory(
             const char *path, MediaScannerClient &client);
 
+    enum {
+        kMaxBatchSize = 32,
+    };
+
+    // Same as calling processFile() for each of |paths| in turn, without
+    // a mime type, and returns MEDIA_SCAN_RESULT_ERROR if any of them did.
+    // Each file is announced with MediaScannerClient::beginBatchedFile().
+    // Implementations may extract the metadata of several files at once,
+    // but report it to |client| on the calling thread and in order.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client);
+
     void setLocale(const char *locale);
 
     virtual MediaAlbumArt *extractAlbumArt(int fd) = 0;
@@ -95,7 +112,8 @@ private:
             char *path, int pathRemaining, MediaScannerClient &client, bool noMedia);
     MediaScanResult doProcessDirectoryEntry(
             char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
-            struct dirent* entry, char* fileSpot);
+            struct dirent* entry, char* fileSpot, Vector<String8> *batch);
+    MediaScanResult flushBatch(Vector<String8> *batch, MediaScannerClient &client);
     void loadSkipList();
     bool shouldSkipDirectory(char *path);
 
@@ -116,6 +134,20 @@ public:
 
     virtual status_t scanFile(const char* path, long long lastModified,
             long long fileSize, bool isDirectory, bool noMedia) = 0;
+
+    // MediaScanner::processDirectory() asks this for each regular file
+    // before reporting it. By default files go to scanFile(), which is
+    // expected to call MediaScanner::processFile() for those that need it.
+    // A client that can tell up front which files need scanning returns
+    // true for them instead, and gets them back through
+    // MediaScanner::processFiles(), which can scan several at once.
+    virtual bool wantsBatchedScan(const char* path, long long lastModified,
+            long long fileSize, bool noMedia);
+
+    // Called by MediaScanner::processFiles() before the metadata of |path|
+    // is reported.
+    virtual void beginBatchedFile(const char* path);
+
     virtual status_t handleStringTag(const char* name, const char* value) = 0;
     virtual status_t setMimeType(const char* mimeType) = 0;
 
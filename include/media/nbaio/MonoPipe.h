@@ -60,6 +60,13 @@ public:
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+            // In-place write, for a writer which produces its frames directly in the pipe.
+            // obtainWrite() returns up to count frames of contiguous free space at the rear of
+            // the pipe in *buffer, or 0 if the pipe is full. releaseWrite() then makes the first
+            // count of those frames available to the reader. Neither blocks nor throttles.
+            ssize_t obtainWrite(void **buffer, size_t count);
+            void    releaseWrite(size_t count);
+
     // MonoPipe's implementation of getNextWriteTimestamp works in conjunction
     // with MonoPipeReader.  Every time a MonoPipeReader reads from the pipe, it
     // receives a "readPTS" indicating the point in time for which the reader
@@ -53,12 +53,20 @@ public:
 
     // NBAIO_Source end
 
+            // In-place read, for a reader which consumes its frames directly from the pipe.
+            // obtainRead() returns up to count contiguous frames at the front of the pipe
+            // in *buffer, or 0 if the pipe is empty. releaseRead() then frees the first count
+            // of those frames for the writer. readPTS is as for read().
+            ssize_t obtainRead(void **buffer, size_t count, int64_t readPTS);
+            void    releaseRead(size_t count);
+
 #if 0   // until necessary
     MonoPipe* pipe() const { return mPipe; }
 #endif
 
 private:
     MonoPipe * const mPipe;
+    int64_t          mNextReadPTS;  // computed by obtainRead(), published by releaseRead()
 };
 
 }   // namespace android
@@ -25,6 +25,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 #include <drm/DrmManagerClient.h>
 
@@ -84,6 +85,10 @@ public:
 
     ////////////////////////////////////////////////////////////////////////////
 
+    // Runs the registered sniffers over a window of the source they all
+    // share, the ones that are likely to recognize the uri's extension
+    // first. Sniffers that can't beat the best confidence so far are
+    // skipped.
     bool sniff(String8 *mimeType, float *confidence, sp<AMessage> *meta);
 
     // The sniffer can optionally fill in "meta" with an AMessage containing
@@ -95,6 +100,10 @@ public:
 
     static void RegisterDefaultSniffers();
 
+    // Writes how often each sniffer ran and recognized the content, and
+    // how long it took.
+    static void DumpSniffers(int fd);
+
     // for DRM
     virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL) {
         return NULL;
@@ -111,11 +120,27 @@ protected:
     virtual ~DataSource() {}
 
 private:
+    struct Sniffer {
+        SnifferFunc mFunc;
+        const char *mName;
+        // The highest confidence the sniffer ever reports.
+        float mMaxConfidence;
+        // Space separated file name extensions, like "mp4 m4a".
+        const char *mExtensions;
+
+        size_t mNumCalls;
+        size_t mNumHits;
+        size_t mNumSkips;
+        int64_t mTotalTimeUs;
+    };
+
     static Mutex gSnifferMutex;
-    static List<SnifferFunc> gSniffers;
+    static Vector<Sniffer> gSniffers;
     static bool gSniffersRegistered;
 
-    static void RegisterSniffer_l(SnifferFunc func);
+    static void RegisterSniffer_l(
+            SnifferFunc func, const char *name, float maxConfidence,
+            const char *extensions);
 
     DataSource(const DataSource &);
     DataSource &operator=(const DataSource &);
@@ -22,6 +22,8 @@
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/List.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -34,7 +36,16 @@ struct MPEG2TSWriter : public MediaWriter {
             void *cookie,
             ssize_t (*write)(void *cookie, const void *data, size_t size));
 
+    // Adds |source| to program number 1.
     virtual status_t addSource(const sp<MediaSource> &source);
+
+    // Adds |source| to the program with the given number (1..65535), which
+    // is created if needed. Each program gets its own PMT and PCR PID.
+    status_t addSource(const sp<MediaSource> &source, unsigned programNumber);
+
+    // If |param| has kKeyMuxRate, the transport stream is sent out at that
+    // constant rate in real time, with a PCR on every program at least
+    // every 40 ms and null packets filling the gaps.
     virtual status_t start(MetaData *param = NULL);
     virtual status_t stop() { return reset(); }
     virtual status_t pause();
@@ -48,11 +59,28 @@ protected:
 
 private:
     enum {
-        kWhatSourceNotify = 'noti'
+        kWhatSourceNotify = 'noti',
+        kWhatDrain        = 'drai',
+    };
+
+    enum {
+        kTSPacketSize = 188,
+        // as many packets as fit in an ethernet frame carrying them over UDP
+        kPacketsPerWrite = 7,
     };
 
     struct SourceInfo;
 
+    struct Program {
+        unsigned mProgramNumber;
+        unsigned mPMTPID;
+        unsigned mPCRPID;
+        int mPMTContinuityCounter;
+        int mPCRContinuityCounter;
+        Vector<size_t> mSourceIndices;
+        int64_t mNextPCRTimeUs;
+    };
+
     FILE *mFile;
 
     void *mWriteCookie;
@@ -63,24 +91,61 @@ private:
 
     bool mStarted;
 
+    // Guards the output state against reset() called while the looper is
+    // still delivering access units.
+    Mutex mLock;
+
     Vector<sp<SourceInfo> > mSources;
+    Vector<Program> mPrograms;
     size_t mNumSourcesDone;
 
-    int64_t mNumTSPacketsWritten;
-    int64_t mNumTSPacketsBeforeMeta;
+    bool mWroteTables;
     int mPATContinuityCounter;
-    int mPMTContinuityCounter;
     uint32_t mCrcTable[256];
 
+    // Packets are handed to the output in groups of kPacketsPerWrite.
+    uint8_t mOutputBuffer[kTSPacketSize * kPacketsPerWrite];
+    size_t mOutputPackets;
+
+    // Paced output (kKeyMuxRate). Packetized access units wait in
+    // mPendingPackets until the scheduler gives them a slot; the system
+    // time clock runs from mStartSTCUs at the first slot, which is sent
+    // at mStartTimeUs.
+    int32_t mMuxRate;
+    List<sp<ABuffer> > mPendingPackets;
+    size_t mNumPendingPackets;
+    int64_t mNumPacedPackets;
+    int64_t mStartTimeUs;
+    int64_t mStartSTCUs;
+    int64_t mNextPSITimeUs;
+    size_t mNumPSIPacketsDue;
+    int32_t mDrainGeneration;
+    bool mPacingStarted;
+    bool mOutputDrained;
+    bool mWarnedOverflow;
+
     void init();
 
+    void writeEarliestAccessUnit();
     void writeTS();
     void writeProgramAssociationTable();
-    void writeProgramMap();
+    void writeProgramMap(size_t programIndex);
     void writeAccessUnit(int32_t sourceIndex, const sp<ABuffer> &buffer);
+    void writePCR(size_t programIndex, int64_t PCR);
+    void writeNullPacket();
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t length);
 
+    void queueESPacket(const uint8_t *packet);
+    void writePendingPacket();
+    void writePacket(const uint8_t *packet);
+    void flushOutput();
+
+    void startPacing(int64_t firstTimeUs);
+    void drainPacedOutput();
+    void writeNextPacedPacket();
+    int64_t getSlotTicks(int64_t packetIndex) const;
+
     ssize_t internalWrite(const void *data, size_t size);
     status_t reset();
 
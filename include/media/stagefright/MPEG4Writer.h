@@ -27,6 +27,7 @@
 namespace android {
 
 class AMessage;
+struct BufferedFileWriter;
 class MediaBuffer;
 class MediaSource;
 class MetaData;
@@ -64,6 +65,11 @@ public:
     int32_t getTimeScale() const { return mTimeScale; }
 
     status_t setGeoData(int latitudex10000, int longitudex10000);
+    // Adds an entry to the edit list of the |trackIndex|-th track added,
+    // which then presents |durationUs| of its media from |mediaTimeUs| on,
+    // or nothing for |durationUs| if |mediaTimeUs| is -1. Media time 0 is
+    // the track's first sample. Has to be called before start().
+    status_t addEditListEntry(size_t trackIndex, int64_t mediaTimeUs, int64_t durationUs);
     status_t setCaptureRate(float captureFps);
     virtual void setStartTimeOffsetMs(int ms) { mStartTimeOffsetMs = ms; }
     virtual int32_t getStartTimeOffsetMs() const { return mStartTimeOffsetMs; }
@@ -75,6 +81,7 @@ private:
     class Track;
 
     int  mFd;
+    BufferedFileWriter *mOutput;  // all file output goes through this
     status_t mInitCheck;
     bool mIsRealTimeRecording;
     bool mUse4ByteNalLength;
@@ -85,11 +92,10 @@ private:
     bool mWriterThreadStarted;  // Only writer thread started successfully
     off64_t mOffset;
     off_t mMdatOffset;
-    uint8_t *mMoovBoxBuffer;
-    off64_t mMoovBoxBufferOffset;
-    bool  mWriteMoovBoxToMemory;
+    bool mMeasuringMoovBox;  // moov box content is only counted, not written
     off64_t mFreeBoxOffset;
     bool mStreamableFile;
+    bool mFastStart;         // make room for the moov box at the front if needed
     off64_t mEstimatedMoovBoxSize;
     off64_t mMoovExtraSize;
     uint32_t mInterleaveDurationUs;
@@ -100,6 +106,13 @@ private:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
 
+    // Fragmented (moof/mdat) recording, enabled by kKeyFragmentDurationUs
+    int64_t mFragmentDurationUs;
+    int64_t mFragmentStartUs;       // movie time the next fragment starts at
+    uint32_t mFragmentSequenceNumber;
+    bool mWroteFragmentedMoov;
+    off64_t mMehdOffset;            // where the total duration goes at the end
+
     Mutex mLock;
 
     List<Track *> mTracks;
@@ -127,6 +140,32 @@ private:
         }
 
     };
+
+    // A sample of a fragmented recording, described by its 'trun' entry
+    struct FragmentSample {
+        MediaBuffer *mBuffer;
+        int64_t mTimeUs;                  // Decoding time since the track start
+        int64_t mDecodingTicks;           // Same, in the track time scale
+        uint32_t mSize;                   // Including the NAL length prefix
+        uint32_t mDurationTicks;
+        int32_t mCompositionOffsetTicks;
+        bool mIsSync;
+
+        FragmentSample()
+            : mBuffer(NULL), mTimeUs(0), mDecodingTicks(0), mSize(0),
+              mDurationTicks(0), mCompositionOffsetTicks(0), mIsSync(false) {}
+    };
+
+    // The samples of one track that go into the next movie fragment
+    struct TrackFragment {
+        Track                   *mTrack;
+        int64_t                 mStartOffsetUs;   // Track start in movie time
+        off64_t                 mDataOffsetPos;   // Where 'trun' data offset goes
+        List<FragmentSample>    mSamples;
+
+        TrackFragment(): mTrack(NULL), mStartOffsetUs(0), mDataOffsetPos(0) {}
+    };
+
     struct ChunkInfo {
         Track               *mTrack;        // Owner
         List<Chunk>         mChunks;        // Remaining chunks to be written
@@ -137,6 +176,11 @@ private:
         // Max time interval between neighboring chunks
         int64_t mMaxInterChunkDurUs;
 
+        // Samples not yet written to a fragment, in decoding order
+        List<FragmentSample> mFragmentSamples;
+
+        // Whether the track has handed over all its fragment samples
+        bool mFragmentEOS;
     };
 
     bool            mIsFirstChunk;
@@ -164,6 +208,24 @@ private:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
+
+    // Hand a sample whose duration is known over to the writer thread.
+    void bufferFragmentSample(Track *track, const FragmentSample &sample);
+
+    // The track will not buffer any more fragment samples.
+    void signalFragmentEOS(Track *track);
+
+    // Take the samples of the next fragment once every track has
+    // buffered up to where it ends. With |flush|, the tracks are done and
+    // whatever is left is taken. The fragment may be empty.
+    // Return true if a fragment is found; otherwise, return false.
+    bool findFragmentToWrite(bool flush, List<TrackFragment> *fragment);
+
+    // Write the given fragment as a 'moof' and an 'mdat' box. The moov
+    // box is written ahead of the first fragment.
+    void writeFragment(List<TrackFragment> *fragment);
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -196,6 +258,9 @@ private:
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    off64_t getMoovBoxSize(int64_t durationUs);
+    status_t makeRoomForMoovBox(off64_t moovBoxSize);
+    void writeMvexBox();
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
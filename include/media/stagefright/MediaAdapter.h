@@ -21,6 +21,7 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -54,8 +55,17 @@ public:
 
     // pushBuffer() will wait for the read() finish, and read() will have a
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
+    // In queued mode it only waits while |maxQueuedBuffers| pushed buffers
+    // have not come back yet; the reader holds on to the buffer's data until
+    // it releases the buffer.
     status_t pushBuffer(MediaBuffer *buffer);
 
+    // Switches to queued mode if |maxQueuedBuffers| > 0. Call before start().
+    void setMaxQueuedBuffers(size_t maxQueuedBuffers);
+
+    // Waits until the reader has returned all the pushed buffers, or stop().
+    void waitForBuffersReturned();
+
 private:
     Mutex mAdapterLock;
     // Make sure the read() wait for the incoming buffer.
@@ -63,7 +73,11 @@ private:
     // Make sure the pushBuffer() wait for the current buffer consumed.
     Condition mBufferReturnedCond;
 
-    MediaBuffer *mCurrentMediaBuffer;
+    // Pushed buffers not read yet.
+    List<MediaBuffer *> mQueuedBuffers;
+    // Pushed buffers not returned yet, read or not.
+    size_t mNumBuffersInFlight;
+    size_t mMaxQueuedBuffers;
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
@@ -22,6 +22,7 @@
 
 namespace android {
 
+struct AMessage;
 class DataSource;
 class MediaSource;
 class MetaData;
@@ -31,6 +32,12 @@ public:
     static sp<MediaExtractor> Create(
             const sp<DataSource> &source, const char *mime = NULL);
 
+    // For callers that sniffed the source already, |sniffMeta| is the meta
+    // the sniffer returned along with |mime|.
+    static sp<MediaExtractor> Create(
+            const sp<DataSource> &source, const char *mime,
+            const sp<AMessage> &sniffMeta);
+
     virtual size_t countTracks() = 0;
     virtual sp<MediaSource> getTrack(size_t index) = 0;
 
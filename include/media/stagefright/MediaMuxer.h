@@ -47,6 +47,9 @@ public:
     enum OutputFormat {
         OUTPUT_FORMAT_MPEG_4 = 0,
         OUTPUT_FORMAT_WEBM   = 1,
+        // moof/mdat fragments instead of a single moov box at the end, so
+        // that the file is playable while, or after an interrupted, muxing
+        OUTPUT_FORMAT_MPEG_4_FRAGMENTED = 2,
         OUTPUT_FORMAT_LIST_END // must be last - used to validate format type
     };
 
@@ -88,6 +91,39 @@ public:
      */
     status_t setLocation(int latitude, int longitude);
 
+    /**
+     * Add an entry to a track's edit list, which decides what part of the
+     * track's media is presented when. This has to be called before start(),
+     * and is only supported for .mp4 output.
+     * @param trackIndex the track's index.
+     * @param mediaTimeUs where the entry starts in the track's media, the
+     *                    time stamps of which start with 0 at its first
+     *                    sample, or -1 to present nothing for durationUs.
+     * @param durationUs how long the entry is presented for.
+     * @return OK if no error.
+     */
+    status_t addEditListEntry(size_t trackIndex, int64_t mediaTimeUs, int64_t durationUs);
+
+    /**
+     * Let writeSampleData() return before the sample is consumed, as long
+     * as no more than maxSamples samples of the track are pending. The
+     * muxer then refers to the buffers passed to writeSampleData() until
+     * it is done with them, so they must not be modified afterwards.
+     * This has to be called before start().
+     * @param maxSamples the number of pending samples per track, or 0 to
+     *                   wait for each sample to be consumed (the default).
+     * @return OK if no error.
+     */
+    status_t setMaxQueuedSamples(size_t maxSamples);
+
+    /**
+     * Wait until the muxer is done with the buffers passed to
+     * writeSampleData(), so that they can be modified or freed.
+     * Only needed when setMaxQueuedSamples() was used.
+     * @return OK if no error.
+     */
+    status_t waitForQueuedSamples();
+
     /**
      * Stop muxing.
      * This method is a blocking call. Depending on how
@@ -100,7 +136,8 @@ public:
 
     /**
      * Send a sample buffer for muxing.
-     * The buffer can be reused once this method returns. Typically,
+     * The buffer can be reused once this method returns, unless
+     * setMaxQueuedSamples() was used. Typically,
      * this function won't be blocked for very long, and thus there
      * is no need to use a separate thread calling this method to
      * push a buffer.
@@ -119,6 +156,7 @@ private:
     sp<MediaWriter> mWriter;
     Vector< sp<MediaAdapter> > mTrackList;  // Each track has its MediaAdapter.
     sp<MetaData> mFileMeta;  // Metadata for the whole file.
+    size_t mMaxQueuedSamples;
 
     Mutex mMuxerLock;
 
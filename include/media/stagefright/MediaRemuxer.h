@@ -0,0 +1,110 @@
+/*
+ * Copyright 2015, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_REMUXER_H_
+#define MEDIA_REMUXER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct AMessage;
+struct NuMediaExtractor;
+
+// MediaRemuxer cuts time ranges out of one or more files and joins them
+// into a new .mp4 file without decoding them. The media data copied for a
+// range starts at the sync sample before it and ends at the sync sample
+// after it, the edit lists of the output then make playback start and end
+// on the requested times. Ranges of different files can only be joined if
+// the files' tracks have the same formats.
+// The expected calling order of the functions is:
+// Constructor -> addSegment+ -> remux
+struct MediaRemuxer : public RefBase {
+public:
+    // Construct the remuxer with the output file descriptor, which may be
+    // closed right away. The first audio and/or the first video track of
+    // the input files are copied.
+    MediaRemuxer(int fd, MediaMuxer::OutputFormat format, bool useAudio, bool useVideo);
+
+    virtual ~MediaRemuxer();
+
+    /**
+     * Append a time range of a file to the output.
+     * @param path the input file.
+     * @param startUs where the range starts.
+     * @param endUs where the range ends, or -1 for the end of the file.
+     * @return OK if no error, ERROR_UNSUPPORTED if the file's tracks don't
+     *         match those of the first file.
+     */
+    status_t addSegment(const char *path, int64_t startUs, int64_t endUs);
+
+    /**
+     * Let the muxer queue up samples, see MediaMuxer::setMaxQueuedSamples().
+     * Each sample is copied once then, otherwise the samples are handed to
+     * the muxer straight out of the extractors.
+     */
+    status_t setMaxQueuedSamples(size_t maxSamples);
+
+    /**
+     * Write the output file. This method is a blocking call.
+     * @return OK if no error.
+     */
+    status_t remux();
+
+    size_t getNumSamplesWritten() const { return mNumSamplesWritten; }
+
+private:
+    // What is copied of one track of a segment.
+    struct Cut {
+        int64_t mSyncTimeUs;     // first sample, -1 if there is none
+        int64_t mEndTimeUs;      // first sample not to copy, or the track's end
+        int64_t mMediaTimeUs;    // where the first sample goes in the output
+    };
+
+    struct Segment {
+        sp<NuMediaExtractor> mExtractor;
+        Vector<size_t> mTrackIndices;  // extractor track of each output track
+        Vector<int64_t> mTrackDurationsUs;
+        Vector<Cut> mCuts;
+        int64_t mStartUs;
+        int64_t mEndUs;
+    };
+
+    sp<MediaMuxer> mMuxer;
+    bool mUseAudio;
+    bool mUseVideo;
+    size_t mMaxQueuedSamples;
+    bool mStarted;
+    size_t mNumSamplesWritten;
+
+    Vector<sp<AMessage> > mTrackFormats;  // of the output tracks
+    Vector<Segment> mSegments;
+
+    status_t planSegment(Segment *segment, Vector<int64_t> *mediaEndTimesUs);
+    status_t copySegment(const Segment &segment);
+
+    static bool isCompatible(const sp<AMessage> &format, const sp<AMessage> &other);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaRemuxer);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_REMUXER_H_
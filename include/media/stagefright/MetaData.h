@@ -112,6 +112,18 @@ enum {
     kKey64BitFileOffset   = 'fobt',  // int32_t (bool)
     kKey2ByteNalLength    = '2NAL',  // int32_t (bool)
 
+    // Set this key to author a fragmented mp4 file, with a movie fragment
+    // starting about every this many microseconds
+    kKeyFragmentDurationUs = 'frgd',  // int64_t
+
+    // Set this key to always put the moov box in front of the media data,
+    // moving the media data if the space reserved for it is too small
+    kKeyFastStart         = 'fsta',  // int32_t (bool)
+
+    // Set this key to have MPEG2TSWriter pace its output in real time at
+    // this constant rate, stuffing with null packets
+    kKeyMuxRate           = 'muxr',  // int32_t (bps)
+
     // Identify the file output format for authoring
     // Please see <media/mediarecorder.h> for the supported
     // file output formats.
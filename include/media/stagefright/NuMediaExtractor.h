@@ -69,6 +69,13 @@ struct NuMediaExtractor : public RefBase {
 
     status_t advance();
     status_t readSampleData(const sp<ABuffer> &buffer);
+
+    // Like readSampleData(), but without copying: the returned buffer refers
+    // to the extractor's memory, and holds a reference to it until released.
+    // It must be released before the track is unselected, since that frees
+    // the track's buffers. Not supported for Vorbis.
+    status_t getSampleData(sp<ABuffer> *buffer);
+
     status_t getSampleTrackIndex(size_t *trackIndex);
     status_t getSampleTime(int64_t *sampleTimeUs);
     status_t getSampleMeta(sp<MetaData> *sampleMeta);
@@ -19,6 +19,7 @@
 #define STAGEFRIGHT_MEDIA_SCANNER_H_
 
 #include <media/mediascanner.h>
+#include <utils/KeyedVector.h>
 
 namespace android {
 
@@ -30,15 +31,57 @@ struct StagefrightMediaScanner : public MediaScanner {
             const char *path, const char *mimeType,
             MediaScannerClient &client);
 
+    // Extracts the metadata of up to setMaxScanThreads() files at once.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client);
+
     virtual MediaAlbumArt *extractAlbumArt(int fd);
 
+    // Defaults to the number of CPUs, but no more than 4.
+    void setMaxScanThreads(size_t maxThreads);
+
+    // Where the time went while extracting metadata, summed up over all
+    // files scanned so far. The phases of files scanned in parallel overlap.
+    // Only files probed in process, which takes setting the
+    // media.stagefright.scan-in-process property, have their sniffing,
+    // parsing and reads accounted for.
+    struct PhaseTimes {
+        size_t mNumFiles;
+        size_t mNumFallbacks;  // files probed but handed to the media server
+        size_t mNumReads;      // reads of the files
+        size_t mNumBytesRead;
+        int64_t mOpenUs;
+        int64_t mSniffUs;
+        int64_t mParseUs;      // creating the extractor, finding the tracks
+        int64_t mTagsUs;       // ID3 and other tags
+    };
+    void getPhaseTimes(PhaseTimes *times);
+    void resetPhaseTimes();
+
 private:
+    struct FileMetadata {
+        MediaScanResult mResult;
+        KeyedVector<int, String8> mMetaData;  // by METADATA_KEY_*
+    };
+
+    struct Batch;
+
+    bool mProbeInProcess;
+    size_t mMaxScanThreads;
+
+    Mutex mPhaseTimesLock;
+    PhaseTimes mPhaseTimes;
+
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
 
-    MediaScanResult processFileInternal(
-            const char *path, const char *mimeType,
-            MediaScannerClient &client);
+    void extractMetadata(const char *path, FileMetadata *file);
+    status_t probeFile(int fd, off64_t size, FileMetadata *file, PhaseTimes *times);
+    status_t retrieveMetadata(int fd, const char *path, FileMetadata *file);
+    MediaScanResult reportMetadata(
+            const FileMetadata &file, MediaScannerClient &client);
+
+    static void *ThreadWrapper(void *me);
 };
 
 }  // namespace android
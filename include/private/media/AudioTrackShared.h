@@ -144,7 +144,9 @@ struct audio_track_cblk_t
                                         // "for entertainment purposes only",
                                         // which means don't make important decisions based on it.
 
-                uint32_t    mPad1;      // unused
+    volatile    int32_t     mFutexWaiters;  // number of client threads waiting, or about to
+                                        // wait, on mFutex.  The server only wakes the
+                                        // futex when this is non-zero.
 
     volatile    int32_t     mFutex;     // event flag: down (P) by client,
                                         // up (V) by server or binderDied() or interrupt()
@@ -216,6 +218,18 @@ protected:
     const bool      mClientInServer;    // true for OutputTrack, false for AudioTrack & AudioRecord
     bool            mIsShutdown;        // latch set to true when shared memory corruption detected
     size_t          mUnreleased;        // unreleased frames remaining from most recent obtainBuffer
+
+    // Statistics of futex syscalls, updated by the proxy owner without a lock and read racily
+    uint32_t        mFutexWaits;        // FUTEX_WAIT calls by client
+    uint32_t        mFutexWakes;        // FUTEX_WAKE calls by server
+    uint32_t        mFutexWakesAvoided; // wakes not needed by server, as no client was waiting
+    uint32_t        mSpinWakeups;       // client waits ended by spinning instead of FUTEX_WAIT
+
+public:
+    uint32_t    getFutexWaits() const { return mFutexWaits; }
+    uint32_t    getFutexWakes() const { return mFutexWakes; }
+    uint32_t    getFutexWakesAvoided() const { return mFutexWakesAvoided; }
+    uint32_t    getSpinWakeups() const { return mSpinWakeups; }
 };
 
 // ----------------------------------------------------------------------------
@@ -306,8 +320,18 @@ public:
 
     size_t      getFramesFilled();
 
+    // Low latency clients may poll the control block for up to spinNs before waiting on the
+    // futex in obtainBuffer(), which saves the server's FUTEX_WAKE and the client's
+    // FUTEX_WAIT when the server releases or fills frames within that time.  0 disables.
+    void        setSpinNs(nsecs_t spinNs) {
+        mSpinNs = spinNs;
+    }
+
 private:
+    bool        spinUntilChanged(volatile int32_t *index, int32_t value);
+
     size_t      mEpoch;
+    nsecs_t     mSpinNs;
 };
 
 // ----------------------------------------------------------------------------
@@ -462,6 +486,9 @@ public:
     virtual void        releaseBuffer(Buffer* buffer);
 
 protected:
+    // Wakes the client if it is waiting or about to wait on the futex.
+    void        wakeClient();
+
     size_t      mAvailToClient; // estimated frames available to client prior to releaseBuffer()
     int32_t     mFlush;         // our copy of cblk->u.mStreaming.mFlush, for streaming output only
 };
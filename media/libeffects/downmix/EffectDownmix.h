@@ -101,5 +101,9 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
 void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 bool Downmix_foldGeneric(
         uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+void Downmix_stripFloat(const float *pSrc, float *pDst, size_t numFrames,
+        uint32_t inputChannelCount, bool accumulate);
+bool Downmix_foldGenericFloat(
+        uint32_t mask, const float *pSrc, float *pDst, size_t numFrames, bool accumulate);
 
 #endif /*ANDROID_EFFECTDOWNMIX_H_*/
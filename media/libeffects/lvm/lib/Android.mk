@@ -2,11 +2,7 @@ LOCAL_PATH:= $(call my-dir)
 
 # Music bundle
 
-include $(CLEAR_VARS)
-
-LOCAL_ARM_MODE := arm
-
-LOCAL_SRC_FILES:= \
+music_bundle_src_files := \
     StereoWidening/src/LVCS_BypassMix.c \
     StereoWidening/src/LVCS_Control.c \
     StereoWidening/src/LVCS_Equaliser.c \
@@ -41,6 +37,7 @@ LOCAL_SRC_FILES:= \
     Common/src/DC_2I_D16_TRC_WRA_01.c \
     Common/src/DC_2I_D16_TRC_WRA_01_Init.c \
     Common/src/FO_2I_D16F32C15_LShx_TRC_WRA_01.c \
+    Common/src/FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD.c \
     Common/src/FO_2I_D16F32Css_LShx_TRC_WRA_01_Init.c \
     Common/src/FO_1I_D16F16C15_TRC_WRA_01.c \
     Common/src/FO_1I_D16F16Css_TRC_WRA_01_Init.c \
@@ -52,7 +49,9 @@ LOCAL_SRC_FILES:= \
     Common/src/BP_1I_D32F32Cll_TRC_WRA_02_Init.c \
     Common/src/BQ_2I_D32F32Cll_TRC_WRA_01_Init.c \
     Common/src/BQ_2I_D32F32C30_TRC_WRA_01.c \
+    Common/src/BQ_2I_D32F32C30_TRC_WRA_01_SIMD.c \
     Common/src/BQ_2I_D16F32C15_TRC_WRA_01.c \
+    Common/src/BQ_2I_D16F32C15_TRC_WRA_01_SIMD.c \
     Common/src/BQ_2I_D16F32C14_TRC_WRA_01.c \
     Common/src/BQ_2I_D16F32C13_TRC_WRA_01.c \
     Common/src/BQ_2I_D16F32Css_TRC_WRA_01_init.c \
@@ -65,6 +64,7 @@ LOCAL_SRC_FILES:= \
     Common/src/BQ_1I_D16F32Css_TRC_WRA_01_init.c \
     Common/src/PK_2I_D32F32C30G11_TRC_WRA_01.c \
     Common/src/PK_2I_D32F32C14G11_TRC_WRA_01.c \
+    Common/src/PK_2I_D32F32C14G11_TRC_WRA_01_SIMD.c \
     Common/src/PK_2I_D32F32CssGss_TRC_WRA_01_Init.c \
     Common/src/PK_2I_D32F32CllGss_TRC_WRA_01_Init.c \
     Common/src/Int16LShiftToInt32_16x32.c \
@@ -97,15 +97,15 @@ LOCAL_SRC_FILES:= \
     Common/src/LVC_Mixer_GetCurrent.c \
     Common/src/LVC_MixSoft_2St_D16C31_SAT.c \
     Common/src/LVC_Core_MixSoft_1St_D16C31_WRA.c \
+    Common/src/LVC_Core_MixSoft_1St_D16C31_WRA_SIMD.c \
     Common/src/LVC_Core_MixHard_2St_D16C31_SAT.c \
+    Common/src/LVC_Core_MixHard_2St_D16C31_SAT_SIMD.c \
     Common/src/LVC_MixInSoft_D16C31_SAT.c \
     Common/src/AGC_MIX_VOL_2St1Mon_D32_WRA.c \
     Common/src/LVM_Timer.c \
     Common/src/LVM_Timer_Init.c
 
-LOCAL_MODULE:= libmusicbundle
-
-LOCAL_C_INCLUDES += \
+music_bundle_c_includes := \
     $(LOCAL_PATH)/Eq/lib \
     $(LOCAL_PATH)/Eq/src \
     $(LOCAL_PATH)/Bass/lib \
@@ -119,10 +119,34 @@ LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/StereoWidening/src \
     $(LOCAL_PATH)/StereoWidening/lib
 
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= $(music_bundle_src_files)
+
+LOCAL_MODULE:= libmusicbundle
+
+LOCAL_C_INCLUDES += $(music_bundle_c_includes)
+
 LOCAL_CFLAGS += -fvisibility=hidden
 
 include $(BUILD_STATIC_LIBRARY)
 
+# Music bundle for the host, used by the kernel benchmark
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= $(music_bundle_src_files)
+
+LOCAL_MODULE:= libmusicbundle
+
+LOCAL_C_INCLUDES += $(music_bundle_c_includes)
+
+LOCAL_CFLAGS += -fvisibility=hidden
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
 
 
 # Reverb library
@@ -25,6 +25,7 @@
 #include "LVDBE_Private.h"
 #include "VectorArithmetic.h"
 #include "AGC.h"
+#include "LVM_Simd.h"
 #include "LVDBE_Coeffs.h"               /* Filter coefficients */
 
 
@@ -123,10 +124,10 @@ LVDBE_ReturnStatus_en LVDBE_Process(LVDBE_Handle_t            hInstance,
          */
         if (pInstance->Params.HPFSelect == LVDBE_HPF_ON)
         {
-              BQ_2I_D32F32C30_TRC_WRA_01(&pInstance->pCoef->HPFInstance,/* Filter instance      */
-                                       (LVM_INT32 *)pScratch,           /* Source               */
-                                       (LVM_INT32 *)pScratch,           /* Destination          */
-                                       (LVM_INT16)NumSamples);          /* Number of samples    */
+              LVM_SIMD_KERNEL(BQ_2I_D32F32C30_TRC_WRA_01)(&pInstance->pCoef->HPFInstance,/* Filter instance      */
+                                                        (LVM_INT32 *)pScratch,           /* Source               */
+                                                        (LVM_INT32 *)pScratch,           /* Destination          */
+                                                        (LVM_INT16)NumSamples);          /* Number of samples    */
         }
 
 
@@ -25,6 +25,7 @@
 #include "LVM_Private.h"
 #include "VectorArithmetic.h"
 #include "LVM_Coeffs.h"
+#include "LVM_Simd.h"
 
 /****************************************************************************************/
 /*                                                                                      */
@@ -220,10 +221,10 @@ LVM_ReturnStatus_en LVM_Process(LVM_Handle_t                hInstance,
                 /*
                  * Apply the filter
                  */
-                FO_2I_D16F32C15_LShx_TRC_WRA_01(&pInstance->pTE_State->TrebleBoost_State,
-                                           pProcessed,
-                                           pProcessed,
-                                           (LVM_INT16)SampleCount);
+                LVM_SIMD_KERNEL(FO_2I_D16F32C15_LShx_TRC_WRA_01)(&pInstance->pTE_State->TrebleBoost_State,
+                                                            pProcessed,
+                                                            pProcessed,
+                                                            (LVM_INT16)SampleCount);
 
             }
 
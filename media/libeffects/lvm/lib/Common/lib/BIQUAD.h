@@ -30,7 +30,10 @@ extern "C" {
 
 typedef struct
 {
-    LVM_INT32 Storage[6];
+    /* Laid out as the largest filter state, a pointer to the delays and five 32 bit
+       coefficients, so that it is big enough and aligned for 64 bit pointers too */
+    LVM_INT32 *pStorage;
+    LVM_INT32 Storage[5];
 
 } Biquad_Instance_t;
 
@@ -163,6 +166,11 @@ void BQ_2I_D16F32C15_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT16                    *pDataOut,
                                             LVM_INT16                    NrSamples);
 
+void BQ_2I_D16F32C15_TRC_WRA_01_SIMD (      Biquad_Instance_t       *pInstance,
+                                            LVM_INT16                    *pDataIn,
+                                            LVM_INT16                    *pDataOut,
+                                            LVM_INT16                    NrSamples);
+
 void BQ_2I_D16F32C14_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT16                    *pDataIn,
                                             LVM_INT16                    *pDataOut,
@@ -216,6 +224,11 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT32                    *pDataOut,
                                             LVM_INT16                    NrSamples);
 
+void BQ_2I_D32F32C30_TRC_WRA_01_SIMD (      Biquad_Instance_t       *pInstance,
+                                            LVM_INT32                    *pDataIn,
+                                            LVM_INT32                    *pDataOut,
+                                            LVM_INT16                    NrSamples);
+
 /**********************************************************************************
    FUNCTION PROTOTYPES: FIRST ORDER FILTERS
 ***********************************************************************************/
@@ -240,6 +253,11 @@ void FO_2I_D16F32C15_LShx_TRC_WRA_01(Biquad_Instance_t       *pInstance,
                                      LVM_INT16               *pDataOut,
                                      LVM_INT16               NrSamples);
 
+void FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD(Biquad_Instance_t       *pInstance,
+                                          LVM_INT16               *pDataIn,
+                                          LVM_INT16               *pDataOut,
+                                          LVM_INT16               NrSamples);
+
 /*** 32 bit data path *************************************************************/
 
 void FO_1I_D32F32Cll_TRC_WRA_01_Init(       Biquad_Instance_t       *pInstance,
@@ -308,6 +326,11 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 (        Biquad_Instance_t       *pInstance,
                                             LVM_INT32                    *pDataOut,
                                             LVM_INT16                    NrSamples);
 
+void PK_2I_D32F32C14G11_TRC_WRA_01_SIMD (   Biquad_Instance_t       *pInstance,
+                                            LVM_INT32                    *pDataIn,
+                                            LVM_INT32                    *pDataOut,
+                                            LVM_INT16                    NrSamples);
+
 
 /**********************************************************************************
    FUNCTION PROTOTYPES: DC REMOVAL FILTERS
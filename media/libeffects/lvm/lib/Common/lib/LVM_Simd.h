@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LVM_SIMD_H_
+#define _LVM_SIMD_H_
+
+#include "LVM_Types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**********************************************************************************
+   SIMD KERNELS
+
+   The _SIMD kernels process several samples, or both channels of a stereo filter,
+   per operation using the compiler vector extensions, which map to NEON on ARM and
+   to SSE on x86. They are bit exact with the reference kernels of the same name:
+   the fixed point arithmetic of LVM_Macros.h is done per lane, with the same
+   partial products, shifts and wrap arounds.
+
+   LVM_SIMD_KERNEL(Kernel) names the kernel the library uses: the _SIMD kernel when
+   the target has NEON, and the reference kernel if not. Out of order x86 cores
+   already run the two channels of the scalar filters in parallel, so only the
+   mixers gain there. Define LVM_NO_SIMD to build the library with the reference
+   kernels only.
+***********************************************************************************/
+
+#if !defined(LVM_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define LVM_SIMD_KERNEL(Kernel)     Kernel##_SIMD
+#else
+#define LVM_SIMD_KERNEL(Kernel)     Kernel
+#endif
+
+typedef LVM_INT32   LVM_INT32x2     __attribute__ ((vector_size (8)));
+typedef LVM_INT32   LVM_INT32x4     __attribute__ ((vector_size (16)));
+
+/**********************************************************************************
+   LVM_Mul32x16x2(A,B,ShiftR)
+        MUL32x16INTO32(A,B,C,ShiftR) on each lane: C = (A * B) >> ShiftR
+
+        A and C are 32 bit SIGNED numbers.  B is a 16 bit SIGNED number.
+        ShiftR can vary from 0 to 48
+***********************************************************************************/
+static inline LVM_INT32x2 LVM_Mul32x16x2(LVM_INT32x2 A, LVM_INT32x2 B, const LVM_INT32 ShiftR)
+{
+    const LVM_INT32x2 Mask = {0x0000FFFF, 0x0000FFFF};
+    LVM_INT32x2 HH = B * (A >> 16);
+    LVM_INT32x2 LL = (A & Mask) * B;
+
+    if (ShiftR < 16)
+    {
+        return (HH << (16 - ShiftR)) + (LL >> ShiftR);
+    }
+    else if (ShiftR < 32)
+    {
+        return (HH >> (ShiftR - 16)) + (LL >> ShiftR);
+    }
+    return HH >> (ShiftR - 16);
+}
+
+/**********************************************************************************
+   LVM_Mul32x32x2(A,B,ShiftR)
+        MUL32x32INTO32(A,B,C,ShiftR) on each lane: C = (A * B) >> ShiftR
+
+        A, B and C are all 32 bit SIGNED numbers and ShiftR can vary from 0 to 64
+***********************************************************************************/
+static inline LVM_INT32x2 LVM_Mul32x32x2(LVM_INT32x2 A, LVM_INT32x2 B, const LVM_INT32 ShiftR)
+{
+    const LVM_INT32x2 Mask = {0x0000FFFF, 0x0000FFFF};
+    const LVM_INT32x2 AH = A >> 16;
+    const LVM_INT32x2 BH = B >> 16;
+    const LVM_INT32x2 AL = A & Mask;
+    const LVM_INT32x2 BL = B & Mask;
+    LVM_INT32x2 HH = AH * BH;
+    LVM_INT32x2 HL = BL * AH;
+    LVM_INT32x2 LH = AL * BH;
+    LVM_INT32x2 LL = AL * BL;
+    LVM_INT32x2 Temp = (HL & Mask) + (LH & Mask) + ((LL >> 16) & Mask);
+
+    HH = HH + (HL >> 16) + (LH >> 16) + (Temp >> 16);
+    LL = LL + (HL << 16) + (LH << 16);
+    if (ShiftR < 32)
+    {
+        const LVM_INT32 LowMask = ((LVM_INT32)1 << (32 - ShiftR)) - 1;
+        const LVM_INT32x2 LowMask2 = {LowMask, LowMask};
+        return (HH << (32 - ShiftR)) | ((LL >> ShiftR) & LowMask2);
+    }
+    return HH >> (ShiftR - 32);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _LVM_SIMD_H_ */
@@ -44,7 +44,10 @@ extern "C" {
 
 typedef struct
 {
-    LVM_INT32 Storage[6];
+    /* Laid out as LVM_Timer_Instance_Private_t, two 32 bit values followed by
+       pointers, so that it is big enough and aligned for 64 bit pointers too */
+    LVM_INT32 Storage[2];
+    void      *pStorage[4];
 
 } LVM_Timer_Instance_t;
 
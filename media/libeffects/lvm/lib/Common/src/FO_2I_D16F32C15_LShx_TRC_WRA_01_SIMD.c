@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+#include "FO_2I_D16F32Css_LShx_TRC_WRA_01_Private.h"
+#include "LVM_Simd.h"
+
+/**************************************************************************
+ Same shelving filter as FO_2I_D16F32C15_LShx_TRC_WRA_01(), with the left and
+ right channels in the two lanes of a vector and the delays kept in registers
+ for the whole buffer.
+
+ DELAYS-
+ pBiquadState->pDelays[0] is x(n-1)L in Q15 format
+ pBiquadState->pDelays[1] is y(n-1)L in Q30 format
+ pBiquadState->pDelays[2] is x(n-1)R in Q15 format
+ pBiquadState->pDelays[3] is y(n-1)R in Q30 format
+***************************************************************************/
+
+void FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD(Biquad_Instance_t       *pInstance,
+                                          LVM_INT16               *pDataIn,
+                                          LVM_INT16               *pDataOut,
+                                          LVM_INT16               NrSamples)
+    {
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        LVM_INT32 *pDelays = pBiquadState->pDelays;
+        const LVM_INT32x2 A1 = {pBiquadState->coefs[0], pBiquadState->coefs[0]};
+        const LVM_INT32x2 A0 = {pBiquadState->coefs[1], pBiquadState->coefs[1]};
+        const LVM_INT32x2 B1 = {pBiquadState->coefs[2], pBiquadState->coefs[2]};
+        const LVM_INT32x2 Max = {LVM_MAXINT_16, LVM_MAXINT_16};
+        const LVM_INT32x2 Min = {-LVM_MAXINT_16 - 1, -LVM_MAXINT_16 - 1};
+        const LVM_INT16 Shift = pBiquadState->Shift;
+        LVM_INT32x2 Xn1 = {pDelays[0], pDelays[2]};
+        LVM_INT32x2 Yn1 = {pDelays[1], pDelays[3]};
+        LVM_INT32x2 Xn, Yn, Over, Under;
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            Xn = (LVM_INT32x2){pDataIn[0], pDataIn[1]};
+            pDataIn += 2;
+
+            /* yn = A1 (Q15) * x(n-1) (Q15) + A0 (Q15) * x(n) (Q15)
+                    + (-B1 (Q15) * y(n-1) (Q30)) >> 15 in Q30 */
+            Yn = A1 * Xn1 + A0 * Xn + LVM_Mul32x16x2(Yn1, B1, 15);
+
+            Yn1 = Yn;
+            Xn1 = Xn;
+
+            /* Right shift of (15-shift) instead of left shift on the 16-bit result,
+               then saturate, the comparisons give all ones in the lanes out of range */
+            Yn = Yn >> (15 - Shift);
+            Over = Yn > Max;
+            Under = Yn < Min;
+            Yn = (Yn & ~(Over | Under)) | (Max & Over) | (Min & Under);
+
+            pDataOut[0] = (LVM_INT16)Yn[0];
+            pDataOut[1] = (LVM_INT16)Yn[1];
+            pDataOut += 2;
+        }
+
+        pDelays[0] = Xn1[0];
+        pDelays[1] = Yn1[0];
+        pDelays[2] = Xn1[1];
+        pDelays[3] = Yn1[1];
+    }
+
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**********************************************************************************
+   INCLUDE FILES
+***********************************************************************************/
+
+#include "LVC_Mixer_Private.h"
+#include "LVM_Simd.h"
+
+/**********************************************************************************
+   FUNCTION LVCore_MIXHARD_2ST_D16C31_SAT_SIMD
+
+   Same mix as LVC_Core_MixHard_2St_D16C31_SAT(), four samples at a time.
+***********************************************************************************/
+
+void LVC_Core_MixHard_2St_D16C31_SAT_SIMD( LVMixer3_st *ptrInstance1,
+                                    LVMixer3_st         *ptrInstance2,
+                                    const LVM_INT16     *src1,
+                                    const LVM_INT16     *src2,
+                                          LVM_INT16     *dst,
+                                          LVM_INT16     n)
+{
+    LVM_INT32  Temp;
+    LVM_INT16 ii;
+    LVM_INT16 Current1Short;
+    LVM_INT16 Current2Short;
+    Mix_Private_st  *pInstance1=(Mix_Private_st *)(ptrInstance1->PrivateParams);
+    Mix_Private_st  *pInstance2=(Mix_Private_st *)(ptrInstance2->PrivateParams);
+    LVM_INT32x4 Gain1, Gain2, In1, In2, Out, Over, Under;
+    const LVM_INT32x4 Max = {0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF};
+    const LVM_INT32x4 Min = {-0x8000, -0x8000, -0x8000, -0x8000};
+
+
+    Current1Short = (LVM_INT16)(pInstance1->Current >> 16);
+    Current2Short = (LVM_INT16)(pInstance2->Current >> 16);
+    Gain1 = (LVM_INT32x4){Current1Short, Current1Short, Current1Short, Current1Short};
+    Gain2 = (LVM_INT32x4){Current2Short, Current2Short, Current2Short, Current2Short};
+
+    for (ii = (LVM_INT16)(n >> 2); ii != 0; ii--){
+        In1 = (LVM_INT32x4){src1[0], src1[1], src1[2], src1[3]};
+        In2 = (LVM_INT32x4){src2[0], src2[1], src2[2], src2[3]};
+        src1 += 4;
+        src2 += 4;
+
+        Out = ((In1 * Gain1) >> 15) + ((In2 * Gain2) >> 15);
+
+        /* Saturate to 16 bits, the comparisons give all ones in the lanes out of range */
+        Over = Out > Max;
+        Under = Out < Min;
+        Out = (Out & ~(Over | Under)) | (Max & Over) | (Min & Under);
+
+        dst[0] = (LVM_INT16)Out[0];
+        dst[1] = (LVM_INT16)Out[1];
+        dst[2] = (LVM_INT16)Out[2];
+        dst[3] = (LVM_INT16)Out[3];
+        dst += 4;
+    }
+
+    for (ii = (LVM_INT16)(n & 3); ii != 0; ii--){
+        Temp = (((LVM_INT32)*(src1++) * (LVM_INT32)Current1Short)>>15) +
+               (((LVM_INT32)*(src2++) * (LVM_INT32)Current2Short)>>15);
+        if (Temp > 0x00007FFF)
+            *dst++ = 0x7FFF;
+        else if (Temp < -0x00008000)
+            *dst++ = - 0x8000;
+        else
+            *dst++ = (LVM_INT16)Temp;
+    }
+}
+
+
+/**********************************************************************************/
@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "LVC_Mixer_Private.h"
+#include "LVM_Simd.h"
 #include "VectorArithmetic.h"
 #include "ScalarArithmetic.h"
 
@@ -63,10 +64,10 @@ void LVC_MixSoft_1St_D16C31_SAT( LVMixer3_1St_st *ptrInstance,
             HardMixing = FALSE;
             if(pInstance->Shift!=0){
                 Shift_Sat_v16xv16 ((LVM_INT16)pInstance->Shift,src,dst,n);
-                LVC_Core_MixSoft_1St_D16C31_WRA( &(ptrInstance->MixerStream[0]), dst, dst, n);
+                LVM_SIMD_KERNEL(LVC_Core_MixSoft_1St_D16C31_WRA)( &(ptrInstance->MixerStream[0]), dst, dst, n);
             }
             else
-                LVC_Core_MixSoft_1St_D16C31_WRA( &(ptrInstance->MixerStream[0]), src, dst, n);
+                LVM_SIMD_KERNEL(LVC_Core_MixSoft_1St_D16C31_WRA)( &(ptrInstance->MixerStream[0]), src, dst, n);
         }
     }
 
@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "LVC_Mixer_Private.h"
+#include "LVM_Simd.h"
 #include "VectorArithmetic.h"
 
 /**********************************************************************************
@@ -60,10 +61,10 @@ void LVC_MixSoft_2St_D16C31_SAT( LVMixer3_2St_st *ptrInstance,
         if(pInstance1->Shift!=0)
         {
             Shift_Sat_v16xv16 ((LVM_INT16)pInstance1->Shift,src1,dst,n);
-            LVC_Core_MixHard_2St_D16C31_SAT( &ptrInstance->MixerStream[0], &ptrInstance->MixerStream[1], dst, src2, dst, n);
+            LVM_SIMD_KERNEL(LVC_Core_MixHard_2St_D16C31_SAT)( &ptrInstance->MixerStream[0], &ptrInstance->MixerStream[1], dst, src2, dst, n);
         }
         else
-            LVC_Core_MixHard_2St_D16C31_SAT( &ptrInstance->MixerStream[0], &ptrInstance->MixerStream[1], src1, src2, dst, n);
+            LVM_SIMD_KERNEL(LVC_Core_MixHard_2St_D16C31_SAT)( &ptrInstance->MixerStream[0], &ptrInstance->MixerStream[1], src1, src2, dst, n);
     }
 }
 
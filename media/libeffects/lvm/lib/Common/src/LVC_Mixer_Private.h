@@ -60,6 +60,11 @@ void LVC_Core_MixSoft_1St_D16C31_WRA( LVMixer3_st *pInstance,
                                           LVM_INT16     *dst,
                                           LVM_INT16     n);
 
+void LVC_Core_MixSoft_1St_D16C31_WRA_SIMD( LVMixer3_st *pInstance,
+                                    const LVM_INT16     *src,
+                                          LVM_INT16     *dst,
+                                          LVM_INT16     n);
+
 void LVC_Core_MixHard_2St_D16C31_SAT( LVMixer3_st *pInstance1,
                                     LVMixer3_st         *pInstance2,
                                     const LVM_INT16     *src1,
@@ -67,6 +72,13 @@ void LVC_Core_MixHard_2St_D16C31_SAT( LVMixer3_st *pInstance1,
                                           LVM_INT16     *dst,
                                           LVM_INT16     n);
 
+void LVC_Core_MixHard_2St_D16C31_SAT_SIMD( LVMixer3_st *pInstance1,
+                                    LVMixer3_st         *pInstance2,
+                                    const LVM_INT16     *src1,
+                                    const LVM_INT16     *src2,
+                                          LVM_INT16     *dst,
+                                          LVM_INT16     n);
+
 /**********************************************************************************/
 /* For applying different gains to Left and right chennals                        */
 /* ptrInstance1 applies to Left channel                                           */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+#include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
+#include "LVM_Simd.h"
+
+/**************************************************************************
+ Same filter as PK_2I_D32F32C14G11_TRC_WRA_01(), with the left and right
+ channels in the two lanes of a vector and the delays kept in registers
+ for the whole buffer.
+
+ DELAYS-
+ pBiquadState->pDelays[0..1] is x(n-1)L,R in Q0 format
+ pBiquadState->pDelays[2..3] is x(n-2)L,R in Q0 format
+ pBiquadState->pDelays[4..5] is y(n-1)L,R in Q0 format
+ pBiquadState->pDelays[6..7] is y(n-2)L,R in Q0 format
+***************************************************************************/
+
+void PK_2I_D32F32C14G11_TRC_WRA_01_SIMD (   Biquad_Instance_t       *pInstance,
+                                            LVM_INT32               *pDataIn,
+                                            LVM_INT32               *pDataOut,
+                                            LVM_INT16               NrSamples)
+    {
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        LVM_INT32 *pDelays = pBiquadState->pDelays;
+        const LVM_INT32x2 A0 = {pBiquadState->coefs[0], pBiquadState->coefs[0]};
+        const LVM_INT32x2 B2 = {pBiquadState->coefs[1], pBiquadState->coefs[1]};
+        const LVM_INT32x2 B1 = {pBiquadState->coefs[2], pBiquadState->coefs[2]};
+        const LVM_INT32x2 Gain = {pBiquadState->coefs[3], pBiquadState->coefs[3]};
+        LVM_INT32x2 Xn1 = {pDelays[0], pDelays[1]};
+        LVM_INT32x2 Xn2 = {pDelays[2], pDelays[3]};
+        LVM_INT32x2 Yn1 = {pDelays[4], pDelays[5]};
+        LVM_INT32x2 Yn2 = {pDelays[6], pDelays[7]};
+        LVM_INT32x2 Xn, Yn, YnO;
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            Xn = (LVM_INT32x2){pDataIn[0], pDataIn[1]};
+            pDataIn += 2;
+
+            /* yn = (A0 (Q14) * (x(n) - x(n-2)) >> 14) + (-B2 (Q14) * y(n-2) >> 14)
+                    + (-B1 (Q14) * y(n-1) >> 14) in Q0 */
+            Yn = LVM_Mul32x16x2(Xn - Xn2, A0, 14);
+            Yn += LVM_Mul32x16x2(Yn2, B2, 14);
+            Yn += LVM_Mul32x16x2(Yn1, B1, 14);
+
+            /* ynO = ((Gain (Q11) * yn) >> 11) + x(n) in Q0 */
+            YnO = LVM_Mul32x16x2(Yn, Gain, 11) + Xn;
+
+            Yn2 = Yn1;
+            Xn2 = Xn1;
+            Yn1 = Yn;
+            Xn1 = Xn;
+
+            pDataOut[0] = YnO[0];
+            pDataOut[1] = YnO[1];
+            pDataOut += 2;
+        }
+
+        pDelays[0] = Xn1[0];
+        pDelays[1] = Xn1[1];
+        pDelays[2] = Xn2[0];
+        pDelays[3] = Xn2[1];
+        pDelays[4] = Yn1[0];
+        pDelays[5] = Yn1[1];
+        pDelays[6] = Yn2[0];
+        pDelays[7] = Yn2[1];
+    }
+
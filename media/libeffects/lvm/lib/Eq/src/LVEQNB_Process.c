@@ -25,6 +25,7 @@
 #include "LVEQNB_Private.h"
 #include "VectorArithmetic.h"
 #include "BIQUAD.h"
+#include "LVM_Simd.h"
 
 
 /****************************************************************************************/
@@ -127,10 +128,10 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
                     {
                         case LVEQNB_SinglePrecision:
                         {
-                            PK_2I_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          (LVM_INT32 *)pScratch,
-                                                          (LVM_INT32 *)pScratch,
-                                                          (LVM_INT16)NumSamples);
+                            LVM_SIMD_KERNEL(PK_2I_D32F32C14G11_TRC_WRA_01)(pBiquad,
+                                                                           (LVM_INT32 *)pScratch,
+                                                                           (LVM_INT32 *)pScratch,
+                                                                           (LVM_INT16)NumSamples);
                             break;
                         }
 
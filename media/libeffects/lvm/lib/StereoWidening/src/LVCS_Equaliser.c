@@ -25,6 +25,7 @@
 #include "LVCS_Private.h"
 #include "LVCS_Equaliser.h"
 #include "BIQUAD.h"
+#include "LVM_Simd.h"
 #include "VectorArithmetic.h"
 #include "LVCS_Tables.h"
 
@@ -105,7 +106,7 @@ LVCS_ReturnStatus_en LVCS_EqualiserInit(LVCS_Handle_t       hInstance,
                 pConfig->pBiquadCallBack  = BQ_2I_D16F32C14_TRC_WRA_01;
                 break;
             case 15:
-                pConfig->pBiquadCallBack  = BQ_2I_D16F32C15_TRC_WRA_01;
+                pConfig->pBiquadCallBack  = LVM_SIMD_KERNEL(BQ_2I_D16F32C15_TRC_WRA_01);
                 break;
         }
     }
@@ -0,0 +1,51 @@
+# Build the unit tests and the benchmark for the music bundle
+
+LOCAL_PATH:= $(call my-dir)
+
+lvm_test_c_includes := \
+	$(LOCAL_PATH)/../lib/Eq/lib \
+	$(LOCAL_PATH)/../lib/Eq/src \
+	$(LOCAL_PATH)/../lib/Bass/lib \
+	$(LOCAL_PATH)/../lib/Bass/src \
+	$(LOCAL_PATH)/../lib/Common/lib \
+	$(LOCAL_PATH)/../lib/Common/src \
+	$(LOCAL_PATH)/../lib/Bundle/lib \
+	$(LOCAL_PATH)/../lib/Bundle/src
+
+#
+# SIMD kernel unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	lvm_kernel_tests.cpp
+
+LOCAL_C_INCLUDES := $(lvm_test_c_includes)
+
+LOCAL_STATIC_LIBRARIES := \
+	libmusicbundle
+
+LOCAL_MODULE := lvm_kernel_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
+
+#
+# kernel and bundle benchmark, run on the host
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	lvm_bench.cpp
+
+LOCAL_C_INCLUDES := $(lvm_test_c_includes)
+
+LOCAL_STATIC_LIBRARIES := \
+	libmusicbundle
+
+LOCAL_LDLIBS := -lrt
+
+LOCAL_MODULE := lvm_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the music bundle kernels against their _SIMD versions, then the whole
+// bundle in the configurations EffectBundle sets up for bass boost,
+// virtualizer and equalizer, on a long stereo buffer.
+//
+// usage: lvm_bench [seconds]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BIQUAD.h"
+#include "LVDBE_Tables.h"
+#include "LVEQNB_Private.h"
+#include "LVM.h"
+#include "LVM_Tables.h"
+extern "C" {
+#include "LVC_Mixer_Private.h"
+}
+
+static const int kSampleRate = 44100;
+static const LVM_INT16 kBlockFrames = 256;  // MAX_CALL_SIZE of EffectBundle
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds, size_t frames) {
+    printf("%-40s %8.2f ns/frame %8.1fx realtime\n", name, seconds * 1e9 / frames,
+            frames / (seconds * kSampleRate));
+}
+
+template <typename Sample>
+static double timeBiquad(void (*kernel)(Biquad_Instance_t *, Sample *, Sample *, LVM_INT16),
+                         Biquad_Instance_t *instance, Sample *buffer, size_t frames) {
+    double start = now();
+    for (size_t i = 0; i + kBlockFrames <= frames; i += kBlockFrames) {
+        kernel(instance, buffer + 2 * i, buffer + 2 * i, kBlockFrames);
+    }
+    return now() - start;
+}
+
+static void benchKernels(size_t frames) {
+    LVM_INT16 *samples16 = new LVM_INT16[2 * frames];
+    LVM_INT16 *other16 = new LVM_INT16[2 * frames];
+    LVM_INT32 *samples32 = new LVM_INT32[2 * frames];
+    for (size_t i = 0; i < 2 * frames; ++i) {
+        samples16[i] = (LVM_INT16)(rand() >> 20);
+        other16[i] = (LVM_INT16)(rand() >> 16);
+        samples32[i] = (LVM_INT32)samples16[i] << 12;
+    }
+
+    Biquad_Instance_t instance;
+    Biquad_2I_Order2_Taps_t taps;
+
+    BQ_C16_Coefs_t bqC16 = { 5643 >> 1, -18602 >> 1, 13304 >> 1, -1067, 9152 >> 1 };
+    BQ_2I_D16F32Css_TRC_WRA_01_Init(&instance, &taps, &bqC16);
+    report("BQ_2I_D16F32C15_TRC_WRA_01",
+            timeBiquad(BQ_2I_D16F32C15_TRC_WRA_01, &instance, samples16, frames), frames);
+    BQ_2I_D16F32Css_TRC_WRA_01_Init(&instance, &taps, &bqC16);
+    report("BQ_2I_D16F32C15_TRC_WRA_01_SIMD",
+            timeBiquad(BQ_2I_D16F32C15_TRC_WRA_01_SIMD, &instance, samples16, frames), frames);
+
+    BQ_C32_Coefs_t bqC32 = LVDBE_HPF_Table[7];
+    BQ_2I_D32F32Cll_TRC_WRA_01_Init(&instance, &taps, &bqC32);
+    report("BQ_2I_D32F32C30_TRC_WRA_01",
+            timeBiquad(BQ_2I_D32F32C30_TRC_WRA_01, &instance, samples32, frames), frames);
+    BQ_2I_D32F32Cll_TRC_WRA_01_Init(&instance, &taps, &bqC32);
+    report("BQ_2I_D32F32C30_TRC_WRA_01_SIMD",
+            timeBiquad(BQ_2I_D32F32C30_TRC_WRA_01_SIMD, &instance, samples32, frames), frames);
+
+    LVEQNB_BandDef_t band = { 6, 910, 96 };
+    PK_C16_Coefs_t pkC16;
+    LVEQNB_SinglePrecCoefs(LVM_FS_44100, &band, &pkC16);
+    PK_2I_D32F32CssGss_TRC_WRA_01_Init(&instance, &taps, &pkC16);
+    report("PK_2I_D32F32C14G11_TRC_WRA_01",
+            timeBiquad(PK_2I_D32F32C14G11_TRC_WRA_01, &instance, samples32, frames), frames);
+    PK_2I_D32F32CssGss_TRC_WRA_01_Init(&instance, &taps, &pkC16);
+    report("PK_2I_D32F32C14G11_TRC_WRA_01_SIMD",
+            timeBiquad(PK_2I_D32F32C14G11_TRC_WRA_01_SIMD, &instance, samples32, frames), frames);
+
+    Biquad_2I_Order1_Taps_t foTaps;
+    FO_2I_D16F32Css_LShx_TRC_WRA_01_Init(&instance, &foTaps, &LVM_TrebleBoostCoefs[60]);
+    report("FO_2I_D16F32C15_LShx_TRC_WRA_01",
+            timeBiquad(FO_2I_D16F32C15_LShx_TRC_WRA_01, &instance, samples16, frames), frames);
+    FO_2I_D16F32Css_LShx_TRC_WRA_01_Init(&instance, &foTaps, &LVM_TrebleBoostCoefs[60]);
+    report("FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD",
+            timeBiquad(FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD, &instance, samples16, frames),
+            frames);
+
+    // The mixers run on one interleaved stream, two samples per frame.
+    LVMixer3_st mixers[2];
+    memset(mixers, 0, sizeof(mixers));
+    ((Mix_Private_st *)mixers[0].PrivateParams)->Current = 0x5A000000;
+    ((Mix_Private_st *)mixers[1].PrivateParams)->Current = 0x40000000;
+    for (int simd = 0; simd <= 1; ++simd) {
+        double start = now();
+        for (size_t i = 0; i + kBlockFrames <= frames; i += kBlockFrames) {
+            (simd ? LVC_Core_MixHard_2St_D16C31_SAT_SIMD : LVC_Core_MixHard_2St_D16C31_SAT)(
+                    &mixers[0], &mixers[1], samples16 + 2 * i, other16 + 2 * i,
+                    samples16 + 2 * i, 2 * kBlockFrames);
+        }
+        report(simd ? "LVC_Core_MixHard_2St_D16C31_SAT_SIMD" : "LVC_Core_MixHard_2St_D16C31_SAT",
+                now() - start, frames);
+    }
+
+    for (int simd = 0; simd <= 1; ++simd) {
+        Mix_Private_st *params = (Mix_Private_st *)mixers[0].PrivateParams;
+        double start = now();
+        for (size_t i = 0; i + kBlockFrames <= frames; i += kBlockFrames) {
+            // Keep ramping up and down, as a volume change would.
+            if (params->Current == params->Target) {
+                params->Target = params->Target == 0x7FFFFFFF ? 0 : 0x7FFFFFFF;
+                params->Delta = 0x00010000;
+            }
+            (simd ? LVC_Core_MixSoft_1St_D16C31_WRA_SIMD : LVC_Core_MixSoft_1St_D16C31_WRA)(
+                    &mixers[0], samples16 + 2 * i, samples16 + 2 * i, 2 * kBlockFrames);
+        }
+        report(simd ? "LVC_Core_MixSoft_1St_D16C31_WRA_SIMD" : "LVC_Core_MixSoft_1St_D16C31_WRA",
+                now() - start, frames);
+    }
+
+    delete[] samples16;
+    delete[] other16;
+    delete[] samples32;
+}
+
+// Sets up an instance the way LvmBundle_init() does.
+static LVM_Handle_t createBundle(LVM_MemTab_t *memTab, LVM_ControlParams_t *params,
+                                 LVM_EQNB_BandDef_t *bandDefs) {
+    static const LVM_UINT16 kFrequencies[] = { 60, 230, 910, 3600, 14000 };
+    static const LVM_INT16 kRockPreset[] = { 5, 3, -1, 3, 5 };
+
+    LVM_InstParams_t instParams;
+    instParams.BufferMode = LVM_UNMANAGED_BUFFERS;
+    instParams.MaxBlockSize = kBlockFrames;
+    instParams.EQNB_NumBands = 5;
+    instParams.PSA_Included = LVM_PSA_ON;
+
+    LVM_Handle_t handle = LVM_NULL;
+    if (LVM_GetMemoryTable(LVM_NULL, memTab, &instParams) != LVM_SUCCESS) {
+        return LVM_NULL;
+    }
+    for (int i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
+        memTab->Region[i].pBaseAddress =
+                memTab->Region[i].Size != 0 ? calloc(1, memTab->Region[i].Size) : LVM_NULL;
+    }
+    if (LVM_GetInstanceHandle(&handle, memTab, &instParams) != LVM_SUCCESS) {
+        return LVM_NULL;
+    }
+
+    memset(params, 0, sizeof(*params));
+    params->OperatingMode = LVM_MODE_ON;
+    params->SampleRate = LVM_FS_44100;
+    params->SourceFormat = LVM_STEREO;
+    params->SpeakerType = LVM_HEADPHONES;
+    params->VirtualizerOperatingMode = LVM_MODE_OFF;
+    params->VirtualizerType = LVM_CONCERTSOUND;
+    params->VirtualizerReverbLevel = 100;
+    params->CS_EffectLevel = LVM_CS_EFFECT_NONE;
+    params->EQNB_OperatingMode = LVM_EQNB_OFF;
+    params->EQNB_NBands = 5;
+    params->pEQNB_BandDefinition = bandDefs;
+    for (int i = 0; i < 5; i++) {
+        bandDefs[i].Frequency = kFrequencies[i];
+        bandDefs[i].QFactor = 96;
+        bandDefs[i].Gain = kRockPreset[i];
+    }
+    params->TE_OperatingMode = LVM_TE_OFF;
+    params->PSA_Enable = LVM_PSA_OFF;
+    params->PSA_PeakDecayRate = LVM_PSA_SPEED_MEDIUM;
+    params->BE_OperatingMode = LVM_BE_OFF;
+    params->BE_CentreFreq = LVM_BE_CENTRE_90Hz;
+    params->BE_HPF = LVM_BE_HPF_ON;
+
+    LVM_HeadroomBandDef_t headroomBands[2] = { { 20, 4999, 0 }, { 5000, 24000, 0 } };
+    LVM_HeadroomParams_t headroom;
+    headroom.pHeadroomDefinition = headroomBands;
+    headroom.Headroom_OperatingMode = LVM_HEADROOM_ON;
+    headroom.NHeadroomBands = 2;
+    LVM_SetHeadroomParams(handle, &headroom);
+    return handle;
+}
+
+static void benchBundle(const char *name, bool bassBoost, bool virtualizer, bool equalizer,
+                        size_t frames) {
+    LVM_MemTab_t memTab;
+    LVM_ControlParams_t params;
+    LVM_EQNB_BandDef_t bandDefs[5];
+    LVM_Handle_t handle = createBundle(&memTab, &params, bandDefs);
+    if (handle == LVM_NULL) {
+        fprintf(stderr, "%s: cannot create the bundle\n", name);
+        return;
+    }
+
+    // Strengths of 1000, as set through the effect parameters.
+    if (bassBoost) {
+        params.BE_OperatingMode = LVM_BE_ON;
+        params.BE_EffectLevel = 15;
+    }
+    if (virtualizer) {
+        params.VirtualizerOperatingMode = LVM_MODE_ON;
+        params.CS_EffectLevel = 32767;
+    }
+    if (equalizer) {
+        params.EQNB_OperatingMode = LVM_EQNB_ON;
+    }
+    if (LVM_SetControlParameters(handle, &params) != LVM_SUCCESS) {
+        fprintf(stderr, "%s: cannot set the control parameters\n", name);
+        return;
+    }
+
+    LVM_INT16 *in = new LVM_INT16[2 * frames];
+    LVM_INT16 *out = new LVM_INT16[2 * frames];
+    for (size_t i = 0; i < 2 * frames; ++i) {
+        in[i] = (LVM_INT16)(rand() >> 18);
+    }
+
+    double start = now();
+    LVM_UINT32 audioTime = 0;
+    for (size_t i = 0; i + kBlockFrames <= frames; i += kBlockFrames) {
+        LVM_Process(handle, in + 2 * i, out + 2 * i, kBlockFrames, audioTime);
+        audioTime += kBlockFrames;
+    }
+    report(name, now() - start, frames);
+
+    // A checksum of the output, to compare builds with and without LVM_NO_SIMD.
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < 2 * frames; ++i) {
+        checksum = checksum * 31 + (uint16_t)out[i];
+    }
+    printf("%-40s %08x\n", "  output checksum", checksum);
+
+    delete[] in;
+    delete[] out;
+    for (int i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
+        free(memTab.Region[i].pBaseAddress);
+    }
+}
+
+int main(int argc, char **argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    if (seconds <= 0) {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t frames = (size_t)seconds * kSampleRate;
+
+    srand(42);
+    printf("%d s of 44.1 kHz stereo in blocks of %d frames\n\n", seconds, kBlockFrames);
+    benchKernels(frames);
+    printf("\n");
+    benchBundle("bass boost", true, false, false, frames);
+    benchBundle("virtualizer", false, true, false, frames);
+    benchBundle("equalizer", false, false, true, frames);
+    benchBundle("bass boost + virtualizer + equalizer", true, true, true, frames);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that the _SIMD kernels of the music bundle give the same output and
+// leave the same filter state as the reference kernels.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "BIQUAD.h"
+#include "LVDBE_Tables.h"
+#include "LVEQNB_Private.h"
+#include "LVM_Tables.h"
+extern "C" {
+#include "LVC_Mixer_Private.h"
+}
+
+namespace {
+
+// Odd lengths leave samples for the scalar tails of the 4 sample loops.
+const LVM_INT16 kLengths[] = { 1, 3, 4, 7, 64, 255, 256 };
+const size_t kNumLengths = sizeof(kLengths) / sizeof(kLengths[0]);
+const size_t kMaxLength = 256;
+const size_t kNumHpfCoefs = 36;     // 4 centre frequencies at 9 sample rates
+const size_t kNumTrebleBoostCoefs = 75;     // 15 gains at 5 sample rates
+
+LVM_INT32 randomInt(LVM_INT32 low, LVM_INT32 high) {
+    int64_t r = ((int64_t)rand() << 16) ^ rand();
+    return (LVM_INT32)(low + r % ((int64_t)high - low + 1));
+}
+
+template <typename T>
+void randomSamples(T *buffer, size_t count, LVM_INT32 low, LVM_INT32 high) {
+    for (size_t i = 0; i < count; ++i) {
+        buffer[i] = (T)randomInt(low, high);
+    }
+}
+
+// Runs a stereo biquad and its _SIMD version from the same random state
+// over the same random input, block after block.
+template <typename Sample, typename Taps, typename Coefs,
+          void (*Init)(Biquad_Instance_t *, Taps *, Coefs *)>
+void expectSameBiquad(void (*reference)(Biquad_Instance_t *, Sample *, Sample *, LVM_INT16),
+                      void (*simd)(Biquad_Instance_t *, Sample *, Sample *, LVM_INT16),
+                      Coefs *coefs, LVM_INT32 amplitude) {
+    Biquad_Instance_t referenceInstance, simdInstance;
+    Taps referenceTaps, simdTaps;
+    Sample in[2 * kMaxLength], referenceOut[2 * kMaxLength], simdOut[2 * kMaxLength];
+
+    Init(&referenceInstance, &referenceTaps, coefs);
+    Init(&simdInstance, &simdTaps, coefs);
+    randomSamples(referenceTaps.Storage,
+            sizeof(referenceTaps.Storage) / sizeof(referenceTaps.Storage[0]),
+            -amplitude, amplitude);
+    memcpy(simdTaps.Storage, referenceTaps.Storage, sizeof(simdTaps.Storage));
+
+    for (size_t i = 0; i < kNumLengths; ++i) {
+        LVM_INT16 n = kLengths[i];
+        randomSamples(in, 2 * n, -amplitude, amplitude);
+
+        reference(&referenceInstance, in, referenceOut, n);
+        simd(&simdInstance, in, simdOut, n);
+
+        ASSERT_EQ(0, memcmp(referenceOut, simdOut, 2 * n * sizeof(Sample))) << "length " << n;
+        ASSERT_EQ(0, memcmp(referenceTaps.Storage, simdTaps.Storage, sizeof(simdTaps.Storage)))
+                << "length " << n;
+    }
+}
+
+} // namespace
+
+TEST(lvm_kernel, BQ_2I_D16F32C15_TRC_WRA_01) {
+    srand(1);
+    for (int i = 0; i < 100; ++i) {
+        // Feedback coefficients with |b1| + |b2| < 0.75 keep the filter
+        // stable, and the input small enough for its gain.
+        LVM_INT16 b1 = (LVM_INT16)randomInt(-12000, 12000);
+        LVM_INT16 b2 = (LVM_INT16)randomInt(-(24000 - abs(b1)), 24000 - abs(b1));
+        BQ_C16_Coefs_t coefs = {
+            (LVM_INT16)randomInt(-16384, 16384),
+            (LVM_INT16)randomInt(-16384, 16384),
+            (LVM_INT16)randomInt(-16384, 16384),
+            b2,
+            b1,
+        };
+        expectSameBiquad<LVM_INT16, Biquad_2I_Order2_Taps_t, BQ_C16_Coefs_t,
+                BQ_2I_D16F32Css_TRC_WRA_01_Init>(
+                BQ_2I_D16F32C15_TRC_WRA_01, BQ_2I_D16F32C15_TRC_WRA_01_SIMD, &coefs, 4096);
+    }
+}
+
+TEST(lvm_kernel, BQ_2I_D32F32C30_TRC_WRA_01) {
+    srand(2);
+    for (size_t i = 0; i < kNumHpfCoefs; ++i) {
+        BQ_C32_Coefs_t coefs = LVDBE_HPF_Table[i];
+        expectSameBiquad<LVM_INT32, Biquad_2I_Order2_Taps_t, BQ_C32_Coefs_t,
+                BQ_2I_D32F32Cll_TRC_WRA_01_Init>(
+                BQ_2I_D32F32C30_TRC_WRA_01, BQ_2I_D32F32C30_TRC_WRA_01_SIMD, &coefs,
+                0x3FFFFFFF);
+    }
+}
+
+TEST(lvm_kernel, PK_2I_D32F32C14G11_TRC_WRA_01) {
+    static const LVM_UINT16 kSampleRates[] = {
+        8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000 };
+    static const LVM_UINT16 kFrequencies[] = { 60, 230, 910, 3600, 14000 };
+    srand(3);
+    for (LVM_UINT16 fs = 0; fs < sizeof(kSampleRates) / sizeof(kSampleRates[0]); ++fs) {
+        for (size_t i = 0; i < sizeof(kFrequencies) / sizeof(kFrequencies[0]); ++i) {
+            for (LVM_INT16 gain = -15; gain <= 15; gain += 5) {
+                LVEQNB_BandDef_t band = { gain, kFrequencies[i], 96 };
+                PK_C16_Coefs_t coefs;
+                if (band.Frequency * 2 >= kSampleRates[fs]) {
+                    continue;
+                }
+                ASSERT_EQ(LVEQNB_SUCCESS, LVEQNB_SinglePrecCoefs(fs, &band, &coefs));
+                expectSameBiquad<LVM_INT32, Biquad_2I_Order2_Taps_t, PK_C16_Coefs_t,
+                        PK_2I_D32F32CssGss_TRC_WRA_01_Init>(
+                        PK_2I_D32F32C14G11_TRC_WRA_01, PK_2I_D32F32C14G11_TRC_WRA_01_SIMD,
+                        &coefs, 0x07FFFFFF);
+            }
+        }
+    }
+}
+
+TEST(lvm_kernel, FO_2I_D16F32C15_LShx_TRC_WRA_01) {
+    srand(4);
+    for (size_t i = 0; i < kNumTrebleBoostCoefs; ++i) {
+        expectSameBiquad<LVM_INT16, Biquad_2I_Order1_Taps_t, FO_C16_LShx_Coefs_t,
+                FO_2I_D16F32Css_LShx_TRC_WRA_01_Init>(
+                FO_2I_D16F32C15_LShx_TRC_WRA_01, FO_2I_D16F32C15_LShx_TRC_WRA_01_SIMD,
+                &LVM_TrebleBoostCoefs[i], 32767);
+    }
+}
+
+TEST(lvm_kernel, LVC_Core_MixHard_2St_D16C31_SAT) {
+    LVMixer3_st reference[2], simd[2];
+    LVM_INT16 in1[kMaxLength], in2[kMaxLength], referenceOut[kMaxLength], simdOut[kMaxLength];
+
+    srand(5);
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            Mix_Private_st *params = (Mix_Private_st *)reference[j].PrivateParams;
+            memset(params, 0, sizeof(reference[j].PrivateParams));
+            // Gains up to 1.0, so the sum of both streams can saturate.
+            params->Current = randomInt(0, 0x7FFFFFFF);
+            simd[j] = reference[j];
+        }
+        for (size_t k = 0; k < kNumLengths; ++k) {
+            LVM_INT16 n = kLengths[k];
+            randomSamples(in1, n, -32768, 32767);
+            randomSamples(in2, n, -32768, 32767);
+
+            LVC_Core_MixHard_2St_D16C31_SAT(&reference[0], &reference[1], in1, in2,
+                    referenceOut, n);
+            LVC_Core_MixHard_2St_D16C31_SAT_SIMD(&simd[0], &simd[1], in1, in2, simdOut, n);
+
+            ASSERT_EQ(0, memcmp(referenceOut, simdOut, n * sizeof(LVM_INT16))) << "length " << n;
+        }
+    }
+}
+
+TEST(lvm_kernel, LVC_Core_MixSoft_1St_D16C31_WRA) {
+    LVMixer3_st reference, simd;
+    LVM_INT16 in[kMaxLength], referenceOut[kMaxLength], simdOut[kMaxLength];
+
+    srand(6);
+    for (int i = 0; i < 100; ++i) {
+        Mix_Private_st *referenceParams = (Mix_Private_st *)reference.PrivateParams;
+        Mix_Private_st *simdParams = (Mix_Private_st *)simd.PrivateParams;
+        memset(referenceParams, 0, sizeof(reference.PrivateParams));
+        // Ramps both ways, some reaching the target within a block.
+        referenceParams->Current = randomInt(0, 0x7FFFFFFF);
+        referenceParams->Target = randomInt(0, 0x7FFFFFFF);
+        referenceParams->Delta = randomInt(1, 0x01000000);
+        simd = reference;
+
+        for (size_t k = 0; k < kNumLengths; ++k) {
+            LVM_INT16 n = kLengths[k];
+            randomSamples(in, n, -32768, 32767);
+
+            LVC_Core_MixSoft_1St_D16C31_WRA(&reference, in, referenceOut, n);
+            LVC_Core_MixSoft_1St_D16C31_WRA_SIMD(&simd, in, simdOut, n);
+
+            ASSERT_EQ(0, memcmp(referenceOut, simdOut, n * sizeof(LVM_INT16))) << "length " << n;
+            ASSERT_EQ(referenceParams->Current, simdParams->Current) << "length " << n;
+        }
+    }
+}
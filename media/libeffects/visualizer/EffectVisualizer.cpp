@@ -141,7 +141,8 @@ int Visualizer_setConfig(VisualizerContext *pContext, effect_config_t *pConfig)
     if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) return -EINVAL;
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE) return -EINVAL;
-    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) return -EINVAL;
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) return -EINVAL;
 
     pContext->mConfig = *pConfig;
 
@@ -304,6 +305,21 @@ static inline int16_t clamp16(int32_t sample)
     return sample;
 }
 
+// Measurements and captures are done on 16 bit PCM, whatever the buffer format.
+static inline int16_t Visualizer_sample(const audio_buffer_t *buffer, bool isFloat, size_t i)
+{
+    if (!isFloat) {
+        return buffer->s16[i];
+    }
+    float f = ((const float *)buffer->raw)[i] * 32768.0f;
+    if (f >= 32767.0f) {
+        return 32767;
+    } else if (f <= -32768.0f) {
+        return -32768;
+    }
+    return (int16_t)f;
+}
+
 int Visualizer_process(
         effect_handle_t self,audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
@@ -320,6 +336,8 @@ int Visualizer_process(
         return -EINVAL;
     }
 
+    const bool isFloat = pContext->mConfig.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+
     // perform measurements if needed
     if (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) {
         // find the peak and RMS squared for the new buffer
@@ -327,12 +345,13 @@ int Visualizer_process(
         int16_t maxSample = 0;
         float rmsSqAcc = 0;
         for (inIdx = 0 ; inIdx < inBuffer->frameCount * pContext->mChannelCount ; inIdx++) {
-            if (inBuffer->s16[inIdx] > maxSample) {
-                maxSample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > maxSample) {
-                maxSample = -inBuffer->s16[inIdx];
+            const int16_t sample = Visualizer_sample(inBuffer, isFloat, inIdx);
+            if (sample > maxSample) {
+                maxSample = sample;
+            } else if (-sample > maxSample) {
+                maxSample = -sample;
             }
-            rmsSqAcc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
+            rmsSqAcc += (sample * sample);
         }
         // store the measurement
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 = (uint16_t)maxSample;
@@ -344,7 +363,7 @@ int Visualizer_process(
         }
     }
 
-    // all code below assumes stereo 16 bit PCM output and input
+    // all code below assumes stereo output and input
     int32_t shift;
 
     if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
@@ -353,7 +372,7 @@ int Visualizer_process(
         shift = 32;
         int len = inBuffer->frameCount * 2;
         for (int i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
+            int32_t smp = Visualizer_sample(inBuffer, isFloat, i);
             if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
             int32_t clz = __builtin_clz(smp);
             if (shift > clz) shift = clz;
@@ -382,7 +401,8 @@ int Visualizer_process(
             // wrap around
             captIdx = 0;
         }
-        int32_t smp = inBuffer->s16[2 * inIdx] + inBuffer->s16[2 * inIdx + 1];
+        int32_t smp = Visualizer_sample(inBuffer, isFloat, 2 * inIdx) +
+                Visualizer_sample(inBuffer, isFloat, 2 * inIdx + 1);
         smp = smp >> shift;
         buf[captIdx] = ((uint8_t)smp)^0x80;
     }
@@ -397,11 +417,20 @@ int Visualizer_process(
 
     if (inBuffer->raw != outBuffer->raw) {
         if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
-            for (size_t i = 0; i < outBuffer->frameCount*2; i++) {
-                outBuffer->s16[i] = clamp16(outBuffer->s16[i] + inBuffer->s16[i]);
+            if (isFloat) {
+                const float *in = (const float *)inBuffer->raw;
+                float *out = (float *)outBuffer->raw;
+                for (size_t i = 0; i < outBuffer->frameCount*2; i++) {
+                    out[i] += in[i];
+                }
+            } else {
+                for (size_t i = 0; i < outBuffer->frameCount*2; i++) {
+                    outBuffer->s16[i] = clamp16(outBuffer->s16[i] + inBuffer->s16[i]);
+                }
             }
         } else {
-            memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount * 2 * sizeof(int16_t));
+            memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount * 2 *
+                    (isFloat ? sizeof(float) : sizeof(int16_t)));
         }
     }
     if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
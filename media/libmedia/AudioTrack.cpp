@@ -24,6 +24,7 @@
 
 #include <audio_utils/primitives.h>
 #include <binder/IPCThreadState.h>
+#include <cutils/properties.h>
 #include <media/AudioTrack.h>
 #include <utils/Log.h>
 #include <private/media/AudioTrackShared.h>
@@ -68,6 +69,20 @@ static int64_t getNowUs()
     return convertTimespecToUs(tv);
 }
 
+// Longest a fast track client polls for room before sleeping on the futex in obtainBuffer(),
+// see ClientProxy::setSpinNs().  Off unless set with the media.audiotrack.spin_us property.
+static const int32_t kMaxFastTrackSpinUs = 1000;
+static nsecs_t getFastTrackSpinNs()
+{
+    int32_t spinUs = property_get_int32("media.audiotrack.spin_us", 0);
+    if (spinUs < 0) {
+        spinUs = 0;
+    } else if (spinUs > kMaxFastTrackSpinUs) {
+        spinUs = kMaxFastTrackSpinUs;
+    }
+    return (nsecs_t) spinUs * 1000;
+}
+
 // FIXME: we don't use the pitch setting in the time stretcher (not working);
 // instead we emulate it using our sample rate converter.
 static const bool kFixPitch = true; // enable pitch fix
@@ -1424,6 +1439,9 @@ status_t AudioTrack::createTrack_l()
     playbackRateTemp.mPitch = effectivePitch;
     mProxy->setPlaybackRate(playbackRateTemp);
     mProxy->setMinimum(mNotificationFramesAct);
+    if (mFlags & AUDIO_OUTPUT_FLAG_FAST) {
+        mProxy->setSpinNs(getFastTrackSpinNs());
+    }
 
     mDeathNotifier = new DeathNotifier(this);
     IInterface::asBinder(mAudioTrack)->linkToDeath(mDeathNotifier, this);
@@ -2417,6 +2435,11 @@ status_t AudioTrack::dump(int fd, const Vector<String16>& args __unused) const
     result.append(buffer);
     snprintf(buffer, 255, "  state(%d), latency (%d)\n", mState, mLatency);
     result.append(buffer);
+    if (mProxy != 0) {
+        snprintf(buffer, 255, "  futex waits(%u), spin wakeups(%u)\n",
+                mProxy->getFutexWaits(), mProxy->getSpinWakeups());
+        result.append(buffer);
+    }
     ::write(fd, result.string(), result.size());
     return NO_ERROR;
 }
@@ -46,7 +46,7 @@ static uint32_t incrementSequence(uint32_t self, uint32_t other) {
 }
 
 audio_track_cblk_t::audio_track_cblk_t()
-    : mServer(0), mFutex(0), mMinimum(0),
+    : mServer(0), mFutexWaiters(0), mFutex(0), mMinimum(0),
     mVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY), mSampleRate(0), mSendLevel(0), mFlags(0)
 {
     memset(&u, 0, sizeof(u));
@@ -58,7 +58,8 @@ Proxy::Proxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount, size_t
         bool isOut, bool clientInServer)
     : mCblk(cblk), mBuffers(buffers), mFrameCount(frameCount), mFrameSize(frameSize),
       mFrameCountP2(roundup(frameCount)), mIsOut(isOut), mClientInServer(clientInServer),
-      mIsShutdown(false), mUnreleased(0)
+      mIsShutdown(false), mUnreleased(0),
+      mFutexWaits(0), mFutexWakes(0), mFutexWakesAvoided(0), mSpinWakeups(0)
 {
 }
 
@@ -66,7 +67,7 @@ Proxy::Proxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount, size_t
 
 ClientProxy::ClientProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
         size_t frameSize, bool isOut, bool clientInServer)
-    : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer), mEpoch(0)
+    : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer), mEpoch(0), mSpinNs(0)
 {
 }
 
@@ -113,6 +114,8 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
     bool beforeIsValid = false;
     audio_track_cblk_t* cblk = mCblk;
     bool ignoreInitialPendingInterrupt = true;
+    bool spun = false;              // whether we already spun before waiting
+    bool registered = false;        // whether we are counted in cblk->mFutexWaiters
     // check for shared memory corruption
     if (mIsShutdown) {
         status = NO_INIT;
@@ -192,12 +195,29 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
             status = NO_ERROR;
             break;
         }
+        if (timeout == TIMEOUT_ZERO) {
+            status = WOULD_BLOCK;
+            goto end;
+        }
+        if (!spun && mSpinNs > 0) {
+            spun = true;
+            if (spinUntilChanged(mIsOut ? &cblk->u.mStreaming.mFront : &cblk->u.mStreaming.mRear,
+                    mIsOut ? front : rear)) {
+                mSpinWakeups++;
+            }
+            continue;
+        }
+        if (!registered) {
+            // Register before looking at the indices again: either the server sees us waiting
+            // and wakes the futex, or it released the frames before and we see them now.
+            android_atomic_inc(&cblk->mFutexWaiters);
+            android_memory_barrier();
+            registered = true;
+            continue;
+        }
         struct timespec remaining;
         const struct timespec *ts;
         switch (timeout) {
-        case TIMEOUT_ZERO:
-            status = WOULD_BLOCK;
-            goto end;
         case TIMEOUT_INFINITE:
             ts = NULL;
             break;
@@ -238,6 +258,7 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
                 beforeIsValid = true;
             }
             errno = 0;
+            mFutexWaits++;
             (void) syscall(__NR_futex, &cblk->mFutex,
                     mClientInServer ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT, old & ~CBLK_FUTEX_WAKE, ts);
             // update total elapsed time spent waiting
@@ -273,6 +294,9 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
     }
 
 end:
+    if (registered) {
+        android_atomic_dec(&cblk->mFutexWaiters);
+    }
     if (status != NO_ERROR) {
         buffer->mFrameCount = 0;
         buffer->mRaw = NULL;
@@ -317,6 +341,29 @@ void ClientProxy::releaseBuffer(Buffer* buffer)
     }
 }
 
+// Polls *index until it differs from value, for at most mSpinNs.
+// Returns true if it changed, and false on timeout, invalidation or interrupt.
+bool ClientProxy::spinUntilChanged(volatile int32_t *index, int32_t value)
+{
+    audio_track_cblk_t* cblk = mCblk;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        if (android_atomic_acquire_load(index) != value) {
+            return true;
+        }
+        if (cblk->mFlags & (CBLK_INVALID | CBLK_INTERRUPT)) {
+            return false;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec)
+                >= mSpinNs) {
+            return false;
+        }
+    }
+}
+
 void ClientProxy::binderDied()
 {
     audio_track_cblk_t* cblk = mCblk;
@@ -412,6 +459,7 @@ status_t AudioTrackClientProxy::waitStreamEndDone(const struct timespec *request
     } else {
         timeout = TIMEOUT_FINITE;
     }
+    bool registered = false;        // whether we are counted in cblk->mFutexWaiters
     for (;;) {
         int32_t flags = android_atomic_and(~(CBLK_INTERRUPT|CBLK_STREAM_END_DONE), &cblk->mFlags);
         // check for track invalidation by server, or server death detection
@@ -431,12 +479,20 @@ status_t AudioTrackClientProxy::waitStreamEndDone(const struct timespec *request
             status = -EINTR;
             goto end;
         }
+        if (timeout == TIMEOUT_ZERO) {
+            status = WOULD_BLOCK;
+            goto end;
+        }
+        if (!registered) {
+            // see obtainBuffer()
+            android_atomic_inc(&cblk->mFutexWaiters);
+            android_memory_barrier();
+            registered = true;
+            continue;
+        }
         struct timespec remaining;
         const struct timespec *ts;
         switch (timeout) {
-        case TIMEOUT_ZERO:
-            status = WOULD_BLOCK;
-            goto end;
         case TIMEOUT_INFINITE:
             ts = NULL;
             break;
@@ -473,6 +529,7 @@ status_t AudioTrackClientProxy::waitStreamEndDone(const struct timespec *request
         int32_t old = android_atomic_and(~CBLK_FUTEX_WAKE, &cblk->mFutex);
         if (!(old & CBLK_FUTEX_WAKE)) {
             errno = 0;
+            mFutexWaits++;
             (void) syscall(__NR_futex, &cblk->mFutex,
                     mClientInServer ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT, old & ~CBLK_FUTEX_WAKE, ts);
             switch (errno) {
@@ -490,6 +547,9 @@ status_t AudioTrackClientProxy::waitStreamEndDone(const struct timespec *request
     }
 
 end:
+    if (registered) {
+        android_atomic_dec(&cblk->mFutexWaiters);
+    }
     if (requested == NULL) {
         requested = &kNonBlocking;
     }
@@ -640,11 +700,7 @@ status_t ServerProxy::obtainBuffer(Buffer* buffer, bool ackFlush)
             android_atomic_release_store(newFront, &cblk->u.mStreaming.mFront);
             // There is no danger from a false positive, so err on the side of caution
             if (true /*front != newFront*/) {
-                int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-                if (!(old & CBLK_FUTEX_WAKE)) {
-                    (void) syscall(__NR_futex, &cblk->mFutex,
-                            mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
-                }
+                wakeClient();
             }
             front = newFront;
         }
@@ -740,14 +796,10 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     } else if (minimum > half) {
         minimum = half;
     }
-    // FIXME AudioRecord wakeup needs to be optimized; it currently wakes up client every time
+    // AudioRecord is woken every time, but only if the client is waiting
     if (!mIsOut || (mAvailToClient + stepCount >= minimum)) {
         ALOGV("mAvailToClient=%zu stepCount=%zu minimum=%zu", mAvailToClient, stepCount, minimum);
-        int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-        if (!(old & CBLK_FUTEX_WAKE)) {
-            (void) syscall(__NR_futex, &cblk->mFutex,
-                    mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
-        }
+        wakeClient();
     }
 
     buffer->mFrameCount = 0;
@@ -755,6 +807,24 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     buffer->mNonContig = 0;
 }
 
+void ServerProxy::wakeClient()
+{
+    audio_track_cblk_t* cblk = mCblk;
+    // Pairs with the barrier after the client registers in mFutexWaiters: the indices
+    // updated by the caller must be visible before we look for waiters.
+    android_memory_barrier();
+    if (android_atomic_acquire_load(&cblk->mFutexWaiters) <= 0) {
+        mFutexWakesAvoided++;
+        return;
+    }
+    int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
+    if (!(old & CBLK_FUTEX_WAKE)) {
+        mFutexWakes++;
+        (void) syscall(__NR_futex, &cblk->mFutex,
+                mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
+    }
+}
+
 // ---------------------------------------------------------------------------
 
 size_t AudioTrackServerProxy::framesReady()
@@ -791,8 +861,7 @@ bool  AudioTrackServerProxy::setStreamEndDone() {
     bool old =
             (android_atomic_or(CBLK_STREAM_END_DONE, &cblk->mFlags) & CBLK_STREAM_END_DONE) != 0;
     if (!old) {
-        (void) syscall(__NR_futex, &cblk->mFutex, mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE,
-                1);
+        wakeClient();
     }
     return old;
 }
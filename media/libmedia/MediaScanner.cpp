@@ -106,6 +106,19 @@ MediaScanResult MediaScanner::processDirectory(
     return result;
 }
 
+MediaScanResult MediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client) {
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        client.beginBatchedFile(paths[i].string());
+        if (processFile(paths[i].string(), NULL /* mimeType */, client)
+                == MEDIA_SCAN_RESULT_ERROR) {
+            result = MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+    return result;
+}
+
 bool MediaScanner::shouldSkipDirectory(char *path) {
     if (path && mSkipList && mSkipIndex) {
         int len = strlen(path);
@@ -158,20 +171,36 @@ MediaScanResult MediaScanner::doProcessDirectory(
     }
 
     MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    Vector<String8> batch;
     while ((entry = readdir(dir))) {
-        if (doProcessDirectoryEntry(path, pathRemaining, client, noMedia, entry, fileSpot)
-                == MEDIA_SCAN_RESULT_ERROR) {
+        if (doProcessDirectoryEntry(path, pathRemaining, client, noMedia, entry, fileSpot,
+                &batch) == MEDIA_SCAN_RESULT_ERROR) {
             result = MEDIA_SCAN_RESULT_ERROR;
             break;
         }
     }
     closedir(dir);
+
+    if (result != MEDIA_SCAN_RESULT_ERROR) {
+        result = flushBatch(&batch, client);
+    }
     return result;
 }
 
+MediaScanResult MediaScanner::flushBatch(
+        Vector<String8> *batch, MediaScannerClient &client) {
+    if (batch->isEmpty()) {
+        return MEDIA_SCAN_RESULT_OK;
+    }
+
+    MediaScanResult result = processFiles(*batch, client);
+    batch->clear();
+    return result == MEDIA_SCAN_RESULT_ERROR ? MEDIA_SCAN_RESULT_ERROR : MEDIA_SCAN_RESULT_OK;
+}
+
 MediaScanResult MediaScanner::doProcessDirectoryEntry(
         char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
-        struct dirent* entry, char* fileSpot) {
+        struct dirent* entry, char* fileSpot, Vector<String8> *batch) {
     struct stat statbuf;
     const char* name = entry->d_name;
 
@@ -218,6 +247,11 @@ MediaScanResult MediaScanner::doProcessDirectoryEntry(
             }
         }
 
+        // the files found so far go before the subdirectory's
+        if (flushBatch(batch, client) == MEDIA_SCAN_RESULT_ERROR) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+
         // and now process its contents
         strcat(fileSpot, "/");
         MediaScanResult result = doProcessDirectory(path, pathRemaining - nameLength - 1,
@@ -227,10 +261,17 @@ MediaScanResult MediaScanner::doProcessDirectoryEntry(
         }
     } else if (type == DT_REG) {
         stat(path, &statbuf);
-        status_t status = client.scanFile(path, statbuf.st_mtime, statbuf.st_size,
-                false /*isDirectory*/, noMedia);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
+        if (client.wantsBatchedScan(path, statbuf.st_mtime, statbuf.st_size, noMedia)) {
+            batch->push(String8(path));
+            if (batch->size() == kMaxBatchSize) {
+                return flushBatch(batch, client);
+            }
+        } else {
+            status_t status = client.scanFile(path, statbuf.st_mtime, statbuf.st_size,
+                    false /*isDirectory*/, noMedia);
+            if (status) {
+                return MEDIA_SCAN_RESULT_ERROR;
+            }
         }
     }
 
@@ -36,6 +36,14 @@ void MediaScannerClient::setLocale(const char* locale)
     mLocale = locale; // not currently used
 }
 
+bool MediaScannerClient::wantsBatchedScan(const char* /* path */,
+        long long /* lastModified */, long long /* fileSize */, bool /* noMedia */) {
+    return false;
+}
+
+void MediaScannerClient::beginBatchedFile(const char* /* path */) {
+}
+
 void MediaScannerClient::beginFile() {
 }
 
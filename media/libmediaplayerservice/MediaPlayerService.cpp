@@ -55,6 +55,7 @@
 #include <media/Metadata.h>
 #include <media/AudioTrack.h>
 #include <media/MemoryLeakTrackUtil.h>
+#include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaCodecList.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/AudioPlayer.h>
@@ -537,6 +538,7 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
         }
 
         gLooperRoster.dump(fd, args);
+        DataSource::DumpSniffers(fd);
 
         bool dumpMem = false;
         for (size_t i = 0; i < args.size(); i++) {
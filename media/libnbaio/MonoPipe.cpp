@@ -218,6 +218,32 @@ ssize_t MonoPipe::write(const void *buffer, size_t count)
     return totalFramesWritten;
 }
 
+ssize_t MonoPipe::obtainWrite(void **buffer, size_t count)
+{
+    ssize_t avail = availableToWrite();
+    if (CC_UNLIKELY(avail <= 0)) {
+        *buffer = NULL;
+        return avail;
+    }
+    size_t rear = mRear & (mMaxFrames - 1);
+    size_t part1 = mMaxFrames - rear;
+    if (part1 > (size_t) avail) {
+        part1 = avail;
+    }
+    if (part1 > count) {
+        part1 = count;
+    }
+    *buffer = (char *) mBuffer + (rear * mFrameSize);
+    return part1;
+}
+
+void MonoPipe::releaseWrite(size_t count)
+{
+    ALOG_ASSERT(count <= (size_t) availableToWrite());
+    android_atomic_release_store(count + mRear, &mRear);
+    mFramesWritten += count;
+}
+
 void MonoPipe::setAvgFrames(size_t setpoint)
 {
     mSetpoint = setpoint;
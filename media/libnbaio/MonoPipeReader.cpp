@@ -19,13 +19,15 @@
 
 #include <cutils/compiler.h>
 #include <utils/Log.h>
+#include <media/AudioBufferProvider.h>
 #include <media/nbaio/MonoPipeReader.h>
 
 namespace android {
 
 MonoPipeReader::MonoPipeReader(MonoPipe* pipe) :
         NBAIO_Source(pipe->mFormat),
-        mPipe(pipe)
+        mPipe(pipe),
+        mNextReadPTS(AudioBufferProvider::kInvalidPTS)
 {
 }
 
@@ -86,6 +88,36 @@ ssize_t MonoPipeReader::read(void *buffer, size_t count, int64_t readPTS)
     return red;
 }
 
+ssize_t MonoPipeReader::obtainRead(void **buffer, size_t count, int64_t readPTS)
+{
+    // see read() for the next read PTS
+    mNextReadPTS = mPipe->offsetTimestampByAudioFrames(readPTS, count);
+
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        mPipe->updateFrontAndNRPTS(mPipe->mFront, mNextReadPTS);
+        *buffer = NULL;
+        return avail;
+    }
+    size_t front = mPipe->mFront & (mPipe->mMaxFrames - 1);
+    size_t part1 = mPipe->mMaxFrames - front;
+    if (part1 > (size_t) avail) {
+        part1 = avail;
+    }
+    if (part1 > count) {
+        part1 = count;
+    }
+    *buffer = (char *) mPipe->mBuffer + (front * mFrameSize);
+    return part1;
+}
+
+void MonoPipeReader::releaseRead(size_t count)
+{
+    ALOG_ASSERT(count <= (size_t) availableToRead());
+    mPipe->updateFrontAndNRPTS(count + mPipe->mFront, mNextReadPTS);
+    mFramesRead += count;
+}
+
 void MonoPipeReader::onTimestamp(const AudioTimestamp& timestamp)
 {
     mPipe->mTimestampMutator.push(timestamp);
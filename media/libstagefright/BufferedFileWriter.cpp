@@ -0,0 +1,592 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "BufferedFileWriter"
+#include <utils/Log.h>
+
+#include "include/BufferedFileWriter.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// staged data plus at most this many caller supplied iovecs per writev()
+static const int kMaxIovecs = 16;
+
+BufferedFileWriter::BufferedFileWriter(int fd, off64_t offset, size_t bufferSize)
+    : mFd(fd),
+      mBuffer(NULL),
+      mBufferSize(0),
+      mBufferedSize(0),
+      mBufferOffset(offset),
+      mFdOffset(-1),
+      mPreallocationSize(0),
+      mPreallocatedEnd(0),
+      mError(OK),
+      mNumSyscalls(0),
+      mThreadStarted(false),
+      mWriting(false),
+      mExit(false),
+      mIOError(OK) {
+    memset(&mStats, 0, sizeof(mStats));
+
+    if (bufferSize > 0) {
+        void *buffer;
+        if (posix_memalign(&buffer, getpagesize(), bufferSize) == 0) {
+            mBuffer = (uint8_t *)buffer;
+            mBufferSize = bufferSize;
+        } else {
+            // still works, every write goes straight to the file
+            ALOGW("failed to allocate %zu byte staging buffer", bufferSize);
+        }
+    }
+}
+
+BufferedFileWriter::~BufferedFileWriter() {
+    flush();
+
+    if (mThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mExit = true;
+            mCondition.broadcast();
+        }
+        pthread_join(mThread, NULL);
+
+        // mBuffer is one of them
+        for (size_t i = 0; i < mBuffers.size(); ++i) {
+            free(mBuffers[i]);
+        }
+    } else {
+        free(mBuffer);
+    }
+    mBuffer = NULL;
+}
+
+void BufferedFileWriter::setPreallocationSize(off64_t bytes) {
+    mPreallocationSize = bytes;
+}
+
+status_t BufferedFileWriter::startIOThread(size_t numBuffers) {
+    CHECK(!mThreadStarted);
+    CHECK_EQ(mBufferedSize, 0u);
+
+    if (mBufferSize == 0 || numBuffers < 2) {
+        return INVALID_OPERATION;
+    }
+
+    for (size_t i = 1; i < numBuffers; ++i) {
+        void *buffer;
+        if (posix_memalign(&buffer, getpagesize(), mBufferSize) != 0) {
+            ALOGW("only allocated %zu of %zu staging buffers", i, numBuffers);
+            break;
+        }
+        mFreeBuffers.push((uint8_t *)buffer);
+    }
+
+    if (mFreeBuffers.isEmpty()
+            || pthread_create(&mThread, NULL, ThreadWrapper, this) != 0) {
+        for (size_t i = 0; i < mFreeBuffers.size(); ++i) {
+            free(mFreeBuffers[i]);
+        }
+        mFreeBuffers.clear();
+        return NO_MEMORY;
+    }
+
+    mBuffers.appendVector(mFreeBuffers);
+    mBuffers.push(mBuffer);
+    mThreadStarted = true;
+
+    return OK;
+}
+
+status_t BufferedFileWriter::write(const void *data, size_t size) {
+    if (mError != OK || size == 0) {
+        return mError;
+    }
+
+    size_t available = mBufferSize - mBufferedSize;
+    if (size <= available) {
+        memcpy(mBuffer + mBufferedSize, data, size);
+        mBufferedSize += size;
+        return OK;
+    }
+
+    if (mThreadStarted) {
+        // the caller may reuse |data| once we return
+        const uint8_t *ptr = (const uint8_t *)data;
+        while (size > 0) {
+            size_t n = mBufferSize - mBufferedSize;
+            if (n > size) {
+                n = size;
+            }
+            memcpy(mBuffer + mBufferedSize, ptr, n);
+            mBufferedSize += n;
+            ptr += n;
+            size -= n;
+
+            if (mBufferedSize == mBufferSize) {
+                status_t err = queueBuffer();
+                if (err != OK) {
+                    return err;
+                }
+            }
+        }
+        return OK;
+    }
+
+    if (size >= mBufferSize / 2) {
+        // not worth copying
+        struct iovec iov;
+        iov.iov_base = const_cast<void *>(data);
+        iov.iov_len = size;
+        return writeOut(&iov, 1);
+    }
+
+    // top up the buffer, write it out and stage the rest
+    memcpy(mBuffer + mBufferedSize, data, available);
+    mBufferedSize += available;
+
+    status_t err = writeOut(NULL, 0);
+    if (err != OK) {
+        return err;
+    }
+
+    memcpy(mBuffer, (const uint8_t *)data + available, size - available);
+    mBufferedSize = size - available;
+
+    return OK;
+}
+
+status_t BufferedFileWriter::writev(const struct iovec *iov, int iovcnt) {
+    if (mError != OK) {
+        return mError;
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        size += iov[i].iov_len;
+    }
+
+    if (size <= mBufferSize - mBufferedSize) {
+        for (int i = 0; i < iovcnt; ++i) {
+            memcpy(mBuffer + mBufferedSize, iov[i].iov_base, iov[i].iov_len);
+            mBufferedSize += iov[i].iov_len;
+        }
+        return OK;
+    }
+
+    if (!mThreadStarted && size >= mBufferSize / 2 && iovcnt <= kMaxIovecs) {
+        return writeOut(iov, iovcnt);
+    }
+
+    for (int i = 0; i < iovcnt; ++i) {
+        status_t err = write(iov[i].iov_base, iov[i].iov_len);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+status_t BufferedFileWriter::writeAt(off64_t offset, const void *data, size_t size) {
+    if (mError != OK) {
+        return mError;
+    }
+
+    CHECK_GE(offset, 0);
+
+    off64_t end = offset + size;
+    if (offset >= mBufferOffset && end <= position()) {
+        // still staged, e.g. the size of a small box
+        memcpy(mBuffer + (offset - mBufferOffset), data, size);
+        return OK;
+    }
+
+    if (mThreadStarted) {
+        // It may still be queued, patching it in the file is simpler than
+        // finding it and it happens a couple of times per file.
+        status_t err = OK;
+        if (offset < position() && end > mBufferOffset) {
+            err = queueBuffer();
+        }
+        if (err == OK) {
+            err = waitForIdle();
+        }
+        if (err != OK) {
+            return err;
+        }
+    } else if (offset < position() && end > mBufferOffset) {
+        // partially staged, rare enough to not bother splitting it
+        status_t err = flush();
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = pwrite64(mFd, ptr, size, offset);
+        ++mNumSyscalls;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("pwrite64 failed: %s (%d)", strerror(errno), errno);
+            mError = -errno;
+            return mError;
+        }
+        ptr += n;
+        offset += n;
+        size -= n;
+    }
+
+    return OK;
+}
+
+status_t BufferedFileWriter::seek(off64_t offset) {
+    // every queued buffer knows where it goes
+    status_t err = mThreadStarted ? queueBuffer() : flush();
+    if (err != OK) {
+        return err;
+    }
+
+    mBufferOffset = offset;
+
+    return OK;
+}
+
+status_t BufferedFileWriter::moveData(off64_t from, off64_t to, off64_t size) {
+    status_t err = flush();
+    if (err != OK) {
+        return err;
+    }
+
+    // the staging buffer is empty now
+    uint8_t *buffer = mBuffer;
+    size_t bufferSize = mBufferSize;
+    if (bufferSize == 0) {
+        bufferSize = kDefaultBufferSize;
+        buffer = (uint8_t *)malloc(bufferSize);
+        if (buffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+
+    // back to front when moving up, so that nothing is overwritten before
+    // it has been copied
+    bool backwards = to > from;
+    bool modified = false;
+    off64_t done = 0;
+    while (err == OK && done < size) {
+        size_t n = bufferSize;
+        if ((off64_t)n > size - done) {
+            n = size - done;
+        }
+        off64_t offset = backwards ? from + size - done - n : from + done;
+
+        ssize_t numRead;
+        do {
+            numRead = pread64(mFd, buffer, n, offset);
+            ++mNumSyscalls;
+        } while (numRead < 0 && errno == EINTR);
+        if (numRead != (ssize_t)n) {
+            ALOGE("pread64 failed: %s (%d)", strerror(errno), errno);
+            err = numRead < 0 ? -errno : ERROR_IO;
+            break;
+        }
+
+        modified = true;
+        for (size_t written = 0; written < n;) {
+            ssize_t numWritten = pwrite64(
+                    mFd, buffer + written, n - written, offset + (to - from) + written);
+            ++mNumSyscalls;
+            if (numWritten < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ALOGE("pwrite64 failed: %s (%d)", strerror(errno), errno);
+                err = -errno;
+                break;
+            }
+            written += numWritten;
+        }
+        done += n;
+    }
+
+    if (err != OK && modified) {
+        // the file is inconsistent now
+        mError = err;
+    }
+
+    if (buffer != mBuffer) {
+        free(buffer);
+    }
+
+    return err;
+}
+
+status_t BufferedFileWriter::flush() {
+    if (mThreadStarted) {
+        status_t err = queueBuffer();
+        if (err != OK) {
+            return err;
+        }
+        return waitForIdle();
+    }
+
+    if (mError != OK || mBufferedSize == 0) {
+        return mError;
+    }
+
+    return writeOut(NULL, 0);
+}
+
+status_t BufferedFileWriter::submit() {
+    if (!mThreadStarted) {
+        return flush();
+    }
+
+    return queueBuffer();
+}
+
+void BufferedFileWriter::getIOStats(IOStats *stats) {
+    Mutex::Autolock autoLock(mLock);
+    *stats = mStats;
+}
+
+status_t BufferedFileWriter::writeOut(const struct iovec *iov, int iovcnt) {
+    CHECK_LE(iovcnt, kMaxIovecs);
+
+    struct iovec vecs[kMaxIovecs + 1];
+    int numVecs = 0;
+    size_t size = 0;
+
+    if (mBufferedSize > 0) {
+        vecs[numVecs].iov_base = mBuffer;
+        vecs[numVecs].iov_len = mBufferedSize;
+        size += mBufferedSize;
+        ++numVecs;
+    }
+
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len > 0) {
+            vecs[numVecs++] = iov[i];
+            size += iov[i].iov_len;
+        }
+    }
+
+    if (size == 0) {
+        return OK;
+    }
+
+    preallocate(mBufferOffset, mBufferOffset + size);
+
+    if (mFdOffset != mBufferOffset) {
+        ++mNumSyscalls;
+        if (lseek64(mFd, mBufferOffset, SEEK_SET) < 0) {
+            ALOGE("lseek64 failed: %s (%d)", strerror(errno), errno);
+            mError = -errno;
+            return mError;
+        }
+        mFdOffset = mBufferOffset;
+    }
+
+    struct iovec *next = vecs;
+    while (numVecs > 0) {
+        ssize_t n = ::writev(mFd, next, numVecs);
+        ++mNumSyscalls;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("writev failed: %s (%d)", strerror(errno), errno);
+            mError = -errno;
+            mFdOffset = -1;
+            return mError;
+        }
+
+        // skip what has been written, partial writes are rare
+        mFdOffset += n;
+        while (numVecs > 0 && (size_t)n >= next->iov_len) {
+            n -= next->iov_len;
+            ++next;
+            --numVecs;
+        }
+        if (numVecs > 0) {
+            next->iov_base = (uint8_t *)next->iov_base + n;
+            next->iov_len -= n;
+        }
+    }
+
+    mBufferOffset += size;
+    mBufferedSize = 0;
+
+    return OK;
+}
+
+void BufferedFileWriter::preallocate(off64_t offset, off64_t end) {
+    if (mPreallocationSize <= 0 || end <= mPreallocatedEnd) {
+        return;
+    }
+
+    off64_t start = mPreallocatedEnd > offset ? mPreallocatedEnd : offset;
+    off64_t newEnd = end + mPreallocationSize;
+
+    // KEEP_SIZE so that a recording that is cut short has no zero tail
+    ++mNumSyscalls;
+    if (fallocate64(mFd, FALLOC_FL_KEEP_SIZE, start, newEnd - start) != 0) {
+        ALOGW("fallocate not supported (%s), not preallocating", strerror(errno));
+        mPreallocationSize = 0;
+        return;
+    }
+
+    mPreallocatedEnd = newEnd;
+}
+
+status_t BufferedFileWriter::queueBuffer() {
+    if (mError != OK || mBufferedSize == 0) {
+        return mError;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    Block block;
+    block.mData = mBuffer;
+    block.mSize = mBufferedSize;
+    block.mOffset = mBufferOffset;
+    mQueue.push_back(block);
+    if (mQueue.size() > mStats.mMaxQueuedBuffers) {
+        mStats.mMaxQueuedBuffers = mQueue.size();
+    }
+    mCondition.broadcast();
+
+    mBufferOffset += mBufferedSize;
+    mBufferedSize = 0;
+    mBuffer = NULL;
+
+    if (mFreeBuffers.isEmpty()) {
+        // the storage can't keep up, nothing to do but wait
+        int64_t startUs = systemTime() / 1000;
+        while (mFreeBuffers.isEmpty()) {
+            mCondition.wait(mLock);
+        }
+        int64_t stallTimeUs = systemTime() / 1000 - startUs;
+        ALOGV("waited %" PRId64 " us for a free buffer", stallTimeUs);
+        ++mStats.mNumStalls;
+        mStats.mStallTimeUs += stallTimeUs;
+    }
+
+    mBuffer = mFreeBuffers.top();
+    mFreeBuffers.pop();
+
+    mError = mIOError;
+    return mError;
+}
+
+status_t BufferedFileWriter::waitForIdle() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mQueue.empty() || mWriting) {
+        mCondition.wait(mLock);
+    }
+
+    if (mError == OK) {
+        mError = mIOError;
+    }
+    return mError;
+}
+
+status_t BufferedFileWriter::writeBlock(const Block &block) {
+    preallocate(block.mOffset, block.mOffset + block.mSize);
+
+    const uint8_t *ptr = block.mData;
+    size_t size = block.mSize;
+    off64_t offset = block.mOffset;
+    while (size > 0) {
+        ssize_t n = pwrite64(mFd, ptr, size, offset);
+        ++mNumSyscalls;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("pwrite64 failed: %s (%d)", strerror(errno), errno);
+            return -errno;
+        }
+        ptr += n;
+        offset += n;
+        size -= n;
+    }
+
+    return OK;
+}
+
+// static
+void *BufferedFileWriter::ThreadWrapper(void *me) {
+    static_cast<BufferedFileWriter *>(me)->threadFunc();
+    return NULL;
+}
+
+void BufferedFileWriter::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"FileWriterIO", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mQueue.empty() && !mExit) {
+            mCondition.wait(mLock);
+        }
+        if (mQueue.empty()) {
+            break;
+        }
+
+        Block block = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+
+        // after an error the rest is dropped, the caller sees the error
+        if (mIOError == OK) {
+            mWriting = true;
+            mLock.unlock();
+
+            int64_t startUs = systemTime() / 1000;
+            status_t err = writeBlock(block);
+            int64_t writeTimeUs = systemTime() / 1000 - startUs;
+
+            mLock.lock();
+            mWriting = false;
+            if (writeTimeUs > mStats.mMaxWriteTimeUs) {
+                mStats.mMaxWriteTimeUs = writeTimeUs;
+            }
+            mIOError = err;
+        }
+
+        mFreeBuffers.push(block.mData);
+        mCondition.broadcast();
+    }
+}
+
+}  // namespace android
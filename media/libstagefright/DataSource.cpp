@@ -16,6 +16,9 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "DataSource"
 
+#include <inttypes.h>
+#include <unistd.h>
+
 #include "include/AMRExtractor.h"
 
 #include "include/AACExtractor.h"
@@ -30,6 +33,7 @@
 #include "include/MPEG4Extractor.h"
 #include "include/NuCachedSource2.h"
 #include "include/OggExtractor.h"
+#include "include/ProbeDataSource.h"
 #include "include/WAVExtractor.h"
 #include "include/WVMExtractor.h"
 
@@ -38,7 +42,9 @@
 #include <media/IMediaHTTPConnection.h>
 #include <media/IMediaHTTPService.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/DataURISource.h>
 #include <media/stagefright/FileSource.h>
@@ -110,50 +116,176 @@ status_t DataSource::getSize(off64_t *size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// All sniffers share one window of the source. It covers what most of
+// them read, sniffers that look further ahead go through the read ahead.
+static const size_t kSniffHeadSize = 16 * 1024;
+static const size_t kSniffReadAheadSize = 16 * 1024;
+
 Mutex DataSource::gSnifferMutex;
-List<DataSource::SnifferFunc> DataSource::gSniffers;
+Vector<DataSource::Sniffer> DataSource::gSniffers;
 bool DataSource::gSniffersRegistered = false;
 
+// Returns the extension of the path in |uri|, without the dot, or an empty
+// string if there is none.
+static AString GetExtension(const String8 &uri) {
+    AString path(uri.string());
+
+    ssize_t end = path.find("?");
+    if (end >= 0) {
+        path.erase(end, path.size() - end);
+    }
+    end = path.find("#");
+    if (end >= 0) {
+        path.erase(end, path.size() - end);
+    }
+
+    const char *dot = strrchr(path.c_str(), '.');
+    if (dot == NULL || strchr(dot, '/') != NULL) {
+        return AString();
+    }
+    return AString(dot + 1);
+}
+
+// Whether |extension| is one of the space separated |extensions|.
+static bool MatchesExtension(const char *extensions, const AString &extension) {
+    if (extension.empty()) {
+        return false;
+    }
+
+    const char *s = extensions;
+    while (*s != '\0') {
+        const char *end = strchr(s, ' ');
+        size_t length = (end != NULL) ? (size_t)(end - s) : strlen(s);
+        if (length == extension.size()
+                && !strncasecmp(s, extension.c_str(), length)) {
+            return true;
+        }
+        if (end == NULL) {
+            break;
+        }
+        s = end + 1;
+    }
+    return false;
+}
+
 bool DataSource::sniff(
         String8 *mimeType, float *confidence, sp<AMessage> *meta) {
     *mimeType = "";
     *confidence = 0.0f;
     meta->clear();
 
+    // A copy, as the counters of gSniffers change while sniffing.
+    Vector<Sniffer> sniffers;
     {
         Mutex::Autolock autoLock(gSnifferMutex);
         if (!gSniffersRegistered) {
             return false;
         }
+        sniffers = gSniffers;
+    }
+
+    size_t numSniffers = sniffers.size();
+
+    // Sniffers likely to recognize the content run first, the others in
+    // the order of how confident they can get. The outcome doesn't depend
+    // on the order: the most confident sniffer wins, and of equally
+    // confident ones the first registered.
+    AString extension = GetExtension(getUri());
+    Vector<size_t> order;
+    for (size_t i = 0; i < numSniffers; ++i) {
+        if (MatchesExtension(sniffers[i].mExtensions, extension)) {
+            order.push(i);
+        }
     }
+    size_t numHinted = order.size();
+    for (size_t i = 0; i < numSniffers; ++i) {
+        if (MatchesExtension(sniffers[i].mExtensions, extension)) {
+            continue;
+        }
+        size_t j = numHinted;
+        while (j < order.size()
+                && sniffers[order[j]].mMaxConfidence >= sniffers[i].mMaxConfidence) {
+            ++j;
+        }
+        order.insertAt(i, j);
+    }
+
+    sp<DataSource> source = new ProbeDataSource(
+            this, kSniffHeadSize, 0 /* tailSize */, kSniffReadAheadSize);
+
+    ssize_t best = -1;
+    for (size_t k = 0; k < order.size(); ++k) {
+        size_t i = order[k];
+        const Sniffer &sniffer = sniffers[i];
+
+        if (best >= 0 && (sniffer.mMaxConfidence < *confidence
+                || (sniffer.mMaxConfidence == *confidence && (ssize_t)i > best))) {
+            Mutex::Autolock autoLock(gSnifferMutex);
+            ++gSniffers.editItemAt(i).mNumSkips;
+            continue;
+        }
 
-    for (List<SnifferFunc>::iterator it = gSniffers.begin();
-         it != gSniffers.end(); ++it) {
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
-            if (newConfidence > *confidence) {
-                *mimeType = newMimeType;
-                *confidence = newConfidence;
-                *meta = newMeta;
+        int64_t startTimeUs = ALooper::GetNowUs();
+        bool found = (*sniffer.mFunc)(source, &newMimeType, &newConfidence, &newMeta);
+        int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+        ALOGV("sniffer %s took %" PRId64 " us: %s", sniffer.mName, elapsedTimeUs,
+              found ? newMimeType.string() : "no match");
+
+        {
+            Mutex::Autolock autoLock(gSnifferMutex);
+            Sniffer &stats = gSniffers.editItemAt(i);
+            ++stats.mNumCalls;
+            stats.mTotalTimeUs += elapsedTimeUs;
+            if (found) {
+                ++stats.mNumHits;
             }
         }
+
+        if (!found) {
+            continue;
+        }
+
+        if (newConfidence > sniffer.mMaxConfidence) {
+            ALOGW("sniffer %s is more confident than it should be (%.2f)",
+                  sniffer.mName, newConfidence);
+        }
+
+        if (newConfidence > *confidence
+                || (best >= 0 && newConfidence == *confidence && (ssize_t)i < best)) {
+            *mimeType = newMimeType;
+            *confidence = newConfidence;
+            *meta = newMeta;
+            best = i;
+        }
     }
 
     return *confidence > 0.0;
 }
 
 // static
-void DataSource::RegisterSniffer_l(SnifferFunc func) {
-    for (List<SnifferFunc>::iterator it = gSniffers.begin();
-         it != gSniffers.end(); ++it) {
-        if (*it == func) {
+void DataSource::RegisterSniffer_l(
+        SnifferFunc func, const char *name, float maxConfidence,
+        const char *extensions) {
+    for (size_t i = 0; i < gSniffers.size(); ++i) {
+        if (gSniffers[i].mFunc == func) {
             return;
         }
     }
 
-    gSniffers.push_back(func);
+    Sniffer sniffer;
+    sniffer.mFunc = func;
+    sniffer.mName = name;
+    sniffer.mMaxConfidence = maxConfidence;
+    sniffer.mExtensions = extensions;
+    sniffer.mNumCalls = 0;
+    sniffer.mNumHits = 0;
+    sniffer.mNumSkips = 0;
+    sniffer.mTotalTimeUs = 0;
+    gSniffers.push(sniffer);
 }
 
 // static
@@ -163,27 +295,49 @@ void DataSource::RegisterDefaultSniffers() {
         return;
     }
 
-    RegisterSniffer_l(SniffMPEG4);
-    RegisterSniffer_l(SniffMatroska);
-    RegisterSniffer_l(SniffOgg);
-    RegisterSniffer_l(SniffWAV);
-    RegisterSniffer_l(SniffFLAC);
-    RegisterSniffer_l(SniffAMR);
-    RegisterSniffer_l(SniffMPEG2TS);
-    RegisterSniffer_l(SniffMP3);
-    RegisterSniffer_l(SniffAAC);
-    RegisterSniffer_l(SniffMPEG2PS);
-    RegisterSniffer_l(SniffWVM);
-    RegisterSniffer_l(SniffMidi);
+    // The confidences are the highest each sniffer reports.
+    RegisterSniffer_l(SniffMPEG4, "MPEG4", 0.4f, "mp4 m4a m4v mov 3gp 3gpp 3g2 3gpp2");
+    RegisterSniffer_l(SniffMatroska, "Matroska", 0.6f, "mkv mka webm");
+    RegisterSniffer_l(SniffOgg, "Ogg", 0.2f, "ogg oga opus");
+    RegisterSniffer_l(SniffWAV, "WAV", 0.3f, "wav");
+    RegisterSniffer_l(SniffFLAC, "FLAC", 0.5f, "flac");
+    RegisterSniffer_l(SniffAMR, "AMR", 0.5f, "amr awb");
+    RegisterSniffer_l(SniffMPEG2TS, "MPEG2TS", 0.1f, "ts m2ts");
+    RegisterSniffer_l(SniffMP3, "MP3", 0.2f, "mp3 mpga");
+    RegisterSniffer_l(SniffAAC, "AAC", 0.2f, "aac");
+    RegisterSniffer_l(SniffMPEG2PS, "MPEG2PS", 0.25f, "mpg mpeg");
+    RegisterSniffer_l(SniffWVM, "WVM", 10.0f, "wvm");
+    RegisterSniffer_l(SniffMidi, "Midi", 0.8f,
+            "mid midi smf xmf mxmf imy rtttl rtx ota");
 
     char value[PROPERTY_VALUE_MAX];
     if (property_get("drm.service.enabled", value, NULL)
             && (!strcmp(value, "1") || !strcasecmp(value, "true"))) {
-        RegisterSniffer_l(SniffDRM);
+        RegisterSniffer_l(SniffDRM, "DRM", 10.0f, "dcf dm fl");
     }
     gSniffersRegistered = true;
 }
 
+// static
+void DataSource::DumpSniffers(int fd) {
+    Mutex::Autolock autoLock(gSnifferMutex);
+
+    AString s = "Sniffers:\n";
+    for (size_t i = 0; i < gSniffers.size(); ++i) {
+        const Sniffer &sniffer = gSniffers[i];
+        s.append(AStringPrintf(
+                "  %-9s calls %zu, hits %zu, skipped %zu, total %" PRId64 " us",
+                sniffer.mName, sniffer.mNumCalls, sniffer.mNumHits,
+                sniffer.mNumSkips, sniffer.mTotalTimeUs));
+        if (sniffer.mNumCalls > 0) {
+            s.append(AStringPrintf(
+                    ", avg %" PRId64 " us", sniffer.mTotalTimeUs / sniffer.mNumCalls));
+        }
+        s.append("\n");
+    }
+    write(fd, s.c_str(), s.size());
+}
+
 // static
 sp<DataSource> DataSource::CreateFromURI(
         const sp<IMediaHTTPService> &httpService,
@@ -0,0 +1,874 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FragmentedMP4Parser"
+#include <utils/Log.h>
+
+#include "include/FragmentedMP4Parser.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
+
+namespace android {
+
+// moov and moof boxes are buffered completely before parsing
+static const uint64_t kMaxBufferedBoxSize = 16 * 1024 * 1024;
+
+// sample_is_non_sync_sample in the sample flags
+static const uint32_t kSampleFlagNonSync = 0x10000;
+
+static void MakeFourCCString(uint32_t x, char *s) {
+    s[0] = x >> 24;
+    s[1] = (x >> 16) & 0xff;
+    s[2] = (x >> 8) & 0xff;
+    s[3] = x & 0xff;
+    s[4] = '\0';
+}
+
+// Exposes a buffered moov box to MPEG4Extractor.
+struct BufferSource : public DataSource {
+    BufferSource(const sp<ABuffer> &buffer)
+        : mBuffer(buffer) {
+    }
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset < 0) {
+            return ERROR_MALFORMED;
+        }
+        if (offset >= (off64_t)mBuffer->size()) {
+            return 0;
+        }
+
+        size_t available = mBuffer->size() - offset;
+        size_t copy = available < size ? available : size;
+        memcpy(data, mBuffer->data() + offset, copy);
+
+        return copy;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = mBuffer->size();
+        return OK;
+    }
+
+private:
+    sp<ABuffer> mBuffer;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BufferSource);
+};
+
+// Reads the header of the box at |*offset| within |data|, which must be
+// contained entirely. On return |*offset| points to the box payload.
+static status_t parseChildBox(
+        const uint8_t *data, size_t size, size_t *offset,
+        uint32_t *type, size_t *payloadSize) {
+    size_t remaining = size - *offset;
+    if (remaining < 8) {
+        return ERROR_MALFORMED;
+    }
+
+    const uint8_t *ptr = data + *offset;
+    uint64_t boxSize = U32_AT(ptr);
+    *type = U32_AT(ptr + 4);
+    size_t headerSize = 8;
+
+    if (boxSize == 1) {
+        if (remaining < 16) {
+            return ERROR_MALFORMED;
+        }
+        boxSize = U64_AT(ptr + 8);
+        headerSize = 16;
+    } else if (boxSize == 0) {
+        boxSize = remaining;
+    }
+
+    if (boxSize < headerSize || boxSize > remaining) {
+        return ERROR_MALFORMED;
+    }
+
+    *offset += headerSize;
+    *payloadSize = boxSize - headerSize;
+
+    return OK;
+}
+
+FragmentedMP4Parser::FragmentedMP4Parser()
+    : mBufferOffset(0),
+      mState(WAITING_FOR_BOX_HEADER),
+      mFinalResult(OK),
+      mEOS(false),
+      mBoxType(0),
+      mBoxOffset(0),
+      mBoxEnd(0) {
+}
+
+FragmentedMP4Parser::~FragmentedMP4Parser() {
+}
+
+status_t FragmentedMP4Parser::appendData(const uint8_t *data, size_t size) {
+    if (mFinalResult != OK) {
+        return mFinalResult;
+    }
+
+    if (mEOS) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    if (size == 0) {
+        return OK;
+    }
+
+    appendToBuffer(data, size);
+
+    mFinalResult = processBuffer();
+    return mFinalResult;
+}
+
+status_t FragmentedMP4Parser::signalEndOfStream() {
+    mEOS = true;
+
+    if (mFinalResult != OK) {
+        return mFinalResult;
+    }
+
+    bool truncated = !mPendingSamples.empty();
+    switch (mState) {
+        case WAITING_FOR_BOX_HEADER:
+            truncated = truncated || (mBuffer != NULL && mBuffer->size() > 0);
+            break;
+
+        case READING_MDAT:
+        case SKIPPING_BOX:
+            // a box of size 0 extends to the end of the stream
+            truncated = truncated || mBoxEnd != UINT64_MAX;
+            break;
+
+        default:
+            truncated = true;
+            break;
+    }
+
+    if (truncated) {
+        ALOGW("stream ended in the middle of a box or sample");
+        mFinalResult = ERROR_MALFORMED;
+    }
+
+    return mFinalResult;
+}
+
+void FragmentedMP4Parser::flush() {
+    mPendingSamples.clear();
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        mTracks.editItemAt(i).mAccessUnits.clear();
+    }
+    if (mBuffer != NULL) {
+        mBufferOffset += mBuffer->size();
+        mBuffer->setRange(0, 0);
+    }
+    mState = WAITING_FOR_BOX_HEADER;
+    mFinalResult = OK;
+    mEOS = false;
+}
+
+size_t FragmentedMP4Parser::countTracks() const {
+    return mTracks.size();
+}
+
+sp<MetaData> FragmentedMP4Parser::getTrackFormat(size_t index) const {
+    if (index >= mTracks.size()) {
+        return NULL;
+    }
+    return mTracks.itemAt(index).mFormat;
+}
+
+status_t FragmentedMP4Parser::dequeueAccessUnit(
+        size_t index, sp<ABuffer> *accessUnit) {
+    if (index >= mTracks.size()) {
+        return -EINVAL;
+    }
+
+    TrackInfo *track = &mTracks.editItemAt(index);
+    if (track->mAccessUnits.empty()) {
+        return mEOS ? ERROR_END_OF_STREAM : -EAGAIN;
+    }
+
+    *accessUnit = *track->mAccessUnits.begin();
+    track->mAccessUnits.erase(track->mAccessUnits.begin());
+
+    return OK;
+}
+
+void FragmentedMP4Parser::appendToBuffer(const uint8_t *data, size_t size) {
+    if (mBuffer == NULL) {
+        mBuffer = new ABuffer(size < 65536 ? 65536 : size);
+        mBuffer->setRange(0, 0);
+    }
+
+    if (mBuffer->offset() + mBuffer->size() + size > mBuffer->capacity()) {
+        size_t needed = mBuffer->size() + size;
+        if (needed > mBuffer->capacity()) {
+            size_t capacity = mBuffer->capacity();
+            while (capacity < needed) {
+                capacity *= 2;
+            }
+
+            sp<ABuffer> buffer = new ABuffer(capacity);
+            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
+            buffer->setRange(0, mBuffer->size());
+            mBuffer = buffer;
+        } else {
+            memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+            mBuffer->setRange(0, mBuffer->size());
+        }
+    }
+
+    memcpy(mBuffer->data() + mBuffer->size(), data, size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
+}
+
+void FragmentedMP4Parser::consume(size_t size) {
+    CHECK_LE(size, mBuffer->size());
+    mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+    mBufferOffset += size;
+}
+
+status_t FragmentedMP4Parser::processBuffer() {
+    for (;;) {
+        switch (mState) {
+            case WAITING_FOR_BOX_HEADER:
+            {
+                bool needMore;
+                status_t err = parseBoxHeader(&needMore);
+                if (err != OK || needMore) {
+                    return err;
+                }
+                break;
+            }
+
+            case WAITING_FOR_BOX:
+            {
+                size_t boxSize = mBoxEnd - mBoxOffset;
+                if (mBuffer->size() < boxSize) {
+                    return OK;
+                }
+
+                status_t err;
+                if (mBoxType == FOURCC('m', 'o', 'o', 'v')) {
+                    err = parseMovie(mBuffer->data(), boxSize);
+                } else {
+                    err = parseMovieFragment(mBuffer->data(), boxSize);
+                }
+                if (err != OK) {
+                    return err;
+                }
+
+                consume(boxSize);
+                mState = WAITING_FOR_BOX_HEADER;
+                break;
+            }
+
+            case READING_MDAT:
+            {
+                status_t err = readMdat();
+                if (err != OK) {
+                    return err;
+                }
+                if (mBufferOffset < mBoxEnd) {
+                    return OK;
+                }
+                mState = WAITING_FOR_BOX_HEADER;
+                break;
+            }
+
+            case SKIPPING_BOX:
+            {
+                uint64_t remaining = mBoxEnd - mBufferOffset;
+                size_t skip = mBuffer->size() < remaining
+                        ? mBuffer->size() : (size_t)remaining;
+                consume(skip);
+                if (mBufferOffset < mBoxEnd) {
+                    return OK;
+                }
+                mState = WAITING_FOR_BOX_HEADER;
+                break;
+            }
+
+            default:
+                TRESPASS();
+        }
+    }
+}
+
+status_t FragmentedMP4Parser::parseBoxHeader(bool *needMore) {
+    *needMore = true;
+
+    if (mBuffer->size() < 8) {
+        return OK;
+    }
+
+    const uint8_t *ptr = mBuffer->data();
+    uint64_t boxSize = U32_AT(ptr);
+    uint32_t type = U32_AT(ptr + 4);
+    size_t headerSize = 8;
+
+    if (boxSize == 1) {
+        if (mBuffer->size() < 16) {
+            return OK;
+        }
+        boxSize = U64_AT(ptr + 8);
+        headerSize = 16;
+    }
+
+    if (boxSize != 0 && boxSize < headerSize) {
+        ALOGE("invalid box size %llu", (unsigned long long)boxSize);
+        return ERROR_MALFORMED;
+    }
+
+    mBoxType = type;
+    mBoxOffset = mBufferOffset;
+    mBoxEnd = boxSize == 0 ? UINT64_MAX : mBufferOffset + boxSize;
+
+    char chunk[5];
+    MakeFourCCString(type, chunk);
+    ALOGV("box '%s' @ %llu, size %llu",
+            chunk, (unsigned long long)mBoxOffset, (unsigned long long)boxSize);
+
+    switch (type) {
+        case FOURCC('m', 'o', 'o', 'v'):
+        case FOURCC('m', 'o', 'o', 'f'):
+            if (boxSize == 0 || boxSize > kMaxBufferedBoxSize) {
+                ALOGE("'%s' box too large (%llu bytes)",
+                        chunk, (unsigned long long)boxSize);
+                return ERROR_MALFORMED;
+            }
+            mState = WAITING_FOR_BOX;
+            break;
+
+        case FOURCC('m', 'd', 'a', 't'):
+            consume(headerSize);
+            mState = READING_MDAT;
+            break;
+
+        default:
+            // ftyp, styp, sidx, emsg, free, ...
+            consume(headerSize);
+            mState = SKIPPING_BOX;
+            break;
+    }
+
+    *needMore = false;
+    return OK;
+}
+
+status_t FragmentedMP4Parser::readMdat() {
+    uint64_t available = mBufferOffset + mBuffer->size();
+    uint64_t end = mBoxEnd < available ? mBoxEnd : available;
+
+    while (!mPendingSamples.empty()) {
+        const PendingSample &sample = *mPendingSamples.begin();
+
+        if (sample.mOffset < mBufferOffset) {
+            ALOGW("dropping sample of track %zu, data at %llu already passed",
+                    sample.mTrackIndex, (unsigned long long)sample.mOffset);
+            mPendingSamples.erase(mPendingSamples.begin());
+            continue;
+        }
+
+        if (sample.mOffset >= mBoxEnd) {
+            // in a later mdat
+            break;
+        }
+
+        if (sample.mOffset + sample.mSize > mBoxEnd) {
+            ALOGE("sample exceeds mdat");
+            return ERROR_MALFORMED;
+        }
+
+        if (sample.mOffset + sample.mSize > end) {
+            // wait for the rest of the sample, which may not even start
+            // within the data received so far
+            consume((sample.mOffset < end ? sample.mOffset : end) - mBufferOffset);
+            return OK;
+        }
+
+        status_t err = queueAccessUnit(
+                sample, mBuffer->data() + (sample.mOffset - mBufferOffset));
+        if (err != OK) {
+            return err;
+        }
+
+        consume(sample.mOffset + sample.mSize - mBufferOffset);
+        mPendingSamples.erase(mPendingSamples.begin());
+    }
+
+    // nothing refers to the remaining data received so far
+    uint64_t discardEnd = end;
+    if (!mPendingSamples.empty() && mPendingSamples.begin()->mOffset < discardEnd) {
+        discardEnd = mPendingSamples.begin()->mOffset;
+    }
+    consume(discardEnd - mBufferOffset);
+
+    return OK;
+}
+
+status_t FragmentedMP4Parser::parseMovie(const uint8_t *data, size_t size) {
+    sp<ABuffer> moov = new ABuffer(size);
+    memcpy(moov->data(), data, size);
+
+    sp<MPEG4Extractor> extractor = new MPEG4Extractor(new BufferSource(moov));
+
+    size_t numTracks = extractor->countTracks();
+    if (numTracks == 0) {
+        ALOGE("no tracks in moov");
+        return ERROR_MALFORMED;
+    }
+
+    mTracks.clear();
+    mPendingSamples.clear();
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        TrackInfo track;
+        status_t err = extractor->getTrackFragmentDefaults(
+                i, &track.mTrackID, &track.mTimescale, &track.mTrex);
+        if (err != OK) {
+            return err;
+        }
+
+        track.mFormat = extractor->getTrackMetaData(i, 0 /* flags */);
+        if (track.mFormat == NULL) {
+            return ERROR_MALFORMED;
+        }
+
+        int32_t cryptoMode;
+        if (track.mFormat->findInt32(kKeyCryptoMode, &cryptoMode)) {
+            ALOGE("encrypted fragmented mp4 tracks are not supported");
+            return ERROR_UNSUPPORTED;
+        }
+
+        track.mNALLengthSize = 0;
+        uint32_t type;
+        const void *ptr;
+        size_t ptrSize;
+        if (track.mFormat->findData(kKeyAVCC, &type, &ptr, &ptrSize)
+                && ptrSize >= 5) {
+            track.mNALLengthSize = 1 + (((const uint8_t *)ptr)[4] & 3);
+        } else if (track.mFormat->findData(kKeyHVCC, &type, &ptr, &ptrSize)
+                && ptrSize >= 22) {
+            track.mNALLengthSize = 1 + (((const uint8_t *)ptr)[21] & 3);
+        }
+
+        track.mNextDecodeTime = 0;
+
+        ALOGV("track %zu: id %u, timescale %u, nal length size %zu",
+                i, track.mTrackID, track.mTimescale, track.mNALLengthSize);
+
+        mTracks.push_back(track);
+    }
+
+    return OK;
+}
+
+status_t FragmentedMP4Parser::parseMovieFragment(
+        const uint8_t *data, size_t size) {
+    size_t offset = 0;
+    uint32_t type;
+    size_t payloadSize;
+    status_t err = parseChildBox(data, size, &offset, &type, &payloadSize);
+    if (err != OK) {
+        return err;
+    }
+
+    // without an explicit base, the first traf's data starts at the moof and
+    // every following one where the data of the previous traf ended
+    uint64_t implicitBaseDataOffset = mBoxOffset;
+
+    size_t end = offset + payloadSize;
+    while (offset < end) {
+        err = parseChildBox(data, end, &offset, &type, &payloadSize);
+        if (err != OK) {
+            return err;
+        }
+
+        if (type == FOURCC('t', 'r', 'a', 'f')) {
+            err = parseTrackFragment(
+                    data + offset, payloadSize, mBoxOffset,
+                    &implicitBaseDataOffset);
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        offset += payloadSize;
+    }
+
+    return OK;
+}
+
+status_t FragmentedMP4Parser::parseTrackFragment(
+        const uint8_t *data, size_t size, uint64_t moofOffset,
+        uint64_t *implicitBaseDataOffset) {
+    TrackFragment fragment;
+    fragment.mTrackIndex = -1;
+
+    size_t offset = 0;
+    while (offset < size) {
+        uint32_t type;
+        size_t payloadSize;
+        status_t err = parseChildBox(data, size, &offset, &type, &payloadSize);
+        if (err != OK) {
+            return err;
+        }
+
+        const uint8_t *payload = data + offset;
+        offset += payloadSize;
+
+        if (type == FOURCC('t', 'f', 'h', 'd')) {
+            err = parseTrackFragmentHeader(
+                    payload, payloadSize, moofOffset, *implicitBaseDataOffset,
+                    &fragment);
+            if (err != OK) {
+                return err;
+            }
+            continue;
+        }
+
+        if (fragment.mTrackIndex < 0) {
+            // no tfhd yet, or a track we don't know about
+            continue;
+        }
+
+        if (type == FOURCC('t', 'f', 'd', 't')) {
+            if (payloadSize < 8) {
+                return ERROR_MALFORMED;
+            }
+            TrackInfo *track = &mTracks.editItemAt(fragment.mTrackIndex);
+            if (payload[0] == 1) {
+                if (payloadSize < 12) {
+                    return ERROR_MALFORMED;
+                }
+                track->mNextDecodeTime = U64_AT(payload + 4);
+            } else {
+                track->mNextDecodeTime = U32_AT(payload + 4);
+            }
+        } else if (type == FOURCC('t', 'r', 'u', 'n')) {
+            err = parseTrackFragmentRun(payload, payloadSize, &fragment);
+            if (err != OK) {
+                return err;
+            }
+        }
+    }
+
+    if (fragment.mTrackIndex >= 0) {
+        *implicitBaseDataOffset = fragment.mDataOffset;
+    }
+
+    return OK;
+}
+
+status_t FragmentedMP4Parser::parseTrackFragmentHeader(
+        const uint8_t *data, size_t size, uint64_t moofOffset,
+        uint64_t implicitBaseDataOffset, TrackFragment *fragment) {
+    enum {
+        kBaseDataOffsetPresent         = 0x01,
+        kSampleDescriptionIndexPresent = 0x02,
+        kDefaultSampleDurationPresent  = 0x08,
+        kDefaultSampleSizePresent      = 0x10,
+        kDefaultSampleFlagsPresent     = 0x20,
+        kDefaultBaseIsMoof             = 0x20000,
+    };
+
+    if (size < 8) {
+        return ERROR_MALFORMED;
+    }
+
+    uint32_t flags = U32_AT(data) & 0xffffff;
+    uint32_t trackID = U32_AT(data + 4);
+    data += 8;
+    size -= 8;
+
+    fragment->mTrackIndex = findTrack(trackID);
+    if (fragment->mTrackIndex < 0) {
+        ALOGW("ignoring fragment of unknown track %u", trackID);
+        return OK;
+    }
+
+    const Trex &trex = mTracks.itemAt(fragment->mTrackIndex).mTrex;
+
+    fragment->mFlags = flags;
+    fragment->mBaseDataOffset = (flags & kDefaultBaseIsMoof)
+            ? moofOffset : implicitBaseDataOffset;
+    fragment->mDefaultSampleDuration = trex.default_sample_duration;
+    fragment->mDefaultSampleSize = trex.default_sample_size;
+    fragment->mDefaultSampleFlags = trex.default_sample_flags;
+
+    if (flags & kBaseDataOffsetPresent) {
+        if (size < 8) {
+            return ERROR_MALFORMED;
+        }
+        fragment->mBaseDataOffset = U64_AT(data);
+        data += 8;
+        size -= 8;
+    }
+
+    if (flags & kSampleDescriptionIndexPresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        data += 4;
+        size -= 4;
+    }
+
+    if (flags & kDefaultSampleDurationPresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        fragment->mDefaultSampleDuration = U32_AT(data);
+        data += 4;
+        size -= 4;
+    }
+
+    if (flags & kDefaultSampleSizePresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        fragment->mDefaultSampleSize = U32_AT(data);
+        data += 4;
+        size -= 4;
+    }
+
+    if (flags & kDefaultSampleFlagsPresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        fragment->mDefaultSampleFlags = U32_AT(data);
+        data += 4;
+        size -= 4;
+    }
+
+    fragment->mDataOffset = fragment->mBaseDataOffset;
+
+    return OK;
+}
+
+status_t FragmentedMP4Parser::parseTrackFragmentRun(
+        const uint8_t *data, size_t size, TrackFragment *fragment) {
+    enum {
+        kDataOffsetPresent                  = 0x01,
+        kFirstSampleFlagsPresent            = 0x04,
+        kSampleDurationPresent              = 0x100,
+        kSampleSizePresent                  = 0x200,
+        kSampleFlagsPresent                 = 0x400,
+        kSampleCompositionTimeOffsetPresent = 0x800,
+    };
+
+    if (size < 8) {
+        return ERROR_MALFORMED;
+    }
+
+    uint32_t flags = U32_AT(data) & 0xffffff;
+    uint32_t sampleCount = U32_AT(data + 4);
+    data += 8;
+    size -= 8;
+
+    if ((flags & kFirstSampleFlagsPresent) && (flags & kSampleFlagsPresent)) {
+        // These two shall not be used together.
+        return ERROR_MALFORMED;
+    }
+
+    uint64_t dataOffset = fragment->mDataOffset;
+    if (flags & kDataOffsetPresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        dataOffset = fragment->mBaseDataOffset + (int32_t)U32_AT(data);
+        data += 4;
+        size -= 4;
+    }
+
+    uint32_t firstSampleFlags = fragment->mDefaultSampleFlags;
+    if (flags & kFirstSampleFlagsPresent) {
+        if (size < 4) {
+            return ERROR_MALFORMED;
+        }
+        firstSampleFlags = U32_AT(data);
+        data += 4;
+        size -= 4;
+    }
+
+    size_t bytesPerSample = 0;
+    if (flags & kSampleDurationPresent) {
+        bytesPerSample += 4;
+    }
+    if (flags & kSampleSizePresent) {
+        bytesPerSample += 4;
+    }
+    if (flags & kSampleFlagsPresent) {
+        bytesPerSample += 4;
+    }
+    if (flags & kSampleCompositionTimeOffsetPresent) {
+        bytesPerSample += 4;
+    }
+
+    if (bytesPerSample > 0 && sampleCount > size / bytesPerSample) {
+        return ERROR_MALFORMED;
+    }
+
+    TrackInfo *track = &mTracks.editItemAt(fragment->mTrackIndex);
+
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+        uint32_t sampleDuration = fragment->mDefaultSampleDuration;
+        uint32_t sampleSize = fragment->mDefaultSampleSize;
+        uint32_t sampleFlags = i == 0 ? firstSampleFlags : fragment->mDefaultSampleFlags;
+        int32_t sampleCtsOffset = 0;
+
+        if (flags & kSampleDurationPresent) {
+            sampleDuration = U32_AT(data);
+            data += 4;
+        }
+        if (flags & kSampleSizePresent) {
+            sampleSize = U32_AT(data);
+            data += 4;
+        }
+        if (flags & kSampleFlagsPresent) {
+            sampleFlags = U32_AT(data);
+            data += 4;
+        }
+        if (flags & kSampleCompositionTimeOffsetPresent) {
+            // unsigned in version 0, but never meant to be that large
+            sampleCtsOffset = (int32_t)U32_AT(data);
+            data += 4;
+        }
+
+        PendingSample sample;
+        sample.mTrackIndex = fragment->mTrackIndex;
+        sample.mOffset = dataOffset;
+        sample.mSize = sampleSize;
+        sample.mDecodeTime = track->mNextDecodeTime;
+        sample.mCompositionOffset = sampleCtsOffset;
+        sample.mDuration = sampleDuration;
+        sample.mIsSync = !(sampleFlags & kSampleFlagNonSync);
+
+        if (sample.mOffset < mBoxEnd) {
+            ALOGE("sample data precedes its moof");
+            return ERROR_MALFORMED;
+        }
+
+        queuePendingSample(sample);
+
+        dataOffset += sampleSize;
+        track->mNextDecodeTime += sampleDuration;
+    }
+
+    fragment->mDataOffset = dataOffset;
+
+    return OK;
+}
+
+ssize_t FragmentedMP4Parser::findTrack(uint32_t trackID) const {
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        if (mTracks.itemAt(i).mTrackID == trackID) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void FragmentedMP4Parser::queuePendingSample(const PendingSample &sample) {
+    // trafs usually interleave their runs in the mdat, keep offset order
+    List<PendingSample>::iterator it = mPendingSamples.end();
+    while (it != mPendingSamples.begin()) {
+        List<PendingSample>::iterator prev = it;
+        --prev;
+        if (prev->mOffset <= sample.mOffset) {
+            break;
+        }
+        it = prev;
+    }
+    mPendingSamples.insert(it, sample);
+}
+
+status_t FragmentedMP4Parser::queueAccessUnit(
+        const PendingSample &sample, const uint8_t *data) {
+    TrackInfo *track = &mTracks.editItemAt(sample.mTrackIndex);
+
+    sp<ABuffer> accessUnit;
+    if (track->mNALLengthSize == 0) {
+        accessUnit = new ABuffer(sample.mSize);
+        memcpy(accessUnit->data(), data, sample.mSize);
+    } else {
+        // length prefixed NAL units -> start codes
+        size_t nalLengthSize = track->mNALLengthSize;
+        size_t outSize = 0;
+        size_t srcOffset = 0;
+        while (srcOffset < sample.mSize) {
+            if (sample.mSize - srcOffset < nalLengthSize) {
+                return ERROR_MALFORMED;
+            }
+            size_t nalLength = 0;
+            for (size_t i = 0; i < nalLengthSize; ++i) {
+                nalLength = (nalLength << 8) | data[srcOffset + i];
+            }
+            srcOffset += nalLengthSize;
+            if (nalLength > sample.mSize - srcOffset) {
+                ALOGE("incomplete NAL unit");
+                return ERROR_MALFORMED;
+            }
+            srcOffset += nalLength;
+            outSize += 4 + nalLength;
+        }
+
+        accessUnit = new ABuffer(outSize);
+        uint8_t *dst = accessUnit->data();
+        srcOffset = 0;
+        while (srcOffset < sample.mSize) {
+            size_t nalLength = 0;
+            for (size_t i = 0; i < nalLengthSize; ++i) {
+                nalLength = (nalLength << 8) | data[srcOffset + i];
+            }
+            srcOffset += nalLengthSize;
+            memcpy(dst, "\x00\x00\x00\x01", 4);
+            memcpy(dst + 4, data + srcOffset, nalLength);
+            dst += 4 + nalLength;
+            srcOffset += nalLength;
+        }
+    }
+
+    uint32_t timescale = track->mTimescale;
+    int64_t cts = (int64_t)sample.mDecodeTime + sample.mCompositionOffset;
+    accessUnit->meta()->setInt64("timeUs", cts * 1000000ll / timescale);
+    accessUnit->meta()->setInt64(
+            "durationUs", (int64_t)sample.mDuration * 1000000ll / timescale);
+    if (sample.mIsSync) {
+        accessUnit->meta()->setInt32("isSync", 1);
+    }
+
+    track->mAccessUnits.push_back(accessUnit);
+
+    return OK;
+}
+
+}  // namespace android
@@ -34,6 +34,19 @@
 
 namespace android {
 
+static const size_t kMaxPrograms = 16;
+static const size_t kMaxSourcesPerProgram = 16;
+
+// Paced output: how often the PSI tables and each program's PCR are sent.
+static const int64_t kPSIIntervalUs = 100000ll;
+static const int64_t kPCRIntervalUs = 40000ll;
+
+// How far the system time clock trails the timestamps of the access units
+// when pacing starts, which leaves room to send large frames in time.
+static const int64_t kPacedDelayUs = 300000ll;
+
+static const size_t kPacketsPerChunk = 64;
+
 struct MPEG2TSWriter::SourceInfo : public AHandler {
     SourceInfo(const sp<MediaSource> &source);
 
@@ -43,6 +56,10 @@ struct MPEG2TSWriter::SourceInfo : public AHandler {
     unsigned streamType() const;
     unsigned incrementContinuityCounter();
 
+    void setPID(unsigned PID, unsigned streamID);
+    unsigned PID() const;
+    unsigned streamID() const;
+
     void readMore();
 
     enum {
@@ -82,6 +99,8 @@ private:
 
     unsigned mStreamType;
     unsigned mContinuityCounter;
+    unsigned mPID;
+    unsigned mStreamID;
 
     void extractCodecSpecificData();
 
@@ -98,7 +117,9 @@ MPEG2TSWriter::SourceInfo::SourceInfo(const sp<MediaSource> &source)
       mLooper(new ALooper),
       mEOSReceived(false),
       mStreamType(0),
-      mContinuityCounter(0) {
+      mContinuityCounter(0),
+      mPID(0),
+      mStreamID(0) {
     mLooper->setName("MPEG2TSWriter source");
 
     sp<MetaData> meta = mSource->getFormat();
@@ -129,6 +150,19 @@ unsigned MPEG2TSWriter::SourceInfo::incrementContinuityCounter() {
     return mContinuityCounter;
 }
 
+void MPEG2TSWriter::SourceInfo::setPID(unsigned PID, unsigned streamID) {
+    mPID = PID;
+    mStreamID = streamID;
+}
+
+unsigned MPEG2TSWriter::SourceInfo::PID() const {
+    return mPID;
+}
+
+unsigned MPEG2TSWriter::SourceInfo::streamID() const {
+    return mStreamID;
+}
+
 void MPEG2TSWriter::SourceInfo::start(const sp<AMessage> &notify) {
     mLooper->registerHandler(this);
     mLooper->start();
@@ -473,10 +507,15 @@ MPEG2TSWriter::MPEG2TSWriter(int fd)
       mWriteFunc(NULL),
       mStarted(false),
       mNumSourcesDone(0),
-      mNumTSPacketsWritten(0),
-      mNumTSPacketsBeforeMeta(0),
+      mWroteTables(false),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mOutputPackets(0),
+      mMuxRate(0),
+      mNumPendingPackets(0),
+      mDrainGeneration(0),
+      mPacingStarted(false),
+      mOutputDrained(false),
+      mWarnedOverflow(false) {
     init();
 }
 
@@ -488,10 +527,15 @@ MPEG2TSWriter::MPEG2TSWriter(
       mWriteFunc(write),
       mStarted(false),
       mNumSourcesDone(0),
-      mNumTSPacketsWritten(0),
-      mNumTSPacketsBeforeMeta(0),
+      mWroteTables(false),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mOutputPackets(0),
+      mMuxRate(0),
+      mNumPendingPackets(0),
+      mDrainGeneration(0),
+      mPacingStarted(false),
+      mOutputDrained(false),
+      mWarnedOverflow(false) {
     init();
 }
 
@@ -524,8 +568,17 @@ MPEG2TSWriter::~MPEG2TSWriter() {
 }
 
 status_t MPEG2TSWriter::addSource(const sp<MediaSource> &source) {
+    return addSource(source, 1);
+}
+
+status_t MPEG2TSWriter::addSource(
+        const sp<MediaSource> &source, unsigned programNumber) {
     CHECK(!mStarted);
 
+    if (programNumber == 0 || programNumber > 0xffff) {
+        return BAD_VALUE;
+    }
+
     sp<MetaData> meta = source->getFormat();
     const char *mime;
     CHECK(meta->findCString(kKeyMIMEType, &mime));
@@ -535,20 +588,78 @@ status_t MPEG2TSWriter::addSource(const sp<MediaSource> &source) {
         return ERROR_UNSUPPORTED;
     }
 
+    size_t programIndex = 0;
+    while (programIndex < mPrograms.size()
+            && mPrograms.itemAt(programIndex).mProgramNumber != programNumber) {
+        ++programIndex;
+    }
+
+    if (programIndex == mPrograms.size()) {
+        if (mPrograms.size() == kMaxPrograms) {
+            return ERROR_UNSUPPORTED;
+        }
+
+        // The first program keeps the PIDs of the single program layout,
+        // PMT on 0x1e0 and its streams right after it.
+        Program program;
+        program.mProgramNumber = programNumber;
+        program.mPMTPID = 0x1e0 + 0x20 * programIndex;
+        program.mPCRPID = program.mPMTPID + 1;
+        program.mPMTContinuityCounter = 0;
+        program.mPCRContinuityCounter = 0;
+        program.mNextPCRTimeUs = 0;
+        mPrograms.push(program);
+    }
+
+    Program *program = &mPrograms.editItemAt(programIndex);
+    if (program->mSourceIndices.size() == kMaxSourcesPerProgram) {
+        return ERROR_UNSUPPORTED;
+    }
+
     sp<SourceInfo> info = new SourceInfo(source);
 
+    // Streams of a kind within a program need distinct stream_ids.
+    unsigned streamID = info->streamType() == 0x0f ? 0xc0 : 0xe0;
+    for (size_t i = 0; i < program->mSourceIndices.size(); ++i) {
+        if (mSources.itemAt(program->mSourceIndices.itemAt(i))->streamType()
+                == info->streamType()) {
+            ++streamID;
+        }
+    }
+
+    // The first stream of a program carries its PCR.
+    info->setPID(program->mPMTPID + 1 + program->mSourceIndices.size(), streamID);
+
+    program->mSourceIndices.push(mSources.size());
     mSources.push(info);
 
     return OK;
 }
 
-status_t MPEG2TSWriter::start(MetaData * /* param */) {
+status_t MPEG2TSWriter::start(MetaData *param) {
     CHECK(!mStarted);
 
+    mMuxRate = 0;
+    int32_t muxRate;
+    if (param != NULL && param->findInt32(kKeyMuxRate, &muxRate) && muxRate > 0) {
+        mMuxRate = muxRate;
+
+        if (mFile != NULL) {
+            // Each group of packets has to go out in one write, e.g. to be
+            // one datagram on a UDP socket.
+            setvbuf(mFile, NULL, _IONBF, 0);
+        }
+    }
+
     mStarted = true;
     mNumSourcesDone = 0;
-    mNumTSPacketsWritten = 0;
-    mNumTSPacketsBeforeMeta = 0;
+    mWroteTables = false;
+    mOutputPackets = 0;
+    mPendingPackets.clear();
+    mNumPendingPackets = 0;
+    mPacingStarted = false;
+    mOutputDrained = false;
+    mWarnedOverflow = false;
 
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
@@ -568,6 +679,20 @@ status_t MPEG2TSWriter::reset() {
     for (size_t i = 0; i < mSources.size(); ++i) {
         mSources.editItemAt(i)->stop();
     }
+
+    Mutex::Autolock autoLock(mLock);
+
+    // Whatever still waits for its slot goes out right away.
+    ++mDrainGeneration;
+    while (mNumPendingPackets > 0) {
+        writePendingPacket();
+    }
+    flushOutput();
+
+    if (mFile != NULL) {
+        fflush(mFile);
+    }
+
     mStarted = false;
 
     return OK;
@@ -580,7 +705,13 @@ status_t MPEG2TSWriter::pause() {
 }
 
 bool MPEG2TSWriter::reachedEOS() {
-    return !mStarted || (mNumSourcesDone == mSources.size() ? true : false);
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mStarted) {
+        return true;
+    }
+
+    return mNumSourcesDone == mSources.size() && (mMuxRate == 0 || mOutputDrained);
 }
 
 status_t MPEG2TSWriter::dump(
@@ -589,6 +720,13 @@ status_t MPEG2TSWriter::dump(
 }
 
 void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mStarted) {
+        // stopped, reset() has flushed the output already
+        return;
+    }
+
     switch (msg->what()) {
         case kWhatSourceNotify:
         {
@@ -607,11 +745,27 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
                 source->setLastAccessUnit(NULL);
 
                 if (buffer != NULL) {
+                    if (mMuxRate > 0 && !mPacingStarted) {
+                        int64_t timeUs;
+                        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+                        startPacing(timeUs);
+                    }
+
                     writeTS();
                     writeAccessUnit(sourceIndex, buffer);
                 }
 
-                ++mNumSourcesDone;
+                // Access units of the other tracks may have been waiting
+                // for this one.
+                writeEarliestAccessUnit();
+
+                if (++mNumSourcesDone == mSources.size()) {
+                    if (mMuxRate == 0) {
+                        flushOutput();
+                    } else if (!mPacingStarted) {
+                        mOutputDrained = true;
+                    }
+                }
             } else if (what == SourceInfo::kNotifyBuffer) {
                 sp<ABuffer> buffer;
                 CHECK(msg->findBuffer("buffer", &buffer));
@@ -644,50 +798,73 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
                 ALOGV("lastAccessUnitTimeUs[%d] = %.2f secs",
                      sourceIndex, source->lastAccessUnitTimeUs() / 1E6);
 
-                int64_t minTimeUs = -1;
-                size_t minIndex = 0;
-
-                for (size_t i = 0; i < mSources.size(); ++i) {
-                    const sp<SourceInfo> &source = mSources.editItemAt(i);
+                writeEarliestAccessUnit();
+            }
+            break;
+        }
 
-                    if (source->eosReceived()) {
-                        continue;
-                    }
+        case kWhatDrain:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
 
-                    int64_t timeUs = source->lastAccessUnitTimeUs();
-                    if (timeUs < 0) {
-                        minTimeUs = -1;
-                        break;
-                    } else if (minTimeUs < 0 || timeUs < minTimeUs) {
-                        minTimeUs = timeUs;
-                        minIndex = i;
-                    }
-                }
+            if (generation != mDrainGeneration) {
+                break;
+            }
 
-                if (minTimeUs < 0) {
-                    ALOGV("not a all tracks have valid data.");
-                    break;
-                }
+            drainPacedOutput();
+            break;
+        }
 
-                ALOGV("writing access unit at time %.2f secs (index %zu)",
-                     minTimeUs / 1E6, minIndex);
+        default:
+            TRESPASS();
+    }
+}
 
-                source = mSources.editItemAt(minIndex);
+// Writes out the access unit with the smallest timestamp once every track
+// that hasn't reached EOS has one, and asks its track for the next one.
+void MPEG2TSWriter::writeEarliestAccessUnit() {
+    int64_t minTimeUs = -1;
+    size_t minIndex = 0;
 
-                buffer = source->lastAccessUnit();
-                source->setLastAccessUnit(NULL);
+    for (size_t i = 0; i < mSources.size(); ++i) {
+        const sp<SourceInfo> &source = mSources.editItemAt(i);
 
-                writeTS();
-                writeAccessUnit(minIndex, buffer);
+        if (source->eosReceived()) {
+            continue;
+        }
 
-                source->readMore();
-            }
+        int64_t timeUs = source->lastAccessUnitTimeUs();
+        if (timeUs < 0) {
+            minTimeUs = -1;
             break;
+        } else if (minTimeUs < 0 || timeUs < minTimeUs) {
+            minTimeUs = timeUs;
+            minIndex = i;
         }
+    }
 
-        default:
-            TRESPASS();
+    if (minTimeUs < 0) {
+        ALOGV("not a all tracks have valid data.");
+        return;
     }
+
+    ALOGV("writing access unit at time %.2f secs (index %zu)",
+         minTimeUs / 1E6, minIndex);
+
+    sp<SourceInfo> source = mSources.editItemAt(minIndex);
+
+    sp<ABuffer> buffer = source->lastAccessUnit();
+    source->setLastAccessUnit(NULL);
+
+    if (mMuxRate > 0 && !mPacingStarted) {
+        startPacing(minTimeUs);
+    }
+
+    writeTS();
+    writeAccessUnit(minIndex, buffer);
+
+    source->readMore();
 }
 
 void MPEG2TSWriter::writeProgramAssociationTable() {
@@ -712,19 +889,17 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
     // current_next_indicator = b1
     // section_number = 0x00
     // last_section_number = 0x00
-    //   one program follows:
-    //   program_number = 0x0001
+    //   one or more programs follow:
+    //   program_number = 0x????
     //   reserved = b111
-    //   program_map_PID = 0x01e0 (13 bits!)
+    //   program_map_PID = b? ???? ???? ???? (13 bits!)
     // CRC = 0x????????
 
     static const uint8_t kData[] = {
         0x47,
         0x40, 0x00, 0x10, 0x00,  // b0100 0000 0000 0000 0001 ???? 0000 0000
-        0x00, 0xb0, 0x0d, 0x00,  // b0000 0000 1011 0000 0000 1101 0000 0000
+        0x00, 0xb0, 0x00, 0x00,  // b0000 0000 1011 ???? ???? ???? 0000 0000
         0x00, 0xc3, 0x00, 0x00,  // b0000 0000 1100 0011 0000 0000 0000 0000
-        0x00, 0x01, 0xe1, 0xe0,  // b0000 0000 0000 0001 1110 0001 1110 0000
-        0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
     sp<ABuffer> buffer = new ABuffer(188);
@@ -736,18 +911,31 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
     }
     buffer->data()[3] |= mPATContinuityCounter;
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
-    memcpy(&buffer->data()[17], &crc, sizeof(crc));
+    size_t section_length = 4 * mPrograms.size() + 4 + 5;
+    buffer->data()[6] |= section_length >> 8;
+    buffer->data()[7] = section_length & 0xff;
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    uint8_t *ptr = &buffer->data()[sizeof(kData)];
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        const Program &program = mPrograms.itemAt(i);
+        *ptr++ = program.mProgramNumber >> 8;
+        *ptr++ = program.mProgramNumber & 0xff;
+        *ptr++ = 0xe0 | (program.mPMTPID >> 8);
+        *ptr++ = program.mPMTPID & 0xff;
+    }
+
+    uint32_t crc = htonl(crc32(&buffer->data()[5], 8 + mPrograms.size() * 4));
+    memcpy(ptr, &crc, sizeof(crc));
+
+    writePacket(buffer->data());
 }
 
-void MPEG2TSWriter::writeProgramMap() {
+void MPEG2TSWriter::writeProgramMap(size_t programIndex) {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
     // transport_priority = b0
-    // PID = b0 0001 1110 0000 (13 bits) [0x1e0]
+    // PID = b? ???? ???? ???? (13 bits) [0x1e0 + 0x20 * programIndex]
     // transport_scrambling_control = b00
     // adaptation_field_control = b01 (no adaptation field, payload only)
     // continuity_counter = b????
@@ -758,7 +946,7 @@ void MPEG2TSWriter::writeProgramMap() {
     // must_be_zero = b0
     // reserved = b11
     // section_length = 0x???
-    // program_number = 0x0001
+    // program_number = 0x????
     // reserved = b11
     // version_number = b00001
     // current_next_indicator = b1
@@ -778,44 +966,55 @@ void MPEG2TSWriter::writeProgramMap() {
 
     static const uint8_t kData[] = {
         0x47,
-        0x41, 0xe0, 0x10, 0x00,  // b0100 0001 1110 0000 0001 ???? 0000 0000
-        0x02, 0xb0, 0x00, 0x00,  // b0000 0010 1011 ???? ???? ???? 0000 0000
-        0x01, 0xc3, 0x00, 0x00,  // b0000 0001 1100 0011 0000 0000 0000 0000
+        0x40, 0x00, 0x10, 0x00,  // b010? ???? ???? ???? 0001 ???? 0000 0000
+        0x02, 0xb0, 0x00, 0x00,  // b0000 0010 1011 ???? ???? ???? ???? ????
+        0x00, 0xc3, 0x00, 0x00,  // b???? ???? 1100 0011 0000 0000 0000 0000
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
+    Program *program = &mPrograms.editItemAt(programIndex);
+    const size_t numSources = program->mSourceIndices.size();
+
     sp<ABuffer> buffer = new ABuffer(188);
     memset(buffer->data(), 0xff, buffer->size());
     memcpy(buffer->data(), kData, sizeof(kData));
 
-    if (++mPMTContinuityCounter == 16) {
-        mPMTContinuityCounter = 0;
+    buffer->data()[1] |= program->mPMTPID >> 8;
+    buffer->data()[2] = program->mPMTPID & 0xff;
+
+    if (++program->mPMTContinuityCounter == 16) {
+        program->mPMTContinuityCounter = 0;
     }
-    buffer->data()[3] |= mPMTContinuityCounter;
+    buffer->data()[3] |= program->mPMTContinuityCounter;
 
-    size_t section_length = 5 * mSources.size() + 4 + 9;
+    size_t section_length = 5 * numSources + 4 + 9;
     buffer->data()[6] |= section_length >> 8;
     buffer->data()[7] = section_length & 0xff;
 
-    static const unsigned kPCR_PID = 0x1e1;
-    buffer->data()[13] |= (kPCR_PID >> 8) & 0x1f;
-    buffer->data()[14] = kPCR_PID & 0xff;
+    buffer->data()[8] = program->mProgramNumber >> 8;
+    buffer->data()[9] = program->mProgramNumber & 0xff;
+
+    buffer->data()[13] |= (program->mPCRPID >> 8) & 0x1f;
+    buffer->data()[14] = program->mPCRPID & 0xff;
 
     uint8_t *ptr = &buffer->data()[sizeof(kData)];
-    for (size_t i = 0; i < mSources.size(); ++i) {
-        *ptr++ = mSources.editItemAt(i)->streamType();
+    for (size_t i = 0; i < numSources; ++i) {
+        const sp<SourceInfo> &source =
+            mSources.itemAt(program->mSourceIndices.itemAt(i));
 
-        const unsigned ES_PID = 0x1e0 + i + 1;
+        *ptr++ = source->streamType();
+
+        const unsigned ES_PID = source->PID();
         *ptr++ = 0xe0 | (ES_PID >> 8);
         *ptr++ = ES_PID & 0xff;
         *ptr++ = 0xf0;
         *ptr++ = 0x00;
     }
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
-    memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
+    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+numSources*5));
+    memcpy(&buffer->data()[17+numSources*5], &crc, sizeof(crc));
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    writePacket(buffer->data());
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -824,7 +1023,7 @@ void MPEG2TSWriter::writeAccessUnit(
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
     // transport_priority = b0
-    // PID = b0 0001 1110 ???? (13 bits) [0x1e0 + 1 + sourceIndex]
+    // PID = b? ???? ???? ???? (13 bits) [see addSource()]
     // transport_scrambling_control = b00
     // adaptation_field_control = b??
     // continuity_counter = b????
@@ -858,15 +1057,12 @@ void MPEG2TSWriter::writeAccessUnit(
     sp<ABuffer> buffer = new ABuffer(188);
     memset(buffer->data(), 0xff, buffer->size());
 
-    const unsigned PID = 0x1e0 + sourceIndex + 1;
+    const unsigned PID = mSources.editItemAt(sourceIndex)->PID();
 
     const unsigned continuity_counter =
         mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-    // XXX if there are multiple streams of a kind (more than 1 audio or
-    // more than 1 video) they need distinct stream_ids.
-    const unsigned stream_id =
-        mSources.editItemAt(sourceIndex)->streamType() == 0x0f ? 0xc0 : 0xe0;
+    const unsigned stream_id = mSources.editItemAt(sourceIndex)->streamID();
 
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
@@ -878,7 +1074,7 @@ void MPEG2TSWriter::writeAccessUnit(
 
     if (PES_packet_length >= 65536) {
         // This really should only happen for video.
-        CHECK_EQ(stream_id, 0xe0u);
+        CHECK_EQ(stream_id & 0xf0, 0xe0u);
 
         // It's valid to set this to 0 for video according to the specs.
         PES_packet_length = 0;
@@ -920,7 +1116,7 @@ void MPEG2TSWriter::writeAccessUnit(
 
     memcpy(ptr, accessUnit->data(), copy);
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    queueESPacket(buffer->data());
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -930,7 +1126,7 @@ void MPEG2TSWriter::writeAccessUnit(
         // transport_error_indicator = b0
         // payload_unit_start_indicator = b0
         // transport_priority = b0
-        // PID = b0 0001 1110 ???? (13 bits) [0x1e0 + 1 + sourceIndex]
+        // PID = b? ???? ???? ???? (13 bits) [see addSource()]
         // transport_scrambling_control = b00
         // adaptation_field_control = b??
         // continuity_counter = b????
@@ -965,19 +1161,259 @@ void MPEG2TSWriter::writeAccessUnit(
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
+        queueESPacket(buffer->data());
 
         offset += copy;
     }
 }
 
 void MPEG2TSWriter::writeTS() {
-    if (mNumTSPacketsWritten >= mNumTSPacketsBeforeMeta) {
+    if (mMuxRate > 0) {
+        // paced output repeats the tables on its own schedule
+        return;
+    }
+
+    // Files carry the tables once, in front of the first access unit.
+    if (!mWroteTables) {
         writeProgramAssociationTable();
-        writeProgramMap();
+        for (size_t i = 0; i < mPrograms.size(); ++i) {
+            writeProgramMap(i);
+        }
+
+        mWroteTables = true;
+    }
+}
+
+void MPEG2TSWriter::writePCR(size_t programIndex, int64_t PCR) {
+    // 0x47
+    // transport_error_indicator = b0
+    // payload_unit_start_indicator = b0
+    // transport_priority = b0
+    // PID = b? ???? ???? ???? (13 bits) [the program's PCR_PID]
+    // transport_scrambling_control = b00
+    // adaptation_field_control = b10 (adaptation field only, no payload)
+    // continuity_counter = b???? (unchanged without payload)
+    // adaptation_field_length = 0xb7 (183)
+    // discontinuity_indicator = b0
+    // random_access_indicator = b0
+    // elementary_stream_priority_indicator = b0
+    // PCR_flag = b1
+    // OPCR_flag = b0
+    // splicing_point_flag = b0
+    // transport_private_data_flag = b0
+    // adaptation_field_extension_flag = b0
+    // program_clock_reference_base = b????????????????????????????????? (33 bits)
+    // reserved = b111111
+    // program_clock_reference_extension = b????????? (9 bits)
+    // stuffing bytes = 0xff...
+
+    const Program &program = mPrograms.itemAt(programIndex);
+
+    // the PCR is a 33 bit 90 kHz base and a 27 MHz extension
+    static const int64_t kPCRWrap = (1ll << 33) * 300;
+    PCR %= kPCRWrap;
+    if (PCR < 0) {
+        PCR += kPCRWrap;
+    }
+    uint64_t PCR_base = PCR / 300;
+    uint32_t PCR_ext = PCR % 300;
+
+    uint8_t packet[kTSPacketSize];
+    memset(packet, 0xff, sizeof(packet));
+
+    uint8_t *ptr = packet;
+    *ptr++ = 0x47;
+    *ptr++ = program.mPCRPID >> 8;
+    *ptr++ = program.mPCRPID & 0xff;
+    *ptr++ = 0x20 | program.mPCRContinuityCounter;
+    *ptr++ = 0xb7;
+    *ptr++ = 0x10;
+    *ptr++ = (PCR_base >> 25) & 0xff;
+    *ptr++ = (PCR_base >> 17) & 0xff;
+    *ptr++ = (PCR_base >> 9) & 0xff;
+    *ptr++ = (PCR_base >> 1) & 0xff;
+    *ptr++ = ((PCR_base & 1) << 7) | 0x7e | ((PCR_ext >> 8) & 1);
+    *ptr++ = (PCR_ext & 0xff);
+
+    writePacket(packet);
+}
+
+void MPEG2TSWriter::writeNullPacket() {
+    // PID = 0x1fff, adaptation_field_control = b01, payload is ignored
+    uint8_t packet[kTSPacketSize];
+    memset(packet, 0xff, sizeof(packet));
+    packet[0] = 0x47;
+    packet[1] = 0x1f;
+    packet[2] = 0xff;
+    packet[3] = 0x10;
+
+    writePacket(packet);
+}
+
+void MPEG2TSWriter::queueESPacket(const uint8_t *packet) {
+    if (mMuxRate == 0) {
+        writePacket(packet);
+        return;
+    }
+
+    sp<ABuffer> chunk;
+    if (!mPendingPackets.empty()) {
+        chunk = *--mPendingPackets.end();
+    }
+
+    if (chunk == NULL
+            || chunk->offset() + chunk->size() + kTSPacketSize > chunk->capacity()) {
+        chunk = new ABuffer(kPacketsPerChunk * kTSPacketSize);
+        chunk->setRange(0, 0);
+        mPendingPackets.push_back(chunk);
+    }
+
+    memcpy(chunk->data() + chunk->size(), packet, kTSPacketSize);
+    chunk->setRange(chunk->offset(), chunk->size() + kTSPacketSize);
+
+    if (++mNumPendingPackets * kTSPacketSize * 8 > (size_t)mMuxRate
+            && !mWarnedOverflow) {
+        ALOGW("more than a second of data waits to be sent, "
+              "the mux rate of %d bps is too low", mMuxRate);
+        mWarnedOverflow = true;
+    }
+}
+
+void MPEG2TSWriter::writePendingPacket() {
+    CHECK_GT(mNumPendingPackets, 0u);
+
+    sp<ABuffer> chunk = *mPendingPackets.begin();
+    const uint8_t *packet = chunk->data();
+
+    // PCR packets repeat the continuity counter of the last packet sent on
+    // their PID, which can be well behind the one being packetized.
+    unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        if (mPrograms.itemAt(i).mPCRPID == PID) {
+            mPrograms.editItemAt(i).mPCRContinuityCounter = packet[3] & 0x0f;
+        }
+    }
+
+    writePacket(packet);
 
-        mNumTSPacketsBeforeMeta = mNumTSPacketsWritten + 2500;
+    chunk->setRange(chunk->offset() + kTSPacketSize, chunk->size() - kTSPacketSize);
+    if (chunk->size() == 0) {
+        mPendingPackets.erase(mPendingPackets.begin());
+    }
+    --mNumPendingPackets;
+}
+
+void MPEG2TSWriter::writePacket(const uint8_t *packet) {
+    memcpy(&mOutputBuffer[mOutputPackets * kTSPacketSize], packet, kTSPacketSize);
+
+    if (++mOutputPackets == kPacketsPerWrite) {
+        flushOutput();
+    }
+}
+
+void MPEG2TSWriter::flushOutput() {
+    if (mOutputPackets == 0) {
+        return;
+    }
+
+    size_t size = mOutputPackets * kTSPacketSize;
+    CHECK_EQ(internalWrite(mOutputBuffer, size), (ssize_t)size);
+    mOutputPackets = 0;
+}
+
+// 27 MHz clock ticks from the first paced packet to the start of
+// |packetIndex|, split up to stay clear of overflows at high rates.
+int64_t MPEG2TSWriter::getSlotTicks(int64_t packetIndex) const {
+    static const int64_t kTicksPerPacketTimesRate = kTSPacketSize * 8 * 27000000ll;
+
+    return (packetIndex / mMuxRate) * kTicksPerPacketTimesRate
+        + (packetIndex % mMuxRate) * kTicksPerPacketTimesRate / mMuxRate;
+}
+
+void MPEG2TSWriter::startPacing(int64_t firstTimeUs) {
+    CHECK(!mPacingStarted);
+
+    mPacingStarted = true;
+    mStartTimeUs = ALooper::GetNowUs();
+    mStartSTCUs = firstTimeUs - kPacedDelayUs;
+    mNumPacedPackets = 0;
+    mNextPSITimeUs = mStartSTCUs;
+    mNumPSIPacketsDue = 0;
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i).mNextPCRTimeUs = mStartSTCUs;
+    }
+
+    ALOGI("pacing output at %d bps", mMuxRate);
+
+    // nothing is due yet, this schedules the first group of packets
+    sp<AMessage> msg = new AMessage(kWhatDrain, mReflector);
+    msg->setInt32("generation", mDrainGeneration);
+    msg->post();
+}
+
+// Sends every group of packets whose time has come, then schedules itself
+// for the next group.
+void MPEG2TSWriter::drainPacedOutput() {
+    int64_t elapsedUs = ALooper::GetNowUs() - mStartTimeUs;
+    int64_t numPacketsDue =
+        (elapsedUs / 1000000ll) * mMuxRate / (kTSPacketSize * 8)
+        + (elapsedUs % 1000000ll) * mMuxRate / (kTSPacketSize * 8 * 1000000ll);
+
+    while (mNumPacedPackets + kPacketsPerWrite <= numPacketsDue) {
+        for (size_t i = 0; i < kPacketsPerWrite; ++i) {
+            writeNextPacedPacket();
+        }
+    }
+
+    if (mNumSourcesDone == mSources.size() && mNumPendingPackets == 0) {
+        flushOutput();
+        mOutputDrained = true;
+        return;
+    }
+
+    int64_t nextTimeUs = mStartTimeUs
+        + getSlotTicks(mNumPacedPackets + kPacketsPerWrite) / 27;
+
+    sp<AMessage> msg = new AMessage(kWhatDrain, mReflector);
+    msg->setInt32("generation", mDrainGeneration);
+    msg->post(nextTimeUs - (mStartTimeUs + elapsedUs));
+}
+
+// Fills the next slot of the constant rate output: the PSI tables when
+// they are due, then the PCRs, then waiting access unit data, or stuffing.
+void MPEG2TSWriter::writeNextPacedPacket() {
+    int64_t ticks = mStartSTCUs * 27 + getSlotTicks(mNumPacedPackets++);
+    int64_t STCUs = ticks / 27;
+
+    if (mNumPSIPacketsDue == 0 && STCUs >= mNextPSITimeUs) {
+        mNumPSIPacketsDue = 1 + mPrograms.size();
+        mNextPSITimeUs = STCUs + kPSIIntervalUs;
+    }
+
+    if (mNumPSIPacketsDue > 0) {
+        size_t index = mPrograms.size() + 1 - mNumPSIPacketsDue--;
+        if (index == 0) {
+            writeProgramAssociationTable();
+        } else {
+            writeProgramMap(index - 1);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        Program *program = &mPrograms.editItemAt(i);
+        if (STCUs >= program->mNextPCRTimeUs) {
+            program->mNextPCRTimeUs = STCUs + kPCRIntervalUs;
+            writePCR(i, ticks);
+            return;
+        }
+    }
+
+    if (mNumPendingPackets > 0) {
+        writePendingPacket();
+    } else {
+        writeNullPacket();
     }
 }
 
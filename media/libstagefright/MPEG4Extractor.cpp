@@ -565,6 +565,41 @@ char* MPEG4Extractor::getDrmTrackInfo(size_t trackID, int *len) {
     return sinf->IPMPData;
 }
 
+status_t MPEG4Extractor::getTrackFragmentDefaults(
+        size_t index, uint32_t *trackID, uint32_t *timescale, Trex *trex) {
+    status_t err;
+    if ((err = readMetaData()) != OK) {
+        return err;
+    }
+
+    Track *track = mFirstTrack;
+    while (index > 0 && track != NULL) {
+        track = track->next;
+        --index;
+    }
+
+    int32_t id;
+    if (track == NULL || !track->meta->findInt32(kKeyTrackID, &id)
+            || track->timescale == 0) {
+        return ERROR_MALFORMED;
+    }
+
+    *trackID = id;
+    *timescale = track->timescale;
+
+    memset(trex, 0, sizeof(*trex));
+    trex->track_ID = id;
+    trex->default_sample_description_index = 1;
+    for (size_t i = 0; i < mTrex.size(); ++i) {
+        if (mTrex.itemAt(i).track_ID == (uint32_t)id) {
+            *trex = mTrex.itemAt(i);
+            break;
+        }
+    }
+
+    return OK;
+}
+
 // Reads an encoded integer 7 bits at a time until it encounters the high bit clear.
 static int32_t readSize(off64_t offset,
         const sp<DataSource> DataSource, uint8_t *numOfBytes) {
@@ -18,9 +18,11 @@
 #define LOG_TAG "MPEG4Writer"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -40,6 +42,7 @@
 #include <media/mediarecorder.h>
 #include <cutils/properties.h>
 
+#include "include/BufferedFileWriter.h"
 #include "include/ESDS.h"
 
 
@@ -62,6 +65,10 @@ static const int64_t kMax32BitFileSize = 0x00ffffffffLL; // 2^32-1 : max FAT32
 static const uint8_t kNalUnitTypeSeqParamSet = 0x07;
 static const uint8_t kNalUnitTypePicParamSet = 0x08;
 static const int64_t kInitialDelayTimeUs     = 700000LL;
+static const size_t kDefaultNumIOBuffers     = 4;
+static const int64_t kMaxBufferSizeKB        = 16 * 1024;
+static const int64_t kMaxPreallocationSizeMB = 4 * 1024;
+static const int64_t kMaxNumIOBuffers        = 64;
 
 static const char kMetaKey_Version[]    = "com.android.version";
 #ifdef SHOW_MODEL_BUILD
@@ -70,9 +77,35 @@ static const char kMetaKey_Build[]      = "com.android.build";
 #endif
 static const char kMetaKey_CaptureFps[] = "com.android.capture.fps";
 
+// Returns the value of the numeric system property |key|, clamped to
+// |maxValue|, or |defaultValue| if the property isn't set or isn't a
+// positive number.
+static int64_t getPositiveProperty(const char *key, int64_t defaultValue, int64_t maxValue) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(key, value, NULL) <= 0) {
+        return defaultValue;
+    }
+    char *end;
+    errno = 0;
+    long long x = strtoll(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || x <= 0) {
+        ALOGW("ignoring %s=%s", key, value);
+        return defaultValue;
+    }
+    if (x > maxValue) {
+        ALOGW("%s=%s is too large, using %" PRId64, key, value, maxValue);
+        return maxValue;
+    }
+    return x;
+}
+
 /* uncomment to include model and build in meta */
 //#define SHOW_MODEL_BUILD 1
 
+// Between network and host byte order, for the sample table values
+static inline uint32_t swapBytes(uint32_t x) { return ntohl(x); }
+static inline off64_t swapBytes(off64_t x) { return hton64(x); }
+
 class MPEG4Writer::Track {
 public:
     Track(MPEG4Writer *owner, const sp<MediaSource> &source, size_t trackId);
@@ -85,17 +118,29 @@ public:
     bool reachedEOS();
 
     int64_t getDurationUs() const;
+    int64_t getPresentationDurationUs() const;
     int64_t getEstimatedTrackSizeBytes() const;
+    void addEditListEntry(int64_t mediaTimeUs, int64_t durationUs);
+    bool hasEditList() const { return !mEditList.isEmpty(); }
     void writeTrackHeader(bool use32BitOffset = true);
     void bufferChunk(int64_t timestampUs);
     bool isAvc() const { return mIsAvc; }
     bool isAudio() const { return mIsAudio; }
     bool isMPEG4() const { return mIsMPEG4; }
     void addChunkOffset(off64_t offset);
+    void shiftChunkOffsets(off64_t shift);
     int32_t getTrackId() const { return mTrackId; }
+    int64_t getStartTimestampUs() const { return mStartTimestampUs; }
     status_t dump(int fd, const Vector<String16>& args) const;
     static const char *getFourCCForMime(const char *mime);
 
+    // Simple validation on the codec specific data
+    status_t checkCodecSpecificData() const;
+
+    // Boxes of a fragmented file
+    void writeTrexBox();
+    void writeTrafBox(TrackFragment *fragment);
+
 private:
     enum {
         kMaxCttsOffsetTimeUs = 1000000LL,  // 1 second
@@ -210,6 +255,22 @@ private:
             }
         }
 
+        // Add |delta| to every value, e.g. to chunk offsets after the
+        // media data moved. Values stay in network byte order.
+        void addToAll(TYPE delta) {
+            uint32_t nValues = mTotalNumTableEntries * mEntryCapacity + mNumValuesInCurrEntry;
+            uint32_t valuesPerElement = mElementCapacity * mEntryCapacity;
+            for (typename List<TYPE *>::iterator it = mTableEntryList.begin();
+                it != mTableEntryList.end(); ++it) {
+                uint32_t n = nValues < valuesPerElement ? nValues : valuesPerElement;
+                TYPE *values = *it;
+                for (uint32_t i = 0; i < n; ++i) {
+                    values[i] = swapBytes(swapBytes(values[i]) + delta);
+                }
+                nValues -= n;
+            }
+        }
+
         // Return the number of entries in the table.
         uint32_t count() const { return mTotalNumTableEntries; }
 
@@ -262,6 +323,13 @@ private:
     int64_t mMinCttsOffsetTimeUs;
     int64_t mMaxCttsOffsetTimeUs;
 
+    uint32_t mNumSamples;
+    uint32_t mNumSyncSamples;
+
+    // In a fragmented recording, the sample waiting for its successor
+    // to tell its duration
+    FragmentSample mPendingFragmentSample;
+
     // Sequence parameter set or picture parameter set
     struct AVCParamSet {
         AVCParamSet(uint16_t length, const uint8_t *data)
@@ -315,10 +383,14 @@ private:
     // value, the user-supplied time scale will be used.
     void setTimeScale();
 
-    // Simple validation on the codec specific data
-    status_t checkCodecSpecificData() const;
     int32_t mRotation;
 
+    struct EditListEntry {
+        int64_t mMediaTimeUs;  // -1 for an empty edit
+        int64_t mDurationUs;
+    };
+    Vector<EditListEntry> mEditList;
+
     void updateTrackSizeEstimate();
     void addOneStscTableEntry(size_t chunkId, size_t sampleId);
     void addOneStssTableEntry(size_t sampleId);
@@ -349,6 +421,7 @@ private:
     void writeVmhdBox();
     void writeHdlrBox();
     void writeTkhdBox(uint32_t now);
+    void writeEdtsBox();
     void writeMp4aEsdsBox();
     void writeMp4vEsdsBox();
     void writeAudioFourCCBox();
@@ -361,6 +434,7 @@ private:
 
 MPEG4Writer::MPEG4Writer(int fd)
     : mFd(dup(fd)),
+      mOutput(NULL),
       mInitCheck(mFd < 0? NO_INIT: OK),
       mIsRealTimeRecording(true),
       mUse4ByteNalLength(true),
@@ -371,11 +445,10 @@ MPEG4Writer::MPEG4Writer(int fd)
       mWriterThreadStarted(false),
       mOffset(0),
       mMdatOffset(0),
-      mMoovBoxBuffer(NULL),
-      mMoovBoxBufferOffset(0),
-      mWriteMoovBoxToMemory(false),
+      mMeasuringMoovBox(false),
       mFreeBoxOffset(0),
       mStreamableFile(false),
+      mFastStart(false),
       mEstimatedMoovBoxSize(0),
       mMoovExtraSize(0),
       mInterleaveDurationUs(1000000),
@@ -385,6 +458,11 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
       mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentStartUs(0),
+      mFragmentSequenceNumber(0),
+      mWroteFragmentedMoov(false),
+      mMehdOffset(0),
       mMetaKeys(new AMessage()) {
     addDeviceMeta();
 
@@ -393,6 +471,26 @@ MPEG4Writer::MPEG4Writer(int fd)
     if (off < 0) {
         ALOGE("cannot seek mFd: %s (%d)", strerror(errno), errno);
         release();
+        return;
+    }
+
+    // Box headers and NAL length prefixes are tiny, gather them with the
+    // samples instead of issuing a write() for each of them.
+    size_t bufferSize = getPositiveProperty("media.mp4writer.buffer-kb",
+            BufferedFileWriter::kDefaultBufferSize / 1024, kMaxBufferSizeKB) * 1024;
+    mOutput = new BufferedFileWriter(mFd, 0 /* offset */, bufferSize);
+    int64_t preallocationSizeMB = getPositiveProperty("media.mp4writer.prealloc-mb",
+            0 /* defaultValue */, kMaxPreallocationSizeMB);
+    if (preallocationSizeMB > 0) {
+        mOutput->setPreallocationSize((off64_t)preallocationSizeMB * 1024 * 1024);
+    }
+
+    // The disk I/O happens on a separate thread, so that a slow card only
+    // holds up the track threads once this many buffers are in flight.
+    size_t numIOBuffers = getPositiveProperty("media.mp4writer.io-buffers",
+            kDefaultNumIOBuffers, kMaxNumIOBuffers);
+    if (numIOBuffers > 1 && mOutput->startIOThread(numIOBuffers) != OK) {
+        ALOGW("writing synchronously");
     }
 }
 
@@ -677,6 +775,14 @@ status_t MPEG4Writer::start(MetaData *param) {
         mIsRealTimeRecording = isRealTimeRecording;
     }
 
+    int64_t fragmentDurationUs;
+    if (!mStarted && param &&
+        param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs) &&
+        fragmentDurationUs > 0) {
+        mFragmentDurationUs = fragmentDurationUs;
+        ALOGI("fragmented recording, %" PRId64 " us per fragment", mFragmentDurationUs);
+    }
+
     mStartTimestampUs = -1;
 
     if (mStarted) {
@@ -705,44 +811,27 @@ status_t MPEG4Writer::start(MetaData *param) {
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     /*
-     * mWriteMoovBoxToMemory is true if the amount of data in moov box is
-     * smaller than the reserved free space at the beginning of a file, AND
-     * when the content of moov box is constructed. Note that video/audio
-     * frame data is always written to the file but not in the memory.
-     *
-     * Before stop()/reset() is called, mWriteMoovBoxToMemory is always
-     * false. When reset() is called at the end of a recording session,
-     * Moov box needs to be constructed.
-     *
-     * 1) Right before a moov box is constructed, mWriteMoovBoxToMemory
-     * to set to mStreamableFile so that if
-     * the file is intended to be streamable, it is set to true;
-     * otherwise, it is set to false. When the value is set to false,
-     * all the content of the moov box is written immediately to
-     * the end of the file. When the value is set to true, all the
-     * content of the moov box is written to an in-memory cache,
-     * mMoovBoxBuffer, util the following condition happens. Note
-     * that the size of the in-memory cache is the same as the
-     * reserved free space at the beginning of the file.
-     *
-     * 2) While the data of the moov box is written to an in-memory
-     * cache, the data size is checked against the reserved space.
-     * If the data size surpasses the reserved space, subsequent moov
-     * data could no longer be hold in the in-memory cache. This also
-     * indicates that the reserved space was too small. At this point,
-     * _all_ moov data must be written to the end of the file.
-     * mWriteMoovBoxToMemory must be set to false to direct the write
-     * to the file.
-     *
-     * 3) If the data size in moov box is smaller than the reserved
-     * space after moov box is completely constructed, the in-memory
-     * cache copy of the moov box is written to the reserved free
-     * space. Thus, immediately after the moov is completedly
-     * constructed, mWriteMoovBoxToMemory is always set to false.
+     * A fragmented file has no sample tables to reserve space for: the
+     * moov box is written right after the ftyp box once the codec specific
+     * data of all tracks is known, and is followed by a moof and an mdat
+     * box every mFragmentDurationUs. The file is playable up to the last
+     * complete fragment at any time.
      */
-    mWriteMoovBoxToMemory = false;
-    mMoovBoxBuffer = NULL;
-    mMoovBoxBufferOffset = 0;
+    if (isFragmented()) {
+        mStreamableFile = false;
+    }
+
+    /*
+     * The moov box is written when the recording stops. Its size is
+     * computed first so that it can go straight to its final place: into
+     * the free box reserved ahead of the media data if it fits there,
+     * otherwise after the media data, or with mFastStart in front of the
+     * media data after moving that up to make room for it.
+     */
+    int32_t fastStart;
+    mFastStart = !isFragmented() && param &&
+        param->findInt32(kKeyFastStart, &fastStart) && fastStart;
+    mMeasuringMoovBox = false;
 
     writeFtypBox(param);
 
@@ -756,9 +845,14 @@ status_t MPEG4Writer::start(MetaData *param) {
         mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
     }
     CHECK_GE(mEstimatedMoovBoxSize, 8);
-    if (mStreamableFile) {
+    if (isFragmented()) {
+        mMdatOffset = mOffset;
+        mFragmentStartUs = 0;
+        mFragmentSequenceNumber = 0;
+        mWroteFragmentedMoov = false;
+    } else if (mStreamableFile) {
         // Reserve a 'free' box only for streamable file
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+        mOutput->seek(mFreeBoxOffset);
         writeInt32(mEstimatedMoovBoxSize);
         write("free", 4);
         mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
@@ -767,8 +861,10 @@ status_t MPEG4Writer::start(MetaData *param) {
     }
 
     mOffset = mMdatOffset;
-    lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+    mOutput->seek(mMdatOffset);
+    if (isFragmented()) {
+        // every fragment has its own mdat box
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
@@ -880,12 +976,27 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
 }
 
 void MPEG4Writer::release() {
+    if (mOutput != NULL) {
+        mOutput->flush();
+
+        BufferedFileWriter::IOStats stats;
+        mOutput->getIOStats(&stats);
+        if (stats.mNumStalls > 0) {
+            ALOGW("waited %zu times (%" PRId64 " us) for the storage,"
+                    " slowest write took %" PRId64 " us",
+                    stats.mNumStalls, stats.mStallTimeUs, stats.mMaxWriteTimeUs);
+        } else {
+            ALOGV("at most %zu buffers queued, slowest write took %" PRId64 " us",
+                    stats.mMaxQueuedBuffers, stats.mMaxWriteTimeUs);
+        }
+
+        delete mOutput;
+        mOutput = NULL;
+    }
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
     mStarted = false;
-    free(mMoovBoxBuffer);
-    mMoovBoxBuffer = NULL;
 }
 
 status_t MPEG4Writer::reset() {
@@ -912,7 +1023,7 @@ status_t MPEG4Writer::reset() {
             err = status;
         }
 
-        int64_t durationUs = (*it)->getDurationUs();
+        int64_t durationUs = (*it)->getPresentationDurationUs();
         if (durationUs > maxDurationUs) {
             maxDurationUs = durationUs;
         }
@@ -934,62 +1045,67 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    if (isFragmented()) {
+        // The moov box and the fragments are all out, only the total
+        // duration was not known yet.
+        if (mWroteFragmentedMoov) {
+            uint64_t duration = (maxDurationUs * mTimeScale + 5E5) / 1E6;
+            duration = hton64(duration);
+            mOutput->writeAt(mMehdOffset, &duration, 8);
+        }
+
+        err = mOutput->flush();
+        if (err != OK) {
+            ALOGE("failed to write the file: %d", err);
+        }
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
-        lseek64(mFd, mMdatOffset, SEEK_SET);
         uint32_t size = htonl(static_cast<uint32_t>(mOffset - mMdatOffset));
-        ::write(mFd, &size, 4);
+        mOutput->writeAt(mMdatOffset, &size, 4);
     } else {
-        lseek64(mFd, mMdatOffset + 8, SEEK_SET);
         uint64_t size = mOffset - mMdatOffset;
         size = hton64(size);
-        ::write(mFd, &size, 8);
+        mOutput->writeAt(mMdatOffset + 8, &size, 8);
     }
-    lseek64(mFd, mOffset, SEEK_SET);
 
     // Construct moov box now
-    mMoovBoxBufferOffset = 0;
-    mWriteMoovBoxToMemory = mStreamableFile;
-    if (mWriteMoovBoxToMemory) {
-        // There is no need to allocate in-memory cache
-        // for moov box if the file is not streamable.
-
-        mMoovBoxBuffer = (uint8_t *) malloc(mEstimatedMoovBoxSize);
-        CHECK(mMoovBoxBuffer != NULL);
+    off64_t moovBoxSize = getMoovBoxSize(maxDurationUs);
+    off64_t reservedSize = mMdatOffset - mFreeBoxOffset;
+    if (mFastStart && moovBoxSize + 8 > reservedSize) {
+        err = makeRoomForMoovBox(moovBoxSize);
+        if (err == OK) {
+            reservedSize = mMdatOffset - mFreeBoxOffset;
+        } else {
+            ALOGW("could not move the media data (%d)", err);
+            err = OK;
+        }
     }
-    writeMoovBox(maxDurationUs);
-
-    // mWriteMoovBoxToMemory could be set to false in
-    // MPEG4Writer::write() method
-    if (mWriteMoovBoxToMemory) {
-        mWriteMoovBoxToMemory = false;
-        // Content of the moov box is saved in the cache, and the in-memory
-        // moov box needs to be written to the file in a single shot.
-
-        CHECK_LE(mMoovBoxBufferOffset + 8, mEstimatedMoovBoxSize);
 
-        // Moov box
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+    if (moovBoxSize + 8 <= reservedSize) {
+        // In place of the reserved free box, followed by what is left of it
+        mOutput->seek(mFreeBoxOffset);
         mOffset = mFreeBoxOffset;
-        write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
+        writeMoovBox(maxDurationUs);
 
-        // Free box
-        lseek64(mFd, mOffset, SEEK_SET);
-        writeInt32(mEstimatedMoovBoxSize - mMoovBoxBufferOffset);
+        writeInt32(reservedSize - moovBoxSize);
         write("free", 4);
     } else {
         ALOGI("The mp4 file will not be streamable.");
-    }
-
-    // Free in-memory cache for moov box
-    if (mMoovBoxBuffer != NULL) {
-        free(mMoovBoxBuffer);
-        mMoovBoxBuffer = NULL;
-        mMoovBoxBufferOffset = 0;
+        writeMoovBox(maxDurationUs);
     }
 
     CHECK(mBoxes.empty());
 
+    err = mOutput->flush();
+    if (err != OK) {
+        ALOGE("failed to write the file: %d", err);
+    }
+    ALOGV("file written with %zu system calls", mOutput->numSyscalls());
+
     release();
     return err;
 }
@@ -1040,14 +1156,76 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+off64_t MPEG4Writer::getMoovBoxSize(int64_t durationUs) {
+    off64_t offset = mOffset;
+    mOffset = 0;
+    mMeasuringMoovBox = true;
+    writeMoovBox(durationUs);
+    mMeasuringMoovBox = false;
+
+    off64_t size = mOffset;
+    mOffset = offset;
+    return size;
+}
+
+// Moves the media data up, so that the moov box and a free box header fit
+// in front of it.
+status_t MPEG4Writer::makeRoomForMoovBox(off64_t moovBoxSize) {
+    off64_t shift = moovBoxSize + 8 - (mMdatOffset - mFreeBoxOffset);
+    if (mUse32BitOffset && mOffset + shift > kMax32BitFileSize) {
+        return -EFBIG;
+    }
+
+    int64_t startUs = systemTime() / 1000;
+    status_t err = mOutput->moveData(mMdatOffset, mMdatOffset + shift, mOffset - mMdatOffset);
+    if (err != OK) {
+        return err;
+    }
+
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        (*it)->shiftChunkOffsets(shift);
+    }
+    ALOGI("moved %" PRId64 " bytes of media data by %" PRId64 " bytes in %" PRId64 " us",
+            (int64_t)(mOffset - mMdatOffset), shift, systemTime() / 1000 - startUs);
+
+    mMdatOffset += shift;
+    mOffset += shift;
+
+    return OK;
+}
+
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    beginBox("mehd");
+    writeInt32(0x01000000);    // version=1, flags=0
+    mMehdOffset = mOffset;
+    writeInt64(0);             // fragment duration, filled in by reset()
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        (*it)->writeTrexBox();
+    }
+    endBox();  // mvex
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
     int32_t fileType;
-    if (param && param->findInt32(kKeyFileType, &fileType) &&
+    if (isFragmented()) {
+        writeFourcc("iso6");
+        writeInt32(0);
+        writeFourcc("isom");
+        writeFourcc("iso6");
+        writeFourcc("mp41");
+    } else if (param && param->findInt32(kKeyFileType, &fileType) &&
         fileType != OUTPUT_FORMAT_MPEG_4) {
         writeFourcc("3gp4");
         writeInt32(0);
@@ -1109,9 +1287,9 @@ void MPEG4Writer::unlock() {
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
-          (const uint8_t *)buffer->data() + buffer->range_offset(),
-          buffer->range_length());
+    mOutput->write(
+            (const uint8_t *)buffer->data() + buffer->range_offset(),
+            buffer->range_length());
 
     mOffset += buffer->range_length();
 
@@ -1137,32 +1315,29 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
 
     size_t length = buffer->range_length();
 
+    uint8_t header[4];
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[1].iov_base = (uint8_t *)buffer->data() + buffer->range_offset();
+    iov[1].iov_len = length;
+
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
-        mOffset += length + 4;
+        header[0] = length >> 24;
+        header[1] = (length >> 16) & 0xff;
+        header[2] = (length >> 8) & 0xff;
+        header[3] = length & 0xff;
+        iov[0].iov_len = 4;
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
-        mOffset += length + 2;
+        header[0] = length >> 8;
+        header[1] = length & 0xff;
+        iov[0].iov_len = 2;
     }
 
+    mOutput->writev(iov, 2);
+    mOffset += iov[0].iov_len + length;
+
     return old_offset;
 }
 
@@ -1170,43 +1345,15 @@ size_t MPEG4Writer::write(
         const void *ptr, size_t size, size_t nmemb) {
 
     const size_t bytes = size * nmemb;
-    if (mWriteMoovBoxToMemory) {
-
-        off64_t moovBoxSize = 8 + mMoovBoxBufferOffset + bytes;
-        if (moovBoxSize > mEstimatedMoovBoxSize) {
-            // The reserved moov box at the beginning of the file
-            // is not big enough. Moov box should be written to
-            // the end of the file from now on, but not to the
-            // in-memory cache.
-
-            // We write partial moov box that is in the memory to
-            // the file first.
-            for (List<off64_t>::iterator it = mBoxes.begin();
-                 it != mBoxes.end(); ++it) {
-                (*it) += mOffset;
-            }
-            lseek64(mFd, mOffset, SEEK_SET);
-            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
-            ::write(mFd, ptr, bytes);
-            mOffset += (bytes + mMoovBoxBufferOffset);
-
-            // All subsequent moov box content will be written
-            // to the end of the file.
-            mWriteMoovBoxToMemory = false;
-        } else {
-            memcpy(mMoovBoxBuffer + mMoovBoxBufferOffset, ptr, bytes);
-            mMoovBoxBufferOffset += bytes;
-        }
-    } else {
-        ::write(mFd, ptr, size * nmemb);
-        mOffset += bytes;
+    if (!mMeasuringMoovBox) {
+        mOutput->write(ptr, bytes);
     }
+    mOffset += bytes;
     return bytes;
 }
 
 void MPEG4Writer::beginBox(uint32_t id) {
-    mBoxes.push_back(mWriteMoovBoxToMemory?
-            mMoovBoxBufferOffset: mOffset);
+    mBoxes.push_back(mOffset);
 
     writeInt32(0);
     writeInt32(id);
@@ -1215,8 +1362,7 @@ void MPEG4Writer::beginBox(uint32_t id) {
 void MPEG4Writer::beginBox(const char *fourcc) {
     CHECK_EQ(strlen(fourcc), 4);
 
-    mBoxes.push_back(mWriteMoovBoxToMemory?
-            mMoovBoxBufferOffset: mOffset);
+    mBoxes.push_back(mOffset);
 
     writeInt32(0);
     writeFourcc(fourcc);
@@ -1228,14 +1374,9 @@ void MPEG4Writer::endBox() {
     off64_t offset = *--mBoxes.end();
     mBoxes.erase(--mBoxes.end());
 
-    if (mWriteMoovBoxToMemory) {
-       int32_t x = htonl(mMoovBoxBufferOffset - offset);
-       memcpy(mMoovBoxBuffer + offset, &x, 4);
-    } else {
-        lseek64(mFd, offset, SEEK_SET);
-        writeInt32(mOffset - offset);
-        mOffset -= 4;
-        lseek64(mFd, mOffset, SEEK_SET);
+    if (!mMeasuringMoovBox) {
+        int32_t x = htonl(mOffset - offset);
+        mOutput->writeAt(offset, &x, 4);
     }
 }
 
@@ -1340,6 +1481,34 @@ status_t MPEG4Writer::setGeoData(int latitudex10000, int longitudex10000) {
     return OK;
 }
 
+status_t MPEG4Writer::addEditListEntry(
+        size_t trackIndex, int64_t mediaTimeUs, int64_t durationUs) {
+    if (mStarted) {
+        ALOGE("Attempt to add an edit list entry after recording has started");
+        return INVALID_OPERATION;
+    }
+
+    if (mediaTimeUs < -1ll || durationUs <= 0ll) {
+        return BAD_VALUE;
+    }
+
+    List<Track *>::iterator it = mTracks.begin();
+    for (size_t i = 0; i < trackIndex && it != mTracks.end(); ++i) {
+        ++it;
+    }
+    if (it == mTracks.end()) {
+        return BAD_VALUE;
+    }
+
+    if (!(*it)->hasEditList()) {
+        mMoovExtraSize += 24;  // edts and elst headers
+    }
+    mMoovExtraSize += 20;      // a 64 bit entry
+    (*it)->addEditListEntry(mediaTimeUs, durationUs);
+
+    return OK;
+}
+
 status_t MPEG4Writer::setCaptureRate(float captureFps) {
     if (captureFps <= 0.0f) {
         return BAD_VALUE;
@@ -1451,6 +1620,8 @@ MPEG4Writer::Track::Track(
       mStssTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
       mSttsTableEntries(new ListTableEntries<uint32_t>(1000, 2)),
       mCttsTableEntries(new ListTableEntries<uint32_t>(1000, 2)),
+      mNumSamples(0),
+      mNumSyncSamples(0),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
       mGotAllCodecSpecificData(false),
@@ -1530,6 +1701,14 @@ void MPEG4Writer::Track::addChunkOffset(off64_t offset) {
     }
 }
 
+void MPEG4Writer::Track::shiftChunkOffsets(off64_t shift) {
+    if (mOwner->use32BitFileOffset()) {
+        mStcoTableEntries->addToAll(shift);
+    } else {
+        mCo64TableEntries->addToAll(shift);
+    }
+}
+
 void MPEG4Writer::Track::setTimeScale() {
     ALOGV("setTimeScale");
     // Default time scale
@@ -1602,6 +1781,11 @@ MPEG4Writer::Track::~Track() {
     mStssTableEntries = NULL;
     mCttsTableEntries = NULL;
 
+    if (mPendingFragmentSample.mBuffer != NULL) {
+        mPendingFragmentSample.mBuffer->release();
+        mPendingFragmentSample.mBuffer = NULL;
+    }
+
     if (mCodecSpecificData != NULL) {
         free(mCodecSpecificData);
         mCodecSpecificData = NULL;
@@ -1673,6 +1857,208 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     chunk->mSamples.clear();
 }
 
+void MPEG4Writer::bufferFragmentSample(Track *track, const FragmentSample &sample) {
+    Mutex::Autolock autolock(mLock);
+    CHECK_EQ(mDone, false);
+
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+
+        if (track == it->mTrack) {
+            it->mFragmentSamples.push_back(sample);
+            mChunkReadyCondition.signal();
+            return;
+        }
+    }
+
+    CHECK(!"Received a sample for a unknown track");
+}
+
+void MPEG4Writer::signalFragmentEOS(Track *track) {
+    Mutex::Autolock autolock(mLock);
+
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+
+        if (track == it->mTrack) {
+            it->mFragmentEOS = true;
+            mChunkReadyCondition.signal();
+            return;
+        }
+    }
+}
+
+bool MPEG4Writer::findFragmentToWrite(bool flush, List<TrackFragment> *fragment) {
+    ALOGV("findFragmentToWrite");
+
+    // Fragments are cut at a sync sample of the video track, or of the
+    // only track there is, about mFragmentDurationUs after the previous
+    // cut. The other tracks follow at the same movie time.
+    ChunkInfo *lead = NULL;
+    bool isEmpty = true;
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        if (lead == NULL || (lead->mTrack->isAudio() && !it->mTrack->isAudio())) {
+            lead = &*it;
+        }
+        if (!it->mFragmentSamples.empty()) {
+            isEmpty = false;
+        }
+    }
+
+    if (isEmpty) {
+        return false;
+    }
+
+    int64_t minCutUs = mFragmentStartUs + mFragmentDurationUs;
+    // don't wait for a sync sample forever, it costs memory
+    int64_t maxCutUs = mFragmentStartUs + 2 * mFragmentDurationUs;
+
+    int64_t leadOffsetUs = lead->mTrack->getStartTimestampUs() - mStartTimestampUs;
+    int64_t cutUs = -1;
+    for (List<FragmentSample>::iterator it = lead->mFragmentSamples.begin();
+         it != lead->mFragmentSamples.end(); ++it) {
+        int64_t timeUs = it->mTimeUs + leadOffsetUs;
+        if ((it->mIsSync && timeUs >= minCutUs) || timeUs >= maxCutUs) {
+            cutUs = timeUs;
+            break;
+        }
+    }
+
+    if (cutUs < 0) {
+        if (!lead->mFragmentEOS && !flush) {
+            return false;
+        }
+
+        // the lead track is done, what it has left goes into this fragment
+        cutUs = minCutUs;
+        if (!lead->mFragmentSamples.empty()) {
+            int64_t lastTimeUs = (--lead->mFragmentSamples.end())->mTimeUs + leadOffsetUs;
+            if (lastTimeUs >= cutUs) {
+                cutUs = lastTimeUs + 1;
+            }
+        }
+    }
+
+    // The other tracks must have buffered beyond the cut, or be done.
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        if (&*it == lead || it->mFragmentEOS || flush) {
+            continue;
+        }
+        if (it->mFragmentSamples.empty()) {
+            return false;
+        }
+        int64_t offsetUs = it->mTrack->getStartTimestampUs() - mStartTimestampUs;
+        if ((--it->mFragmentSamples.end())->mTimeUs + offsetUs < cutUs) {
+            return false;
+        }
+    }
+
+    fragment->clear();
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        TrackFragment trackFragment;
+        trackFragment.mTrack = it->mTrack;
+        if (!it->mFragmentSamples.empty()) {
+            trackFragment.mStartOffsetUs =
+                it->mTrack->getStartTimestampUs() - mStartTimestampUs;
+        }
+
+        while (!it->mFragmentSamples.empty()) {
+            List<FragmentSample>::iterator sampleIt = it->mFragmentSamples.begin();
+            if (sampleIt->mTimeUs + trackFragment.mStartOffsetUs >= cutUs) {
+                break;
+            }
+            trackFragment.mSamples.push_back(*sampleIt);
+            it->mFragmentSamples.erase(sampleIt);
+        }
+
+        if (!trackFragment.mSamples.empty()) {
+            fragment->push_back(trackFragment);
+        }
+    }
+
+    mFragmentStartUs = cutUs;
+    return true;
+}
+
+void MPEG4Writer::writeFragment(List<TrackFragment> *fragment) {
+    if (fragment->empty()) {
+        return;
+    }
+
+    if (!mWroteFragmentedMoov) {
+        for (List<Track *>::iterator it = mTracks.begin();
+             it != mTracks.end(); ++it) {
+            if ((*it)->checkCodecSpecificData() != OK) {
+                // a track failed before it started, reset() reports it
+                ALOGE("Dropping a fragment, the moov box can't be written");
+                for (List<TrackFragment>::iterator fragIt = fragment->begin();
+                     fragIt != fragment->end(); ++fragIt) {
+                    for (List<FragmentSample>::iterator sampleIt = fragIt->mSamples.begin();
+                         sampleIt != fragIt->mSamples.end(); ++sampleIt) {
+                        sampleIt->mBuffer->release();
+                    }
+                }
+                fragment->clear();
+                return;
+            }
+        }
+
+        writeMoovBox(0);
+        mWroteFragmentedMoov = true;
+    }
+
+    off64_t moofOffset = mOffset;
+    beginBox("moof");
+    beginBox("mfhd");
+    writeInt32(0);             // version=0, flags=0
+    writeInt32(++mFragmentSequenceNumber);
+    endBox();  // mfhd
+    for (List<TrackFragment>::iterator it = fragment->begin();
+         it != fragment->end(); ++it) {
+        it->mTrack->writeTrafBox(&*it);
+    }
+    endBox();  // moof
+
+    // The trun data offsets are relative to the start of the moof box
+    // and could only be filled in now that its size is known.
+    uint64_t mdatSize = 8;
+    for (List<TrackFragment>::iterator it = fragment->begin();
+         it != fragment->end(); ++it) {
+        int32_t dataOffset = htonl(mOffset - moofOffset + mdatSize);
+        mOutput->writeAt(it->mDataOffsetPos, &dataOffset, 4);
+
+        for (List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+             sampleIt != it->mSamples.end(); ++sampleIt) {
+            mdatSize += sampleIt->mSize;
+        }
+    }
+    CHECK_LE(mdatSize, 0xffffffffull);
+
+    writeInt32(mdatSize);
+    write("mdat", 4);
+    for (List<TrackFragment>::iterator it = fragment->begin();
+         it != fragment->end(); ++it) {
+        while (!it->mSamples.empty()) {
+            List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+            if (it->mTrack->isAvc()) {
+                addLengthPrefixedSample_l(sampleIt->mBuffer);
+            } else {
+                addSample_l(sampleIt->mBuffer);
+            }
+            sampleIt->mBuffer->release();
+            it->mSamples.erase(sampleIt);
+        }
+    }
+    fragment->clear();
+
+    // Everything up to here is a playable file, should the recording be
+    // cut short.
+    mOutput->submit();
+}
+
 void MPEG4Writer::writeAllChunks() {
     ALOGV("writeAllChunks");
     size_t outstandingChunks = 0;
@@ -1682,6 +2068,12 @@ void MPEG4Writer::writeAllChunks() {
         ++outstandingChunks;
     }
 
+    List<TrackFragment> fragment;
+    while (findFragmentToWrite(true /* flush */, &fragment)) {
+        writeFragment(&fragment);
+        ++outstandingChunks;
+    }
+
     sendSessionSummary();
 
     mChunkInfos.clear();
@@ -1741,9 +2133,12 @@ void MPEG4Writer::threadFunc() {
     Mutex::Autolock autoLock(mLock);
     while (!mDone) {
         Chunk chunk;
+        List<TrackFragment> fragment;
         bool chunkFound = false;
 
-        while (!mDone && !(chunkFound = findChunkToWrite(&chunk))) {
+        while (!mDone && !(chunkFound = isFragmented()
+                ? findFragmentToWrite(false /* flush */, &fragment)
+                : findChunkToWrite(&chunk))) {
             mChunkReadyCondition.wait(mLock);
         }
 
@@ -1755,7 +2150,11 @@ void MPEG4Writer::threadFunc() {
             if (mIsRealTimeRecording) {
                 mLock.unlock();
             }
-            writeChunkToFile(&chunk);
+            if (isFragmented()) {
+                writeFragment(&fragment);
+            } else {
+                writeChunkToFile(&chunk);
+            }
             if (mIsRealTimeRecording) {
                 mLock.lock();
             }
@@ -1777,6 +2176,7 @@ status_t MPEG4Writer::startWriterThread() {
         info.mTrack = *it;
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
+        info.mFragmentEOS = false;
         mChunkInfos.push_back(info);
     }
 
@@ -2178,6 +2578,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int64_t lastCttsOffsetTimeTicks = -1;  // Timescale based ticks
     int32_t cttsSampleCount = 0;           // Sample count in the current ctts table entry
     uint32_t lastSamplesPerChunk = 0;
+    int64_t decodingTicks = 0;             // Timescale based, fragmented only
 
     if (mIsAudio) {
         prctl(PR_SET_NAME, (unsigned long)"AudioTrackEncoding", 0, 0, 0);
@@ -2280,7 +2681,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         CHECK(meta_data->findInt64(kKeyTime, &timestampUs));
 
 ////////////////////////////////////////////////////////////////////////////////
-        if (mStszTableEntries->count() == 0) {
+        if (mNumSamples == 0) {
             mFirstSampleTimeRealUs = systemTime() / 1000;
             mStartTimestampUs = timestampUs;
             mOwner->setStartTimestampUs(mStartTimestampUs);
@@ -2338,7 +2739,9 @@ status_t MPEG4Writer::Track::threadEntry() {
                 return ERROR_MALFORMED;
             }
 
-            if (mStszTableEntries->count() == 0) {
+            if (mOwner->isFragmented()) {
+                // composition offsets go into the trun boxes
+            } else if (mNumSamples == 0) {
                 // Force the first ctts table entry to have one single entry
                 // so that we can do adjustment for the initial track start
                 // time offset easily in writeCttsBox().
@@ -2356,7 +2759,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
 
             // Update ctts time offset range
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mMinCttsOffsetTimeUs = currCttsOffsetTimeTicks;
                 mMaxCttsOffsetTimeUs = currCttsOffsetTimeTicks;
             } else {
@@ -2417,21 +2820,42 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
         }
 
-        mStszTableEntries->add(htonl(sampleSize));
-        if (mStszTableEntries->count() > 2) {
-
-            // Force the first sample to have its own stts entry so that
-            // we can adjust its value later to maintain the A/V sync.
-            if (mStszTableEntries->count() == 3 || currDurationTicks != lastDurationTicks) {
-                addOneSttsTableEntry(sampleCount, lastDurationTicks);
-                sampleCount = 1;
-            } else {
-                ++sampleCount;
+        ++mNumSamples;
+        if (mOwner->isFragmented()) {
+            // The duration of a sample is only known once the next one
+            // is here, the writer gets the previous one now.
+            decodingTicks += currDurationTicks;
+            if (mPendingFragmentSample.mBuffer != NULL) {
+                mPendingFragmentSample.mDurationTicks = currDurationTicks;
+                mOwner->bufferFragmentSample(this, mPendingFragmentSample);
             }
+            mPendingFragmentSample.mBuffer = copy;
+            mPendingFragmentSample.mTimeUs = timestampUs;
+            mPendingFragmentSample.mDecodingTicks = decodingTicks;
+            mPendingFragmentSample.mSize = sampleSize;
+            mPendingFragmentSample.mIsSync = isSync;
+            // without the bias added for the ctts box
+            mPendingFragmentSample.mCompositionOffsetTicks =
+                mIsAudio ? 0 : currCttsOffsetTimeTicks - mTimeScale;
+            copy = NULL;
+        } else {
+            mStszTableEntries->add(htonl(sampleSize));
+            if (mStszTableEntries->count() > 2) {
+
+                // Force the first sample to have its own stts entry so that
+                // we can adjust its value later to maintain the A/V sync.
+                if (mStszTableEntries->count() == 3 ||
+                    currDurationTicks != lastDurationTicks) {
+                    addOneSttsTableEntry(sampleCount, lastDurationTicks);
+                    sampleCount = 1;
+                } else {
+                    ++sampleCount;
+                }
 
+            }
         }
         if (mSamplesHaveSameSize) {
-            if (mStszTableEntries->count() >= 2 && previousSampleSize != sampleSize) {
+            if (mNumSamples >= 2 && previousSampleSize != sampleSize) {
                 mSamplesHaveSameSize = false;
             }
             previousSampleSize = sampleSize;
@@ -2443,7 +2867,10 @@ status_t MPEG4Writer::Track::threadEntry() {
         lastTimestampUs = timestampUs;
 
         if (isSync != 0) {
-            addOneStssTableEntry(mStszTableEntries->count());
+            ++mNumSyncSamples;
+            if (!mOwner->isFragmented()) {
+                addOneStssTableEntry(mStszTableEntries->count());
+            }
         }
 
         if (mTrackingProgressStatus) {
@@ -2452,6 +2879,9 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
             trackProgressStatus(timestampUs);
         }
+        if (mOwner->isFragmented()) {
+            continue;
+        }
         if (!hasMultipleTracks) {
             off64_t offset = mIsAvc? mOwner->addLengthPrefixedSample_l(copy)
                                  : mOwner->addSample_l(copy);
@@ -2501,38 +2931,53 @@ status_t MPEG4Writer::Track::threadEntry() {
 
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
-    // Last chunk
-    if (!hasMultipleTracks) {
-        addOneStscTableEntry(1, mStszTableEntries->count());
-    } else if (!mChunkSamples.empty()) {
-        addOneStscTableEntry(++nChunks, mChunkSamples.size());
-        bufferChunk(timestampUs);
-    }
-
-    // We don't really know how long the last frame lasts, since
-    // there is no frame time after it, just repeat the previous
-    // frame's duration.
-    if (mStszTableEntries->count() == 1) {
-        lastDurationUs = 0;  // A single sample's duration
-        lastDurationTicks = 0;
+    if (mOwner->isFragmented()) {
+        // As with the stts box, the last sample lasts as long as the one
+        // before it.
+        if (mNumSamples == 1) {
+            lastDurationUs = 0;
+            lastDurationTicks = 0;
+        }
+        if (mPendingFragmentSample.mBuffer != NULL) {
+            mPendingFragmentSample.mDurationTicks = lastDurationTicks;
+            mOwner->bufferFragmentSample(this, mPendingFragmentSample);
+            mPendingFragmentSample.mBuffer = NULL;
+        }
+        mOwner->signalFragmentEOS(this);
     } else {
-        ++sampleCount;  // Count for the last sample
-    }
+        // Last chunk
+        if (!hasMultipleTracks) {
+            addOneStscTableEntry(1, mStszTableEntries->count());
+        } else if (!mChunkSamples.empty()) {
+            addOneStscTableEntry(++nChunks, mChunkSamples.size());
+            bufferChunk(timestampUs);
+        }
 
-    if (mStszTableEntries->count() <= 2) {
-        addOneSttsTableEntry(1, lastDurationTicks);
-        if (sampleCount - 1 > 0) {
-            addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
+        // We don't really know how long the last frame lasts, since
+        // there is no frame time after it, just repeat the previous
+        // frame's duration.
+        if (mStszTableEntries->count() == 1) {
+            lastDurationUs = 0;  // A single sample's duration
+            lastDurationTicks = 0;
+        } else {
+            ++sampleCount;  // Count for the last sample
+        }
+
+        if (mStszTableEntries->count() <= 2) {
+            addOneSttsTableEntry(1, lastDurationTicks);
+            if (sampleCount - 1 > 0) {
+                addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
+            }
+        } else {
+            addOneSttsTableEntry(sampleCount, lastDurationTicks);
         }
-    } else {
-        addOneSttsTableEntry(sampleCount, lastDurationTicks);
-    }
 
-    // The last ctts box may not have been written yet, and this
-    // is to make sure that we write out the last ctts box.
-    if (currCttsOffsetTimeTicks == lastCttsOffsetTimeTicks) {
-        if (cttsSampleCount > 0) {
-            addOneCttsTableEntry(cttsSampleCount, lastCttsOffsetTimeTicks);
+        // The last ctts box may not have been written yet, and this
+        // is to make sure that we write out the last ctts box.
+        if (currCttsOffsetTimeTicks == lastCttsOffsetTimeTicks) {
+            if (cttsSampleCount > 0) {
+                addOneCttsTableEntry(cttsSampleCount, lastCttsOffsetTimeTicks);
+            }
         }
     }
 
@@ -2542,7 +2987,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     sendTrackSummary(hasMultipleTracks);
 
     ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), trackName);
+            count, nZeroLengthFrames, mNumSamples, trackName);
     if (mIsAudio) {
         ALOGI("Audio track drift time: %" PRId64 " us", mOwner->getDriftTimeUs());
     }
@@ -2554,12 +2999,12 @@ status_t MPEG4Writer::Track::threadEntry() {
 }
 
 bool MPEG4Writer::Track::isTrackMalFormed() const {
-    if (mStszTableEntries->count() == 0) {                      // no samples written
+    if (mNumSamples == 0) {                      // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
 
-    if (!mIsAudio && mStssTableEntries->count() == 0) {  // no sync frames for video
+    if (!mIsAudio && mNumSyncSamples == 0) {  // no sync frames for video
         ALOGE("There are no sync frames for video track");
         return true;
     }
@@ -2590,7 +3035,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -2696,6 +3141,26 @@ int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
 
+// What the edit list, if there is one, makes of the track
+int64_t MPEG4Writer::Track::getPresentationDurationUs() const {
+    if (mEditList.isEmpty()) {
+        return mTrackDurationUs;
+    }
+
+    int64_t durationUs = 0;
+    for (size_t i = 0; i < mEditList.size(); ++i) {
+        durationUs += mEditList[i].mDurationUs;
+    }
+    return durationUs;
+}
+
+void MPEG4Writer::Track::addEditListEntry(int64_t mediaTimeUs, int64_t durationUs) {
+    EditListEntry entry;
+    entry.mMediaTimeUs = mediaTimeUs;
+    entry.mDurationUs = durationUs;
+    mEditList.push(entry);
+}
+
 int64_t MPEG4Writer::Track::getEstimatedTrackSizeBytes() const {
     return mEstimatedTrackSizeBytes;
 }
@@ -2729,6 +3194,7 @@ void MPEG4Writer::Track::writeTrackHeader(bool use32BitOffset) {
     uint32_t now = getMpeg4Time();
     mOwner->beginBox("trak");
         writeTkhdBox(now);
+        writeEdtsBox();
         mOwner->beginBox("mdia");
             writeMdhdBox(now);
             writeHdlrBox();
@@ -2756,6 +3222,28 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are described by the movie fragments.
+        mOwner->beginBox("stts");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stts
+        mOwner->beginBox("stsc");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stsc
+        mOwner->beginBox("stsz");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // sample size
+        mOwner->writeInt32(0);  // sample count
+        mOwner->endBox();  // stsz
+        mOwner->beginBox("stco");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stco
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -2941,7 +3429,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // a fragmented file is still being recorded when the moov box is written
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getPresentationDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -2970,6 +3459,47 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->endBox();  // tkhd
 }
 
+void MPEG4Writer::Track::writeEdtsBox() {
+    if (mEditList.isEmpty()) {
+        return;
+    }
+
+    int32_t mvhdTimeScale = mOwner->getTimeScale();
+    Vector<int64_t> durations, mediaTimes;
+    bool use64BitEntries = false;
+    for (size_t i = 0; i < mEditList.size(); ++i) {
+        const EditListEntry &entry = mEditList[i];
+        int64_t duration = (entry.mDurationUs * mvhdTimeScale + 500000LL) / 1000000LL;
+        int64_t mediaTime = -1;
+        if (entry.mMediaTimeUs >= 0) {
+            mediaTime = (entry.mMediaTimeUs * mTimeScale + 500000LL) / 1000000LL;
+        }
+        if (duration > 0xffffffffLL || mediaTime > 0x7fffffffLL) {
+            use64BitEntries = true;
+        }
+        durations.push(duration);
+        mediaTimes.push(mediaTime);
+    }
+
+    mOwner->beginBox("edts");
+    mOwner->beginBox("elst");
+    mOwner->writeInt32(use64BitEntries ? (1 << 24) : 0);  // version, flags=0
+    mOwner->writeInt32(mEditList.size());
+    for (size_t i = 0; i < mEditList.size(); ++i) {
+        if (use64BitEntries) {
+            mOwner->writeInt64(durations[i]);   // in mvhd timescale
+            mOwner->writeInt64(mediaTimes[i]);  // in mdhd timescale, -1 if empty
+        } else {
+            mOwner->writeInt32(durations[i]);
+            mOwner->writeInt32(mediaTimes[i]);
+        }
+        mOwner->writeInt16(1);  // media rate: 1.0
+        mOwner->writeInt16(0);
+    }
+    mOwner->endBox();  // elst
+    mOwner->endBox();  // edts
+}
+
 void MPEG4Writer::Track::writeVmhdBox() {
     mOwner->beginBox("vmhd");
     mOwner->writeInt32(0x01);        // version=0, flags=1
@@ -3002,7 +3532,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
@@ -3101,6 +3631,8 @@ void MPEG4Writer::Track::writeSttsBox() {
     duration = htonl(duration);  // Back to host byte order
     mSttsTableEntries->set(htonl(duration + getStartTimeOffsetScaledTime()), 1);
     mSttsTableEntries->write(mOwner);
+    // the moov box may be written more than once
+    mSttsTableEntries->set(htonl(duration), 1);
     mOwner->endBox();  // stts
 }
 
@@ -3129,9 +3661,65 @@ void MPEG4Writer::Track::writeCttsBox() {
     duration = htonl(duration);  // Back host byte order
     mCttsTableEntries->set(htonl(duration + getStartTimeOffsetScaledTime() - mMinCttsOffsetTimeUs), 1);
     mCttsTableEntries->write(mOwner);
+    mCttsTableEntries->set(htonl(duration), 1);
     mOwner->endBox();  // ctts
 }
 
+void MPEG4Writer::Track::writeTrexBox() {
+    mOwner->beginBox("trex");
+    mOwner->writeInt32(0);         // version=0, flags=0
+    mOwner->writeInt32(mTrackId);
+    mOwner->writeInt32(1);         // default sample description index
+    mOwner->writeInt32(0);         // default sample duration
+    mOwner->writeInt32(0);         // default sample size
+    mOwner->writeInt32(0);         // default sample flags
+    mOwner->endBox();  // trex
+}
+
+void MPEG4Writer::Track::writeTrafBox(TrackFragment *fragment) {
+    CHECK(!fragment->mSamples.empty());
+    const FragmentSample &first = *fragment->mSamples.begin();
+
+    mOwner->beginBox("traf");
+
+    mOwner->beginBox("tfhd");
+    mOwner->writeInt32(0x020000);  // version=0, flags=default-base-is-moof
+    mOwner->writeInt32(mTrackId);
+    mOwner->endBox();  // tfhd
+
+    mOwner->beginBox("tfdt");
+    mOwner->writeInt32(0x01000000);  // version=1, flags=0
+    int64_t startOffsetTicks =
+        (fragment->mStartOffsetUs * mTimeScale + 500000LL) / 1000000LL;
+    mOwner->writeInt64(startOffsetTicks + first.mDecodingTicks);
+    mOwner->endBox();  // tfdt
+
+    // data offset, sample duration, size and flags are present, plus the
+    // signed composition time offsets (version 1) for video
+    uint32_t flags = 0x000001 | 0x000100 | 0x000200 | 0x000400;
+    if (!mIsAudio) {
+        flags |= 0x01000000 | 0x000800;
+    }
+    mOwner->beginBox("trun");
+    mOwner->writeInt32(flags);
+    mOwner->writeInt32(fragment->mSamples.size());
+    fragment->mDataOffsetPos = mOwner->mOffset;
+    mOwner->writeInt32(0);         // data offset, filled in by writeFragment()
+    for (List<FragmentSample>::iterator it = fragment->mSamples.begin();
+         it != fragment->mSamples.end(); ++it) {
+        mOwner->writeInt32(it->mDurationTicks);
+        mOwner->writeInt32(it->mSize);
+        // sample_depends_on and sample_is_non_sync_sample
+        mOwner->writeInt32(it->mIsSync ? 0x02000000 : 0x01010000);
+        if (!mIsAudio) {
+            mOwner->writeInt32(it->mCompositionOffsetTicks);
+        }
+    }
+    mOwner->endBox();  // trun
+
+    mOwner->endBox();  // traf
+}
+
 void MPEG4Writer::Track::writeStssBox() {
     mOwner->beginBox("stss");
     mOwner->writeInt32(0);  // version=0, flags=0
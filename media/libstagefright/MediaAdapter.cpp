@@ -24,8 +24,13 @@
 
 namespace android {
 
+// How long stop() waits for the reader to take a queued buffer before it
+// drops the rest.
+static const int64_t kDrainTimeoutNs = 1000000000ll;
+
 MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
-    : mCurrentMediaBuffer(NULL),
+    : mNumBuffersInFlight(0),
+      mMaxQueuedBuffers(0),
       mStarted(false),
       mOutputFormat(meta) {
 }
@@ -33,7 +38,21 @@ MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
 MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
-    CHECK(mCurrentMediaBuffer == NULL);
+    CHECK(mQueuedBuffers.empty());
+}
+
+void MediaAdapter::setMaxQueuedBuffers(size_t maxQueuedBuffers) {
+    Mutex::Autolock autoLock(mAdapterLock);
+    CHECK(!mStarted);
+    mMaxQueuedBuffers = maxQueuedBuffers;
+}
+
+void MediaAdapter::waitForBuffersReturned() {
+    Mutex::Autolock autoLock(mAdapterLock);
+    while (mNumBuffersInFlight > 0 && mStarted) {
+        ALOGV("wait for %zu buffers returned", mNumBuffersInFlight);
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
 }
 
 status_t MediaAdapter::start(MetaData * /* params */) {
@@ -45,18 +64,40 @@ status_t MediaAdapter::start(MetaData * /* params */) {
 }
 
 status_t MediaAdapter::stop() {
-    Mutex::Autolock autoLock(mAdapterLock);
-    if (mStarted) {
+    List<MediaBuffer *> unreadBuffers;
+    {
+        Mutex::Autolock autoLock(mAdapterLock);
+        if (!mStarted) {
+            return OK;
+        }
+
+        // Queued buffers were accepted already, give the reader a chance
+        // to get to them before it sees the end of the stream.
+        while (!mQueuedBuffers.empty()) {
+            size_t numQueued = mQueuedBuffers.size();
+            status_t err = mBufferReturnedCond.waitRelative(mAdapterLock, kDrainTimeoutNs);
+            if (err == TIMED_OUT && mQueuedBuffers.size() == numQueued) {
+                ALOGW("dropping %zu buffers the reader didn't take", numQueued);
+                break;
+            }
+        }
+
         mStarted = false;
         // If stop() happens immediately after a pushBuffer(), we should
-        // clean up the mCurrentMediaBuffer
-        if (mCurrentMediaBuffer != NULL) {
-            mCurrentMediaBuffer->release();
-            mCurrentMediaBuffer = NULL;
-        }
+        // clean up the buffers not read yet.
+        unreadBuffers = mQueuedBuffers;
+        mQueuedBuffers.clear();
         // While read() is still waiting, we should signal it to finish.
         mBufferReadCond.signal();
     }
+
+    // Hand them back as the reader would have, which also wakes up a
+    // pushBuffer() waiting for them.
+    for (List<MediaBuffer *>::iterator it = unreadBuffers.begin();
+            it != unreadBuffers.end(); ++it) {
+        (*it)->setObserver(this);
+        (*it)->release();
+    }
     return OK;
 }
 
@@ -71,6 +112,8 @@ void MediaAdapter::signalBufferReturned(MediaBuffer *buffer) {
     buffer->setObserver(0);
     buffer->release();
     ALOGV("buffer returned %p", buffer);
+    CHECK_GT(mNumBuffersInFlight, 0u);
+    --mNumBuffersInFlight;
     mBufferReturnedCond.signal();
 }
 
@@ -82,21 +125,21 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mQueuedBuffers.empty() && mStarted) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
 
     if (!mStarted) {
         ALOGV("read interrupted after stop");
-        CHECK(mCurrentMediaBuffer == NULL);
+        CHECK(mQueuedBuffers.empty());
         return ERROR_END_OF_STREAM;
     }
 
-    CHECK(mCurrentMediaBuffer != NULL);
+    CHECK(!mQueuedBuffers.empty());
 
-    *buffer = mCurrentMediaBuffer;
-    mCurrentMediaBuffer = NULL;
+    *buffer = *mQueuedBuffers.begin();
+    mQueuedBuffers.erase(mQueuedBuffers.begin());
     (*buffer)->setObserver(this);
 
     return OK;
@@ -113,14 +156,31 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
         ALOGE("pushBuffer called before start");
         return INVALID_OPERATION;
     }
-    mCurrentMediaBuffer = buffer;
+
+    if (mMaxQueuedBuffers > 0) {
+        while (mNumBuffersInFlight >= mMaxQueuedBuffers && mStarted) {
+            ALOGV("wait for a queued buffer returned @ pushBuffer!");
+            mBufferReturnedCond.wait(mAdapterLock);
+        }
+
+        if (!mStarted) {
+            ALOGE("pushBuffer interrupted by stop");
+            return INVALID_OPERATION;
+        }
+    }
+
+    mQueuedBuffers.push_back(buffer);
+    ++mNumBuffersInFlight;
     mBufferReadCond.signal();
 
-    ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
+    if (mMaxQueuedBuffers == 0) {
+        ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
+        while (mNumBuffersInFlight > 0) {
+            mBufferReturnedCond.wait(mAdapterLock);
+        }
+    }
 
     return OK;
 }
 
 }  // namespace android
-
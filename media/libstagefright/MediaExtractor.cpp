@@ -53,7 +53,14 @@ uint32_t MediaExtractor::flags() const {
 // static
 sp<MediaExtractor> MediaExtractor::Create(
         const sp<DataSource> &source, const char *mime) {
-    sp<AMessage> meta;
+    return Create(source, mime, NULL /* sniffMeta */);
+}
+
+// static
+sp<MediaExtractor> MediaExtractor::Create(
+        const sp<DataSource> &source, const char *mime,
+        const sp<AMessage> &sniffMeta) {
+    sp<AMessage> meta = sniffMeta;
 
     String8 tmp;
     if (mime == NULL) {
@@ -38,10 +38,15 @@
 
 namespace android {
 
+// A fragment is cut at the first sync frame after this long.
+static const int64_t kFragmentDurationUs = 2000000ll;
+
 MediaMuxer::MediaMuxer(int fd, OutputFormat format)
     : mFormat(format),
+      mMaxQueuedSamples(0),
       mState(UNINITIALIZED) {
-    if (format == OUTPUT_FORMAT_MPEG_4) {
+    if (format == OUTPUT_FORMAT_MPEG_4
+            || format == OUTPUT_FORMAT_MPEG_4_FRAGMENTED) {
         mWriter = new MPEG4Writer(fd);
     } else if (format == OUTPUT_FORMAT_WEBM) {
         mWriter = new WebmWriter(fd);
@@ -108,7 +113,8 @@ status_t MediaMuxer::setLocation(int latitude, int longitude) {
         ALOGE("setLocation() must be called before start().");
         return INVALID_OPERATION;
     }
-    if (mFormat != OUTPUT_FORMAT_MPEG_4) {
+    if (mFormat != OUTPUT_FORMAT_MPEG_4
+            && mFormat != OUTPUT_FORMAT_MPEG_4_FRAGMENTED) {
         ALOGE("setLocation() is only supported for .mp4 output.");
         return INVALID_OPERATION;
     }
@@ -117,11 +123,65 @@ status_t MediaMuxer::setLocation(int latitude, int longitude) {
     return static_cast<MPEG4Writer*>(mWriter.get())->setGeoData(latitude, longitude);
 }
 
+status_t MediaMuxer::addEditListEntry(
+        size_t trackIndex, int64_t mediaTimeUs, int64_t durationUs) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    if (mState != INITIALIZED) {
+        ALOGE("addEditListEntry() must be called before start().");
+        return INVALID_OPERATION;
+    }
+
+    if (mFormat != OUTPUT_FORMAT_MPEG_4
+            && mFormat != OUTPUT_FORMAT_MPEG_4_FRAGMENTED) {
+        ALOGE("addEditListEntry() is only supported for .mp4 output.");
+        return INVALID_OPERATION;
+    }
+
+    if (trackIndex >= mTrackList.size()) {
+        ALOGE("addEditListEntry() get an invalid index %zu", trackIndex);
+        return -EINVAL;
+    }
+
+    return static_cast<MPEG4Writer*>(mWriter.get())->addEditListEntry(
+            trackIndex, mediaTimeUs, durationUs);
+}
+
+status_t MediaMuxer::setMaxQueuedSamples(size_t maxSamples) {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (mState != INITIALIZED) {
+        ALOGE("setMaxQueuedSamples() must be called before start().");
+        return INVALID_OPERATION;
+    }
+
+    mMaxQueuedSamples = maxSamples;
+    return OK;
+}
+
+status_t MediaMuxer::waitForQueuedSamples() {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (mState != STARTED) {
+        ALOGE("waitForQueuedSamples() is called in invalid state %d", mState);
+        return INVALID_OPERATION;
+    }
+
+    for (size_t i = 0; i < mTrackList.size(); i++) {
+        mTrackList[i]->waitForBuffersReturned();
+    }
+    return OK;
+}
+
 status_t MediaMuxer::start() {
     Mutex::Autolock autoLock(mMuxerLock);
     if (mState == INITIALIZED) {
         mState = STARTED;
+        for (size_t i = 0; i < mTrackList.size(); i++) {
+            mTrackList[i]->setMaxQueuedBuffers(mMaxQueuedSamples);
+        }
         mFileMeta->setInt32(kKeyRealTimeRecording, false);
+        if (mFormat == OUTPUT_FORMAT_MPEG_4_FRAGMENTED) {
+            mFileMeta->setInt64(kKeyFragmentDurationUs, kFragmentDurationUs);
+        }
         return mWriter->start(mFileMeta.get());
     } else {
         ALOGE("start() is called in invalid state %d", mState);
@@ -180,7 +240,9 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
     }
 
     sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
-    // This pushBuffer will wait until the mediaBuffer is consumed.
+    // This pushBuffer will wait until the mediaBuffer is consumed, or in
+    // queued mode until there is room for it. The mediaBuffer keeps a
+    // reference to the buffer either way.
     return currentTrack->pushBuffer(mediaBuffer);
 }
 
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2015, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaRemuxer"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <media/stagefright/MediaRemuxer.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <utils/misc.h>
+
+namespace android {
+
+MediaRemuxer::MediaRemuxer(
+        int fd, MediaMuxer::OutputFormat format, bool useAudio, bool useVideo)
+    : mMuxer(new MediaMuxer(fd, format)),
+      mUseAudio(useAudio),
+      mUseVideo(useVideo),
+      mMaxQueuedSamples(0),
+      mStarted(false),
+      mNumSamplesWritten(0) {
+}
+
+MediaRemuxer::~MediaRemuxer() {
+}
+
+static bool isAudio(const sp<AMessage> &format) {
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    return !strncasecmp(mime.c_str(), "audio/", 6);
+}
+
+static bool isVideo(const sp<AMessage> &format) {
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    return !strncasecmp(mime.c_str(), "video/", 6);
+}
+
+// static
+bool MediaRemuxer::isCompatible(const sp<AMessage> &format, const sp<AMessage> &other) {
+    AString mime, otherMime;
+    CHECK(format->findString("mime", &mime));
+    CHECK(other->findString("mime", &otherMime));
+    if (strcasecmp(mime.c_str(), otherMime.c_str())) {
+        return false;
+    }
+
+    static const char *kInt32Keys[] = {
+        "width", "height", "sample-rate", "channel-count",
+    };
+    for (size_t i = 0; i < (size_t)NELEM(kInt32Keys); ++i) {
+        int32_t value = -1, otherValue = -1;
+        format->findInt32(kInt32Keys[i], &value);
+        other->findInt32(kInt32Keys[i], &otherValue);
+        if (value != otherValue) {
+            return false;
+        }
+    }
+
+    // the output has the codec specific data of the first file only
+    static const char *kCsdKeys[] = { "csd-0", "csd-1", "csd-2" };
+    for (size_t i = 0; i < (size_t)NELEM(kCsdKeys); ++i) {
+        sp<ABuffer> csd, otherCsd;
+        format->findBuffer(kCsdKeys[i], &csd);
+        other->findBuffer(kCsdKeys[i], &otherCsd);
+        if (csd == NULL || otherCsd == NULL) {
+            if (csd != otherCsd) {
+                return false;
+            }
+        } else if (csd->size() != otherCsd->size()
+                || memcmp(csd->data(), otherCsd->data(), csd->size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+status_t MediaRemuxer::addSegment(const char *path, int64_t startUs, int64_t endUs) {
+    if (mStarted) {
+        ALOGE("addSegment() must be called before remux().");
+        return INVALID_OPERATION;
+    }
+
+    if (startUs < 0 || (endUs >= 0 && endUs <= startUs)) {
+        return BAD_VALUE;
+    }
+
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(NULL /* httpService */, path);
+    if (err != OK) {
+        ALOGE("unable to instantiate extractor for %s", path);
+        return err;
+    }
+
+    Segment segment;
+    segment.mExtractor = extractor;
+    segment.mStartUs = startUs;
+    segment.mEndUs = endUs;
+
+    Vector<sp<AMessage> > formats;
+    bool haveAudio = false;
+    bool haveVideo = false;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        err = extractor->getTrackFormat(i, &format);
+        if (err != OK) {
+            return err;
+        }
+
+        if (mUseAudio && !haveAudio && isAudio(format)) {
+            haveAudio = true;
+        } else if (mUseVideo && !haveVideo && isVideo(format)) {
+            haveVideo = true;
+        } else {
+            continue;
+        }
+
+        int64_t durationUs;
+        if (!format->findInt64("durationUs", &durationUs)) {
+            ALOGE("track %zu of %s has no duration", i, path);
+            return ERROR_UNSUPPORTED;
+        }
+
+        segment.mTrackIndices.push(i);
+        segment.mTrackDurationsUs.push(durationUs);
+        formats.push(format);
+    }
+
+    if (formats.isEmpty()) {
+        ALOGE("%s has no track to copy", path);
+        return ERROR_UNSUPPORTED;
+    }
+
+    if (mSegments.isEmpty()) {
+        mTrackFormats = formats;
+    } else if (formats.size() != mTrackFormats.size()) {
+        ALOGE("%s doesn't have the tracks of the first file", path);
+        return ERROR_UNSUPPORTED;
+    } else {
+        if (formats.size() > 1 && isAudio(formats[0]) != isAudio(mTrackFormats[0])) {
+            // in the order of the first file's tracks
+            formats.push(formats[0]);
+            formats.removeAt(0);
+            segment.mTrackIndices.push(segment.mTrackIndices[0]);
+            segment.mTrackIndices.removeAt(0);
+            segment.mTrackDurationsUs.push(segment.mTrackDurationsUs[0]);
+            segment.mTrackDurationsUs.removeAt(0);
+        }
+        for (size_t i = 0; i < formats.size(); ++i) {
+            if (!isCompatible(formats[i], mTrackFormats[i])) {
+                ALOGE("track %zu of %s can't be joined to the first file's",
+                        segment.mTrackIndices[i], path);
+                return ERROR_UNSUPPORTED;
+            }
+        }
+    }
+
+    int64_t durationUs = 0;
+    for (size_t i = 0; i < segment.mTrackDurationsUs.size(); ++i) {
+        if (segment.mTrackDurationsUs[i] > durationUs) {
+            durationUs = segment.mTrackDurationsUs[i];
+        }
+    }
+    if (segment.mEndUs < 0 || segment.mEndUs > durationUs) {
+        segment.mEndUs = durationUs;
+    }
+    if (segment.mStartUs >= segment.mEndUs) {
+        ALOGE("%s ends before %" PRId64 " us", path, startUs);
+        return BAD_VALUE;
+    }
+
+    mSegments.push(segment);
+    return OK;
+}
+
+status_t MediaRemuxer::setMaxQueuedSamples(size_t maxSamples) {
+    if (mStarted) {
+        ALOGE("setMaxQueuedSamples() must be called before remux().");
+        return INVALID_OPERATION;
+    }
+
+    mMaxQueuedSamples = maxSamples;
+    return OK;
+}
+
+// Finds the sync samples around the segment's range in each of its tracks
+// and adds the edit list entries that present just the range.
+status_t MediaRemuxer::planSegment(Segment *segment, Vector<int64_t> *mediaEndTimesUs) {
+    const sp<NuMediaExtractor> &extractor = segment->mExtractor;
+    int64_t startUs = segment->mStartUs;
+    int64_t endUs = segment->mEndUs;
+
+    segment->mCuts.clear();
+    for (size_t i = 0; i < segment->mTrackIndices.size(); ++i) {
+        size_t index = segment->mTrackIndices[i];
+        int64_t trackDurationUs = segment->mTrackDurationsUs[i];
+
+        Cut cut;
+        cut.mSyncTimeUs = -1;
+        cut.mEndTimeUs = trackDurationUs;
+        cut.mMediaTimeUs = mediaEndTimesUs->itemAt(i);
+
+        // one track at a time, the seeks are done for every selected one
+        status_t err = extractor->selectTrack(index);
+        if (err != OK) {
+            return err;
+        }
+        if (extractor->seekTo(startUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC) == OK) {
+            CHECK_EQ(extractor->getSampleTime(&cut.mSyncTimeUs), (status_t)OK);
+        }
+        if (cut.mSyncTimeUs >= 0 && endUs < trackDurationUs
+                && extractor->seekTo(endUs, MediaSource::ReadOptions::SEEK_NEXT_SYNC) == OK) {
+            CHECK_EQ(extractor->getSampleTime(&cut.mEndTimeUs), (status_t)OK);
+        }
+        extractor->unselectTrack(index);
+
+        ALOGV("track %zu: copying [%" PRId64 ", %" PRId64 ") us for [%" PRId64
+                ", %" PRId64 ") us", i, cut.mSyncTimeUs, cut.mEndTimeUs, startUs, endUs);
+
+        // The track may start late, or end early, in which case nothing
+        // is presented for that time.
+        int64_t presentedStartUs = startUs;
+        int64_t presentedEndUs = endUs < trackDurationUs ? endUs : trackDurationUs;
+        if (cut.mSyncTimeUs > presentedStartUs) {
+            presentedStartUs = cut.mSyncTimeUs;
+        }
+        if (cut.mSyncTimeUs < 0 || cut.mEndTimeUs <= cut.mSyncTimeUs
+                || presentedStartUs >= presentedEndUs) {
+            cut.mSyncTimeUs = -1;
+            presentedStartUs = presentedEndUs = endUs;
+        }
+
+        if (presentedStartUs > startUs) {
+            err = mMuxer->addEditListEntry(i, -1ll, presentedStartUs - startUs);
+        }
+        if (err == OK && presentedEndUs > presentedStartUs) {
+            err = mMuxer->addEditListEntry(
+                    i, cut.mMediaTimeUs + presentedStartUs - cut.mSyncTimeUs,
+                    presentedEndUs - presentedStartUs);
+        }
+        if (err == OK && endUs > presentedEndUs) {
+            err = mMuxer->addEditListEntry(i, -1ll, endUs - presentedEndUs);
+        }
+        if (err != OK) {
+            return err;
+        }
+
+        if (cut.mSyncTimeUs >= 0) {
+            mediaEndTimesUs->editItemAt(i) += cut.mEndTimeUs - cut.mSyncTimeUs;
+        }
+        segment->mCuts.push(cut);
+    }
+
+    return OK;
+}
+
+status_t MediaRemuxer::copySegment(const Segment &segment) {
+    const sp<NuMediaExtractor> &extractor = segment.mExtractor;
+
+    size_t numTracksCopying = 0;
+    for (size_t i = 0; i < segment.mTrackIndices.size(); ++i) {
+        if (segment.mCuts[i].mSyncTimeUs >= 0) {
+            status_t err = extractor->selectTrack(segment.mTrackIndices[i]);
+            if (err != OK) {
+                return err;
+            }
+            ++numTracksCopying;
+        }
+    }
+
+    if (numTracksCopying > 0) {
+        // every track lands on the sync sample planSegment() found
+        extractor->seekTo(segment.mStartUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    }
+
+    status_t err = OK;
+    while (numTracksCopying > 0) {
+        size_t index;
+        if (extractor->getSampleTrackIndex(&index) != OK) {
+            break;
+        }
+
+        size_t trackIndex = 0;
+        while (segment.mTrackIndices[trackIndex] != index) {
+            ++trackIndex;
+        }
+        const Cut &cut = segment.mCuts[trackIndex];
+
+        int64_t timeUs;
+        CHECK_EQ(extractor->getSampleTime(&timeUs), (status_t)OK);
+        if (timeUs >= cut.mEndTimeUs) {
+            // unselecting the track frees the samples the muxer still queues
+            if (mMaxQueuedSamples > 0) {
+                mMuxer->waitForQueuedSamples();
+            }
+            extractor->unselectTrack(index);
+            --numTracksCopying;
+            continue;
+        } else if (timeUs < cut.mSyncTimeUs) {
+            // leading pictures of an open GOP, which refer to the one before
+            extractor->advance();
+            continue;
+        }
+
+        sp<MetaData> meta;
+        CHECK_EQ(extractor->getSampleMeta(&meta), (status_t)OK);
+        uint32_t sampleFlags = 0;
+        int32_t isSync;
+        if (meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync != 0) {
+            sampleFlags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+        }
+
+        sp<ABuffer> buffer;
+        err = extractor->getSampleData(&buffer);
+        if (err != OK) {
+            break;
+        }
+
+        err = mMuxer->writeSampleData(
+                buffer, trackIndex, cut.mMediaTimeUs + timeUs - cut.mSyncTimeUs, sampleFlags);
+        if (err != OK) {
+            break;
+        }
+        ++mNumSamplesWritten;
+
+        extractor->advance();
+    }
+
+    if (mMaxQueuedSamples > 0) {
+        mMuxer->waitForQueuedSamples();
+    }
+    for (size_t i = 0; i < segment.mTrackIndices.size(); ++i) {
+        extractor->unselectTrack(segment.mTrackIndices[i]);
+    }
+
+    return err;
+}
+
+status_t MediaRemuxer::remux() {
+    if (mStarted || mSegments.isEmpty()) {
+        return INVALID_OPERATION;
+    }
+    mStarted = true;
+
+    for (size_t i = 0; i < mTrackFormats.size(); ++i) {
+        if (mMuxer->addTrack(mTrackFormats[i]) < 0) {
+            ALOGE("track format %s unsupported by muxer",
+                    mTrackFormats[i]->debugString().c_str());
+            return ERROR_UNSUPPORTED;
+        }
+    }
+
+    // Each track's samples follow those of the previous segment, so the
+    // edit lists are all known before the muxer starts.
+    Vector<int64_t> mediaEndTimesUs;
+    mediaEndTimesUs.insertAt(0ll, 0, mTrackFormats.size());
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        status_t err = planSegment(&mSegments.editItemAt(i), &mediaEndTimesUs);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    status_t err = mMuxer->setMaxQueuedSamples(mMaxQueuedSamples);
+    if (err == OK) {
+        err = mMuxer->start();
+    }
+    if (err != OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < mSegments.size() && err == OK; ++i) {
+        err = copySegment(mSegments[i]);
+    }
+
+    status_t stopErr = mMuxer->stop();
+    return err != OK ? err : stopErr;
+}
+
+}  // namespace android
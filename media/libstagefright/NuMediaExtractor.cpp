@@ -39,6 +39,17 @@
 
 namespace android {
 
+// Gives a MediaBuffer which doesn't come from a MediaBufferGroup the reference
+// counting of one, and deletes it once the last reference is released.
+struct DeleteOnReturn : public MediaBufferObserver {
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        buffer->setObserver(NULL);
+        buffer->release();
+    }
+};
+
+static DeleteOnReturn gDeleteOnReturn;
+
 NuMediaExtractor::NuMediaExtractor()
     : mIsWidevineExtractor(false),
       mTotalBitrate(-1ll),
@@ -488,6 +499,41 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
     return OK;
 }
 
+status_t NuMediaExtractor::getSampleData(sp<ABuffer> *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t minIndex = fetchTrackSamples();
+
+    if (minIndex < 0) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+
+    if (info->mTrackFlags & kIsVorbis) {
+        // the page sample count readSampleData() adds has no place here
+        return ERROR_UNSUPPORTED;
+    }
+
+    MediaBuffer *sample = info->mSample;
+    if (sample->refcount() == 0) {
+        // only buffers of a MediaBufferGroup are reference counted, the
+        // others are ours alone until released
+        sample->setObserver(&gDeleteOnReturn);
+        sample->add_ref();
+    }
+
+    *buffer = new ABuffer(
+            (uint8_t *)sample->data() + sample->range_offset(),
+            sample->range_length());
+
+    // the sample stays valid for as long as the ABuffer is around
+    sample->add_ref();
+    (*buffer)->setMediaBufferBase(sample);
+
+    return OK;
+}
+
 status_t NuMediaExtractor::getSampleTrackIndex(size_t *trackIndex) {
     Mutex::Autolock autoLock(mLock);
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ProbeDataSource"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include "include/ProbeDataSource.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+ProbeDataSource::ProbeDataSource(
+        const sp<DataSource> &source,
+        size_t headSize,
+        size_t tailSize,
+        size_t readAheadSize)
+    : mSource(source),
+      mSize(-1),
+      mNumReads(0),
+      mNumBytesRead(0) {
+    if (mSource->getSize(&mSize) != OK) {
+        mSize = -1;
+    }
+
+    InitBlock(&mHead, headSize);
+    InitBlock(&mTail, tailSize);
+    InitBlock(&mReadAhead, readAheadSize);
+
+    // The tail only covers what the head doesn't.
+    mTail.mOffset = headSize;
+    if (mSize > (off64_t)(headSize + tailSize)) {
+        mTail.mOffset = mSize - tailSize;
+    }
+}
+
+ProbeDataSource::~ProbeDataSource() {
+    delete[] mHead.mData;
+    delete[] mTail.mData;
+    delete[] mReadAhead.mData;
+}
+
+// static
+void ProbeDataSource::InitBlock(Block *block, size_t capacity) {
+    block->mOffset = 0;
+    block->mLength = -1;
+    block->mCapacity = capacity;
+    block->mData = capacity > 0 ? new uint8_t[capacity] : NULL;
+}
+
+status_t ProbeDataSource::initCheck() const {
+    return mSource->initCheck();
+}
+
+status_t ProbeDataSource::getSize(off64_t *size) {
+    if (mSize < 0) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    *size = mSize;
+    return OK;
+}
+
+sp<DecryptHandle> ProbeDataSource::DrmInitialization(const char *mime) {
+    Mutex::Autolock autoLock(mLock);
+
+    flush_l();
+    return mSource->DrmInitialization(mime);
+}
+
+void ProbeDataSource::getReadStats(size_t *numReads, size_t *numBytesRead) {
+    Mutex::Autolock autoLock(mLock);
+
+    *numReads = mNumReads;
+    *numBytesRead = mNumBytesRead;
+}
+
+ssize_t ProbeDataSource::readAt(off64_t offset, void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (offset < 0) {
+        return UNKNOWN_ERROR;
+    }
+
+    uint8_t *dst = (uint8_t *)data;
+    size_t copied = 0;
+    while (copied < size) {
+        off64_t pos = offset + copied;
+        if (mSize >= 0 && pos >= mSize) {
+            break;
+        }
+
+        Block *block = findBlock_l(pos);
+        if (block == NULL) {
+            if (size - copied >= mReadAhead.mCapacity) {
+                // Caching this wouldn't save any reads.
+                ssize_t n = readFromSource_l(pos, dst + copied, size - copied);
+                if (n < 0) {
+                    return copied > 0 ? (ssize_t)copied : n;
+                }
+                copied += n;
+                break;
+            }
+
+            block = &mReadAhead;
+            status_t err = fillBlock_l(block, pos);
+            if (err != OK) {
+                return copied > 0 ? (ssize_t)copied : err;
+            }
+        }
+
+        size_t available = block->mOffset + block->mLength - pos;
+        if (available == 0) {
+            break;
+        }
+
+        size_t n = size - copied;
+        if (n > available) {
+            n = available;
+        }
+        memcpy(dst + copied, block->mData + (pos - block->mOffset), n);
+        copied += n;
+    }
+
+    return copied;
+}
+
+ProbeDataSource::Block *ProbeDataSource::findBlock_l(off64_t offset) {
+    Block *block = &mReadAhead;
+    if (offset < (off64_t)mHead.mCapacity) {
+        block = &mHead;
+    } else if (mTail.mCapacity > 0
+            && mSize > (off64_t)mHead.mCapacity && offset >= mTail.mOffset) {
+        block = &mTail;
+    }
+
+    if (block != &mReadAhead && block->mLength < 0
+            && fillBlock_l(block, block->mOffset) != OK) {
+        return NULL;
+    }
+
+    if (block->mLength < 0
+            || offset < block->mOffset
+            || offset >= block->mOffset + block->mLength) {
+        return NULL;
+    }
+
+    return block;
+}
+
+status_t ProbeDataSource::fillBlock_l(Block *block, off64_t offset) {
+    ssize_t n = readFromSource_l(offset, block->mData, block->mCapacity);
+    if (n < 0) {
+        block->mLength = -1;
+        return n;
+    }
+
+    ALOGV("cached %zd bytes at %lld", n, (long long)offset);
+
+    block->mOffset = offset;
+    block->mLength = n;
+    return OK;
+}
+
+ssize_t ProbeDataSource::readFromSource_l(off64_t offset, void *data, size_t size) {
+    ssize_t n = mSource->readAt(offset, data, size);
+    ++mNumReads;
+    if (n > 0) {
+        mNumBytesRead += n;
+    }
+    return n;
+}
+
+void ProbeDataSource::flush_l() {
+    mHead.mLength = -1;
+    mTail.mLength = -1;
+    mReadAhead.mLength = -1;
+}
+
+}  // namespace android
@@ -18,22 +18,107 @@
 #define LOG_TAG "StagefrightMediaScanner"
 #include <utils/Log.h>
 
+#include <inttypes.h>
+#include <cutils/properties.h>
+#include <sys/prctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include <media/stagefright/StagefrightMediaScanner.h>
 
+#include "include/ProbeDataSource.h"
+#include "include/StagefrightMetadataRetriever.h"
+
 #include <media/IMediaHTTPService.h>
 #include <media/mediametadataretriever.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaExtractor.h>
 #include <private/media/VideoFrame.h>
 
 namespace android {
 
-StagefrightMediaScanner::StagefrightMediaScanner() {}
+static const size_t kMaxDefaultScanThreads = 4;
+
+// Files the workers may get ahead of the client, per worker.
+static const size_t kMaxFilesAheadPerThread = 2;
+
+struct KeyMap {
+    const char *tag;
+    int key;
+};
+static const KeyMap kKeyMap[] = {
+    { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER },
+    { "discnumber", METADATA_KEY_DISC_NUMBER },
+    { "album", METADATA_KEY_ALBUM },
+    { "artist", METADATA_KEY_ARTIST },
+    { "albumartist", METADATA_KEY_ALBUMARTIST },
+    { "composer", METADATA_KEY_COMPOSER },
+    { "genre", METADATA_KEY_GENRE },
+    { "title", METADATA_KEY_TITLE },
+    { "year", METADATA_KEY_YEAR },
+    { "duration", METADATA_KEY_DURATION },
+    { "writer", METADATA_KEY_WRITER },
+    { "compilation", METADATA_KEY_COMPILATION },
+    { "isdrm", METADATA_KEY_IS_DRM },
+    { "width", METADATA_KEY_VIDEO_WIDTH },
+    { "height", METADATA_KEY_VIDEO_HEIGHT },
+};
+static const size_t kNumEntries = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
+
+// The state shared by the threads of one processFiles() call.
+struct StagefrightMediaScanner::Batch {
+    StagefrightMediaScanner *mScanner;
+    const Vector<String8> *mPaths;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<FileMetadata *> mFiles;  // NULL until extracted, or once reported
+    size_t mNextToExtract;
+    size_t mNextToReport;
+    size_t mMaxFilesAhead;
+    bool mDone;
+};
+
+StagefrightMediaScanner::StagefrightMediaScanner() {
+    // The metadata comes from the media server's retriever, so that a file
+    // that crashes an extractor doesn't take the scanner down with it.
+    // Probing in this process is faster, but only for trusted media.
+    mProbeInProcess = property_get_bool(
+            "media.stagefright.scan-in-process", false /* default_value */);
+    if (mProbeInProcess) {
+        DataSource::RegisterDefaultSniffers();
+    }
+
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    mMaxScanThreads = numCpus > 0 ? numCpus : 1;
+    if (mMaxScanThreads > kMaxDefaultScanThreads) {
+        mMaxScanThreads = kMaxDefaultScanThreads;
+    }
+
+    resetPhaseTimes();
+}
 
 StagefrightMediaScanner::~StagefrightMediaScanner() {}
 
+void StagefrightMediaScanner::setMaxScanThreads(size_t maxThreads) {
+    mMaxScanThreads = maxThreads > 0 ? maxThreads : 1;
+}
+
+void StagefrightMediaScanner::getPhaseTimes(PhaseTimes *times) {
+    Mutex::Autolock autoLock(mPhaseTimesLock);
+    *times = mPhaseTimes;
+}
+
+void StagefrightMediaScanner::resetPhaseTimes() {
+    Mutex::Autolock autoLock(mPhaseTimesLock);
+    memset(&mPhaseTimes, 0, sizeof(mPhaseTimes));
+}
+
 static bool FileHasAcceptableExtension(const char *extension) {
     static const char *kValidExtensions[] = {
         ".mp3", ".mp4", ".m4a", ".3gp", ".3gpp", ".3g2", ".3gpp2",
@@ -55,82 +140,288 @@ static bool FileHasAcceptableExtension(const char *extension) {
 }
 
 MediaScanResult StagefrightMediaScanner::processFile(
-        const char *path, const char *mimeType,
+        const char *path, const char * /* mimeType */,
         MediaScannerClient &client) {
     ALOGV("processFile '%s'.", path);
 
+    FileMetadata file;
+    extractMetadata(path, &file);
+
     client.setLocale(locale());
     client.beginFile();
-    MediaScanResult result = processFileInternal(path, mimeType, client);
+    MediaScanResult result = reportMetadata(file, client);
     client.endFile();
     return result;
 }
 
-MediaScanResult StagefrightMediaScanner::processFileInternal(
-        const char *path, const char * /* mimeType */,
-        MediaScannerClient &client) {
+MediaScanResult StagefrightMediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client) {
+    size_t numThreads = mMaxScanThreads;
+    if (numThreads > paths.size()) {
+        numThreads = paths.size();
+    }
+    if (numThreads <= 1) {
+        return MediaScanner::processFiles(paths, client);
+    }
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    Batch batch;
+    batch.mScanner = this;
+    batch.mPaths = &paths;
+    batch.mFiles.insertAt((FileMetadata *)NULL, 0, paths.size());
+    batch.mNextToExtract = 0;
+    batch.mNextToReport = 0;
+    batch.mMaxFilesAhead = numThreads * kMaxFilesAheadPerThread;
+    batch.mDone = false;
+
+    Vector<pthread_t> threads;
+    for (size_t i = 0; i < numThreads; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, ThreadWrapper, &batch) != 0) {
+            ALOGW("could only start %zu of %zu scan threads", i, numThreads);
+            break;
+        }
+        threads.push(thread);
+    }
+
+    if (threads.isEmpty()) {
+        return MediaScanner::processFiles(paths, client);
+    }
+
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        FileMetadata *file;
+        {
+            Mutex::Autolock autoLock(batch.mLock);
+            while (batch.mFiles[i] == NULL) {
+                batch.mCondition.wait(batch.mLock);
+            }
+            file = batch.mFiles[i];
+            batch.mFiles.editItemAt(i) = NULL;
+            batch.mNextToReport = i + 1;
+            batch.mCondition.broadcast();
+        }
+
+        ALOGV("processFile '%s'.", paths[i].string());
+
+        client.beginBatchedFile(paths[i].string());
+        client.setLocale(locale());
+        client.beginFile();
+        if (reportMetadata(*file, client) == MEDIA_SCAN_RESULT_ERROR) {
+            result = MEDIA_SCAN_RESULT_ERROR;
+        }
+        client.endFile();
+
+        delete file;
+    }
+
+    {
+        Mutex::Autolock autoLock(batch.mLock);
+        batch.mDone = true;
+        batch.mCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ALOGV("scanned %zu files on %zu threads in %" PRId64 " ms",
+          paths.size(), threads.size(), (ALooper::GetNowUs() - startTimeUs) / 1000);
+
+    return result;
+}
+
+// static
+void *StagefrightMediaScanner::ThreadWrapper(void *me) {
+    Batch *batch = static_cast<Batch *>(me);
+
+    prctl(PR_SET_NAME, (unsigned long)"MediaScanner", 0, 0, 0);
+
+    Mutex::Autolock autoLock(batch->mLock);
+    for (;;) {
+        while (!batch->mDone
+                && batch->mNextToExtract < batch->mPaths->size()
+                && batch->mNextToExtract
+                        >= batch->mNextToReport + batch->mMaxFilesAhead) {
+            batch->mCondition.wait(batch->mLock);
+        }
+
+        if (batch->mDone || batch->mNextToExtract == batch->mPaths->size()) {
+            break;
+        }
+
+        size_t index = batch->mNextToExtract++;
+        FileMetadata *file = new FileMetadata;
+
+        batch->mLock.unlock();
+        batch->mScanner->extractMetadata((*batch->mPaths)[index].string(), file);
+        batch->mLock.lock();
+
+        batch->mFiles.editItemAt(index) = file;
+        batch->mCondition.broadcast();
+    }
+
+    return NULL;
+}
+
+void StagefrightMediaScanner::extractMetadata(
+        const char *path, FileMetadata *file) {
+    file->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+    file->mMetaData.clear();
+
     const char *extension = strrchr(path, '.');
 
     if (!extension) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
     if (!FileHasAcceptableExtension(extension)) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
-    sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
+    PhaseTimes times;
+    memset(&times, 0, sizeof(times));
+    times.mNumFiles = 1;
 
+    int64_t startTimeUs = ALooper::GetNowUs();
     int fd = open(path, O_RDONLY | O_LARGEFILE);
+    off64_t size = fd >= 0 ? lseek64(fd, 0, SEEK_END) : -1;
+    times.mOpenUs = ALooper::GetNowUs() - startTimeUs;
+
+    status_t status = UNKNOWN_ERROR;
+    if (mProbeInProcess && size >= 0) {
+        status = probeFile(fd, size, file, &times);
+        if (status != OK) {
+            // couldn't make sense of it locally, maybe the media server can?
+            ++times.mNumFallbacks;
+            file->mMetaData.clear();
+        }
+    }
+
+    if (status != OK) {
+        status = retrieveMetadata(fd, path, file);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    file->mResult = status == OK ? MEDIA_SCAN_RESULT_OK : MEDIA_SCAN_RESULT_ERROR;
+
+    ALOGV("'%s': open %" PRId64 " us, sniff %" PRId64 " us, parse %" PRId64 " us,"
+          " tags %" PRId64 " us, %zu reads",
+          path, times.mOpenUs, times.mSniffUs, times.mParseUs, times.mTagsUs,
+          times.mNumReads);
+
+    Mutex::Autolock autoLock(mPhaseTimesLock);
+    mPhaseTimes.mNumFiles += times.mNumFiles;
+    mPhaseTimes.mNumFallbacks += times.mNumFallbacks;
+    mPhaseTimes.mNumReads += times.mNumReads;
+    mPhaseTimes.mNumBytesRead += times.mNumBytesRead;
+    mPhaseTimes.mOpenUs += times.mOpenUs;
+    mPhaseTimes.mSniffUs += times.mSniffUs;
+    mPhaseTimes.mParseUs += times.mParseUs;
+    mPhaseTimes.mTagsUs += times.mTagsUs;
+}
+
+status_t StagefrightMediaScanner::probeFile(
+        int fd, off64_t size, FileMetadata *file, PhaseTimes *times) {
+    int probeFd = dup(fd);
+    if (probeFd < 0) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<ProbeDataSource> source = new ProbeDataSource(new FileSource(probeFd, 0, size));
+    status_t err = source->initCheck();
+    if (err != OK) {
+        return err;
+    }
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+    String8 mime;
+    float confidence;
+    sp<AMessage> meta;
+    bool sniffed = source->sniff(&mime, &confidence, &meta);
+    int64_t nowUs = ALooper::GetNowUs();
+    times->mSniffUs = nowUs - startTimeUs;
+
+    sp<MediaExtractor> extractor;
+    if (sniffed) {
+        startTimeUs = nowUs;
+        extractor = MediaExtractor::Create(source, mime.string(), meta);
+        if (extractor != NULL) {
+            // Most extractors only parse the file once asked for the tracks.
+            extractor->countTracks();
+        }
+        nowUs = ALooper::GetNowUs();
+        times->mParseUs = nowUs - startTimeUs;
+    }
+
+    if (extractor == NULL) {
+        source->getReadStats(&times->mNumReads, &times->mNumBytesRead);
+        return ERROR_UNSUPPORTED;
+    }
+
+    startTimeUs = nowUs;
+    StagefrightMetadataRetriever::ParseMetaData(
+            extractor, source, &file->mMetaData, NULL /* albumArt */);
+    times->mTagsUs = ALooper::GetNowUs() - startTimeUs;
+
+    source->getReadStats(&times->mNumReads, &times->mNumBytesRead);
+    return OK;
+}
+
+status_t StagefrightMediaScanner::retrieveMetadata(
+        int fd, const char *path, FileMetadata *file) {
+    sp<MediaMetadataRetriever> retriever(new MediaMetadataRetriever);
+
     status_t status;
     if (fd < 0) {
-        // couldn't open it locally, maybe the media server can?
-        status = mRetriever->setDataSource(NULL /* httpService */, path);
+        status = retriever->setDataSource(NULL /* httpService */, path);
     } else {
-        status = mRetriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
-        close(fd);
+        status = retriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
     }
 
     if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+        return status;
     }
 
     const char *value;
-    if ((value = mRetriever->extractMetadata(
+    if ((value = retriever->extractMetadata(
                     METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
+        file->mMetaData.add(METADATA_KEY_MIMETYPE, String8(value));
+    }
+
+    for (size_t i = 0; i < kNumEntries; ++i) {
+        if ((value = retriever->extractMetadata(kKeyMap[i].key)) != NULL) {
+            file->mMetaData.add(kKeyMap[i].key, String8(value));
+        }
+    }
+
+    return OK;
+}
+
+MediaScanResult StagefrightMediaScanner::reportMetadata(
+        const FileMetadata &file, MediaScannerClient &client) {
+    if (file.mResult != MEDIA_SCAN_RESULT_OK) {
+        return file.mResult;
+    }
+
+    status_t status;
+    ssize_t index = file.mMetaData.indexOfKey(METADATA_KEY_MIMETYPE);
+    if (index >= 0) {
+        status = client.setMimeType(file.mMetaData.valueAt(index).string());
         if (status) {
             return MEDIA_SCAN_RESULT_ERROR;
         }
     }
 
-    struct KeyMap {
-        const char *tag;
-        int key;
-    };
-    static const KeyMap kKeyMap[] = {
-        { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER },
-        { "discnumber", METADATA_KEY_DISC_NUMBER },
-        { "album", METADATA_KEY_ALBUM },
-        { "artist", METADATA_KEY_ARTIST },
-        { "albumartist", METADATA_KEY_ALBUMARTIST },
-        { "composer", METADATA_KEY_COMPOSER },
-        { "genre", METADATA_KEY_GENRE },
-        { "title", METADATA_KEY_TITLE },
-        { "year", METADATA_KEY_YEAR },
-        { "duration", METADATA_KEY_DURATION },
-        { "writer", METADATA_KEY_WRITER },
-        { "compilation", METADATA_KEY_COMPILATION },
-        { "isdrm", METADATA_KEY_IS_DRM },
-        { "width", METADATA_KEY_VIDEO_WIDTH },
-        { "height", METADATA_KEY_VIDEO_HEIGHT },
-    };
-    static const size_t kNumEntries = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
-
     for (size_t i = 0; i < kNumEntries; ++i) {
-        const char *value;
-        if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
+        index = file.mMetaData.indexOfKey(kKeyMap[i].key);
+        if (index >= 0) {
+            status = client.addStringTag(
+                    kKeyMap[i].tag, file.mMetaData.valueAt(index).string());
             if (status != OK) {
                 return MEDIA_SCAN_RESULT_ERROR;
             }
@@ -539,7 +539,14 @@ const char *StagefrightMetadataRetriever::extractMetadata(int keyCode) {
 }
 
 void StagefrightMetadataRetriever::parseMetaData() {
-    sp<MetaData> meta = mExtractor->getMetaData();
+    ParseMetaData(mExtractor, mSource, &mMetaData, &mAlbumArt);
+}
+
+// static
+void StagefrightMetadataRetriever::ParseMetaData(
+        const sp<MediaExtractor> &extractor, const sp<DataSource> &source,
+        KeyedVector<int, String8> *metaData, MediaAlbumArt **albumArt) {
+    sp<MetaData> meta = extractor->getMetaData();
 
     if (meta == NULL) {
         ALOGV("extractor doesn't publish metadata, failed to initialize?");
@@ -581,7 +588,7 @@ void StagefrightMetadataRetriever::parseMetaData() {
                 detector->addTag(kMap[i].name, value);
             } else {
                 // directly add to output list
-                mMetaData.add(kMap[i].to, String8(value));
+                metaData->add(kMap[i].to, String8(value));
             }
         }
     }
@@ -595,7 +602,7 @@ void StagefrightMetadataRetriever::parseMetaData() {
             detector->getTag(i, &name, &value);
             for (size_t j = 0; j < kNumMapEntries; ++j) {
                 if (kMap[j].name && !strcmp(kMap[j].name, name)) {
-                    mMetaData.add(kMap[j].to, String8(value));
+                    metaData->add(kMap[j].to, String8(value));
                 }
             }
         }
@@ -606,21 +613,21 @@ void StagefrightMetadataRetriever::parseMetaData() {
     uint32_t type;
     size_t dataSize;
     if (meta->findData(kKeyAlbumArt, &type, &data, &dataSize)
-            && mAlbumArt == NULL) {
-        mAlbumArt = MediaAlbumArt::fromData(dataSize, data);
+            && albumArt != NULL && *albumArt == NULL) {
+        *albumArt = MediaAlbumArt::fromData(dataSize, data);
     }
 
-    size_t numTracks = mExtractor->countTracks();
+    size_t numTracks = extractor->countTracks();
 
     char tmp[32];
     sprintf(tmp, "%zu", numTracks);
 
-    mMetaData.add(METADATA_KEY_NUM_TRACKS, String8(tmp));
+    metaData->add(METADATA_KEY_NUM_TRACKS, String8(tmp));
 
     float captureFps;
     if (meta->findFloat(kKeyCaptureFramerate, &captureFps)) {
         sprintf(tmp, "%f", captureFps);
-        mMetaData.add(METADATA_KEY_CAPTURE_FRAMERATE, String8(tmp));
+        metaData->add(METADATA_KEY_CAPTURE_FRAMERATE, String8(tmp));
     }
 
     bool hasAudio = false;
@@ -634,7 +641,7 @@ void StagefrightMetadataRetriever::parseMetaData() {
     int64_t maxDurationUs = 0;
     String8 timedTextLang;
     for (size_t i = 0; i < numTracks; ++i) {
-        sp<MetaData> trackMeta = mExtractor->getTrackMetaData(i);
+        sp<MetaData> trackMeta = extractor->getTrackMetaData(i);
 
         int64_t durationUs;
         if (trackMeta->findInt64(kKeyDuration, &durationUs)) {
@@ -672,40 +679,40 @@ void StagefrightMetadataRetriever::parseMetaData() {
     // If multiple text tracks present, the format will look
     // like "eng:chi"
     if (!timedTextLang.isEmpty()) {
-        mMetaData.add(METADATA_KEY_TIMED_TEXT_LANGUAGES, timedTextLang);
+        metaData->add(METADATA_KEY_TIMED_TEXT_LANGUAGES, timedTextLang);
     }
 
     // The duration value is a string representing the duration in ms.
     sprintf(tmp, "%" PRId64, (maxDurationUs + 500) / 1000);
-    mMetaData.add(METADATA_KEY_DURATION, String8(tmp));
+    metaData->add(METADATA_KEY_DURATION, String8(tmp));
 
     if (hasAudio) {
-        mMetaData.add(METADATA_KEY_HAS_AUDIO, String8("yes"));
+        metaData->add(METADATA_KEY_HAS_AUDIO, String8("yes"));
     }
 
     if (hasVideo) {
-        mMetaData.add(METADATA_KEY_HAS_VIDEO, String8("yes"));
+        metaData->add(METADATA_KEY_HAS_VIDEO, String8("yes"));
 
         sprintf(tmp, "%d", videoWidth);
-        mMetaData.add(METADATA_KEY_VIDEO_WIDTH, String8(tmp));
+        metaData->add(METADATA_KEY_VIDEO_WIDTH, String8(tmp));
 
         sprintf(tmp, "%d", videoHeight);
-        mMetaData.add(METADATA_KEY_VIDEO_HEIGHT, String8(tmp));
+        metaData->add(METADATA_KEY_VIDEO_HEIGHT, String8(tmp));
 
         sprintf(tmp, "%d", rotationAngle);
-        mMetaData.add(METADATA_KEY_VIDEO_ROTATION, String8(tmp));
+        metaData->add(METADATA_KEY_VIDEO_ROTATION, String8(tmp));
     }
 
     if (numTracks == 1 && hasAudio && audioBitrate >= 0) {
         sprintf(tmp, "%d", audioBitrate);
-        mMetaData.add(METADATA_KEY_BITRATE, String8(tmp));
+        metaData->add(METADATA_KEY_BITRATE, String8(tmp));
     } else {
         off64_t sourceSize;
-        if (mSource->getSize(&sourceSize) == OK) {
+        if (source->getSize(&sourceSize) == OK) {
             int64_t avgBitRate = (int64_t)(sourceSize * 8E6 / maxDurationUs);
 
             sprintf(tmp, "%" PRId64, avgBitRate);
-            mMetaData.add(METADATA_KEY_BITRATE, String8(tmp));
+            metaData->add(METADATA_KEY_BITRATE, String8(tmp));
         }
     }
 
@@ -714,22 +721,22 @@ void StagefrightMetadataRetriever::parseMetaData() {
         CHECK(meta->findCString(kKeyMIMEType, &fileMIME));
 
         if (!strcasecmp(fileMIME, "video/x-matroska")) {
-            sp<MetaData> trackMeta = mExtractor->getTrackMetaData(0);
+            sp<MetaData> trackMeta = extractor->getTrackMetaData(0);
             const char *trackMIME;
             CHECK(trackMeta->findCString(kKeyMIMEType, &trackMIME));
 
             if (!strncasecmp("audio/", trackMIME, 6)) {
                 // The matroska file only contains a single audio track,
                 // rewrite its mime type.
-                mMetaData.add(
+                metaData->add(
                         METADATA_KEY_MIMETYPE, String8("audio/x-matroska"));
             }
         }
     }
 
     // To check whether the media file is drm-protected
-    if (mExtractor->getDrmFlag()) {
-        mMetaData.add(METADATA_KEY_IS_DRM, String8("1"));
+    if (extractor->getDrmFlag()) {
+        metaData->add(METADATA_KEY_IS_DRM, String8("1"));
     }
 }
 
@@ -8,6 +8,7 @@ LOCAL_SRC_FILES:=               \
         LiveSession.cpp         \
         M3UParser.cpp           \
         PlaylistFetcher.cpp     \
+        SegmentPrefetcher.cpp   \
 
 LOCAL_C_INCLUDES:= \
 	$(TOP)/frameworks/av/media/libstagefright \
@@ -39,7 +39,10 @@ HTTPDownloader::HTTPDownloader(
         const KeyedVector<String8, String8> &headers) :
     mHTTPDataSource(new MediaHTTP(httpService->makeHTTPConnection())),
     mExtraHeaders(headers),
-    mDisconnecting(false) {
+    mDisconnecting(false),
+    mConnectedOffset(0ll),
+    mConnectedEnd(0ll),
+    mOpenEnded(false) {
 }
 
 void HTTPDownloader::reconnect() {
@@ -51,6 +54,7 @@ void HTTPDownloader::disconnect() {
     {
         AutoMutex _l(mLock);
         mDisconnecting = true;
+        mConnectedUrl.clear();
     }
     mHTTPDataSource->disconnect();
 }
@@ -60,6 +64,16 @@ bool HTTPDownloader::isDisconnecting() {
     return mDisconnecting;
 }
 
+// Returns true if the open response can be read on at |range_offset| for |url|;
+// |contiguous| is set if the last range fetched from |url| ends there.
+bool HTTPDownloader::continuesResponse(
+        const char *url, int64_t range_offset, bool *contiguous) {
+    AutoMutex _l(mLock);
+    *contiguous = !mConnectedUrl.empty()
+            && mConnectedUrl == url && mConnectedEnd == range_offset;
+    return *contiguous && mOpenEnded;
+}
+
 /*
  * Illustration of parameters:
  *
@@ -88,13 +102,25 @@ ssize_t HTTPDownloader::fetchBlock(
 
     off64_t size;
 
+    bool contiguous = false;
+    if (reconnect && continuesResponse(url, range_offset, &contiguous)) {
+        ALOGV("reading on '%s' @ %lld", url, (long long)range_offset);
+        reconnect = false;
+    }
+
     if (reconnect) {
+        {
+            AutoMutex _l(mLock);
+            mConnectedUrl.clear();
+        }
         if (!strncasecmp(url, "file://", 7)) {
             mDataSource = new FileSource(url + 7);
         } else if (strncasecmp(url, "http://", 7)
                 && strncasecmp(url, "https://", 8)) {
             return ERROR_UNSUPPORTED;
         } else {
+            // a url fetched range after range gets the rest of the file requested
+            bool openEnded = contiguous || range_length < 0;
             KeyedVector<String8, String8> headers = mExtraHeaders;
             if (range_offset > 0 || range_length >= 0) {
                 headers.add(
@@ -103,7 +129,7 @@ ssize_t HTTPDownloader::fetchBlock(
                             AStringPrintf(
                                 "bytes=%lld-%s",
                                 range_offset,
-                                range_length < 0
+                                openEnded
                                     ? "" : AStringPrintf("%lld",
                                             range_offset + range_length - 1).c_str()).c_str()));
             }
@@ -119,17 +145,39 @@ ssize_t HTTPDownloader::fetchBlock(
             }
 
             mDataSource = mHTTPDataSource;
+
+            AutoMutex _l(mLock);
+            mConnectedUrl = url;
+            mConnectedOffset = range_offset;
+            mConnectedEnd = range_offset;
+            mOpenEnded = openEnded;
         }
     }
 
+    // where the requested range starts in the response
+    int64_t responseOffset = 0;
+    if (mDataSource == mHTTPDataSource) {
+        AutoMutex _l(mLock);
+        responseOffset = range_offset - mConnectedOffset;
+    }
+
     status_t getSizeErr = mDataSource->getSize(&size);
 
     if (isDisconnecting()) {
         return ERROR_NOT_CONNECTED;
     }
 
-    if (getSizeErr != OK) {
+    if (getSizeErr == OK) {
+        size -= responseOffset;
+    }
+    if (range_length >= 0 && (getSizeErr != OK || size > range_length)) {
+        // an open ended response is longer than the range
+        size = range_length;
+        getSizeErr = OK;
+    }
+    if (getSizeErr != OK || size < 0) {
         size = 65536;
+        getSizeErr = UNKNOWN_ERROR;
     }
 
     sp<ABuffer> buffer = *out != NULL ? *out : new ABuffer(size);
@@ -177,7 +225,7 @@ ssize_t HTTPDownloader::fetchBlock(
         // The DataSource is responsible for informing us of error (n < 0) or eof (n == 0)
         // to help us break out of the loop.
         ssize_t n = mDataSource->readAt(
-                buffer->size(), buffer->data() + buffer->size(),
+                responseOffset + buffer->size(), buffer->data() + buffer->size(),
                 maxBytesToRead);
 
         if (isDisconnecting()) {
@@ -185,6 +233,8 @@ ssize_t HTTPDownloader::fetchBlock(
         }
 
         if (n < 0) {
+            AutoMutex _l(mLock);
+            mConnectedUrl.clear();
             return n;
         }
 
@@ -196,6 +246,11 @@ ssize_t HTTPDownloader::fetchBlock(
         bytesRead += n;
     }
 
+    if (mDataSource == mHTTPDataSource) {
+        AutoMutex _l(mLock);
+        mConnectedEnd = range_offset + buffer->size();
+    }
+
     *out = buffer;
     if (actualUrl != NULL) {
         *actualUrl = mDataSource->getUri();
@@ -212,13 +267,18 @@ ssize_t HTTPDownloader::fetchFile(
     ssize_t err = fetchBlock(url, out, 0, -1, 0, actualUrl, true /* reconnect */);
 
     // close off the connection after use
+    {
+        AutoMutex _l(mLock);
+        mConnectedUrl.clear();
+    }
     mHTTPDataSource->disconnect();
 
     return err;
 }
 
 sp<M3UParser> HTTPDownloader::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previous) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -258,8 +318,8 @@ sp<M3UParser> HTTPDownloader::fetchPlaylist(
     }
 #endif
 
-    sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+    sp<M3UParser> playlist = new M3UParser(
+            actualUrl.string(), buffer->data(), buffer->size(), previous);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -19,6 +19,7 @@
 #define HTTP_DOWNLOADER_H_
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AString.h>
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
@@ -50,6 +51,11 @@ struct HTTPDownloader : public RefBase {
     //
     // For reused HTTP sources, the caller must download a file sequentially without
     // any overlaps or gaps to prevent reconnection.
+    //
+    // Even with |reconnect|, a range which continues the last one fetched from the
+    // same HTTP url is read from the open response rather than requested again:
+    // once a url is fetched in consecutive ranges, as byte range segments are, the
+    // rest of the file is requested at once and read range by range.
     ssize_t fetchBlock(
             const char *url,
             sp<ABuffer> *out,
@@ -66,9 +72,11 @@ struct HTTPDownloader : public RefBase {
             sp<ABuffer> *out,
             String8 *actualUrl = NULL);
 
-    // fetch a playlist file
+    // fetch a playlist file; |previous|, if given, is the last playlist
+    // fetched from |url| and lets the parser skip unchanged segments.
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previous = NULL);
 
 private:
     sp<HTTPBase> mHTTPDataSource;
@@ -78,6 +86,15 @@ private:
     Mutex mLock;
     bool mDisconnecting;
 
+    // The HTTP response mHTTPDataSource is reading, if mConnectedUrl is not empty.
+    // Protected by mLock, as disconnect() ends it.
+    AString mConnectedUrl;
+    int64_t mConnectedOffset;   // offset in the file the response starts at
+    int64_t mConnectedEnd;      // offset in the file following the last byte read
+    bool mOpenEnded;            // the response runs to the end of the file
+
+    bool continuesResponse(const char *url, int64_t range_offset, bool *contiguous);
+
     DISALLOW_EVIL_CONSTRUCTORS(HTTPDownloader);
 };
 
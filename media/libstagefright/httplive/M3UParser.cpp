@@ -21,6 +21,7 @@
 #include "M3UParser.h"
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaDefs.h>
@@ -30,6 +31,8 @@
 
 namespace android {
 
+static bool MakeURL(const char *baseURL, const char *url, AString *out);
+
 struct M3UParser::MediaGroup : public RefBase {
     enum Type {
         TYPE_AUDIO,
@@ -243,7 +246,8 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -255,8 +259,16 @@ M3UParser::M3UParser(
       mTargetDurationUs(-1ll),
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
-      mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+      mSelectedIndex(-1),
+      mHasGlobalTagsInSegments(false),
+      mReusedItemCount(0),
+      mCanBlockReload(false),
+      mPartHoldBackUs(-1ll),
+      mPartTargetDurationUs(-1ll) {
+    mText = new ABuffer(size);
+    memcpy(mText->data(), data, size);
+
+    mInitCheck = parse(previous);
 }
 
 M3UParser::~M3UParser() {
@@ -304,7 +316,7 @@ sp<AMessage> M3UParser::meta() {
 }
 
 size_t M3UParser::size() {
-    return mItems.size();
+    return mIsVariantPlaylist ? mItems.size() : mSegments.size();
 }
 
 bool M3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
@@ -316,21 +328,222 @@ bool M3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
         *meta = NULL;
     }
 
-    if (index >= mItems.size()) {
+    if (mIsVariantPlaylist) {
+        if (index >= mItems.size()) {
+            return false;
+        }
+
+        if (uri) {
+            *uri = mItems.itemAt(index).mURI;
+        }
+
+        if (meta) {
+            *meta = mItems.itemAt(index).mMeta;
+        }
+
+        return true;
+    }
+
+    if (index >= mSegments.size()) {
         return false;
     }
 
+    const Segment &segment = mSegments.itemAt(index);
+
     if (uri) {
-        *uri = mItems.itemAt(index).mURI;
+        AString relURI(
+                (const char *)mText->data() + segment.mURIOffset,
+                segment.mURILength);
+        CHECK(MakeURL(mBaseURI.c_str(), relURI.c_str(), uri));
     }
 
     if (meta) {
-        *meta = mItems.itemAt(index).mMeta;
+        *meta = segment.mCipherMeta != NULL
+                ? segment.mCipherMeta->dup() : new AMessage;
+
+        (*meta)->setInt64("durationUs", segment.mDurationUs);
+        (*meta)->setInt32("discontinuity-sequence", segment.mDiscontinuitySeq);
+        if (segment.mFlags & kFlagDiscontinuity) {
+            (*meta)->setInt32("discontinuity", true);
+        }
+        if (segment.mFlags & kFlagHasRange) {
+            (*meta)->setInt64("range-offset", segment.mRangeOffset);
+            (*meta)->setInt64("range-length", segment.mRangeLength);
+        }
     }
 
     return true;
 }
 
+int64_t M3UParser::getItemDurationUs(size_t index) const {
+    CHECK_LT(index, mSegments.size());
+    return mSegments.itemAt(index).mDurationUs;
+}
+
+int64_t M3UParser::getItemStartTimeUs(size_t index) const {
+    CHECK_LT(index, mSegments.size());
+    return mSegments.itemAt(index).mStartTimeUs;
+}
+
+int32_t M3UParser::getItemDiscontinuitySeq(size_t index) const {
+    CHECK_LT(index, mSegments.size());
+    return mSegments.itemAt(index).mDiscontinuitySeq;
+}
+
+sp<AMessage> M3UParser::getItemCipherMeta(size_t index) const {
+    CHECK_LT(index, mSegments.size());
+    return mSegments.itemAt(index).mCipherMeta;
+}
+
+bool M3UParser::getItemInitSegment(
+        size_t index, AString *uri,
+        int64_t *rangeOffset, int64_t *rangeLength) const {
+    CHECK_LT(index, mSegments.size());
+
+    // an EXT-X-MAP applies to all segments following it
+    for (ssize_t i = index; i >= 0; --i) {
+        const sp<AMessage> &meta = mSegments.itemAt(i).mMapMeta;
+        if (meta == NULL) {
+            continue;
+        }
+
+        CHECK(meta->findString("uri", uri));
+        if (!meta->findInt64("range-offset", rangeOffset)
+                || !meta->findInt64("range-length", rangeLength)) {
+            *rangeOffset = 0;
+            *rangeLength = -1;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+size_t M3UParser::getItemIndexForTime(int64_t timeUs) const {
+    // first segment ending after timeUs
+    size_t lo = 0;
+    size_t hi = mSegments.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const Segment &segment = mSegments.itemAt(mid);
+        if (timeUs < segment.mStartTimeUs + segment.mDurationUs) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    if (lo >= mSegments.size()) {
+        lo = mSegments.size() - 1;
+    }
+
+    return lo;
+}
+
+int64_t M3UParser::getDurationUs() const {
+    if (mSegments.isEmpty()) {
+        return 0ll;
+    }
+
+    const Segment &last = mSegments.itemAt(mSegments.size() - 1);
+    return last.mStartTimeUs + last.mDurationUs;
+}
+
+size_t M3UParser::getReusedItemCount() const {
+    return mReusedItemCount;
+}
+
+bool M3UParser::hasParts() const {
+    return !mParts.isEmpty();
+}
+
+bool M3UParser::canBlockReload() const {
+    return mCanBlockReload;
+}
+
+int64_t M3UParser::getPartTargetDuration() const {
+    if (mPartTargetDurationUs > 0) {
+        return mPartTargetDurationUs;
+    }
+    // EXT-X-PART-INF is missing or bogus
+    return mTargetDurationUs;
+}
+
+int64_t M3UParser::getPartHoldBackUs() const {
+    if (mPartHoldBackUs >= 0) {
+        return mPartHoldBackUs;
+    }
+    return getPartTargetDuration() * 3;
+}
+
+size_t M3UParser::getPartCount() const {
+    return mParts.size();
+}
+
+bool M3UParser::partAt(
+        size_t index, int32_t *seqNumber, int32_t *partIndex,
+        AString *uri, sp<AMessage> *meta) const {
+    if (index >= mParts.size()) {
+        return false;
+    }
+
+    const Part &part = mParts.itemAt(index);
+
+    if (seqNumber) {
+        *seqNumber = part.mSeqNumber;
+    }
+    if (partIndex) {
+        *partIndex = part.mPartIndex;
+    }
+    if (uri) {
+        *uri = part.mURI;
+    }
+    if (meta) {
+        *meta = new AMessage;
+        (*meta)->setInt64("durationUs", part.mDurationUs);
+        (*meta)->setInt32("independent", part.mIndependent);
+        if (part.mRangeLength >= 0) {
+            (*meta)->setInt64("range-offset", part.mRangeOffset);
+            (*meta)->setInt64("range-length", part.mRangeLength);
+        }
+    }
+
+    return true;
+}
+
+ssize_t M3UParser::findPart(int32_t seqNumber, int32_t partIndex) const {
+    for (size_t i = mParts.size(); i > 0; --i) {
+        const Part &part = mParts.itemAt(i - 1);
+        if (part.mSeqNumber == seqNumber && part.mPartIndex == partIndex) {
+            return i - 1;
+        }
+        if (part.mSeqNumber < seqNumber) {
+            break;
+        }
+    }
+    return -1;
+}
+
+bool M3UParser::getPreloadHint(
+        int32_t *seqNumber, int32_t *partIndex, AString *uri) const {
+    if (mPreloadHintURI.empty() || mParts.isEmpty()) {
+        return false;
+    }
+
+    const Part &last = mParts.itemAt(mParts.size() - 1);
+    if (last.mSeqNumber <= mLastSeqNumber) {
+        // the last part completed its segment, the hint starts the next one
+        *seqNumber = mLastSeqNumber + 1;
+        *partIndex = 0;
+    } else {
+        *seqNumber = last.mSeqNumber;
+        *partIndex = last.mPartIndex + 1;
+    }
+    *uri = mPreloadHintURI;
+
+    return true;
+}
+
 void M3UParser::pickRandomMediaItems() {
     for (size_t i = 0; i < mMediaGroups.size(); ++i) {
         mMediaGroups.valueAt(i)->pickRandomMediaItems();
@@ -544,12 +757,107 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+void M3UParser::appendSegment(Segment *segment) {
+    segment->mStartTimeUs = 0ll;
+    if (!mSegments.isEmpty()) {
+        const Segment &last = mSegments.itemAt(mSegments.size() - 1);
+        segment->mStartTimeUs = last.mStartTimeUs + last.mDurationUs;
+    }
+
+    mSegments.push_back(*segment);
+}
+
+// Takes over the segments of |previous| starting at the current media
+// sequence number, provided that their text appears verbatim at |offset|.
+// A fresh parse would produce the same segments, save for the start times
+// and discontinuity sequence numbers which are rebased here.
+bool M3UParser::reuseSegments(
+        const sp<M3UParser> &previous, size_t offset,
+        uint64_t *segmentRangeOffset, size_t *parsedSize) {
+    if (previous->mInitCheck != OK
+            || previous->mIsVariantPlaylist
+            || previous->mHasGlobalTagsInSegments
+            || previous->mSegments.isEmpty()
+            || !previous->mParts.isEmpty()
+            || previous->mBaseURI != mBaseURI) {
+        return false;
+    }
+
+    int32_t firstSeqNumber = 0;
+    if (mMeta != NULL) {
+        mMeta->findInt32("media-sequence", &firstSeqNumber);
+    }
+
+    if (firstSeqNumber < previous->mFirstSeqNumber
+            || firstSeqNumber > previous->mLastSeqNumber) {
+        return false;
+    }
+
+    size_t firstIndex = firstSeqNumber - previous->mFirstSeqNumber;
+    const Segment &first = previous->mSegments.itemAt(firstIndex);
+    const Segment &last =
+        previous->mSegments.itemAt(previous->mSegments.size() - 1);
+
+    if (firstIndex > 0 && (first.mFlags & kFlagImplicitRangeOffset)) {
+        // offset was relative to a segment that is no longer listed
+        return false;
+    }
+
+    size_t length = last.mTextEnd - first.mTextOffset;
+    if (offset + length > mText->size()
+            || memcmp(mText->data() + offset,
+                      previous->mText->data() + first.mTextOffset,
+                      length)) {
+        return false;
+    }
+
+    int32_t discontinuityBase = first.mDiscontinuitySeq
+            - ((first.mFlags & kFlagDiscontinuity) ? 1 : 0);
+    int32_t discontinuitySeq = mDiscontinuitySeq + mDiscontinuityCount;
+    int64_t textDelta = (int64_t)offset - first.mTextOffset;
+
+    mSegments.setCapacity(previous->mSegments.size() - firstIndex);
+    for (size_t i = firstIndex; i < previous->mSegments.size(); ++i) {
+        Segment segment = previous->mSegments.itemAt(i);
+
+        segment.mStartTimeUs -= first.mStartTimeUs;
+        segment.mDiscontinuitySeq += discontinuitySeq - discontinuityBase;
+        segment.mTextOffset += textDelta;
+        segment.mTextEnd += textDelta;
+        segment.mURIOffset += textDelta;
+
+        mSegments.push_back(segment);
+    }
+
+    mDiscontinuityCount += last.mDiscontinuitySeq - discontinuityBase;
+    *segmentRangeOffset = (last.mFlags & kFlagHasRange)
+            ? last.mRangeOffset + last.mRangeLength : 0;
+    *parsedSize = length;
+    mReusedItemCount = mSegments.size();
+
+    ALOGV("reused %zu segments (%zu bytes) from previous playlist",
+            mReusedItemCount, length);
+
+    return true;
+}
+
+status_t M3UParser::parse(const sp<M3UParser> &previous) {
     int32_t lineNo = 0;
 
+    // meta of the next variant playlist entry
     sp<AMessage> itemMeta;
 
-    const char *data = (const char *)_data;
+    // next media segment; its text starts right after the previous URI line
+    Segment segment = Segment();
+    bool segmentHasDuration = false;
+    bool segmentStarted = false;
+    size_t segmentTextOffset = 0;
+    bool sawGlobalTag = false;
+
+    bool tryReuse = (previous != NULL);
+
+    const char *data = (const char *)mText->data();
+    size_t size = mText->size();
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
     while (offset < size) {
@@ -576,42 +884,116 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             mIsExtM3U = true;
         }
 
+        // Once the media sequence number is known (or the segments start
+        // without one), see if the segment list is a continuation of the
+        // previous one.
+        if (tryReuse && mIsExtM3U && !mIsVariantPlaylist
+                && mSegments.isEmpty() && !segmentStarted) {
+            int32_t seq;
+            bool segmentLine = !line.startsWith("#")
+                    || line.startsWith("#EXTINF")
+                    || line.startsWith("#EXT-X-KEY")
+                    || line.startsWith("#EXT-X-MAP")
+                    || line.startsWith("#EXT-X-BYTERANGE")
+                    || (line.startsWith("#EXT-X-DISCONTINUITY")
+                            && !line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE"))
+                    || line.startsWith("#EXT-X-PROGRAM-DATE-TIME");
+            if (segmentLine
+                    || (mMeta != NULL && mMeta->findInt32("media-sequence", &seq))) {
+                size_t parsedSize;
+                if (reuseSegments(
+                        previous, offset, &segmentRangeOffset, &parsedSize)) {
+                    tryReuse = false;
+                    offset += parsedSize;
+                    segmentTextOffset = offset;
+                    ++lineNo;
+                    continue;
+                }
+                if (segmentLine) {
+                    tryReuse = false;
+                }
+            }
+        }
+
+        if (mSegments.isEmpty() && !segmentStarted) {
+            // the first segment's text starts with its first tag
+            segmentTextOffset = offset;
+        }
+
         if (mIsExtM3U) {
             status_t err = OK;
+            bool globalTag = false;
 
             if (line.startsWith("#EXT-X-TARGETDURATION")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
                 err = parseMetaData(line, &mMeta, "target-duration");
+                globalTag = true;
             } else if (line.startsWith("#EXT-X-MEDIA-SEQUENCE")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
                 err = parseMetaData(line, &mMeta, "media-sequence");
+                globalTag = true;
             } else if (line.startsWith("#EXT-X-KEY")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
-                err = parseCipherInfo(line, &itemMeta, mBaseURI);
+                err = parseCipherInfo(line, &segment.mCipherMeta, mBaseURI);
+                segmentStarted = true;
+            } else if (line.startsWith("#EXT-X-MAP")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = parseMap(line, &segment.mMapMeta);
+                segmentStarted = true;
             } else if (line.startsWith("#EXT-X-ENDLIST")) {
                 mIsComplete = true;
+                globalTag = true;
             } else if (line.startsWith("#EXT-X-PLAYLIST-TYPE:EVENT")) {
                 mIsEvent = true;
+                globalTag = true;
             } else if (line.startsWith("#EXTINF")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
-                err = parseMetaDataDuration(line, &itemMeta, "durationUs");
-            } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
+                err = parseMetaDataDuration(line, &segment.mDurationUs);
+                segmentHasDuration = (err == OK);
+                segmentStarted = true;
+            } else if (line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
-                if (itemMeta == NULL) {
-                    itemMeta = new AMessage;
+                size_t seq;
+                err = parseDiscontinuitySequence(line, &seq);
+                if (err == OK) {
+                    mDiscontinuitySeq = seq;
                 }
-                itemMeta->setInt32("discontinuity", true);
+                globalTag = true;
+            } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                segment.mFlags |= kFlagDiscontinuity;
                 ++mDiscontinuityCount;
+                segmentStarted = true;
+            } else if (line.startsWith("#EXT-X-PROGRAM-DATE-TIME")) {
+                segmentStarted = true;
+            } else if (line.startsWith("#EXT-X-SERVER-CONTROL")) {
+                err = parseServerControl(line);
+                globalTag = true;
+            } else if (line.startsWith("#EXT-X-PART-INF")) {
+                err = parsePartInf(line);
+                globalTag = true;
+            } else if (line.startsWith("#EXT-X-PART")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = parsePart(line);
+                segmentStarted = true;
+            } else if (line.startsWith("#EXT-X-PRELOAD-HINT")) {
+                err = parsePreloadHint(line);
             } else if (line.startsWith("#EXT-X-STREAM-INF")) {
                 if (mMeta != NULL) {
                     return ERROR_MALFORMED;
@@ -627,52 +1009,63 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                 err = parseByteRange(line, segmentRangeOffset, &length, &offset);
 
                 if (err == OK) {
-                    if (itemMeta == NULL) {
-                        itemMeta = new AMessage;
+                    segment.mFlags |= kFlagHasRange;
+                    if (line.find("@") < 0) {
+                        segment.mFlags |= kFlagImplicitRangeOffset;
                     }
-
-                    itemMeta->setInt64("range-offset", offset);
-                    itemMeta->setInt64("range-length", length);
+                    segment.mRangeOffset = offset;
+                    segment.mRangeLength = length;
 
                     segmentRangeOffset = offset + length;
                 }
+                segmentStarted = true;
             } else if (line.startsWith("#EXT-X-MEDIA")) {
                 err = parseMedia(line);
-            } else if (line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                size_t seq;
-                err = parseDiscontinuitySequence(line, &seq);
-                if (err == OK) {
-                    mDiscontinuitySeq = seq;
-                }
+                globalTag = true;
             }
 
             if (err != OK) {
                 return err;
             }
+
+            if (globalTag && !mSegments.isEmpty()) {
+                sawGlobalTag = true;
+            }
         }
 
         if (!line.startsWith("#")) {
             if (!mIsVariantPlaylist) {
-                int64_t durationUs;
-                if (itemMeta == NULL
-                        || !itemMeta->findInt64("durationUs", &durationUs)) {
+                if (!segmentHasDuration) {
                     return ERROR_MALFORMED;
                 }
-                itemMeta->setInt32("discontinuity-sequence",
-                        mDiscontinuitySeq + mDiscontinuityCount);
-            }
 
-            mItems.push();
-            Item *item = &mItems.editItemAt(mItems.size() - 1);
+                if (sawGlobalTag) {
+                    mHasGlobalTagsInSegments = true;
+                }
+
+                segment.mDiscontinuitySeq =
+                        mDiscontinuitySeq + mDiscontinuityCount;
+                segment.mTextOffset = segmentTextOffset;
+                segment.mTextEnd = offsetLF < size ? offsetLF + 1 : size;
+                segment.mURIOffset = offset;
+                segment.mURILength = line.size();
+
+                appendSegment(&segment);
 
-            CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
+                segmentTextOffset = segment.mTextEnd;
+                segment = Segment();
+                segmentHasDuration = false;
+                segmentStarted = false;
+            } else {
+                mItems.push();
+                Item *item = &mItems.editItemAt(mItems.size() - 1);
 
-            item->mMeta = itemMeta;
+                CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
 
-            itemMeta.clear();
+                item->mMeta = itemMeta;
+
+                itemMeta.clear();
+            }
         }
 
         offset = offsetLF + 1;
@@ -695,7 +1088,11 @@ status_t M3UParser::parse(const void *_data, size_t size) {
         if (mMeta != NULL) {
             mMeta->findInt32("media-sequence", &mFirstSeqNumber);
         }
-        mLastSeqNumber = mFirstSeqNumber + mItems.size() - 1;
+        mLastSeqNumber = mFirstSeqNumber + mSegments.size() - 1;
+
+        for (size_t i = 0; i < mParts.size(); ++i) {
+            mParts.editItemAt(i).mSeqNumber += mFirstSeqNumber;
+        }
     }
 
     return OK;
@@ -727,7 +1124,7 @@ status_t M3UParser::parseMetaData(
 
 // static
 status_t M3UParser::parseMetaDataDuration(
-        const AString &line, sp<AMessage> *meta, const char *key) {
+        const AString &line, int64_t *durationUs) {
     ssize_t colonPos = line.find(":");
 
     if (colonPos < 0) {
@@ -741,10 +1138,7 @@ status_t M3UParser::parseMetaDataDuration(
         return err;
     }
 
-    if (meta->get() == NULL) {
-        *meta = new AMessage;
-    }
-    (*meta)->setInt64(key, (int64_t)(x * 1E6));
+    *durationUs = (int64_t)(x * 1E6);
 
     return OK;
 }
@@ -1266,6 +1660,225 @@ status_t M3UParser::parseDiscontinuitySequence(const AString &line, size_t *seq)
     return OK;
 }
 
+// static
+status_t M3UParser::parseAttributeList(
+        const AString &line, KeyedVector<AString, AString> *attrs) {
+    ssize_t colonPos = line.find(":");
+
+    if (colonPos < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    size_t offset = colonPos + 1;
+
+    while (offset < line.size()) {
+        ssize_t end = FindNextUnquoted(line, ',', offset);
+        if (end < 0) {
+            end = line.size();
+        }
+
+        AString attr(line, offset, end - offset);
+        attr.trim();
+
+        offset = end + 1;
+
+        ssize_t equalPos = attr.find("=");
+        if (equalPos < 0) {
+            continue;
+        }
+
+        AString key(attr, 0, equalPos);
+        key.trim();
+        key.tolower();
+
+        AString val(attr, equalPos + 1, attr.size() - equalPos - 1);
+        val.trim();
+
+        if (isQuotedString(val)) {
+            val = unquoteString(val);
+        }
+
+        attrs->add(key, val);
+    }
+
+    return OK;
+}
+
+status_t M3UParser::parseServerControl(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t index = attrs.indexOfKey(AString("can-block-reload"));
+    mCanBlockReload = (index >= 0 && attrs.valueAt(index) == "YES");
+
+    index = attrs.indexOfKey(AString("part-hold-back"));
+    if (index >= 0) {
+        double x;
+        err = ParseDouble(attrs.valueAt(index).c_str(), &x);
+        if (err != OK) {
+            return err;
+        }
+        mPartHoldBackUs = (int64_t)(x * 1E6);
+    }
+
+    return OK;
+}
+
+status_t M3UParser::parsePartInf(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t index = attrs.indexOfKey(AString("part-target"));
+    if (index < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    double x;
+    err = ParseDouble(attrs.valueAt(index).c_str(), &x);
+    if (err != OK) {
+        return err;
+    }
+    mPartTargetDurationUs = (int64_t)(x * 1E6);
+
+    return OK;
+}
+
+status_t M3UParser::parsePart(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t uriIndex = attrs.indexOfKey(AString("uri"));
+    ssize_t durationIndex = attrs.indexOfKey(AString("duration"));
+    if (uriIndex < 0 || durationIndex < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    Part part;
+    part.mSeqNumber = mSegments.size();
+    part.mPartIndex = 0;
+    part.mRangeOffset = 0;
+    part.mRangeLength = -1;
+
+    if (!mParts.isEmpty()) {
+        const Part &prev = mParts.itemAt(mParts.size() - 1);
+        if (prev.mSeqNumber == part.mSeqNumber) {
+            part.mPartIndex = prev.mPartIndex + 1;
+        }
+    }
+
+    double x;
+    err = ParseDouble(attrs.valueAt(durationIndex).c_str(), &x);
+    if (err != OK) {
+        return err;
+    }
+    part.mDurationUs = (int64_t)(x * 1E6);
+
+    ssize_t index = attrs.indexOfKey(AString("independent"));
+    part.mIndependent = (index >= 0 && attrs.valueAt(index) == "YES");
+
+    if (!MakeURL(mBaseURI.c_str(), attrs.valueAt(uriIndex).c_str(), &part.mURI)) {
+        return ERROR_MALFORMED;
+    }
+
+    index = attrs.indexOfKey(AString("byterange"));
+    if (index >= 0) {
+        // an implicit offset continues from the previous part of the
+        // same resource
+        uint64_t curOffset = 0;
+        if (!mParts.isEmpty()) {
+            const Part &prev = mParts.itemAt(mParts.size() - 1);
+            if (prev.mURI == part.mURI && prev.mRangeLength >= 0) {
+                curOffset = prev.mRangeOffset + prev.mRangeLength;
+            }
+        }
+
+        AString range("BYTERANGE:");
+        range.append(attrs.valueAt(index));
+
+        uint64_t length, offset;
+        err = parseByteRange(range, curOffset, &length, &offset);
+        if (err != OK) {
+            return err;
+        }
+        part.mRangeOffset = offset;
+        part.mRangeLength = length;
+    }
+
+    mParts.push_back(part);
+
+    return OK;
+}
+
+status_t M3UParser::parseMap(const AString &line, sp<AMessage> *meta) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t uriIndex = attrs.indexOfKey(AString("uri"));
+    if (uriIndex < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    AString uri;
+    if (!MakeURL(mBaseURI.c_str(), attrs.valueAt(uriIndex).c_str(), &uri)) {
+        return ERROR_MALFORMED;
+    }
+
+    *meta = new AMessage;
+    (*meta)->setString("uri", uri);
+
+    ssize_t rangeIndex = attrs.indexOfKey(AString("byterange"));
+    if (rangeIndex >= 0) {
+        uint64_t length, offset;
+        AString range(":");
+        range.append(attrs.valueAt(rangeIndex));
+        err = parseByteRange(range, 0, &length, &offset);
+        if (err != OK) {
+            return err;
+        }
+        (*meta)->setInt64("range-offset", offset);
+        (*meta)->setInt64("range-length", length);
+    }
+
+    return OK;
+}
+
+status_t M3UParser::parsePreloadHint(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t typeIndex = attrs.indexOfKey(AString("type"));
+    ssize_t uriIndex = attrs.indexOfKey(AString("uri"));
+    if (typeIndex < 0 || uriIndex < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    if (attrs.valueAt(typeIndex) != "PART") {
+        // only part hints are used
+        return OK;
+    }
+
+    if (!MakeURL(mBaseURI.c_str(), attrs.valueAt(uriIndex).c_str(), &mPreloadHintURI)) {
+        return ERROR_MALFORMED;
+    }
+
+    return OK;
+}
+
 // static
 status_t M3UParser::ParseInt32(const char *s, int32_t *x) {
     char *end;
@@ -26,8 +26,14 @@
 
 namespace android {
 
+struct ABuffer;
+
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // If |previous| is a media playlist fetched earlier from the same URI,
+    // segments that are textually unchanged (matched by media sequence
+    // number) are taken over from it and only the remainder is parsed.
+    M3UParser(const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -45,6 +51,47 @@ struct M3UParser : public RefBase {
     size_t size();
     bool itemAt(size_t index, AString *uri, sp<AMessage> *meta = NULL);
 
+    // Cheaper per-segment accessors for media playlists that don't
+    // materialize the item's AMessage.
+    int64_t getItemDurationUs(size_t index) const;
+    // Sum of the durations of all segments before |index|.
+    int64_t getItemStartTimeUs(size_t index) const;
+    int32_t getItemDiscontinuitySeq(size_t index) const;
+    // EXT-X-KEY attributes ("cipher-*") of the segment, or NULL.
+    sp<AMessage> getItemCipherMeta(size_t index) const;
+    // Initialization section (EXT-X-MAP) in effect for the segment, if any.
+    // |rangeLength| is -1 if the whole resource is used.
+    bool getItemInitSegment(
+            size_t index, AString *uri,
+            int64_t *rangeOffset, int64_t *rangeLength) const;
+    // Index of the segment containing |timeUs|, clamped to the last one.
+    size_t getItemIndexForTime(int64_t timeUs) const;
+    int64_t getDurationUs() const;
+
+    // Number of segments taken over from the previous playlist.
+    size_t getReusedItemCount() const;
+
+    // Low-latency HLS (EXT-X-PART, EXT-X-PRELOAD-HINT, EXT-X-SERVER-CONTROL).
+    bool hasParts() const;
+    bool canBlockReload() const;
+    // PART-TARGET, or the target duration without a valid EXT-X-PART-INF.
+    int64_t getPartTargetDuration() const;
+    // Suggested distance from the live edge, PART-HOLD-BACK or 3 part
+    // target durations if not given.
+    int64_t getPartHoldBackUs() const;
+
+    size_t getPartCount() const;
+    // Parts are listed in playback order. |seqNumber| is the media sequence
+    // number of the parent segment, which may not be listed yet if it is
+    // still being produced. |meta| receives "durationUs", "independent" and
+    // "range-offset"/"range-length" if applicable.
+    bool partAt(size_t index, int32_t *seqNumber, int32_t *partIndex,
+            AString *uri, sp<AMessage> *meta = NULL) const;
+    ssize_t findPart(int32_t seqNumber, int32_t partIndex) const;
+    // The hinted resource is the part following the last listed one.
+    bool getPreloadHint(
+            int32_t *seqNumber, int32_t *partIndex, AString *uri) const;
+
     void pickRandomMediaItems();
     status_t selectTrack(size_t index, bool select);
     size_t getTrackCount() const;
@@ -61,11 +108,48 @@ protected:
 private:
     struct MediaGroup;
 
+    // Variant playlist entry.
     struct Item {
         AString mURI;
         sp<AMessage> mMeta;
     };
 
+    enum SegmentFlags {
+        kFlagDiscontinuity          = 1,
+        kFlagHasRange               = 2,
+        kFlagImplicitRangeOffset    = 4,
+    };
+
+    // Media playlist entry. URIs are kept as ranges of mText and only
+    // resolved against mBaseURI when requested.
+    struct Segment {
+        int64_t mStartTimeUs;
+        int64_t mDurationUs;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;
+        int32_t mDiscontinuitySeq;
+        uint32_t mFlags;
+        // [mTextOffset, mTextEnd) spans the segment's tags and URI line.
+        uint32_t mTextOffset;
+        uint32_t mTextEnd;
+        uint32_t mURIOffset;
+        uint32_t mURILength;
+        sp<AMessage> mCipherMeta;
+        sp<AMessage> mMapMeta;
+    };
+
+    struct Part {
+        // index of the parent segment within mSegments at parse time,
+        // converted to a media sequence number once that is known.
+        int32_t mSeqNumber;
+        int32_t mPartIndex;
+        int64_t mDurationUs;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;
+        bool mIndependent;
+        AString mURI;
+    };
+
     status_t mInitCheck;
 
     AString mBaseURI;
@@ -81,18 +165,37 @@ private:
 
     sp<AMessage> mMeta;
     Vector<Item> mItems;
+    Vector<Segment> mSegments;
     ssize_t mSelectedIndex;
 
+    // Copy of the playlist text, referenced by mSegments.
+    sp<ABuffer> mText;
+    // Set if a tag affecting the whole playlist appeared after the first
+    // segment, which makes the segment text unsafe to reuse.
+    bool mHasGlobalTagsInSegments;
+    size_t mReusedItemCount;
+
+    Vector<Part> mParts;
+    bool mCanBlockReload;
+    int64_t mPartHoldBackUs;
+    int64_t mPartTargetDurationUs;
+    AString mPreloadHintURI;
+
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(const sp<M3UParser> &previous);
+
+    bool reuseSegments(
+            const sp<M3UParser> &previous, size_t offset,
+            uint64_t *segmentRangeOffset, size_t *parsedSize);
+    void appendSegment(Segment *segment);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
 
     static status_t parseMetaDataDuration(
-            const AString &line, sp<AMessage> *meta, const char *key);
+            const AString &line, int64_t *durationUs);
 
     status_t parseStreamInf(
             const AString &line, sp<AMessage> *meta) const;
@@ -108,6 +211,14 @@ private:
 
     static status_t parseDiscontinuitySequence(const AString &line, size_t *seq);
 
+    static status_t parseAttributeList(
+            const AString &line, KeyedVector<AString, AString> *attrs);
+    status_t parseServerControl(const AString &line);
+    status_t parsePartInf(const AString &line);
+    status_t parsePart(const AString &line);
+    status_t parsePreloadHint(const AString &line);
+    status_t parseMap(const AString &line, sp<AMessage> *meta);
+
     static status_t ParseInt32(const char *s, int32_t *x);
     static status_t ParseDouble(const char *s, double *x);
 
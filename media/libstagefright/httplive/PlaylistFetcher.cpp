@@ -23,7 +23,9 @@
 #include "HTTPDownloader.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 #include "include/avc_utils.h"
+#include "include/FragmentedMP4Parser.h"
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 
@@ -34,6 +36,7 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 
+#include <cutils/properties.h>
 #include <ctype.h>
 #include <inttypes.h>
 #include <openssl/aes.h>
@@ -49,6 +52,12 @@ const int64_t PlaylistFetcher::kMinBufferedDurationUs = 30000000ll;
 const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t PlaylistFetcher::kDownloadBlockSize = 47 * 1024;
+// upper bound for media.httplive.prefetch-segments
+const int32_t PlaylistFetcher::kMaxPrefetchSegments = 3;
+// parts are handed to the parser in small blocks as they arrive
+const int32_t PlaylistFetcher::kLowLatencyDownloadBlockSize = 188 * 16;
+// shortest wait for a part to be published
+const int64_t PlaylistFetcher::kMinPartRetryDelayUs = 10000ll;
 
 struct PlaylistFetcher::DownloadState : public RefBase {
     DownloadState();
@@ -59,6 +68,7 @@ struct PlaylistFetcher::DownloadState : public RefBase {
             sp<AMessage> &itemMeta,
             sp<ABuffer> &buffer,
             sp<ABuffer> &tsBuffer,
+            sp<ABuffer> &prefetchedBuffer,
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
     void saveState(
@@ -66,6 +76,7 @@ struct PlaylistFetcher::DownloadState : public RefBase {
             sp<AMessage> &itemMeta,
             sp<ABuffer> &buffer,
             sp<ABuffer> &tsBuffer,
+            sp<ABuffer> &prefetchedBuffer,
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
 
@@ -75,6 +86,7 @@ private:
     sp<AMessage> mItemMeta;
     sp<ABuffer> mBuffer;
     sp<ABuffer> mTsBuffer;
+    sp<ABuffer> mPrefetchedBuffer;
     int32_t mFirstSeqNumberInPlaylist;
     int32_t mLastSeqNumberInPlaylist;
 };
@@ -94,6 +106,7 @@ void PlaylistFetcher::DownloadState::resetState() {
     mItemMeta = NULL;
     mBuffer = NULL;
     mTsBuffer = NULL;
+    mPrefetchedBuffer = NULL;
     mFirstSeqNumberInPlaylist = 0;
     mLastSeqNumberInPlaylist = 0;
 }
@@ -103,6 +116,7 @@ void PlaylistFetcher::DownloadState::restoreState(
         sp<AMessage> &itemMeta,
         sp<ABuffer> &buffer,
         sp<ABuffer> &tsBuffer,
+        sp<ABuffer> &prefetchedBuffer,
         int32_t &firstSeqNumberInPlaylist,
         int32_t &lastSeqNumberInPlaylist) {
     if (!mHasSavedState) {
@@ -113,6 +127,7 @@ void PlaylistFetcher::DownloadState::restoreState(
     itemMeta = mItemMeta;
     buffer = mBuffer;
     tsBuffer = mTsBuffer;
+    prefetchedBuffer = mPrefetchedBuffer;
     firstSeqNumberInPlaylist = mFirstSeqNumberInPlaylist;
     lastSeqNumberInPlaylist = mLastSeqNumberInPlaylist;
 
@@ -124,6 +139,7 @@ void PlaylistFetcher::DownloadState::saveState(
         sp<AMessage> &itemMeta,
         sp<ABuffer> &buffer,
         sp<ABuffer> &tsBuffer,
+        sp<ABuffer> &prefetchedBuffer,
         int32_t &firstSeqNumberInPlaylist,
         int32_t &lastSeqNumberInPlaylist) {
     mHasSavedState = true;
@@ -132,6 +148,7 @@ void PlaylistFetcher::DownloadState::saveState(
     mItemMeta = itemMeta;
     mBuffer = buffer;
     mTsBuffer = tsBuffer;
+    mPrefetchedBuffer = prefetchedBuffer;
     mFirstSeqNumberInPlaylist = firstSeqNumberInPlaylist;
     mLastSeqNumberInPlaylist = lastSeqNumberInPlaylist;
 }
@@ -144,6 +161,10 @@ PlaylistFetcher::PlaylistFetcher(
         int32_t subtitleGeneration)
     : mNotify(notify),
       mSession(session),
+      mNumPrefetchSegments(1),
+      mNumPrefetchHits(0),
+      mNumPrefetchMisses(0),
+      mStartRequestTimeUs(-1ll),
       mURI(uri),
       mFetcherID(id),
       mStreamTypeMask(0),
@@ -154,6 +175,8 @@ PlaylistFetcher::PlaylistFetcher(
       mLastPlaylistFetchTimeUs(-1ll),
       mPlaylistTimeUs(-1ll),
       mSeqNumber(-1),
+      mLowLatency(false),
+      mPartIndex(-1),
       mNumRetries(0),
       mStartup(true),
       mIDRFound(false),
@@ -164,6 +187,7 @@ PlaylistFetcher::PlaylistFetcher(
       mSubtitleGeneration(subtitleGeneration),
       mLastDiscontinuitySeq(-1ll),
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
+      mInitSegmentRangeOffset(0),
       mFirstPTSValid(false),
       mFirstTimeUs(-1ll),
       mVideoBuffer(new AnotherPacketSource(NULL)),
@@ -172,9 +196,39 @@ PlaylistFetcher::PlaylistFetcher(
       mHasMetadata(false) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mHTTPDownloader = mSession->getHTTPDownloader();
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-segments", value, NULL)) {
+        char *end;
+        long n = strtol(value, &end, 10);
+        if (end > value && *end == '\0' && n >= 0) {
+            mNumPrefetchSegments =
+                    n > kMaxPrefetchSegments ? kMaxPrefetchSegments : n;
+        }
+    }
+
+    if (property_get("media.httplive.low-latency", value, NULL)) {
+        mLowLatency = !strcmp(value, "1") || !strcasecmp(value, "true");
+    }
+
+    if (mNumPrefetchSegments > 0) {
+        mPrefetchLooper = new ALooper();
+        mPrefetchLooper->setName("FetcherPrefetch");
+        mPrefetchLooper->start(false, false);
+
+        mPrefetcher = new SegmentPrefetcher(
+                mSession->getHTTPDownloader(), mNumPrefetchSegments);
+        mPrefetchLooper->registerHandler(mPrefetcher);
+    }
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    if (mPrefetcher != NULL) {
+        // abort any in-flight download so that stopping the looper won't block
+        mPrefetcher->cancel();
+        mPrefetchLooper->unregisterHandler(mPrefetcher->id());
+        mPrefetchLooper->stop();
+    }
 }
 
 int32_t PlaylistFetcher::getFetcherID() const {
@@ -189,22 +243,15 @@ int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
             &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
 
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
-    CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int64_t segmentStartUs = 0ll;
-    for (int32_t index = 0;
-            index < seqNumber - firstSeqNumberInPlaylist; ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        segmentStartUs += itemDurationUs;
+    if (seqNumber == lastSeqNumberInPlaylist + 1 && mPlaylist->hasParts()) {
+        // segment still being produced, only its parts are listed
+        return mPlaylist->getDurationUs();
     }
 
-    return segmentStartUs;
+    CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
+
+    return mPlaylist->getItemStartTimeUs(seqNumber - firstSeqNumberInPlaylist);
 }
 
 int64_t PlaylistFetcher::getSegmentDurationUs(int32_t seqNumber) const {
@@ -215,17 +262,14 @@ int64_t PlaylistFetcher::getSegmentDurationUs(int32_t seqNumber) const {
             &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
 
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
-    CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int32_t index = seqNumber - firstSeqNumberInPlaylist;
-    sp<AMessage> itemMeta;
-    CHECK(mPlaylist->itemAt(
-                index, NULL /* uri */, &itemMeta));
+    if (seqNumber == lastSeqNumberInPlaylist + 1 && mPlaylist->hasParts()) {
+        return mPlaylist->getTargetDuration();
+    }
 
-    int64_t itemDurationUs;
-    CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+    CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    return itemDurationUs;
+    return mPlaylist->getItemDurationUs(seqNumber - firstSeqNumberInPlaylist);
 }
 
 int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
@@ -249,13 +293,7 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
         {
             size_t n = mPlaylist->size();
             if (n > 0) {
-                sp<AMessage> itemMeta;
-                CHECK(mPlaylist->itemAt(n - 1, NULL /* uri */, &itemMeta));
-
-                int64_t itemDurationUs;
-                CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-                minPlaylistAgeUs = itemDurationUs;
+                minPlaylistAgeUs = mPlaylist->getItemDurationUs(n - 1);
                 break;
             }
 
@@ -296,11 +334,15 @@ status_t PlaylistFetcher::decryptBuffer(
     bool found = false;
     AString method;
 
+    // parts of a segment that isn't listed yet are past the last item
+    ssize_t lastIndex = (ssize_t)mPlaylist->size() - 1;
+    if ((ssize_t)playlistIndex > lastIndex) {
+        playlistIndex = lastIndex;
+    }
     for (ssize_t i = playlistIndex; i >= 0; --i) {
-        AString uri;
-        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
+        itemMeta = mPlaylist->getItemCipherMeta(i);
 
-        if (itemMeta->findString("cipher-method", &method)) {
+        if (itemMeta != NULL && itemMeta->findString("cipher-method", &method)) {
             found = true;
             break;
         }
@@ -449,6 +491,7 @@ void PlaylistFetcher::setStoppingThreshold(float thresholdRatio, bool disconnect
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        cancelPrefetch();
     }
 }
 
@@ -459,6 +502,7 @@ void PlaylistFetcher::resetStoppingThreshold(bool disconnect) {
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        cancelPrefetch();
     } else {
         // allow reconnect
         mHTTPDownloader->reconnect();
@@ -701,10 +745,14 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mStartTimeUs = startTimeUs;
         mFirstPTSValid = false;
         mSeqNumber = -1;
+        mPartIndex = -1;
         mTimeChangeSignaled = false;
         mDownloadState->resetState();
+        cancelPrefetch();
     }
 
+    mStartRequestTimeUs = ALooper::GetNowUs();
+
     postMonitorQueue();
 
     return OK;
@@ -847,11 +895,25 @@ void PlaylistFetcher::onMonitorQueue() {
     }
 }
 
-status_t PlaylistFetcher::refreshPlaylist() {
-    if (delayUsToRefreshPlaylist() <= 0) {
+status_t PlaylistFetcher::refreshPlaylist(
+        int32_t blockingSeqNumber, int32_t blockingPartIndex) {
+    bool blocking = blockingSeqNumber >= 0
+            && mPlaylist != NULL && mPlaylist->canBlockReload();
+
+    if (blocking || delayUsToRefreshPlaylist() <= 0) {
+        AString url = mURI;
+        if (blocking) {
+            // the server holds the request until the part is available
+            url.append(mURI.find("?") < 0 ? "?" : "&");
+            url.append(AStringPrintf("_HLS_msn=%d", blockingSeqNumber));
+            if (blockingPartIndex >= 0) {
+                url.append(AStringPrintf("&_HLS_part=%d", blockingPartIndex));
+            }
+        }
+
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                url.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -967,17 +1029,25 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
-    mSegmentFirstPTS = -1ll;
+    if (mPartIndex <= 0) {
+        // parts continue the segment started by part 0
+        mSegmentFirstPTS = -1ll;
+    }
 
     if (mPlaylist != NULL && mSeqNumber < 0) {
         CHECK_GE(mStartTimeUs, 0ll);
 
         if (mSegmentStartTimeUs < 0) {
             if (!mPlaylist->isComplete() && !mPlaylist->isEvent()) {
-                // If this is a live session, start 3 segments from the end on connect
-                mSeqNumber = lastSeqNumberInPlaylist - 3;
-                if (mSeqNumber < firstSeqNumberInPlaylist) {
-                    mSeqNumber = firstSeqNumberInPlaylist;
+                if (canUseParts()) {
+                    // start PART-HOLD-BACK behind the live edge
+                    selectLowLatencyStartPart();
+                } else {
+                    // If this is a live session, start 3 segments from the end on connect
+                    mSeqNumber = lastSeqNumberInPlaylist - 3;
+                    if (mSeqNumber < firstSeqNumberInPlaylist) {
+                        mSeqNumber = firstSeqNumberInPlaylist;
+                    }
                 }
             } else {
                 // When seeking mSegmentStartTimeUs is unavailable (< 0), we
@@ -1026,8 +1096,35 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
+    if (err == OK && mPlaylist != NULL && mPartIndex < 0
+            && mSeqNumber == lastSeqNumberInPlaylist + 1 && canUseParts()
+            && mPlaylist->findPart(mSeqNumber, 0) >= 0) {
+        // caught up with the live edge, continue with parts
+        FLOGV("switching to parts at segment %d", mSeqNumber);
+        mPartIndex = 0;
+    }
+
+    bool fetchingPart = false;
+    if (err == OK && mPlaylist != NULL && mPartIndex >= 0) {
+        int32_t res = initPartDownloadState(uri, itemMeta, lastSeqNumberInPlaylist);
+        if (res < 0) {
+            return false;
+        }
+        // otherwise we fell behind the parts window, fetch whole segments
+        fetchingPart = (res > 0);
+    }
+
     // if mPlaylist is NULL then err must be non-OK; but the other way around might not be true
-    if (mSeqNumber < firstSeqNumberInPlaylist
+    if (fetchingPart) {
+        // part located (and possibly the playlist reloaded) above
+        mPlaylist->getSeqNumberRange(
+                &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+        int32_t val;
+        if (mPartIndex == 0
+                && itemMeta->findInt32("discontinuity", &val) && val != 0) {
+            discontinuity = true;
+        }
+    } else if (mSeqNumber < firstSeqNumberInPlaylist
             || mSeqNumber > lastSeqNumberInPlaylist
             || err != OK) {
         if ((err != OK || !mPlaylist->isComplete()) && mNumRetries < kMaxNumRetries) {
@@ -1114,16 +1211,20 @@ bool PlaylistFetcher::initDownloadState(
 
     mNumRetries = 0;
 
-    CHECK(mPlaylist->itemAt(
-                mSeqNumber - firstSeqNumberInPlaylist,
-                &uri,
-                &itemMeta));
+    if (!fetchingPart) {
+        CHECK(mPlaylist->itemAt(
+                    mSeqNumber - firstSeqNumberInPlaylist,
+                    &uri,
+                    &itemMeta));
 
-    CHECK(itemMeta->findInt32("discontinuity-sequence", &mDiscontinuitySeq));
+        CHECK(itemMeta->findInt32("discontinuity-sequence", &mDiscontinuitySeq));
+    }
 
     int32_t val;
-    if (itemMeta->findInt32("discontinuity", &val) && val != 0) {
+    if (!fetchingPart && itemMeta->findInt32("discontinuity", &val) && val != 0) {
         discontinuity = true;
+    } else if (fetchingPart && mPartIndex > 0) {
+        // a discontinuity can only start with the first part of a segment
     } else if (mLastDiscontinuitySeq >= 0
             && mDiscontinuitySeq != mLastDiscontinuitySeq) {
         // Seek jumped to a new discontinuity sequence. We need to signal
@@ -1138,7 +1239,8 @@ bool PlaylistFetcher::initDownloadState(
 
     // decrypt a junk buffer to prefetch key; since a session uses only one http connection,
     // this avoids interleaved connections to the key and segment file.
-    {
+    // Parts are only used for clear streams.
+    if (!fetchingPart) {
         sp<ABuffer> junk = new ABuffer(16);
         junk->setRange(0, 16);
         status_t err = decryptBuffer(mSeqNumber - firstSeqNumberInPlaylist, junk,
@@ -1200,16 +1302,223 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
-    FLOGV("fetching segment %d from (%d .. %d)",
-            mSeqNumber, firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+    FLOGV("fetching segment %d part %d from (%d .. %d)",
+            mSeqNumber, mPartIndex, firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+    return true;
+}
+
+bool PlaylistFetcher::canUseParts() const {
+    if (!mLowLatency || mPlaylist == NULL || !mPlaylist->hasParts()
+            || mPlaylist->isComplete()
+            || mPlaylist->getPartTargetDuration() <= 0
+            || mStreamTypeMask == LiveSession::STREAMTYPE_SUBTITLES) {
+        return false;
+    }
+
+    // CBC state can't be carried across parts fetched as separate resources
+    for (size_t i = 0; i < mPlaylist->size(); ++i) {
+        if (mPlaylist->getItemCipherMeta(i) != NULL) {
+            return false;
+        }
+    }
+
     return true;
 }
 
+void PlaylistFetcher::selectLowLatencyStartPart() {
+    // Walk back from the newest part until PART-HOLD-BACK is covered, then
+    // back to the closest independent part so decoding can start there.
+    int64_t holdBackUs = mPlaylist->getPartHoldBackUs();
+    int64_t accumulatedUs = 0ll;
+    ssize_t index = mPlaylist->getPartCount() - 1;
+    while (index > 0 && accumulatedUs < holdBackUs) {
+        sp<AMessage> meta;
+        CHECK(mPlaylist->partAt(index, NULL, NULL, NULL, &meta));
+        int64_t durationUs;
+        CHECK(meta->findInt64("durationUs", &durationUs));
+        accumulatedUs += durationUs;
+        --index;
+    }
+
+    while (index > 0) {
+        sp<AMessage> meta;
+        CHECK(mPlaylist->partAt(index, NULL, NULL, NULL, &meta));
+        int32_t independent;
+        if (meta->findInt32("independent", &independent) && independent) {
+            break;
+        }
+        --index;
+    }
+
+    CHECK(mPlaylist->partAt(index, &mSeqNumber, &mPartIndex, NULL));
+
+    FLOGV("low-latency start at segment %d part %d (hold back %lld us)",
+            mSeqNumber, mPartIndex, (long long)holdBackUs);
+}
+
+int32_t PlaylistFetcher::initPartDownloadState(
+        AString &uri,
+        sp<AMessage> &itemMeta,
+        int32_t lastSeqNumberInPlaylist) {
+    for (;;) {
+        ssize_t index = mPlaylist->findPart(mSeqNumber, mPartIndex);
+        if (index >= 0) {
+            CHECK(mPlaylist->partAt(index, NULL, NULL, &uri, &itemMeta));
+            break;
+        }
+
+        if (mSeqNumber <= lastSeqNumberInPlaylist) {
+            if (mPartIndex > 0 && mPlaylist->findPart(mSeqNumber, 0) >= 0) {
+                // all parts of a now complete segment were fetched
+                ++mSeqNumber;
+                mPartIndex = 0;
+                continue;
+            }
+
+            // parts of this segment are gone from the playlist
+            mPartIndex = -1;
+            return 0;
+        }
+
+        int32_t hintSeqNumber, hintPartIndex;
+        if (mPlaylist->getPreloadHint(&hintSeqNumber, &hintPartIndex, &uri)
+                && hintSeqNumber == mSeqNumber && hintPartIndex == mPartIndex) {
+            // request the hinted part now, the server will deliver it as
+            // it is being produced
+            itemMeta = new AMessage;
+            itemMeta->setInt64("durationUs", mPlaylist->getPartTargetDuration());
+            break;
+        }
+
+        if (mNumRetries >= kMaxNumRetries) {
+            // The playlist may be stale: without blocking reloads it is only
+            // refreshed once per segment. Reload it in full now.
+            ALOGW("part %d of segment %d didn't show up, reloading playlist",
+                    mPartIndex, mSeqNumber);
+            mNumRetries = 0;
+            mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
+            mLastPlaylistFetchTimeUs = -1ll;
+            status_t err = refreshPlaylist();
+            if (err == OK) {
+                int32_t firstSeqNumberInPlaylist;
+                mPlaylist->getSeqNumberRange(
+                        &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+                if (mSeqNumber <= lastSeqNumberInPlaylist
+                        || mPlaylist->findPart(mSeqNumber, mPartIndex) >= 0) {
+                    continue;
+                }
+            }
+            if (mPartIndex == 0) {
+                // nothing of this segment was fetched yet, wait for it whole
+                mPartIndex = -1;
+                return 0;
+            }
+            // otherwise keep waiting for the rest of the segment part by part
+        }
+        ++mNumRetries;
+
+        if (mPlaylist->canBlockReload()) {
+            status_t err = refreshPlaylist(mSeqNumber, mPartIndex);
+            if (err == OK && mPlaylist->findPart(mSeqNumber, mPartIndex) >= 0) {
+                int32_t firstSeqNumberInPlaylist;
+                mPlaylist->getSeqNumberRange(
+                        &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+                continue;
+            }
+        }
+
+        // back off from half a part target duration, up to a target duration
+        int64_t delayUs = (mPlaylist->getPartTargetDuration() / 2) << (mNumRetries - 1);
+        if (delayUs > mPlaylist->getTargetDuration()) {
+            delayUs = mPlaylist->getTargetDuration();
+        }
+        if (delayUs < kMinPartRetryDelayUs) {
+            delayUs = kMinPartRetryDelayUs;
+        }
+        FLOGV("part %d of segment %d not available yet, retry in %lld us",
+                mPartIndex, mSeqNumber, (long long)delayUs);
+        postMonitorQueue(delayUs, delayUs);
+        return -1;
+    }
+
+    if (mPartIndex == 0) {
+        int32_t firstSeqNumberInPlaylist, lastSeqNumber;
+        mPlaylist->getSeqNumberRange(&firstSeqNumberInPlaylist, &lastSeqNumber);
+        if (mSeqNumber <= lastSeqNumber) {
+            size_t index = mSeqNumber - firstSeqNumberInPlaylist;
+            mDiscontinuitySeq = mPlaylist->getItemDiscontinuitySeq(index);
+            sp<AMessage> segmentMeta;
+            int32_t val;
+            if (mPlaylist->itemAt(index, NULL, &segmentMeta)
+                    && segmentMeta->findInt32("discontinuity", &val) && val != 0) {
+                itemMeta->setInt32("discontinuity", 1);
+            }
+        }
+    }
+
+    return 1;
+}
+
+void PlaylistFetcher::advancePart() {
+    int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
+    mPlaylist->getSeqNumberRange(
+            &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+
+    if (mSeqNumber <= lastSeqNumberInPlaylist
+            && mPlaylist->findPart(mSeqNumber, mPartIndex + 1) < 0) {
+        ++mSeqNumber;
+        mPartIndex = 0;
+    } else {
+        ++mPartIndex;
+    }
+}
+
+void PlaylistFetcher::cancelPrefetch() {
+    if (mPrefetcher != NULL) {
+        mPrefetcher->cancel();
+    }
+}
+
+void PlaylistFetcher::prefetchSegmentsAfter(
+        int32_t seqNumber, int32_t lastSeqNumberInPlaylist) {
+    if (mPrefetcher == NULL || mPlaylist == NULL || mStopParams != NULL) {
+        // when resuming until a stopping point we most likely don't need
+        // anything beyond the current segment.
+        return;
+    }
+
+    int32_t firstSeqNumberInPlaylist = mPlaylist->getFirstSeqNumber();
+
+    for (int32_t i = 1; i <= mNumPrefetchSegments; ++i) {
+        int32_t nextSeqNumber = seqNumber + i;
+        if (nextSeqNumber > lastSeqNumberInPlaylist) {
+            break;
+        }
+
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    nextSeqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta));
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        mPrefetcher->prefetch(nextSeqNumber, uri, rangeOffset, rangeLength);
+    }
+}
+
 void PlaylistFetcher::onDownloadNext() {
     AString uri;
     sp<AMessage> itemMeta;
     sp<ABuffer> buffer;
     sp<ABuffer> tsBuffer;
+    // complete segment handed over by mPrefetcher; |buffer| then wraps its
+    // data and grows block by block as if it was being downloaded.
+    sp<ABuffer> prefetchedBuffer;
     int32_t firstSeqNumberInPlaylist = 0;
     int32_t lastSeqNumberInPlaylist = 0;
     bool connectHTTP = true;
@@ -1220,11 +1529,23 @@ void PlaylistFetcher::onDownloadNext() {
                 itemMeta,
                 buffer,
                 tsBuffer,
+                prefetchedBuffer,
                 firstSeqNumberInPlaylist,
                 lastSeqNumberInPlaylist);
         connectHTTP = false;
         FLOGV("resuming: '%s'", uri.c_str());
     } else {
+        if (mPrefetcher != NULL && mPartIndex < 0 && mSeqNumber >= 0) {
+            // rather than block the looper until the next segment is prefetched,
+            // come back once it is
+            sp<AMessage> notify = new AMessage(kWhatDownloadNext, this);
+            notify->setInt32("generation", mMonitorQueueGeneration);
+            if (mPrefetcher->notifyWhenDone(mSeqNumber, notify)) {
+                FLOGV("waiting for prefetched segment %d", mSeqNumber);
+                return;
+            }
+        }
+
         if (!initDownloadState(
                 uri,
                 itemMeta,
@@ -1232,7 +1553,48 @@ void PlaylistFetcher::onDownloadNext() {
                 lastSeqNumberInPlaylist)) {
             return;
         }
-        FLOGV("fetching: '%s'", uri.c_str());
+
+        int64_t downloadTimeUs;
+        if (mPrefetcher != NULL && mPartIndex < 0
+                && mPrefetcher->take(
+                        mSeqNumber, uri, &prefetchedBuffer, &downloadTimeUs)) {
+            ++mNumPrefetchHits;
+            FLOGV("using prefetched: '%s' (%zu bytes)",
+                    uri.c_str(), prefetchedBuffer->size());
+
+            buffer = new ABuffer(
+                    prefetchedBuffer->data(), prefetchedBuffer->size());
+            buffer->setRange(0, 0);
+
+            // Same criteria as for blockwise downloads below. The prefetch
+            // connection runs concurrently with ours, so this only samples
+            // whole segments to limit the error.
+            if (!mStartup && mStopParams == NULL && prefetchedBuffer->size() > 0
+                    && (mStreamTypeMask
+                            & (LiveSession::STREAMTYPE_AUDIO
+                            | LiveSession::STREAMTYPE_VIDEO))) {
+                mSession->addBandwidthMeasurement(
+                        prefetchedBuffer->size(), downloadTimeUs);
+            }
+        } else {
+            if (mPrefetcher != NULL) {
+                ++mNumPrefetchMisses;
+            }
+            FLOGV("fetching: '%s'", uri.c_str());
+        }
+
+        // start transferring the next segment(s) while this one is demuxed
+        if (mPartIndex < 0) {
+            prefetchSegmentsAfter(mSeqNumber, lastSeqNumberInPlaylist);
+        }
+
+        status_t err = prepareFragmentedMP4Parser(firstSeqNumberInPlaylist);
+        if (err == ERROR_NOT_CONNECTED) {
+            return;
+        } else if (err != OK) {
+            notifyError(err);
+            return;
+        }
     }
 
     int64_t range_offset, range_length;
@@ -1245,11 +1607,20 @@ void PlaylistFetcher::onDownloadNext() {
     // block-wise download
     bool shouldPause = false;
     ssize_t bytesRead;
+    uint32_t blockSize = mPartIndex >= 0
+            ? kLowLatencyDownloadBlockSize : kDownloadBlockSize;
     do {
         int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
+        if (prefetchedBuffer != NULL) {
+            // expose the next block of the already downloaded segment
+            size_t remaining = buffer->capacity() - buffer->size();
+            bytesRead = remaining < blockSize ? remaining : blockSize;
+            buffer->setRange(0, buffer->size() + bytesRead);
+        } else {
+            bytesRead = mHTTPDownloader->fetchBlock(
+                    uri.c_str(), &buffer, range_offset, range_length, blockSize,
+                    NULL /* actualURL */, connectHTTP);
+        }
         int64_t delayUs = ALooper::GetNowUs() - startUs;
 
         if (bytesRead == ERROR_NOT_CONNECTED) {
@@ -1265,7 +1636,8 @@ void PlaylistFetcher::onDownloadNext() {
         // add sample for bandwidth estimation, excluding samples from subtitles (as
         // its too small), or during startup/resumeUntil (when we could have more than
         // one connection open which affects bandwidth)
-        if (!mStartup && mStopParams == NULL && bytesRead > 0
+        if (prefetchedBuffer == NULL
+                && !mStartup && mStopParams == NULL && bytesRead > 0
                 && (mStreamTypeMask
                         & (LiveSession::STREAMTYPE_AUDIO
                         | LiveSession::STREAMTYPE_VIDEO))) {
@@ -1298,7 +1670,18 @@ void PlaylistFetcher::onDownloadNext() {
         bool startUp = mStartup; // save current start up state
 
         err = OK;
-        if (bufferStartsWithTsSyncByte(buffer)) {
+        if (mFragmentedMP4Parser != NULL) {
+            // Samples are queued as soon as they are complete. The last AES
+            // block is held back until its padding has been removed.
+            AString method;
+            CHECK(buffer->meta()->findString("cipher-method", &method));
+            size_t holdBack = (method == "NONE") ? 0 : 16;
+            size_t start = size - bytesRead;
+            start = start > holdBack ? start - holdBack : 0;
+            size_t end = size > holdBack ? size - holdBack : 0;
+            err = extractAndQueueAccessUnitsFromFragmentedMP4(
+                    buffer, start, end - start);
+        } else if (bufferStartsWithTsSyncByte(buffer)) {
             // Incremental extraction is only supported for MPEG2 transport streams.
             if (tsBuffer == NULL) {
                 tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
@@ -1315,6 +1698,9 @@ void PlaylistFetcher::onDownloadNext() {
         if (err == -EAGAIN) {
             // starting sequence number too low/high
             mTSParser.clear();
+            if (mFragmentedMP4Parser != NULL) {
+                mFragmentedMP4Parser->flush();
+            }
             for (size_t i = 0; i < mPacketSources.size(); i++) {
                 sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(i);
                 packetSource->clear();
@@ -1346,6 +1732,7 @@ void PlaylistFetcher::onDownloadNext() {
                         itemMeta,
                         buffer,
                         tsBuffer,
+                        prefetchedBuffer,
                         firstSeqNumberInPlaylist,
                         lastSeqNumberInPlaylist);
                 return;
@@ -1354,7 +1741,7 @@ void PlaylistFetcher::onDownloadNext() {
         }
     } while (bytesRead != 0);
 
-    if (bufferStartsWithTsSyncByte(buffer)) {
+    if (mFragmentedMP4Parser == NULL && bufferStartsWithTsSyncByte(buffer)) {
         // If we don't see a stream in the program table after fetching a full ts segment
         // mark it as nonexistent.
         ATSParser::SourceType srcTypes[] =
@@ -1382,6 +1769,7 @@ void PlaylistFetcher::onDownloadNext() {
 
     }
 
+    size_t sizeBeforePadding = buffer->size();
     if (checkDecryptPadding(buffer) != OK) {
         ALOGE("Incorrect padding bytes after decryption.");
         notifyError(ERROR_MALFORMED);
@@ -1402,8 +1790,21 @@ void PlaylistFetcher::onDownloadNext() {
 
     // bulk extract non-ts files
     bool startUp = mStartup;
-    if (tsBuffer == NULL) {
-        status_t err = extractAndQueueAccessUnits(buffer, itemMeta);
+    if (mFragmentedMP4Parser != NULL || tsBuffer == NULL) {
+        status_t err;
+        if (mFragmentedMP4Parser != NULL) {
+            // whatever was held back for the padding check
+            AString method;
+            CHECK(buffer->meta()->findString("cipher-method", &method));
+            size_t fed = sizeBeforePadding;
+            if (method != "NONE") {
+                fed = fed > 16 ? fed - 16 : 0;
+            }
+            err = extractAndQueueAccessUnitsFromFragmentedMP4(
+                    buffer, fed, buffer->size() > fed ? buffer->size() - fed : 0);
+        } else {
+            err = extractAndQueueAccessUnits(buffer, itemMeta);
+        }
         if (err == -EAGAIN) {
             // starting sequence number too low/high
             postMonitorQueue();
@@ -1418,7 +1819,19 @@ void PlaylistFetcher::onDownloadNext() {
         }
     }
 
-    ++mSeqNumber;
+    if (mPartIndex >= 0) {
+        advancePart();
+    } else {
+        ++mSeqNumber;
+    }
+
+    if (mStartRequestTimeUs >= 0) {
+        ALOGI("[fetcher-%d] first segment queued %lld us after start "
+                "(prefetch hits %d, misses %d)",
+                mFetcherID, (long long)(ALooper::GetNowUs() - mStartRequestTimeUs),
+                mNumPrefetchHits, mNumPrefetchMisses);
+        mStartRequestTimeUs = -1ll;
+    }
 
     // if adapting, pause after found the next starting point
     if (mSeekMode != LiveSession::kSeekModeExactPosition && startUp != mStartup) {
@@ -1463,32 +1876,22 @@ bool PlaylistFetcher::adjustSeqNumberWithAnchorTime(int64_t anchorTimeUs) {
         while (index > 0 && diffUs > maxDiffUs) {
             --index;
 
-            sp<AMessage> itemMeta;
-            CHECK(mPlaylist->itemAt(index, NULL /* uri */, &itemMeta));
-
-            int64_t itemDurationUs;
-            CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-            diffUs -= itemDurationUs;
+            diffUs -= mPlaylist->getItemDurationUs(index);
         }
     } else if (diffUs < minDiffUs) {
         while (index + 1 < (ssize_t) mPlaylist->size()
                 && diffUs < minDiffUs) {
             ++index;
 
-            sp<AMessage> itemMeta;
-            CHECK(mPlaylist->itemAt(index, NULL /* uri */, &itemMeta));
-
-            int64_t itemDurationUs;
-            CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-            diffUs += itemDurationUs;
+            diffUs += mPlaylist->getItemDurationUs(index);
         }
     }
 
     mSeqNumber = firstSeqNumberInPlaylist + index;
 
     if (mSeqNumber != oldSeqNumber) {
+        // restart from a segment boundary
+        mPartIndex = -1;
         FLOGV("guessed wrong seg number: diff %lld out of [%lld, %lld]",
                 (long long) anchorTimeUs - mStartTimeUs,
                 (long long) minDiffUs,
@@ -1503,10 +1906,7 @@ int32_t PlaylistFetcher::getSeqNumberForDiscontinuity(size_t discontinuitySeq) c
 
     size_t index = 0;
     while (index < mPlaylist->size()) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt( index, NULL /* uri */, &itemMeta));
-        size_t curDiscontinuitySeq;
-        CHECK(itemMeta->findInt32("discontinuity-sequence", (int32_t *)&curDiscontinuitySeq));
+        size_t curDiscontinuitySeq = mPlaylist->getItemDiscontinuitySeq(index);
         int32_t seqNumber = firstSeqNumberInPlaylist + index;
         if (curDiscontinuitySeq == discontinuitySeq) {
             return seqNumber;
@@ -1521,29 +1921,7 @@ int32_t PlaylistFetcher::getSeqNumberForDiscontinuity(size_t discontinuitySeq) c
 }
 
 int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
-    size_t index = 0;
-    int64_t segmentStartUs = 0;
-    while (index < mPlaylist->size()) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        if (timeUs < segmentStartUs + itemDurationUs) {
-            break;
-        }
-
-        segmentStartUs += itemDurationUs;
-        ++index;
-    }
-
-    if (index >= mPlaylist->size()) {
-        index = mPlaylist->size() - 1;
-    }
-
-    return mPlaylist->getFirstSeqNumber() + index;
+    return mPlaylist->getFirstSeqNumber() + mPlaylist->getItemIndexForTime(timeUs);
 }
 
 const sp<ABuffer> &PlaylistFetcher::setAccessUnitProperties(
@@ -1823,6 +2201,255 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
     return OK;
 }
 
+status_t PlaylistFetcher::prepareFragmentedMP4Parser(
+        int32_t firstSeqNumberInPlaylist) {
+    AString uri;
+    int64_t rangeOffset, rangeLength;
+    // parts of a segment that isn't listed yet use the last known map
+    ssize_t index = mSeqNumber - firstSeqNumberInPlaylist;
+    if (index >= (ssize_t)mPlaylist->size()) {
+        index = mPlaylist->size() - 1;
+    }
+    if (index < 0 || !mPlaylist->getItemInitSegment(
+            index, &uri, &rangeOffset, &rangeLength)) {
+        mFragmentedMP4Parser.clear();
+        mInitSegmentURI.clear();
+        return OK;
+    }
+
+    if (mFragmentedMP4Parser != NULL
+            && uri == mInitSegmentURI && rangeOffset == mInitSegmentRangeOffset) {
+        // every segment starts with a new box
+        mFragmentedMP4Parser->flush();
+        return OK;
+    }
+
+    FLOGV("fetching init segment '%s' @ %lld", uri.c_str(), (long long)rangeOffset);
+
+    sp<ABuffer> buffer;
+    ssize_t bytesRead = mHTTPDownloader->fetchBlock(
+            uri.c_str(), &buffer, rangeOffset, rangeLength,
+            0 /* block_size */, NULL /* actualURL */, true /* reconnect */);
+    if (bytesRead == ERROR_NOT_CONNECTED) {
+        return ERROR_NOT_CONNECTED;
+    } else if (bytesRead < 0) {
+        ALOGE("failed to fetch init segment at url '%s'", uri.c_str());
+        return bytesRead;
+    }
+
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    status_t err = parser->appendData(buffer->data(), buffer->size());
+    if (err != OK) {
+        return err;
+    }
+    parser->flush();
+
+    if (parser->countTracks() == 0) {
+        ALOGE("init segment declares no tracks");
+        return ERROR_MALFORMED;
+    }
+
+    // Like for transport streams, drop what the segments don't carry.
+    static const LiveSession::StreamType kStreamTypes[] =
+            { LiveSession::STREAMTYPE_VIDEO, LiveSession::STREAMTYPE_AUDIO };
+    static const char *kMimePrefixes[] = { "video/", "audio/" };
+    for (size_t i = 0; i < NELEM(kStreamTypes); ++i) {
+        if (!(mStreamTypeMask & kStreamTypes[i])) {
+            continue;
+        }
+
+        bool found = false;
+        for (size_t j = 0; j < parser->countTracks(); ++j) {
+            const char *mime;
+            if (parser->getTrackFormat(j)->findCString(kKeyMIMEType, &mime)
+                    && !strncasecmp(mime, kMimePrefixes[i], strlen(kMimePrefixes[i]))) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            ALOGW("fragmented mp4 stream does not contain %s data.",
+                    kStreamTypes[i] == LiveSession::STREAMTYPE_VIDEO ? "video" : "audio");
+            mStreamTypeMask &= ~kStreamTypes[i];
+            mPacketSources.removeItem(kStreamTypes[i]);
+        }
+    }
+
+    mFragmentedMP4Parser = parser;
+    mInitSegmentURI = uri;
+    mInitSegmentRangeOffset = rangeOffset;
+
+    return OK;
+}
+
+status_t PlaylistFetcher::extractAndQueueAccessUnitsFromFragmentedMP4(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    if (mNextPTSTimeUs >= 0ll) {
+        // sample times are absolute
+        mNextPTSTimeUs = -1ll;
+    }
+
+    if (size > 0) {
+        status_t err = mFragmentedMP4Parser->appendData(
+                buffer->data() + offset, size);
+        if (err != OK) {
+            ALOGE("failed to parse fragmented mp4 segment (%d)", err);
+            return err;
+        }
+    }
+
+    size_t numTracks = mFragmentedMP4Parser->countTracks();
+    Vector<LiveSession::StreamType> streams;
+    Vector<List<sp<ABuffer> > > units;
+    streams.resize(numTracks);
+    units.resize(numTracks);
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        const char *mime;
+        CHECK(mFragmentedMP4Parser->getTrackFormat(i)->findCString(
+                kKeyMIMEType, &mime));
+        LiveSession::StreamType stream =
+            !strncasecmp(mime, "video/", 6) ? LiveSession::STREAMTYPE_VIDEO
+            : !strncasecmp(mime, "audio/", 6) ? LiveSession::STREAMTYPE_AUDIO
+            : LiveSession::STREAMTYPE_METADATA;
+        streams.editItemAt(i) = stream;
+
+        sp<ABuffer> accessUnit;
+        while (mFragmentedMP4Parser->dequeueAccessUnit(i, &accessUnit) == OK) {
+            if (stream != LiveSession::STREAMTYPE_METADATA
+                    && mPacketSources.indexOfKey(stream) >= 0) {
+                units.editItemAt(i).push_back(accessUnit);
+            }
+        }
+    }
+
+    if (mSegmentFirstPTS < 0ll) {
+        for (size_t i = 0; i < numTracks; ++i) {
+            if (units[i].empty()) {
+                continue;
+            }
+            int64_t timeUs;
+            CHECK((*units[i].begin())->meta()->findInt64("timeUs", &timeUs));
+            if (mSegmentFirstPTS < 0ll || timeUs < mSegmentFirstPTS) {
+                mSegmentFirstPTS = timeUs;
+            }
+        }
+        if (mSegmentFirstPTS < 0ll) {
+            // no complete sample yet
+            return OK;
+        }
+        // Duplicated logic from how we handle .ts playlists.
+        if (!mStartTimeUsRelative && mStartup && mSegmentStartTimeUs >= 0
+                && adjustSeqNumberWithAnchorTime(mSegmentFirstPTS)) {
+            mStartTimeUsNotify = mNotify->dup();
+            mStartTimeUsNotify->setInt32("what", kWhatStartedAt);
+            mStartTimeUsNotify->setString("uri", mURI);
+            mIDRFound = false;
+            mSegmentStartTimeUs = -1;
+            return -EAGAIN;
+        }
+    }
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        const LiveSession::StreamType stream = streams[i];
+        ssize_t sourceIndex = mPacketSources.indexOfKey(stream);
+        if (sourceIndex < 0) {
+            continue;
+        }
+
+        sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(sourceIndex);
+        if (packetSource->getFormat() == NULL) {
+            packetSource->setFormat(mFragmentedMP4Parser->getTrackFormat(i));
+        }
+
+        const char *key = LiveSession::getKeyForStream(stream);
+        bool isVideo = (stream == LiveSession::STREAMTYPE_VIDEO);
+
+        for (List<sp<ABuffer> >::iterator it = units.editItemAt(i).begin();
+                it != units.editItemAt(i).end(); ++it) {
+            const sp<ABuffer> &accessUnit = *it;
+
+            int64_t timeUs;
+            CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+
+            if (mStartup) {
+                bool startTimeReached = isStartTimeReached(timeUs);
+
+                if (!startTimeReached || (isVideo && !mIDRFound)) {
+                    // same as for transport streams, except that sync
+                    // samples are flagged by the container
+                    int32_t isSync;
+                    if (isVideo && accessUnit->meta()->findInt32("isSync", &isSync)
+                            && isSync) {
+                        mVideoBuffer->clear();
+                        mIDRFound = true;
+                    }
+                    if (isVideo && mIDRFound && mStartTimeUsRelative
+                            && !startTimeReached) {
+                        mVideoBuffer->queueAccessUnit(accessUnit);
+                    }
+                    if (!startTimeReached || (isVideo && !mIDRFound)) {
+                        continue;
+                    }
+                }
+            }
+
+            if (mStartTimeUsNotify != NULL) {
+                uint32_t streamMask = 0;
+                mStartTimeUsNotify->findInt32("streamMask", (int32_t *) &streamMask);
+                if ((mStreamTypeMask & stream) && !(streamMask & stream)) {
+                    streamMask |= stream;
+                    mStartTimeUsNotify->setInt32("streamMask", streamMask);
+                    FSLOGV(stream, "found start point, timeUs=%lld, streamMask becomes %x",
+                            (long long)timeUs, streamMask);
+
+                    if (streamMask == mStreamTypeMask) {
+                        FLOGV("found start point for all streams");
+                        mStartup = false;
+                    }
+                }
+            }
+
+            if (mStopParams != NULL) {
+                int32_t discontinuitySeq;
+                int64_t stopTimeUs;
+                if (!mStopParams->findInt32("discontinuitySeq", &discontinuitySeq)
+                        || discontinuitySeq > mDiscontinuitySeq
+                        || !mStopParams->findInt64(key, &stopTimeUs)
+                        || (discontinuitySeq == mDiscontinuitySeq
+                                && timeUs >= stopTimeUs)) {
+                    FSLOGV(stream, "reached stop point, timeUs=%lld", (long long)timeUs);
+                    mStreamTypeMask &= ~stream;
+                    mPacketSources.removeItemsAt(sourceIndex);
+                    break;
+                }
+            }
+
+            if (isVideo) {
+                const bool discard = true;
+                status_t status;
+                while (mVideoBuffer->hasBufferAvailable(&status)) {
+                    sp<ABuffer> videoBuffer;
+                    mVideoBuffer->dequeueAccessUnit(&videoBuffer);
+                    setAccessUnitProperties(videoBuffer, packetSource, discard);
+                    packetSource->queueAccessUnit(videoBuffer);
+                }
+            }
+
+            setAccessUnitProperties(accessUnit, packetSource);
+            packetSource->queueAccessUnit(accessUnit);
+        }
+    }
+
+    if (!mStreamTypeMask) {
+        FLOGV("reached stop point for all streams");
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    return OK;
+}
+
 /* static */
 bool PlaylistFetcher::bufferStartsWithWebVTTMagicSequence(
         const sp<ABuffer> &buffer) {
@@ -2062,17 +2689,7 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
 }
 
 void PlaylistFetcher::updateDuration() {
-    int64_t durationUs = 0ll;
-    for (size_t index = 0; index < mPlaylist->size(); ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        durationUs += itemDurationUs;
-    }
+    int64_t durationUs = mPlaylist->getDurationUs();
 
     sp<AMessage> msg = mNotify->dup();
     msg->setInt32("what", kWhatDurationUpdate);
@@ -28,9 +28,11 @@ namespace android {
 struct ABuffer;
 struct AnotherPacketSource;
 class DataSource;
+struct FragmentedMP4Parser;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 class String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -108,6 +110,9 @@ private:
 
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kNumSkipFrames;
+    static const int32_t kMaxPrefetchSegments;
+    static const int32_t kLowLatencyDownloadBlockSize;
+    static const int64_t kMinPartRetryDelayUs;
 
     static bool bufferStartsWithTsSyncByte(const sp<ABuffer>& buffer);
     static bool bufferStartsWithWebVTTMagicSequence(const sp<ABuffer>& buffer);
@@ -118,6 +123,18 @@ private:
 
     sp<HTTPDownloader> mHTTPDownloader;
     sp<LiveSession> mSession;
+
+    // Downloads the segments following the current one on a separate
+    // connection; NULL if prefetching is disabled.
+    sp<ALooper> mPrefetchLooper;
+    sp<SegmentPrefetcher> mPrefetcher;
+    int32_t mNumPrefetchSegments;
+    int32_t mNumPrefetchHits;
+    int32_t mNumPrefetchMisses;
+
+    // Time onStart() was handled, used to log how long it took to queue
+    // the first segment (-1 once reported).
+    int64_t mStartRequestTimeUs;
     AString mURI;
 
     int32_t mFetcherID;
@@ -143,6 +160,10 @@ private:
     int64_t mPlaylistTimeUs;
     sp<M3UParser> mPlaylist;
     int32_t mSeqNumber;
+    bool mLowLatency;
+    // Low-latency mode: index of the part of segment mSeqNumber to fetch
+    // next, or -1 when fetching whole segments.
+    int32_t mPartIndex;
     int32_t mNumRetries;
     bool mStartup;
     bool mIDRFound;
@@ -167,6 +188,12 @@ private:
 
     sp<ATSParser> mTSParser;
 
+    // Set while the playlist has an initialization section (EXT-X-MAP),
+    // i.e. the segments are fragmented MP4.
+    sp<FragmentedMP4Parser> mFragmentedMP4Parser;
+    AString mInitSegmentURI;
+    int64_t mInitSegmentRangeOffset;
+
     bool mFirstPTSValid;
     int64_t mFirstTimeUs;
     int64_t mSegmentFirstPTS;
@@ -205,7 +232,10 @@ private:
     bool shouldPauseDownload();
 
     int64_t delayUsToRefreshPlaylist() const;
-    status_t refreshPlaylist();
+    // If |blockingSeqNumber| is non-negative and the server supports it,
+    // issue a blocking reload that returns once that part is available.
+    status_t refreshPlaylist(
+            int32_t blockingSeqNumber = -1, int32_t blockingPartIndex = -1);
 
     // Returns the media time in us of the segment specified by seqNumber.
     // This is computed by summing the durations of all segments before it.
@@ -218,11 +248,23 @@ private:
     void onStop(const sp<AMessage> &msg);
     void onMonitorQueue();
     void onDownloadNext();
+    void prefetchSegmentsAfter(int32_t seqNumber, int32_t lastSeqNumberInPlaylist);
+    void cancelPrefetch();
     bool initDownloadState(
             AString &uri,
             sp<AMessage> &itemMeta,
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
+    bool canUseParts() const;
+    void selectLowLatencyStartPart();
+    // Returns 1 if the next part was found, 0 if the fetcher should fall
+    // back to whole segments, and -1 if the part isn't available yet (a
+    // retry has been scheduled).
+    int32_t initPartDownloadState(
+            AString &uri,
+            sp<AMessage> &itemMeta,
+            int32_t lastSeqNumberInPlaylist);
+    void advancePart();
 
     // Resume a fetcher to continue until the stopping point stored in msg.
     status_t onResumeUntil(const sp<AMessage> &msg);
@@ -234,6 +276,12 @@ private:
     bool isStartTimeReached(int64_t timeUs);
     status_t extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &buffer);
 
+    status_t prepareFragmentedMP4Parser(int32_t firstSeqNumberInPlaylist);
+    // Hands buffer bytes [offset, offset + size) to mFragmentedMP4Parser
+    // and queues the samples that are complete.
+    status_t extractAndQueueAccessUnitsFromFragmentedMP4(
+            const sp<ABuffer> &buffer, size_t offset, size_t size);
+
     status_t extractAndQueueAccessUnits(
             const sp<ABuffer> &buffer, const sp<AMessage> &itemMeta);
 
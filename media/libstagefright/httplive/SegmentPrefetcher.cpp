@@ -0,0 +1,250 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+#include "HTTPDownloader.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const sp<HTTPDownloader> &downloader, size_t maxPending)
+    : mHTTPDownloader(downloader),
+      mMaxPending(maxPending),
+      mGeneration(0),
+      mInFlight(false),
+      mNotifySeqNumber(-1) {
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+}
+
+bool SegmentPrefetcher::prefetch(
+        int32_t seqNumber,
+        const AString &uri,
+        int64_t rangeOffset,
+        int64_t rangeLength) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mJobs.size() >= mMaxPending) {
+        return false;
+    }
+
+    for (List<Job>::iterator it = mJobs.begin(); it != mJobs.end(); ++it) {
+        if (it->mSeqNumber == seqNumber) {
+            return false;
+        }
+    }
+
+    Job job;
+    job.mSeqNumber = seqNumber;
+    job.mUri = uri;
+    job.mRangeOffset = rangeOffset;
+    job.mRangeLength = rangeLength;
+    job.mState = QUEUED;
+    job.mDownloadTimeUs = 0ll;
+    mJobs.push_back(job);
+
+    ALOGV("queued segment %d '%s'", seqNumber, uri.c_str());
+
+    if (!mInFlight) {
+        sp<AMessage> msg = new AMessage(kWhatFetchNext, this);
+        msg->setInt32("generation", mGeneration);
+        msg->post();
+    }
+
+    return true;
+}
+
+bool SegmentPrefetcher::notifyWhenDone(
+        int32_t seqNumber, const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (List<Job>::iterator it = mJobs.begin(); it != mJobs.end(); ++it) {
+        if (it->mSeqNumber != seqNumber) {
+            continue;
+        }
+        if (it->mState == IN_FLIGHT || (it->mState == QUEUED && mInFlight)) {
+            mNotify = notify;
+            mNotifySeqNumber = seqNumber;
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+bool SegmentPrefetcher::take(
+        int32_t seqNumber,
+        const AString &uri,
+        sp<ABuffer> *buffer,
+        int64_t *downloadTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    // A download in flight is left to finish, the worker drops its result.
+    List<Job>::iterator it = mJobs.begin();
+    while (it != mJobs.end()) {
+        if (it->mSeqNumber > seqNumber) {
+            break;
+        }
+        if (it->mSeqNumber < seqNumber) {
+            it = mJobs.erase(it);
+            continue;
+        }
+
+        bool success = (it->mState == DONE) && (it->mUri == uri);
+        if (success) {
+            *buffer = it->mBuffer;
+            *downloadTimeUs = it->mDownloadTimeUs;
+        }
+        mJobs.erase(it);
+        return success;
+    }
+    return false;
+}
+
+void SegmentPrefetcher::cancel() {
+    Mutex::Autolock autoLock(mLock);
+
+    ++mGeneration;
+    mJobs.clear();
+    postNotify_l();
+
+    if (mInFlight) {
+        // Disconnect under the lock: the worker only reconnects under it too,
+        // once it notices the generation change, so the disconnect can't land
+        // after that reconnect and fail every later prefetch.
+        mHTTPDownloader->disconnect();
+    }
+}
+
+size_t SegmentPrefetcher::numPending() {
+    Mutex::Autolock autoLock(mLock);
+    return mJobs.size();
+}
+
+void SegmentPrefetcher::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatFetchNext:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (generation != mGeneration) {
+                    break;
+                }
+            }
+
+            onFetchNext();
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+void SegmentPrefetcher::onFetchNext() {
+    AString uri;
+    int32_t seqNumber;
+    int64_t rangeOffset, rangeLength;
+    int32_t generation;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        List<Job>::iterator it = mJobs.begin();
+        while (it != mJobs.end() && it->mState != QUEUED) {
+            ++it;
+        }
+        if (it == mJobs.end() || mInFlight) {
+            return;
+        }
+
+        it->mState = IN_FLIGHT;
+        mInFlight = true;
+
+        seqNumber = it->mSeqNumber;
+        uri = it->mUri;
+        rangeOffset = it->mRangeOffset;
+        rangeLength = it->mRangeLength;
+        generation = mGeneration;
+    }
+
+    sp<ABuffer> buffer;
+    int64_t startUs = ALooper::GetNowUs();
+    ssize_t bytesRead = mHTTPDownloader->fetchBlock(
+            uri.c_str(), &buffer, rangeOffset, rangeLength,
+            0 /* block_size */, NULL /* actualUrl */, true /* reconnect */);
+    int64_t downloadTimeUs = ALooper::GetNowUs() - startUs;
+
+    Mutex::Autolock autoLock(mLock);
+
+    mInFlight = false;
+
+    if (generation != mGeneration) {
+        // cancelled while downloading, result is stale
+        mHTTPDownloader->reconnect();
+        return;
+    }
+
+    for (List<Job>::iterator it = mJobs.begin(); it != mJobs.end(); ++it) {
+        if (it->mSeqNumber != seqNumber || it->mState != IN_FLIGHT) {
+            continue;
+        }
+
+        if (bytesRead < 0) {
+            ALOGW("failed to prefetch segment %d, err %zd", seqNumber, bytesRead);
+            it->mState = FAILED;
+        } else {
+            ALOGV("prefetched segment %d, %zd bytes in %lld us",
+                    seqNumber, bytesRead, (long long)downloadTimeUs);
+            it->mState = DONE;
+            it->mBuffer = buffer;
+            it->mDownloadTimeUs = downloadTimeUs;
+        }
+        break;
+    }
+
+    if (seqNumber == mNotifySeqNumber) {
+        postNotify_l();
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatFetchNext, this);
+    msg->setInt32("generation", mGeneration);
+    msg->post();
+}
+
+void SegmentPrefetcher::postNotify_l() {
+    if (mNotify != NULL) {
+        mNotify->post();
+        mNotify.clear();
+    }
+    mNotifySeqNumber = -1;
+}
+
+}  // namespace android
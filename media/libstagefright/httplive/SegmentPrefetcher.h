@@ -0,0 +1,113 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+struct ABuffer;
+struct HTTPDownloader;
+
+// Downloads upcoming segments of a playlist on its own looper and its own
+// HTTPDownloader, so that segment N+1 is transferred while
+// PlaylistFetcher is still demuxing segment N. The number of segments
+// queued or in flight is bounded by |maxPending|.
+struct SegmentPrefetcher : public AHandler {
+    SegmentPrefetcher(const sp<HTTPDownloader> &downloader, size_t maxPending);
+
+    // Queues segment |seqNumber| for download. Returns false if the segment
+    // is already queued or the prefetch window is full.
+    bool prefetch(
+            int32_t seqNumber,
+            const AString &uri,
+            int64_t rangeOffset,
+            int64_t rangeLength);
+
+    // Returns true if segment |seqNumber| is being downloaded, in which case
+    // |notify| is posted once it is done, failed or cancelled, and the caller
+    // should call take() then rather than wait. Returns false if there is
+    // nothing to wait for.
+    bool notifyWhenDone(int32_t seqNumber, const sp<AMessage> &notify);
+
+    // Returns true and the complete segment if |seqNumber| / |uri| was
+    // prefetched successfully. Returns false, without waiting, if the segment
+    // was never queued, its download failed or is not finished; the caller
+    // should then fetch it itself. Entries for earlier sequence numbers are
+    // dropped.
+    bool take(
+            int32_t seqNumber,
+            const AString &uri,
+            sp<ABuffer> *buffer,
+            int64_t *downloadTimeUs);
+
+    // Drops all queued segments and aborts the in-flight download, if any.
+    // A pending notifyWhenDone() message is posted.
+    void cancel();
+
+    size_t numPending();
+
+protected:
+    virtual ~SegmentPrefetcher();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatFetchNext = 'fnxt',
+    };
+
+    enum JobState {
+        QUEUED,
+        IN_FLIGHT,
+        DONE,
+        FAILED,
+    };
+
+    struct Job {
+        int32_t mSeqNumber;
+        AString mUri;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;
+        JobState mState;
+        sp<ABuffer> mBuffer;
+        int64_t mDownloadTimeUs;
+    };
+
+    sp<HTTPDownloader> mHTTPDownloader;
+    const size_t mMaxPending;
+
+    Mutex mLock;
+    List<Job> mJobs;
+    int32_t mGeneration;
+    bool mInFlight;
+    sp<AMessage> mNotify;       // posted when segment mNotifySeqNumber is done
+    int32_t mNotifySeqNumber;
+
+    void onFetchNext();
+    void postNotify_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
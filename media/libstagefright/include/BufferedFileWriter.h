@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BUFFERED_FILE_WRITER_H_
+
+#define BUFFERED_FILE_WRITER_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Write-combining output for container writers.
+//
+// Small writes (box headers, NAL length prefixes) are gathered in a page
+// aligned staging buffer. Large payloads are not copied, they are passed
+// to writev() together with whatever is staged, so that every sample costs
+// at most one system call and usually none. Data that has been written
+// already can be patched in place with writeAt(), which does not disturb
+// the staged data unless the two overlap.
+//
+// With startIOThread() the system calls move to a dedicated thread: full
+// staging buffers are queued for it and the caller continues with the next
+// free one, so it only waits for the storage when all of them are in
+// flight. Large payloads are then copied as well.
+//
+// Not thread safe, the owner serializes access. Errors are sticky: after
+// a failed system call all further calls return the same error.
+struct BufferedFileWriter {
+    enum {
+        kDefaultBufferSize = 1024 * 1024,
+    };
+
+    struct IOStats {
+        size_t mNumStalls;         // times the caller waited for a free buffer
+        int64_t mStallTimeUs;      // total time spent waiting
+        size_t mMaxQueuedBuffers;  // most buffers waiting to be written
+        int64_t mMaxWriteTimeUs;   // slowest write of a single buffer
+    };
+
+    // Does not take ownership of |fd|; output starts at |offset|.
+    BufferedFileWriter(int fd, off64_t offset = 0, size_t bufferSize = kDefaultBufferSize);
+    ~BufferedFileWriter();
+
+    // Reserves disk space |bytes| at a time ahead of the write position,
+    // without changing the file size. 0 (the default) disables it.
+    void setPreallocationSize(off64_t bytes);
+
+    // Writes from a separate thread through |numBuffers| staging buffers,
+    // of which all but the one being filled can be queued. Must be called
+    // before anything is written. Stays synchronous if that fails.
+    status_t startIOThread(size_t numBuffers);
+
+    status_t write(const void *data, size_t size);
+    status_t writev(const struct iovec *iov, int iovcnt);
+
+    // Overwrites |size| bytes at |offset|, e.g. to fill in the size of a
+    // box once its end is known. The write position is unchanged.
+    status_t writeAt(off64_t offset, const void *data, size_t size);
+
+    // Flushes and continues at |offset|.
+    status_t seek(off64_t offset);
+
+    // Copies |size| bytes of the file from |from| to |to| in a single pass,
+    // the ranges may overlap. Flushes first, needs a readable fd.
+    status_t moveData(off64_t from, off64_t to, off64_t size);
+
+    // Returns once everything staged so far is in the file.
+    status_t flush();
+
+    // Hands what is staged to the I/O thread without waiting for it to be
+    // written; same as flush() without an I/O thread.
+    status_t submit();
+
+    off64_t position() const { return mBufferOffset + mBufferedSize; }
+    status_t error() const { return mError; }
+
+    // Number of system calls issued so far.
+    size_t numSyscalls() const { return mNumSyscalls; }
+
+    // All zero without an I/O thread.
+    void getIOStats(IOStats *stats);
+
+private:
+    int mFd;
+    uint8_t *mBuffer;
+    size_t mBufferSize;
+    size_t mBufferedSize;
+    off64_t mBufferOffset;  // file offset of mBuffer[0]
+    off64_t mFdOffset;      // current offset of mFd, -1 if unknown
+    off64_t mPreallocationSize;
+    off64_t mPreallocatedEnd;
+    status_t mError;
+    size_t mNumSyscalls;
+
+    struct Block {
+        uint8_t *mData;
+        size_t mSize;
+        off64_t mOffset;
+    };
+
+    // Shared with the I/O thread.
+    Mutex mLock;
+    Condition mCondition;
+    List<Block> mQueue;
+    Vector<uint8_t *> mFreeBuffers;
+    Vector<uint8_t *> mBuffers;  // all of them, for freeing
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mWriting;
+    bool mExit;
+    status_t mIOError;
+    IOStats mStats;
+
+    // Writes the staged data followed by |iov|, then empties the buffer.
+    status_t writeOut(const struct iovec *iov, int iovcnt);
+    void preallocate(off64_t offset, off64_t end);
+
+    // Queues the staged data and continues with a free buffer.
+    status_t queueBuffer();
+    // Waits until the I/O thread has written everything queued.
+    status_t waitForIdle();
+    status_t writeBlock(const Block &block);
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+
+    DISALLOW_EVIL_CONSTRUCTORS(BufferedFileWriter);
+};
+
+}  // namespace android
+
+#endif  // BUFFERED_FILE_WRITER_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAGMENTED_MP4_PARSER_H_
+
+#define FRAGMENTED_MP4_PARSER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include "include/MPEG4Extractor.h"
+
+namespace android {
+
+struct ABuffer;
+class MetaData;
+
+// Push-mode parser for fragmented MP4 (ISO BMFF / CMAF) streams.
+//
+// Data is fed in arbitrarily sized chunks as it arrives, e.g. from a socket,
+// and is never re-read, so the source need not be seekable. A moov box,
+// either from a separate initialization segment or in-band, declares the
+// tracks; track formats are taken from MPEG4Extractor. moof boxes are parsed as a
+// whole (they are small), while mdat payload is only retained until the
+// sample that covers it is complete, at which point the sample is queued
+// as an access unit. AVC/HEVC samples are converted to start code prefixed
+// NAL units.
+struct FragmentedMP4Parser : public RefBase {
+    FragmentedMP4Parser();
+
+    // Appends the next |size| bytes of the stream. Errors are sticky, all
+    // further calls return the first error encountered.
+    status_t appendData(const uint8_t *data, size_t size);
+
+    // No more data will follow. Returns ERROR_MALFORMED if the stream
+    // ended in the middle of a box or sample.
+    status_t signalEndOfStream();
+
+    // Drops partially received boxes, samples still waiting for data and
+    // queued access units; the tracks are kept and a previous error or end
+    // of stream is forgotten. Call this before feeding data that doesn't
+    // continue the previous stream, e.g. the next segment after a seek.
+    void flush();
+
+    size_t countTracks() const;
+    sp<MetaData> getTrackFormat(size_t index) const;
+
+    // Returns -EAGAIN if no complete access unit of track |index| is queued,
+    // or ERROR_END_OF_STREAM once the end of stream has been signalled and
+    // all access units have been dequeued.
+    // Access units carry "timeUs", "durationUs" and, for sync samples,
+    // "isSync" in their meta.
+    status_t dequeueAccessUnit(size_t index, sp<ABuffer> *accessUnit);
+
+protected:
+    virtual ~FragmentedMP4Parser();
+
+private:
+    enum State {
+        WAITING_FOR_BOX_HEADER,
+        WAITING_FOR_BOX,    // moov or moof, parsed once complete
+        READING_MDAT,
+        SKIPPING_BOX,
+    };
+
+    struct TrackInfo {
+        uint32_t mTrackID;
+        uint32_t mTimescale;
+        Trex mTrex;
+        sp<MetaData> mFormat;
+        size_t mNALLengthSize;  // 0 unless AVC/HEVC
+        uint64_t mNextDecodeTime;
+        List<sp<ABuffer> > mAccessUnits;
+    };
+
+    // a sample whose data hasn't been completely received yet
+    struct PendingSample {
+        size_t mTrackIndex;
+        uint64_t mOffset;
+        size_t mSize;
+        uint64_t mDecodeTime;
+        int32_t mCompositionOffset;
+        uint32_t mDuration;
+        bool mIsSync;
+    };
+
+    // per traf state while parsing a moof
+    struct TrackFragment {
+        ssize_t mTrackIndex;
+        uint32_t mFlags;
+        uint64_t mBaseDataOffset;
+        uint32_t mDefaultSampleDuration;
+        uint32_t mDefaultSampleSize;
+        uint32_t mDefaultSampleFlags;
+        uint64_t mDataOffset;  // end of the previous trun's data
+    };
+
+    Vector<TrackInfo> mTracks;
+    List<PendingSample> mPendingSamples;  // ordered by offset
+
+    // unconsumed input, starting at stream offset mBufferOffset
+    sp<ABuffer> mBuffer;
+    uint64_t mBufferOffset;
+
+    State mState;
+    status_t mFinalResult;
+    bool mEOS;
+    uint32_t mBoxType;
+    uint64_t mBoxOffset;
+    uint64_t mBoxEnd;  // UINT64_MAX if the box extends to the end
+
+    void appendToBuffer(const uint8_t *data, size_t size);
+    void consume(size_t size);
+    status_t processBuffer();
+    status_t parseBoxHeader(bool *needMore);
+    status_t readMdat();
+
+    status_t parseMovie(const uint8_t *data, size_t size);
+    status_t parseMovieFragment(const uint8_t *data, size_t size);
+    status_t parseTrackFragment(
+            const uint8_t *data, size_t size, uint64_t moofOffset,
+            uint64_t *implicitBaseDataOffset);
+    status_t parseTrackFragmentHeader(
+            const uint8_t *data, size_t size, uint64_t moofOffset,
+            uint64_t implicitBaseDataOffset, TrackFragment *fragment);
+    status_t parseTrackFragmentRun(
+            const uint8_t *data, size_t size, TrackFragment *fragment);
+
+    ssize_t findTrack(uint32_t trackID) const;
+    void queuePendingSample(const PendingSample &sample);
+    status_t queueAccessUnit(const PendingSample &sample, const uint8_t *data);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FragmentedMP4Parser);
+};
+
+}  // namespace android
+
+#endif  // FRAGMENTED_MP4_PARSER_H_
@@ -62,6 +62,11 @@ public:
     // for DRM
     virtual char* getDrmTrackInfo(size_t trackID, int *len);
 
+    // Track ID, media timescale and movie extends defaults of track |index|,
+    // for parsing its fragments outside of the extractor.
+    status_t getTrackFragmentDefaults(
+            size_t index, uint32_t *trackID, uint32_t *timescale, Trex *trex);
+
 protected:
     virtual ~MPEG4Extractor();
 
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROBE_DATA_SOURCE_H_
+
+#define PROBE_DATA_SOURCE_H_
+
+#include <media/stagefright/DataSource.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Caches the first and last few KB of a local DataSource and reads ahead
+// a little everywhere else. Sniffing a file and parsing its headers and
+// tags then takes a handful of reads of the wrapped source, instead of
+// each sniffer and parser reading the same bytes over again.
+// Meant for short lived probes of a source, not for playback.
+struct ProbeDataSource : public DataSource {
+    enum {
+        kHeadSize       = 64 * 1024,
+        kTailSize       = 16 * 1024,
+        kReadAheadSize  = 32 * 1024,
+    };
+
+    // A |tailSize| of 0 leaves the end of the source to the read ahead.
+    ProbeDataSource(
+            const sp<DataSource> &source,
+            size_t headSize = kHeadSize,
+            size_t tailSize = kTailSize,
+            size_t readAheadSize = kReadAheadSize);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    // Drops the cached bytes, as the wrapped source may decrypt its reads
+    // from now on.
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL);
+
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    };
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+    // The number of reads that went to the wrapped source, and the number
+    // of bytes they returned.
+    void getReadStats(size_t *numReads, size_t *numBytesRead);
+
+protected:
+    virtual ~ProbeDataSource();
+
+private:
+    struct Block {
+        off64_t mOffset;
+        ssize_t mLength;    // -1 until the block is filled
+        size_t mCapacity;
+        uint8_t *mData;
+    };
+
+    Mutex mLock;
+
+    sp<DataSource> mSource;
+    off64_t mSize;          // -1 if the wrapped source doesn't know
+    Block mHead;
+    Block mTail;
+    Block mReadAhead;
+    size_t mNumReads;
+    size_t mNumBytesRead;
+
+    static void InitBlock(Block *block, size_t capacity);
+    Block *findBlock_l(off64_t offset);
+    status_t fillBlock_l(Block *block, off64_t offset);
+    ssize_t readFromSource_l(off64_t offset, void *data, size_t size);
+    void flush_l();
+
+    ProbeDataSource(const ProbeDataSource &);
+    ProbeDataSource &operator=(const ProbeDataSource &);
+};
+
+}  // namespace android
+
+#endif  // PROBE_DATA_SOURCE_H_
@@ -44,6 +44,13 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     virtual MediaAlbumArt *extractAlbumArt();
     virtual const char *extractMetadata(int keyCode);
 
+    // Fills |metaData| with the METADATA_KEY_* values of the content
+    // |extractor| was created for, and |albumArt| with its album art unless
+    // |albumArt| is NULL.
+    static void ParseMetaData(
+            const sp<MediaExtractor> &extractor, const sp<DataSource> &source,
+            KeyedVector<int, String8> *metaData, MediaAlbumArt **albumArt);
+
 private:
     OMXClient mClient;
     sp<DataSource> mSource;
@@ -0,0 +1,547 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FragmentedMP4Parser_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Vector.h>
+
+#include "include/FragmentedMP4Parser.h"
+
+namespace android {
+
+// Serializes a single ISO BMFF box, the size is filled in by data().
+struct Box {
+    Box(const char *type) {
+        put32(0);
+        putFourCC(type);
+    }
+
+    void put8(uint8_t x) {
+        mData.push_back(x);
+    }
+
+    void put16(uint16_t x) {
+        put8(x >> 8);
+        put8(x & 0xff);
+    }
+
+    void put32(uint32_t x) {
+        put16(x >> 16);
+        put16(x & 0xffff);
+    }
+
+    void put64(uint64_t x) {
+        put32(x >> 32);
+        put32(x & 0xffffffff);
+    }
+
+    void putFourCC(const char *type) {
+        put(type, 4);
+    }
+
+    void putZeros(size_t count) {
+        while (count-- > 0) {
+            put8(0);
+        }
+    }
+
+    void put(const void *data, size_t size) {
+        mData.appendArray((const uint8_t *)data, size);
+    }
+
+    void put(const Box &box) {
+        const Vector<uint8_t> &data = box.data();
+        mData.appendVector(data);
+    }
+
+    const Vector<uint8_t> &data() const {
+        uint32_t size = mData.size();
+        uint8_t *ptr = const_cast<Vector<uint8_t> &>(mData).editArray();
+        ptr[0] = size >> 24;
+        ptr[1] = (size >> 16) & 0xff;
+        ptr[2] = (size >> 8) & 0xff;
+        ptr[3] = size & 0xff;
+        return mData;
+    }
+
+private:
+    Vector<uint8_t> mData;
+};
+
+static const uint32_t kVideoTrackID = 1;
+static const uint32_t kVideoTimescale = 90000;
+static const uint32_t kVideoSampleDuration = 3000;
+static const uint32_t kAudioTrackID = 2;
+static const uint32_t kAudioTimescale = 8000;
+static const uint32_t kAudioSampleDuration = 160;
+static const uint32_t kAudioSampleSize = 13;
+static const size_t kSamplesPerFragment = 3;
+
+static Box makeTrack(uint32_t trackID, uint32_t timescale, bool video) {
+    Box tkhd("tkhd");
+    tkhd.putZeros(12);  // version, flags, creation and modification time
+    tkhd.put32(trackID);
+    tkhd.putZeros(8 + 16);
+    static const uint32_t kIdentity[] =
+        { 0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000 };
+    for (size_t i = 0; i < NELEM(kIdentity); ++i) {
+        tkhd.put32(kIdentity[i]);
+    }
+    tkhd.putZeros(8);
+
+    Box mdhd("mdhd");
+    mdhd.putZeros(12);
+    mdhd.put32(timescale);
+    mdhd.put32(0);  // duration
+    mdhd.put16(0x55c4);  // "und"
+    mdhd.put16(0);
+
+    Box hdlr("hdlr");
+    hdlr.putZeros(8);
+    hdlr.putFourCC(video ? "vide" : "soun");
+    hdlr.putZeros(13);
+
+    Box stsd("stsd");
+    stsd.put32(0);
+    stsd.put32(1);
+    if (video) {
+        Box avc1("avc1");
+        avc1.putZeros(6);
+        avc1.put16(1);  // data reference index
+        avc1.putZeros(16);
+        avc1.put16(320);
+        avc1.put16(240);
+        avc1.put32(0x480000);
+        avc1.put32(0x480000);
+        avc1.put32(0);
+        avc1.put16(1);
+        avc1.putZeros(32);
+        avc1.put16(0x18);
+        avc1.put16(0xffff);
+
+        // 4 byte NAL lengths, no parameter sets
+        static const uint8_t kAVCC[] = { 1, 0x42, 0xc0, 0x1e, 0xff, 0xe0, 0x00 };
+        Box avcC("avcC");
+        avcC.put(kAVCC, sizeof(kAVCC));
+        avc1.put(avcC);
+
+        stsd.put(avc1);
+    } else {
+        Box samr("samr");
+        samr.putZeros(6);
+        samr.put16(1);
+        samr.putZeros(8);
+        samr.put16(1);  // channels
+        samr.put16(16);
+        samr.putZeros(4);
+        samr.put32(8000 << 16);
+        stsd.put(samr);
+    }
+
+    // empty sample tables, the samples are in the fragments
+    Box stts("stts");
+    stts.putZeros(8);
+    Box stsc("stsc");
+    stsc.putZeros(8);
+    Box stsz("stsz");
+    stsz.putZeros(12);
+    Box stco("stco");
+    stco.putZeros(8);
+
+    Box stbl("stbl");
+    stbl.put(stsd);
+    stbl.put(stts);
+    stbl.put(stsc);
+    stbl.put(stsz);
+    stbl.put(stco);
+
+    Box minf("minf");
+    minf.put(stbl);
+
+    Box mdia("mdia");
+    mdia.put(mdhd);
+    mdia.put(hdlr);
+    mdia.put(minf);
+
+    Box trak("trak");
+    trak.put(tkhd);
+    trak.put(mdia);
+    return trak;
+}
+
+static Box makeTrex(uint32_t trackID, uint32_t duration, uint32_t size, uint32_t flags) {
+    Box trex("trex");
+    trex.put32(0);
+    trex.put32(trackID);
+    trex.put32(1);
+    trex.put32(duration);
+    trex.put32(size);
+    trex.put32(flags);
+    return trex;
+}
+
+// Video sample |index| consists of two NAL units, either length prefixed
+// as stored in the mdat or with start codes as the parser outputs them.
+static AString videoSample(size_t index, bool startCodes = false) {
+    uint8_t nal1[] = { 0x65, 0x88, (uint8_t)index, 0x00, 0x00 };
+    if (index % kSamplesPerFragment != 0) {
+        nal1[0] = 0x41;
+    }
+    uint8_t nal2[] = { 0x06, 0x05, (uint8_t)index };
+
+    AString sample;
+    sample.append(startCodes ? "\x00\x00\x00\x01" : "\x00\x00\x00\x05", 4);
+    sample.append((const char *)nal1, sizeof(nal1));
+    sample.append(startCodes ? "\x00\x00\x00\x01" : "\x00\x00\x00\x03", 4);
+    sample.append((const char *)nal2, sizeof(nal2));
+    return sample;
+}
+
+static AString audioSample(size_t index) {
+    AString sample;
+    for (size_t i = 0; i < kAudioSampleSize; ++i) {
+        sample.append((char)(0x3c ^ (index + i)));
+    }
+    return sample;
+}
+
+// Composition offsets of the video samples within a fragment, B-frame style.
+static const uint32_t kCtsOffsets[kSamplesPerFragment] = { 6000, 0, 3000 };
+
+// Builds a moof + mdat pair. The first fragment uses default-base-is-moof
+// and explicit data offsets for both tracks, later ones rely on the implicit
+// base of the audio traf following the video data. The mdat starts with
+// |leadingBytes| bytes that no sample refers to.
+static void appendFragment(
+        size_t fragment, Vector<uint8_t> *stream, size_t leadingBytes) {
+    bool baseIsMoof = (fragment == 0);
+    size_t firstSample = fragment * kSamplesPerFragment;
+
+    AString videoData, audioData;
+    for (size_t i = 0; i < kSamplesPerFragment; ++i) {
+        videoData.append(videoSample(firstSample + i));
+        audioData.append(audioSample(firstSample + i));
+    }
+
+    uint32_t moofSize = 0;
+    Box moof("moof");
+    for (int pass = 0; pass < 2; ++pass) {
+        // the moof size doesn't depend on the offsets written into it
+        moof = Box("moof");
+
+        Box mfhd("mfhd");
+        mfhd.put32(0);
+        mfhd.put32(fragment + 1);
+        moof.put(mfhd);
+
+        Box videoTfhd("tfhd");
+        videoTfhd.put32(baseIsMoof ? 0x20000 : 0);
+        videoTfhd.put32(kVideoTrackID);
+        Box videoTfdt("tfdt");
+        videoTfdt.put32(0x01000000);
+        videoTfdt.put64((uint64_t)firstSample * kVideoSampleDuration);
+        Box videoTrun("trun");
+        videoTrun.put32(0x1 | 0x4 | 0x200 | 0x800);
+        videoTrun.put32(kSamplesPerFragment);
+        videoTrun.put32(moofSize + 8 + leadingBytes);
+        videoTrun.put32(0);  // first sample is a sync sample
+        for (size_t i = 0; i < kSamplesPerFragment; ++i) {
+            videoTrun.put32(videoSample(firstSample + i).size());
+            videoTrun.put32(kCtsOffsets[i]);
+        }
+        Box videoTraf("traf");
+        videoTraf.put(videoTfhd);
+        videoTraf.put(videoTfdt);
+        videoTraf.put(videoTrun);
+        moof.put(videoTraf);
+
+        Box audioTfhd("tfhd");
+        audioTfhd.put32((baseIsMoof ? 0x20000 : 0) | 0x10);
+        audioTfhd.put32(kAudioTrackID);
+        audioTfhd.put32(kAudioSampleSize);
+        Box audioTfdt("tfdt");
+        audioTfdt.put32(0);
+        audioTfdt.put32(firstSample * kAudioSampleDuration);
+        Box audioTrun("trun");
+        if (baseIsMoof) {
+            audioTrun.put32(0x1);
+            audioTrun.put32(kSamplesPerFragment);
+            audioTrun.put32(moofSize + 8 + leadingBytes + videoData.size());
+        } else {
+            audioTrun.put32(0);
+            audioTrun.put32(kSamplesPerFragment);
+        }
+        Box audioTraf("traf");
+        audioTraf.put(audioTfhd);
+        audioTraf.put(audioTfdt);
+        audioTraf.put(audioTrun);
+        moof.put(audioTraf);
+
+        moofSize = moof.data().size();
+    }
+
+    Box mdat("mdat");
+    for (size_t i = 0; i < leadingBytes; ++i) {
+        mdat.put8(0xa5);
+    }
+    mdat.put(videoData.c_str(), videoData.size());
+    mdat.put(audioData.c_str(), audioData.size());
+
+    stream->appendVector(moof.data());
+    stream->appendVector(mdat.data());
+}
+
+static Vector<uint8_t> makeStream(size_t numFragments, size_t leadingBytes = 0) {
+    Vector<uint8_t> stream;
+
+    Box ftyp("ftyp");
+    ftyp.putFourCC("iso6");
+    ftyp.put32(0);
+    ftyp.putFourCC("iso6");
+    ftyp.putFourCC("cmfc");
+    stream.appendVector(ftyp.data());
+
+    Box mvhd("mvhd");
+    mvhd.putZeros(12);
+    mvhd.put32(1000);
+    mvhd.putZeros(100 - 16);
+
+    Box mvex("mvex");
+    mvex.put(makeTrex(kVideoTrackID, kVideoSampleDuration, 0, 0x10000));
+    mvex.put(makeTrex(kAudioTrackID, kAudioSampleDuration, 0, 0));
+
+    Box moov("moov");
+    moov.put(mvhd);
+    moov.put(makeTrack(kVideoTrackID, kVideoTimescale, true /* video */));
+    moov.put(makeTrack(kAudioTrackID, kAudioTimescale, false /* video */));
+    moov.put(mvex);
+    stream.appendVector(moov.data());
+
+    for (size_t i = 0; i < numFragments; ++i) {
+        appendFragment(i, &stream, leadingBytes);
+    }
+
+    return stream;
+}
+
+struct Sample {
+    size_t mTrack;
+    AString mData;
+    int64_t mTimeUs;
+    bool mIsSync;
+};
+
+static void drain(const sp<FragmentedMP4Parser> &parser, Vector<Sample> *samples) {
+    for (size_t i = 0; i < parser->countTracks(); ++i) {
+        sp<ABuffer> accessUnit;
+        while (parser->dequeueAccessUnit(i, &accessUnit) == OK) {
+            Sample sample;
+            sample.mTrack = i;
+            sample.mData.setTo((const char *)accessUnit->data(), accessUnit->size());
+            CHECK(accessUnit->meta()->findInt64("timeUs", &sample.mTimeUs));
+            int32_t isSync;
+            sample.mIsSync = accessUnit->meta()->findInt32("isSync", &isSync) && isSync;
+            samples->push_back(sample);
+        }
+    }
+}
+
+static void expectSameSamples(const Vector<Sample> &a, const Vector<Sample> &b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(a[i].mTrack, b[i].mTrack);
+        EXPECT_EQ(a[i].mTimeUs, b[i].mTimeUs);
+        EXPECT_EQ(a[i].mIsSync, b[i].mIsSync);
+        EXPECT_TRUE(a[i].mData == b[i].mData) << "sample " << i;
+    }
+}
+
+// Feeds |stream| split into chunks at the given offsets, draining the
+// parser after every chunk the way a live consumer would.
+static status_t feed(
+        const Vector<uint8_t> &stream, const Vector<size_t> &splits,
+        Vector<Sample> *samples) {
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    size_t offset = 0;
+    for (size_t i = 0; i <= splits.size(); ++i) {
+        size_t end = i < splits.size() ? splits[i] : stream.size();
+        status_t err = parser->appendData(stream.array() + offset, end - offset);
+        if (err != OK) {
+            return err;
+        }
+        drain(parser, samples);
+        offset = end;
+    }
+    return parser->signalEndOfStream();
+}
+
+// Sorts by track so that samples can be compared regardless of when they
+// were drained.
+static Vector<Sample> byTrack(const Vector<Sample> &samples) {
+    Vector<Sample> sorted;
+    for (size_t track = 0; track < 2; ++track) {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (samples[i].mTrack == track) {
+                sorted.push_back(samples[i]);
+            }
+        }
+    }
+    return sorted;
+}
+
+TEST(FragmentedMP4ParserTest, ParsesStream) {
+    static const size_t kNumFragments = 2;
+    Vector<uint8_t> stream = makeStream(kNumFragments);
+
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    ASSERT_EQ(OK, parser->appendData(stream.array(), stream.size()));
+    ASSERT_EQ(OK, parser->signalEndOfStream());
+
+    ASSERT_EQ(2u, parser->countTracks());
+    const char *mime;
+    ASSERT_TRUE(parser->getTrackFormat(0)->findCString(kKeyMIMEType, &mime));
+    EXPECT_STREQ(MEDIA_MIMETYPE_VIDEO_AVC, mime);
+    ASSERT_TRUE(parser->getTrackFormat(1)->findCString(kKeyMIMEType, &mime));
+    EXPECT_STREQ(MEDIA_MIMETYPE_AUDIO_AMR_NB, mime);
+
+    Vector<Sample> samples;
+    drain(parser, &samples);
+    ASSERT_EQ(2 * kNumFragments * kSamplesPerFragment, samples.size());
+
+    sp<ABuffer> accessUnit;
+    EXPECT_EQ(ERROR_END_OF_STREAM, parser->dequeueAccessUnit(0, &accessUnit));
+
+    for (size_t i = 0; i < kNumFragments * kSamplesPerFragment; ++i) {
+        const Sample &video = samples[i];
+        size_t indexInFragment = i % kSamplesPerFragment;
+        EXPECT_EQ(0u, video.mTrack);
+        EXPECT_EQ((int64_t)(i * kVideoSampleDuration + kCtsOffsets[indexInFragment])
+                * 1000000ll / kVideoTimescale, video.mTimeUs);
+        EXPECT_EQ(indexInFragment == 0, video.mIsSync);
+
+        EXPECT_TRUE(videoSample(i, true /* startCodes */) == video.mData)
+                << "video sample " << i;
+
+        const Sample &audio = samples[kNumFragments * kSamplesPerFragment + i];
+        EXPECT_EQ(1u, audio.mTrack);
+        EXPECT_EQ((int64_t)i * kAudioSampleDuration * 1000000ll / kAudioTimescale,
+                audio.mTimeUs);
+        EXPECT_TRUE(audio.mIsSync);
+        EXPECT_TRUE(audioSample(i) == audio.mData) << "audio sample " << i;
+    }
+}
+
+TEST(FragmentedMP4ParserTest, SplitAtEveryOffset) {
+    Vector<uint8_t> stream = makeStream(2);
+
+    Vector<Sample> reference;
+    ASSERT_EQ(OK, feed(stream, Vector<size_t>(), &reference));
+
+    for (size_t split = 1; split < stream.size(); ++split) {
+        Vector<size_t> splits;
+        splits.push_back(split);
+
+        Vector<Sample> samples;
+        ASSERT_EQ(OK, feed(stream, splits, &samples)) << "split at " << split;
+        expectSameSamples(reference, byTrack(samples));
+    }
+}
+
+TEST(FragmentedMP4ParserTest, ByteByByte) {
+    Vector<uint8_t> stream = makeStream(3);
+
+    Vector<Sample> reference;
+    ASSERT_EQ(OK, feed(stream, Vector<size_t>(), &reference));
+
+    Vector<size_t> splits;
+    for (size_t i = 1; i < stream.size(); ++i) {
+        splits.push_back(i);
+    }
+
+    Vector<Sample> samples;
+    ASSERT_EQ(OK, feed(stream, splits, &samples));
+    expectSameSamples(reference, byTrack(samples));
+}
+
+TEST(FragmentedMP4ParserTest, ByteByByteWithUnreferencedMdatData) {
+    // the next sample starts past the data received so far, as it would
+    // after the data of an ignored track or a gap in the mdat
+    Vector<uint8_t> stream = makeStream(2, 64 /* leadingBytes */);
+
+    Vector<Sample> reference;
+    ASSERT_EQ(OK, feed(makeStream(2), Vector<size_t>(), &reference));
+    ASSERT_EQ(2 * 2 * kSamplesPerFragment, reference.size());
+
+    Vector<Sample> whole;
+    ASSERT_EQ(OK, feed(stream, Vector<size_t>(), &whole));
+    expectSameSamples(reference, whole);
+
+    Vector<size_t> splits;
+    for (size_t i = 1; i < stream.size(); ++i) {
+        splits.push_back(i);
+    }
+
+    Vector<Sample> samples;
+    ASSERT_EQ(OK, feed(stream, splits, &samples));
+    expectSameSamples(reference, byTrack(samples));
+}
+
+TEST(FragmentedMP4ParserTest, EmitsSamplesBeforeMdatIsComplete) {
+    Vector<uint8_t> stream = makeStream(1);
+    Vector<uint8_t> moovOnly = makeStream(0);
+
+    // everything up to and including the first video sample
+    size_t mdatOffset = stream.size()
+            - 8 - kSamplesPerFragment * (videoSample(0).size() + kAudioSampleSize);
+    size_t end = mdatOffset + 8 + videoSample(0).size();
+    ASSERT_GT(mdatOffset, moovOnly.size());
+
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    ASSERT_EQ(OK, parser->appendData(stream.array(), end - 1));
+    sp<ABuffer> accessUnit;
+    EXPECT_EQ(-EAGAIN, parser->dequeueAccessUnit(0, &accessUnit));
+
+    ASSERT_EQ(OK, parser->appendData(stream.array() + end - 1, 1));
+    EXPECT_EQ(OK, parser->dequeueAccessUnit(0, &accessUnit));
+    EXPECT_EQ(-EAGAIN, parser->dequeueAccessUnit(0, &accessUnit));
+    EXPECT_EQ(-EAGAIN, parser->dequeueAccessUnit(1, &accessUnit));
+}
+
+TEST(FragmentedMP4ParserTest, TruncatedStream) {
+    Vector<uint8_t> stream = makeStream(1);
+
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    ASSERT_EQ(OK, parser->appendData(stream.array(), stream.size() - 1));
+    EXPECT_EQ(ERROR_MALFORMED, parser->signalEndOfStream());
+
+    // errors are sticky until flushed
+    EXPECT_EQ(ERROR_MALFORMED, parser->appendData(stream.array(), 1));
+    parser->flush();
+    EXPECT_EQ(OK, parser->signalEndOfStream());
+}
+
+}  // namespace android
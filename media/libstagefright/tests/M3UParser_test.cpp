@@ -0,0 +1,374 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "M3UParser_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+#include "httplive/M3UParser.h"
+
+namespace android {
+
+static const char *kBaseURI = "http://example.com/live/index.m3u8";
+
+// Builds a media playlist listing segments [firstSeq, firstSeq + count).
+// Every 100th segment starts a new discontinuity.
+static AString makePlaylist(
+        int32_t firstSeq, int32_t count, bool event, bool endList, bool key) {
+    AString s("#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:6\n");
+    if (event) {
+        s.append("#EXT-X-PLAYLIST-TYPE:EVENT\n");
+    }
+    s.append(AStringPrintf("#EXT-X-MEDIA-SEQUENCE:%d\n", firstSeq));
+    s.append(AStringPrintf("#EXT-X-DISCONTINUITY-SEQUENCE:%d\n", firstSeq / 100));
+    if (key) {
+        s.append("#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\"\n");
+    }
+    for (int32_t seq = firstSeq; seq < firstSeq + count; ++seq) {
+        if (seq % 100 == 0 && seq != firstSeq) {
+            s.append("#EXT-X-DISCONTINUITY\n");
+        }
+        s.append(AStringPrintf("#EXTINF:%d.%03d,\n", 5 + seq % 2, seq % 1000));
+        s.append(AStringPrintf("segment%d.ts\n", seq));
+    }
+    if (endList) {
+        s.append("#EXT-X-ENDLIST\n");
+    }
+    return s;
+}
+
+static sp<M3UParser> parse(const AString &text, const sp<M3UParser> &previous = NULL) {
+    return new M3UParser(kBaseURI, text.c_str(), text.size(), previous);
+}
+
+static void expectSamePlaylist(const sp<M3UParser> &a, const sp<M3UParser> &b) {
+    ASSERT_EQ(OK, a->initCheck());
+    ASSERT_EQ(OK, b->initCheck());
+    ASSERT_EQ(a->size(), b->size());
+    ASSERT_EQ(a->getFirstSeqNumber(), b->getFirstSeqNumber());
+    ASSERT_EQ(a->isEvent(), b->isEvent());
+    ASSERT_EQ(a->isComplete(), b->isComplete());
+    ASSERT_EQ(a->getDurationUs(), b->getDurationUs());
+
+    for (size_t i = 0; i < a->size(); ++i) {
+        AString uriA, uriB;
+        sp<AMessage> metaA, metaB;
+        ASSERT_TRUE(a->itemAt(i, &uriA, &metaA));
+        ASSERT_TRUE(b->itemAt(i, &uriB, &metaB));
+        EXPECT_EQ(uriA, uriB);
+        EXPECT_EQ(metaA->debugString(), metaB->debugString());
+        EXPECT_EQ(a->getItemStartTimeUs(i), b->getItemStartTimeUs(i));
+        EXPECT_EQ(a->getItemDiscontinuitySeq(i), b->getItemDiscontinuitySeq(i));
+    }
+}
+
+// Produces the playlists of a low-latency live origin. Segments consist of
+// kPartsPerSegment one-second parts; parts are listed for the last
+// kSegmentsWithParts complete segments and for the segment in progress, and
+// the part being produced next is announced with a preload hint.
+class LowLatencyOrigin {
+public:
+    enum {
+        kPartsPerSegment   = 4,
+        kWindowSegments    = 6,
+        kSegmentsWithParts = 2,
+    };
+
+    LowLatencyOrigin() : mNumPartsProduced(0) {}
+
+    void produceParts(int32_t count) {
+        mNumPartsProduced += count;
+    }
+
+    int32_t numCompleteSegments() const {
+        return mNumPartsProduced / kPartsPerSegment;
+    }
+
+    AString playlist() const {
+        int32_t complete = numCompleteSegments();
+        int32_t firstSeq = complete > kWindowSegments ? complete - kWindowSegments : 0;
+
+        AString s("#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:4\n");
+        s.append("#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=3.0\n");
+        s.append("#EXT-X-PART-INF:PART-TARGET=1.0\n");
+        s.append(AStringPrintf("#EXT-X-MEDIA-SEQUENCE:%d\n", firstSeq));
+        for (int32_t seq = firstSeq; seq <= complete; ++seq) {
+            int32_t numParts = seq < complete
+                    ? kPartsPerSegment : mNumPartsProduced % kPartsPerSegment;
+            if (seq >= complete - kSegmentsWithParts) {
+                for (int32_t part = 0; part < numParts; ++part) {
+                    s.append(AStringPrintf(
+                            "#EXT-X-PART:DURATION=1.0,URI=\"seg%d.part%d.ts\"%s\n",
+                            seq, part, part % 2 == 0 ? ",INDEPENDENT=YES" : ""));
+                }
+            }
+            if (seq < complete) {
+                s.append("#EXTINF:4.0,\n");
+                s.append(AStringPrintf("seg%d.ts\n", seq));
+            }
+        }
+        s.append(AStringPrintf(
+                "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"seg%d.part%d.ts\"\n",
+                complete, mNumPartsProduced % kPartsPerSegment));
+        return s;
+    }
+
+private:
+    int32_t mNumPartsProduced;
+};
+
+static AString partURI(int32_t seq, int32_t part) {
+    return AStringPrintf("http://example.com/live/seg%d.part%d.ts", seq, part);
+}
+
+class M3UParserTest : public ::testing::Test {
+};
+
+TEST_F(M3UParserTest, SlidingWindowRefreshReusesSegments) {
+    sp<M3UParser> first = parse(makePlaylist(95, 20, false, false, false));
+    ASSERT_EQ(OK, first->initCheck());
+
+    // six segments rolled off, including the discontinuity at 100
+    AString text = makePlaylist(101, 20, false, false, false);
+    sp<M3UParser> incremental = parse(text, first);
+    sp<M3UParser> fresh = parse(text);
+
+    EXPECT_EQ(14u, incremental->getReusedItemCount());
+    expectSamePlaylist(fresh, incremental);
+}
+
+TEST_F(M3UParserTest, SlidingWindowWithLeadingKeyIsReparsed) {
+    sp<M3UParser> first = parse(makePlaylist(95, 20, false, false, true));
+
+    // the EXT-X-KEY now precedes a different segment
+    AString text = makePlaylist(98, 20, false, false, true);
+    sp<M3UParser> incremental = parse(text, first);
+    sp<M3UParser> fresh = parse(text);
+
+    EXPECT_EQ(0u, incremental->getReusedItemCount());
+    expectSamePlaylist(fresh, incremental);
+}
+
+TEST_F(M3UParserTest, EventRefreshReusesSegments) {
+    sp<M3UParser> first = parse(makePlaylist(0, 150, true, false, true));
+    ASSERT_EQ(OK, first->initCheck());
+
+    AString text = makePlaylist(0, 160, true, true, true);
+    sp<M3UParser> incremental = parse(text, first);
+    sp<M3UParser> fresh = parse(text);
+
+    EXPECT_EQ(150u, incremental->getReusedItemCount());
+    EXPECT_TRUE(incremental->isComplete());
+    expectSamePlaylist(fresh, incremental);
+}
+
+TEST_F(M3UParserTest, ChangedSegmentIsNotReused) {
+    AString text = makePlaylist(0, 10, true, false, false);
+    sp<M3UParser> first = parse(text);
+
+    ssize_t pos = text.find("segment5.ts");
+    ASSERT_GE(pos, 0);
+    text.erase(pos, strlen("segment5.ts"));
+    text.insert(AString("replaced5.ts"), pos);
+
+    sp<M3UParser> incremental = parse(text, first);
+    sp<M3UParser> fresh = parse(text);
+
+    EXPECT_EQ(0u, incremental->getReusedItemCount());
+    expectSamePlaylist(fresh, incremental);
+}
+
+TEST_F(M3UParserTest, TimeLookup) {
+    sp<M3UParser> playlist = parse(makePlaylist(0, 10, true, true, false));
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    for (size_t i = 0; i < playlist->size(); ++i) {
+        int64_t startUs = playlist->getItemStartTimeUs(i);
+        EXPECT_EQ(i, playlist->getItemIndexForTime(startUs));
+        EXPECT_EQ(i, playlist->getItemIndexForTime(
+                startUs + playlist->getItemDurationUs(i) - 1));
+    }
+    EXPECT_EQ(playlist->size() - 1,
+            playlist->getItemIndexForTime(playlist->getDurationUs() + 1));
+}
+
+TEST_F(M3UParserTest, LowLatencyPlaylist) {
+    LowLatencyOrigin origin;
+    origin.produceParts(4 * 10 + 2);
+    sp<M3UParser> playlist = parse(origin.playlist());
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    int32_t firstSeq, lastSeq;
+    playlist->getSeqNumberRange(&firstSeq, &lastSeq);
+    EXPECT_EQ(4, firstSeq);
+    EXPECT_EQ(9, lastSeq);
+
+    EXPECT_TRUE(playlist->hasParts());
+    EXPECT_TRUE(playlist->canBlockReload());
+    EXPECT_EQ(1000000ll, playlist->getPartTargetDuration());
+    EXPECT_EQ(3000000ll, playlist->getPartHoldBackUs());
+
+    // segments 8 and 9 plus two parts of the unlisted segment 10
+    ASSERT_EQ(10u, playlist->getPartCount());
+    EXPECT_LT(playlist->findPart(7, 3), 0);
+    EXPECT_EQ(0, playlist->findPart(8, 0));
+    EXPECT_EQ(9, playlist->findPart(10, 1));
+    EXPECT_LT(playlist->findPart(10, 2), 0);
+
+    int32_t seq, part;
+    AString uri;
+    sp<AMessage> meta;
+    ASSERT_TRUE(playlist->partAt(9, &seq, &part, &uri, &meta));
+    EXPECT_EQ(10, seq);
+    EXPECT_EQ(1, part);
+    EXPECT_EQ(partURI(10, 1), uri);
+    int64_t durationUs;
+    int32_t independent;
+    ASSERT_TRUE(meta->findInt64("durationUs", &durationUs));
+    EXPECT_EQ(1000000ll, durationUs);
+    ASSERT_TRUE(meta->findInt32("independent", &independent));
+    EXPECT_EQ(0, independent);
+
+    ASSERT_TRUE(playlist->getPreloadHint(&seq, &part, &uri));
+    EXPECT_EQ(10, seq);
+    EXPECT_EQ(2, part);
+    EXPECT_EQ(partURI(10, 2), uri);
+}
+
+// Without a valid EXT-X-PART-INF, part timing falls back to the target
+// duration rather than to -1.
+TEST_F(M3UParserTest, LowLatencyPlaylistWithoutPartInf) {
+    LowLatencyOrigin origin;
+    origin.produceParts(4 * 10 + 2);
+    AString text = origin.playlist();
+    const char *kPartInf = "#EXT-X-PART-INF:PART-TARGET=1.0\n";
+    ssize_t pos = text.find(kPartInf);
+    ASSERT_GE(pos, 0);
+    text.erase(pos, strlen(kPartInf));
+    const char *kHoldBack = ",PART-HOLD-BACK=3.0";
+    pos = text.find(kHoldBack);
+    ASSERT_GE(pos, 0);
+    text.erase(pos, strlen(kHoldBack));
+
+    sp<M3UParser> playlist = parse(text);
+    ASSERT_EQ(OK, playlist->initCheck());
+    EXPECT_TRUE(playlist->hasParts());
+    EXPECT_EQ(4000000ll, playlist->getPartTargetDuration());
+    EXPECT_EQ(12000000ll, playlist->getPartHoldBackUs());
+}
+
+TEST_F(M3UParserTest, LowLatencyPreloadHintAtSegmentBoundary) {
+    LowLatencyOrigin origin;
+    origin.produceParts(4 * 3);
+    sp<M3UParser> playlist = parse(origin.playlist());
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    int32_t seq, part;
+    AString uri;
+    ASSERT_TRUE(playlist->getPreloadHint(&seq, &part, &uri));
+    EXPECT_EQ(3, seq);
+    EXPECT_EQ(0, part);
+    EXPECT_EQ(partURI(3, 0), uri);
+}
+
+// Follows the live edge part by part the way PlaylistFetcher does, reloading
+// the playlist after every part the origin produces.
+TEST_F(M3UParserTest, LowLatencyFollowLiveEdge) {
+    LowLatencyOrigin origin;
+    origin.produceParts(4 * 8 + 1);
+
+    sp<M3UParser> playlist = parse(origin.playlist());
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    int32_t seq, part;
+    ASSERT_TRUE(playlist->partAt(playlist->getPartCount() - 1, &seq, &part, NULL));
+
+    for (int32_t i = 0; i < 4 * 5; ++i) {
+        origin.produceParts(1);
+        playlist = parse(origin.playlist(), playlist);
+        ASSERT_EQ(OK, playlist->initCheck());
+        EXPECT_EQ(0u, playlist->getReusedItemCount());
+
+        int32_t firstSeq, lastSeq;
+        playlist->getSeqNumberRange(&firstSeq, &lastSeq);
+        if (seq <= lastSeq && playlist->findPart(seq, part + 1) < 0) {
+            ++seq;
+            part = 0;
+        } else {
+            ++part;
+        }
+
+        ssize_t index = playlist->findPart(seq, part);
+        ASSERT_GE(index, 0) << "segment " << seq << " part " << part;
+        AString uri;
+        ASSERT_TRUE(playlist->partAt(index, NULL, NULL, &uri));
+        EXPECT_EQ(partURI(seq, part), uri);
+    }
+}
+
+// Refreshes a long event playlist with the previous parse, and checks the
+// result against a full parse. The cost of both is only logged.
+TEST_F(M3UParserTest, RefreshLargePlaylist) {
+    const int32_t kNumSegments = 10000;
+    const int32_t kNumRefreshes = 20;
+
+    sp<M3UParser> previous = parse(makePlaylist(0, kNumSegments, true, false, true));
+    ASSERT_EQ(OK, previous->initCheck());
+
+    int64_t freshUs = 0ll;
+    int64_t incrementalUs = 0ll;
+    for (int32_t i = 1; i <= kNumRefreshes; ++i) {
+        AString text = makePlaylist(0, kNumSegments + i, true, false, true);
+
+        int64_t startUs = ALooper::GetNowUs();
+        sp<M3UParser> fresh = parse(text);
+        freshUs += ALooper::GetNowUs() - startUs;
+
+        startUs = ALooper::GetNowUs();
+        sp<M3UParser> incremental = parse(text, previous);
+        incrementalUs += ALooper::GetNowUs() - startUs;
+
+        ASSERT_EQ(OK, incremental->initCheck());
+        ASSERT_EQ((size_t)(kNumSegments + i - 1), incremental->getReusedItemCount());
+        ASSERT_EQ((size_t)(kNumSegments + i), incremental->size());
+
+        int32_t firstSeq, lastSeq;
+        incremental->getSeqNumberRange(&firstSeq, &lastSeq);
+        EXPECT_EQ(0, firstSeq);
+        EXPECT_EQ(kNumSegments + i - 1, lastSeq);
+
+        if (i == kNumRefreshes) {
+            // the segments taken over and those appended read back as parsed
+            expectSamePlaylist(fresh, incremental);
+        }
+        previous = incremental;
+    }
+
+    ALOGI("%d refreshes of %d segments: %lld us parsed, %lld us incremental",
+            kNumRefreshes, kNumSegments,
+            (long long)freshUs, (long long)incrementalUs);
+}
+
+} // namespace android
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MPEG2TSWriter_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/MPEG2TSWriter.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+
+#include "SyntheticSource.h"
+
+namespace android {
+
+static const int32_t kVideoFrameRate = 30;
+static const int32_t kAudioFrameRate = 43;
+static const int32_t kDurationSecs = 2;
+static const int32_t kMuxRate = 2000000;
+
+struct Output {
+    Vector<uint8_t> mData;
+    Vector<size_t> mWriteSizes;
+};
+
+static ssize_t writeOutput(void *cookie, const void *data, size_t size) {
+    Output *output = (Output *)cookie;
+    output->mData.appendArray((const uint8_t *)data, size);
+    output->mWriteSizes.push(size);
+    return size;
+}
+
+// Frames come no faster than in real time, as from an encoder.
+static sp<MediaSource> newSource(bool video, size_t frameSize) {
+    const char *mime = video ? MEDIA_MIMETYPE_VIDEO_AVC : MEDIA_MIMETYPE_AUDIO_AAC;
+    int32_t frameRate = video ? kVideoFrameRate : kAudioFrameRate;
+    return new SyntheticSource(mime, kDurationSecs * frameRate, frameRate, frameSize,
+            SyntheticSource::kFlagRealTime);
+}
+
+// Records two programs of AVC and AAC, the second one at a lower rate.
+static void record(int32_t muxRate, Output *output) {
+    sp<MPEG2TSWriter> writer = new MPEG2TSWriter(output, writeOutput);
+    ASSERT_EQ(OK, writer->addSource(newSource(true /* video */, 2000), 1));
+    ASSERT_EQ(OK, writer->addSource(newSource(false /* video */, 300), 1));
+    ASSERT_EQ(OK, writer->addSource(newSource(true /* video */, 1000), 2));
+    ASSERT_EQ(OK, writer->addSource(newSource(false /* video */, 200), 2));
+    ASSERT_EQ(BAD_VALUE, writer->addSource(newSource(false /* video */, 200), 0));
+
+    sp<MetaData> params = new MetaData;
+    if (muxRate > 0) {
+        params->setInt32(kKeyMuxRate, muxRate);
+    }
+    ASSERT_EQ(OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    ASSERT_EQ(OK, writer->stop());
+}
+
+struct TSInfo {
+    // program_number -> PMT PID, from the last PAT
+    KeyedVector<unsigned, unsigned> mPMTPIDs;
+    // PMT PID -> PCR PID, stream PIDs
+    KeyedVector<unsigned, unsigned> mPCRPIDs;
+    KeyedVector<unsigned, Vector<unsigned> > mStreamPIDs;
+    // PID -> number of PES packets started
+    DefaultKeyedVector<unsigned, size_t> mNumPES;
+    // PID -> (packet index, 27 MHz PCR) of each PCR
+    KeyedVector<unsigned, Vector<std::pair<size_t, int64_t> > > mPCRs;
+    size_t mNumNullPackets;
+};
+
+static void parse(const Vector<uint8_t> &data, TSInfo *info) {
+    ASSERT_EQ(0u, data.size() % 188);
+    info->mNumNullPackets = 0;
+
+    KeyedVector<unsigned, unsigned> continuityCounters;
+    for (size_t n = 0; n < data.size() / 188; ++n) {
+        const uint8_t *packet = data.array() + n * 188;
+        ASSERT_EQ(0x47, packet[0]) << "packet " << n;
+
+        unsigned PID = (packet[1] & 0x1f) << 8 | packet[2];
+        bool payloadUnitStart = packet[1] & 0x40;
+        unsigned adaptationFieldControl = (packet[3] >> 4) & 3;
+        unsigned continuityCounter = packet[3] & 0x0f;
+
+        if (PID == 0x1fff) {
+            ++info->mNumNullPackets;
+            continue;
+        }
+
+        // the counter only advances on packets with payload
+        ssize_t index = continuityCounters.indexOfKey(PID);
+        if (index >= 0) {
+            unsigned expected = continuityCounters.valueAt(index);
+            if (adaptationFieldControl & 1) {
+                expected = (expected + 1) & 0x0f;
+            }
+            EXPECT_EQ(expected, continuityCounter) << "PID " << PID << " packet " << n;
+        }
+        continuityCounters.add(PID, continuityCounter);
+
+        const uint8_t *ptr = packet + 4;
+        if (adaptationFieldControl & 2) {
+            if (ptr[0] > 0 && (ptr[1] & 0x10)) {
+                const uint8_t *pcr = &ptr[2];
+                int64_t base = (int64_t)pcr[0] << 25 | pcr[1] << 17 | pcr[2] << 9
+                        | pcr[3] << 1 | pcr[4] >> 7;
+                int64_t ext = (pcr[4] & 1) << 8 | pcr[5];
+                if (info->mPCRs.indexOfKey(PID) < 0) {
+                    info->mPCRs.add(PID, Vector<std::pair<size_t, int64_t> >());
+                }
+                info->mPCRs.editValueFor(PID).push(std::make_pair(n, base * 300 + ext));
+            }
+            ptr += 1 + ptr[0];
+        }
+
+        if (!(adaptationFieldControl & 1) || !payloadUnitStart) {
+            continue;
+        }
+
+        if (PID == 0) {
+            const uint8_t *section = ptr + 1 + ptr[0];
+            size_t sectionLength = (section[1] & 0x0f) << 8 | section[2];
+            info->mPMTPIDs.clear();
+            for (size_t i = 8; i + 4 < sectionLength + 3; i += 4) {
+                info->mPMTPIDs.add(section[i] << 8 | section[i + 1],
+                        (section[i + 2] & 0x1f) << 8 | section[i + 3]);
+            }
+        } else if (ptr[0] == 0x00 && ptr[1] == 0x02) {
+            // pointer_field, then a program_map_section
+            const uint8_t *section = ptr + 1;
+            size_t sectionLength = (section[1] & 0x0f) << 8 | section[2];
+            info->mPCRPIDs.add(PID, (section[8] & 0x1f) << 8 | section[9]);
+            Vector<unsigned> streams;
+            for (size_t i = 12; i + 4 < sectionLength + 3; i += 5) {
+                streams.push((section[i + 1] & 0x1f) << 8 | section[i + 2]);
+            }
+            info->mStreamPIDs.add(PID, streams);
+        } else {
+            ASSERT_TRUE(!memcmp(ptr, "\x00\x00\x01", 3)) << "PID " << PID;
+            info->mNumPES.add(PID, info->mNumPES.valueFor(PID) + 1);
+        }
+    }
+}
+
+static void checkPrograms(const TSInfo &info) {
+    ASSERT_EQ(2u, info.mPMTPIDs.size());
+    for (size_t i = 0; i < info.mPMTPIDs.size(); ++i) {
+        unsigned PMTPID = info.mPMTPIDs.valueFor(i + 1);
+        ASSERT_GE(info.mStreamPIDs.indexOfKey(PMTPID), 0);
+
+        const Vector<unsigned> &streams = info.mStreamPIDs.valueFor(PMTPID);
+        ASSERT_EQ(2u, streams.size());
+        EXPECT_EQ(streams[0], info.mPCRPIDs.valueFor(PMTPID));
+
+        // the extra PES is the out of band AVC parameter sets
+        EXPECT_EQ((size_t)(kDurationSecs * kVideoFrameRate + 1),
+                info.mNumPES.valueFor(streams[0]));
+        EXPECT_GT(info.mNumPES.valueFor(streams[1]), 0u);
+    }
+}
+
+TEST(MPEG2TSWriterTest, MultipleProgramsToFile) {
+    Output output;
+    record(0, &output);
+
+    TSInfo info;
+    parse(output.mData, &info);
+    checkPrograms(info);
+
+    // the first program keeps the single program layout
+    EXPECT_EQ(0x1e0u, info.mPMTPIDs.valueFor(1));
+    EXPECT_EQ(0u, info.mNumNullPackets);
+    EXPECT_EQ(0u, info.mPCRs.size());
+
+    for (size_t i = 0; i + 1 < output.mWriteSizes.size(); ++i) {
+        EXPECT_EQ(7u * 188, output.mWriteSizes[i]);
+    }
+}
+
+TEST(MPEG2TSWriterTest, PacedOutputIsConstantRate) {
+    Output output;
+    record(kMuxRate, &output);
+
+    TSInfo info;
+    parse(output.mData, &info);
+    checkPrograms(info);
+    EXPECT_GT(info.mNumNullPackets, 0u);
+
+    for (size_t i = 0; i < output.mWriteSizes.size(); ++i) {
+        EXPECT_EQ(7u * 188, output.mWriteSizes[i]);
+    }
+
+    // every program has its clock, which advances with the packet count
+    ASSERT_EQ(2u, info.mPCRs.size());
+    const int64_t kPCRWrap = (1ll << 33) * 300;
+    const int64_t kTicksPerPacket = 188 * 8 * 27000000ll / kMuxRate;
+    for (size_t i = 0; i < info.mPCRs.size(); ++i) {
+        const Vector<std::pair<size_t, int64_t> > &PCRs = info.mPCRs.valueAt(i);
+        ASSERT_GT(PCRs.size(), (size_t)(kDurationSecs * 10));
+        for (size_t j = 1; j < PCRs.size(); ++j) {
+            int64_t delta = (PCRs[j].second - PCRs[j - 1].second + kPCRWrap) % kPCRWrap;
+            EXPECT_EQ((int64_t)(PCRs[j].first - PCRs[j - 1].first) * kTicksPerPacket, delta);
+            EXPECT_LE(delta, 40000 * 27 + kTicksPerPacket * 7);
+        }
+    }
+}
+
+} // namespace android
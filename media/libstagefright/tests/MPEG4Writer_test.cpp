@@ -0,0 +1,312 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MPEG4Writer_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/MPEG4Writer.h>
+#include <media/stagefright/Utils.h>
+#include <utils/misc.h>
+#include <utils/Vector.h>
+
+#include "include/FragmentedMP4Parser.h"
+#include "SyntheticSource.h"
+
+namespace android {
+
+static const int32_t kVideoFrameRate = 30;
+static const int32_t kAudioFrameRate = 50;
+static const int32_t kDurationSecs = 5;
+static const int64_t kFragmentDurationUs = 1000000ll;
+
+// Records both synthetic tracks and returns the file content. |configure|
+// gets to set up the writer once the tracks are added.
+static void record(const sp<MetaData> &params, Vector<uint8_t> *file,
+        void (*configure)(MPEG4Writer *writer) = NULL) {
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL);
+
+    sp<MPEG4Writer> writer = new MPEG4Writer(fileno(tmp));
+    // sync frames once a second, B frames are presented a frame late
+    ASSERT_EQ(OK, writer->addSource(new SyntheticSource(
+            MEDIA_MIMETYPE_VIDEO_AVC, kDurationSecs * kVideoFrameRate, kVideoFrameRate,
+            0 /* frameSize */, SyntheticSource::kFlagBFrames)));
+    ASSERT_EQ(OK, writer->addSource(new SyntheticSource(
+            MEDIA_MIMETYPE_AUDIO_AMR_NB, kDurationSecs * kAudioFrameRate, kAudioFrameRate,
+            0 /* frameSize */)));
+    if (configure != NULL) {
+        configure(writer.get());
+    }
+
+    params->setInt32(kKeyRealTimeRecording, false);
+    ASSERT_EQ(OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    ASSERT_EQ(OK, writer->stop());
+
+    off_t size = lseek(fileno(tmp), 0, SEEK_END);
+    ASSERT_GT(size, 0);
+    file->resize(size);
+    ASSERT_EQ(size, pread(fileno(tmp), file->editArray(), size, 0));
+    fclose(tmp);
+}
+
+static void recordFragmented(Vector<uint8_t> *file) {
+    sp<MetaData> params = new MetaData;
+    params->setInt64(kKeyFragmentDurationUs, kFragmentDurationUs);
+    record(params, file);
+}
+
+// Returns the offsets of the boxes of type |fourcc| in [start, end), by
+// default the top level ones.
+static Vector<size_t> findBoxes(
+        const Vector<uint8_t> &file, const char *fourcc, size_t start = 0, size_t end = 0) {
+    if (end == 0) {
+        end = file.size();
+    }
+    Vector<size_t> offsets;
+    size_t offset = start;
+    while (offset + 8 <= end) {
+        const uint8_t *ptr = file.array() + offset;
+        size_t size = U32_AT(ptr);
+        if (!memcmp(ptr + 4, fourcc, 4)) {
+            offsets.push(offset);
+        }
+        if (size < 8) {
+            break;
+        }
+        offset += size;
+    }
+    return offsets;
+}
+
+// Returns the offset of the box at |path| below the one at |offset|.
+static size_t findBox(const Vector<uint8_t> &file, size_t offset,
+        const char *const *path, size_t depth) {
+    for (size_t i = 0; i < depth; ++i) {
+        Vector<size_t> boxes = findBoxes(
+                file, path[i], offset + 8, offset + U32_AT(file.array() + offset));
+        if (boxes.size() != 1) {
+            ADD_FAILURE() << "no single " << path[i] << " box";
+            return 0;
+        }
+        offset = boxes[0];
+    }
+    return offset;
+}
+
+static size_t parse(const Vector<uint8_t> &file, size_t size, bool *isSyncAtFragmentStart,
+        Vector<int64_t> *videoTimesUs, Vector<int64_t> *audioTimesUs) {
+    sp<FragmentedMP4Parser> parser = new FragmentedMP4Parser;
+    EXPECT_EQ(OK, parser->appendData(file.array(), size));
+    parser->signalEndOfStream();
+    EXPECT_EQ(2u, parser->countTracks());
+
+    *isSyncAtFragmentStart = true;
+    for (size_t i = 0; i < parser->countTracks(); ++i) {
+        const char *mime;
+        CHECK(parser->getTrackFormat(i)->findCString(kKeyMIMEType, &mime));
+        bool isVideo = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
+
+        sp<ABuffer> accessUnit;
+        while (parser->dequeueAccessUnit(i, &accessUnit) == OK) {
+            int64_t timeUs;
+            CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+            if (isVideo) {
+                // start code, then the tagged NAL unit
+                CHECK_GE(accessUnit->size(), 7u);
+                int32_t index = accessUnit->data()[5] << 8 | accessUnit->data()[6];
+                EXPECT_EQ((int32_t)videoTimesUs->size(), index);
+                int32_t isSync = 0;
+                accessUnit->meta()->findInt32("isSync", &isSync);
+                EXPECT_EQ(accessUnit->data()[4] == 0x65, isSync != 0);
+                if (index % (kVideoFrameRate * kFragmentDurationUs / 1000000ll) == 0) {
+                    *isSyncAtFragmentStart = *isSyncAtFragmentStart && isSync;
+                }
+                videoTimesUs->push(timeUs);
+            } else {
+                int32_t index = accessUnit->data()[1] << 8 | accessUnit->data()[2];
+                EXPECT_EQ((int32_t)audioTimesUs->size(), index);
+                audioTimesUs->push(timeUs);
+            }
+        }
+    }
+
+    return videoTimesUs->size() + audioTimesUs->size();
+}
+
+TEST(MPEG4WriterTest, FragmentedRecording) {
+    Vector<uint8_t> file;
+    recordFragmented(&file);
+
+    ASSERT_EQ(1u, findBoxes(file, "moov").size());
+    EXPECT_EQ(findBoxes(file, "moof").size(), findBoxes(file, "mdat").size());
+    EXPECT_EQ((size_t)(kDurationSecs * 1000000ll / kFragmentDurationUs),
+            findBoxes(file, "moof").size());
+
+    bool isSyncAtFragmentStart;
+    Vector<int64_t> videoTimesUs, audioTimesUs;
+    parse(file, file.size(), &isSyncAtFragmentStart, &videoTimesUs, &audioTimesUs);
+    EXPECT_TRUE(isSyncAtFragmentStart);
+
+    ASSERT_EQ((size_t)(kDurationSecs * kVideoFrameRate), videoTimesUs.size());
+    ASSERT_EQ((size_t)(kDurationSecs * kAudioFrameRate), audioTimesUs.size());
+    for (size_t i = 0; i < videoTimesUs.size(); ++i) {
+        // presentation times, B frames are a frame late
+        int64_t expectedUs = (i * 1000000ll) / kVideoFrameRate;
+        if (i % kVideoFrameRate) {
+            expectedUs += 1000000ll / kVideoFrameRate;
+        }
+        EXPECT_NEAR(expectedUs, videoTimesUs[i], 20) << "video frame " << i;
+    }
+    for (size_t i = 0; i < audioTimesUs.size(); ++i) {
+        EXPECT_NEAR((i * 1000000ll) / kAudioFrameRate, audioTimesUs[i], 20)
+                << "audio frame " << i;
+    }
+}
+
+TEST(MPEG4WriterTest, InterruptedRecordingIsPlayable) {
+    Vector<uint8_t> file;
+    recordFragmented(&file);
+
+    // as if the recorder died while writing the last fragment
+    Vector<size_t> moofs = findBoxes(file, "moof");
+    ASSERT_GE(moofs.size(), 2u);
+    size_t size = moofs[moofs.size() - 1] + 20;
+
+    bool isSyncAtFragmentStart;
+    Vector<int64_t> videoTimesUs, audioTimesUs;
+    parse(file, size, &isSyncAtFragmentStart, &videoTimesUs, &audioTimesUs);
+
+    // all but the last second
+    EXPECT_EQ((size_t)((kDurationSecs - 1) * kVideoFrameRate), videoTimesUs.size());
+    EXPECT_EQ((size_t)((kDurationSecs - 1) * kAudioFrameRate), audioTimesUs.size());
+}
+
+static void addEdits(MPEG4Writer *writer) {
+    // the video track skips its first half second, the audio track starts
+    // a tenth of a second late
+    EXPECT_EQ(OK, writer->addEditListEntry(0, 500000ll, 2000000ll));
+    EXPECT_EQ(OK, writer->addEditListEntry(1, -1ll, 100000ll));
+    EXPECT_EQ(OK, writer->addEditListEntry(1, 0ll, 1900000ll));
+    EXPECT_EQ(BAD_VALUE, writer->addEditListEntry(2, 0ll, 1000000ll));
+    EXPECT_EQ(BAD_VALUE, writer->addEditListEntry(0, 0ll, 0ll));
+}
+
+TEST(MPEG4WriterTest, EditListIsWritten) {
+    Vector<uint8_t> file;
+    record(new MetaData, &file, addEdits);
+
+    Vector<size_t> moov = findBoxes(file, "moov");
+    ASSERT_EQ(1u, moov.size());
+    static const char *kMvhdPath[] = { "mvhd" };
+    size_t mvhd = findBox(file, moov[0], kMvhdPath, NELEM(kMvhdPath));
+    ASSERT_GT(mvhd, 0u);
+    uint32_t movieTimeScale = U32_AT(file.array() + mvhd + 20);
+    EXPECT_EQ(2 * movieTimeScale, U32_AT(file.array() + mvhd + 24));
+
+    size_t moovEnd = moov[0] + U32_AT(file.array() + moov[0]);
+    Vector<size_t> traks = findBoxes(file, "trak", moov[0] + 8, moovEnd);
+    ASSERT_EQ(2u, traks.size());
+    static const char *kElstPath[] = { "edts", "elst" };
+    static const char *kMdhdPath[] = { "mdia", "mdhd" };
+    static const char *kTkhdPath[] = { "tkhd" };
+    for (size_t i = 0; i < traks.size(); ++i) {
+        size_t elst = findBox(file, traks[i], kElstPath, NELEM(kElstPath));
+        size_t mdhd = findBox(file, traks[i], kMdhdPath, NELEM(kMdhdPath));
+        size_t tkhd = findBox(file, traks[i], kTkhdPath, NELEM(kTkhdPath));
+        ASSERT_TRUE(elst > 0 && mdhd > 0 && tkhd > 0);
+        uint32_t mediaTimeScale = U32_AT(file.array() + mdhd + 20);
+        const uint8_t *entries = file.array() + elst + 16;
+
+        EXPECT_EQ(0u, U32_AT(file.array() + elst + 8));  // version 0
+        EXPECT_EQ(2 * movieTimeScale, U32_AT(file.array() + tkhd + 28));
+        if (i == 0) {
+            ASSERT_EQ(1u, U32_AT(file.array() + elst + 12));
+            EXPECT_EQ(2 * movieTimeScale, U32_AT(entries));
+            EXPECT_EQ(mediaTimeScale / 2, U32_AT(entries + 4));
+            EXPECT_EQ(0x10000u, U32_AT(entries + 8));
+        } else {
+            ASSERT_EQ(2u, U32_AT(file.array() + elst + 12));
+            EXPECT_EQ(movieTimeScale / 10, U32_AT(entries));
+            EXPECT_EQ(0xffffffffu, U32_AT(entries + 4));
+            EXPECT_EQ(movieTimeScale * 19 / 10, U32_AT(entries + 12));
+            EXPECT_EQ(0u, U32_AT(entries + 16));
+        }
+    }
+}
+
+TEST(MPEG4WriterTest, FastStartMovesMediaData) {
+    // 64 bit offsets, so there is no space reserved for the moov box
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKey64BitFileOffset, true);
+    params->setInt32(kKeyFastStart, true);
+    Vector<uint8_t> file;
+    record(params, &file);
+
+    Vector<size_t> ftyp = findBoxes(file, "ftyp");
+    Vector<size_t> moov = findBoxes(file, "moov");
+    Vector<size_t> mdat = findBoxes(file, "mdat");
+    ASSERT_EQ(1u, ftyp.size());
+    ASSERT_EQ(1u, moov.size());
+    ASSERT_EQ(1u, mdat.size());
+    EXPECT_LT(ftyp[0], moov[0]);
+    EXPECT_LT(moov[0], mdat[0]);
+
+    // The chunk offsets followed the media data: the first chunk of each
+    // track starts with its first frame.
+    size_t moovEnd = moov[0] + U32_AT(file.array() + moov[0]);
+    Vector<size_t> traks = findBoxes(file, "trak", moov[0] + 8, moovEnd);
+    ASSERT_EQ(2u, traks.size());
+    for (size_t i = 0; i < traks.size(); ++i) {
+        size_t offset = traks[i];
+        static const char *kPath[] = { "mdia", "minf", "stbl", "co64" };
+        for (size_t j = 0; j < NELEM(kPath); ++j) {
+            Vector<size_t> boxes = findBoxes(
+                    file, kPath[j], offset + 8, offset + U32_AT(file.array() + offset));
+            ASSERT_EQ(1u, boxes.size()) << kPath[j];
+            offset = boxes[0];
+        }
+        ASSERT_GT(U32_AT(file.array() + offset + 12), 0u);
+        uint64_t chunkOffset = U64_AT(file.array() + offset + 16);
+        ASSERT_LT(chunkOffset + 8, file.size());
+        const uint8_t *sample = file.array() + chunkOffset;
+        if (i == 0) {
+            // NAL length, then the sync frame with index 0
+            EXPECT_EQ(0x65, sample[4]);
+            EXPECT_EQ(0, sample[5] << 8 | sample[6]);
+        } else {
+            EXPECT_EQ(0x3c, sample[0]);
+            EXPECT_EQ(0, sample[1] << 8 | sample[2]);
+        }
+    }
+}
+
+}  // namespace android
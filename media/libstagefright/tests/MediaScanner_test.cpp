@@ -0,0 +1,237 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaScanner_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <media/mediascanner.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Records what processDirectory() hands over, without looking at the files.
+struct RecordingScanner : public MediaScanner {
+    RecordingScanner() : mFailAt(-1) {}
+
+    virtual MediaScanResult processFile(
+            const char *path, const char * /* mimeType */, MediaScannerClient & /* client */) {
+        mProcessed.push(String8(path));
+        if ((ssize_t)mProcessed.size() == mFailAt) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+        return MEDIA_SCAN_RESULT_OK;
+    }
+
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client) {
+        mBatches.push(paths);
+        return MediaScanner::processFiles(paths, client);
+    }
+
+    virtual MediaAlbumArt *extractAlbumArt(int /* fd */) {
+        return NULL;
+    }
+
+    ssize_t mFailAt;  // processFile() call, counted from 1, to fail
+    Vector<String8> mProcessed;
+    Vector<Vector<String8> > mBatches;
+};
+
+// Batches the files ending in ".mp3", if |batch|, and scans everything else
+// itself.
+struct RecordingClient : public MediaScannerClient {
+    RecordingClient(bool batch) : mBatch(batch) {}
+
+    virtual status_t scanFile(const char* path, long long /* lastModified */,
+            long long /* fileSize */, bool isDirectory, bool /* noMedia */) {
+        (isDirectory ? mDirectories : mScanned).push(String8(path));
+        return OK;
+    }
+
+    virtual bool wantsBatchedScan(const char* path, long long lastModified,
+            long long fileSize, bool noMedia) {
+        if (!mBatch) {
+            return MediaScannerClient::wantsBatchedScan(path, lastModified, fileSize, noMedia);
+        }
+        size_t length = strlen(path);
+        return length > 4 && !strcmp(path + length - 4, ".mp3");
+    }
+
+    virtual void beginBatchedFile(const char* path) {
+        mBegun.push(String8(path));
+    }
+
+    virtual status_t handleStringTag(const char* /* name */, const char* /* value */) {
+        return OK;
+    }
+
+    virtual status_t setMimeType(const char* /* mimeType */) {
+        return OK;
+    }
+
+    bool mBatch;
+    Vector<String8> mDirectories;
+    Vector<String8> mScanned;
+    Vector<String8> mBegun;
+};
+
+class MediaScannerTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        strcpy(mRoot, "/data/local/tmp/MediaScanner_test.XXXXXX");
+        if (mkdtemp(mRoot) == NULL) {
+            strcpy(mRoot, "/tmp/MediaScanner_test.XXXXXX");
+            ASSERT_TRUE(mkdtemp(mRoot) != NULL);
+        }
+    }
+
+    virtual void TearDown() {
+        // the test only creates files one directory deep
+        for (size_t i = mFiles.size(); i > 0; --i) {
+            unlink(mFiles[i - 1].string());
+        }
+        for (size_t i = mDirectories.size(); i > 0; --i) {
+            rmdir(mDirectories[i - 1].string());
+        }
+        rmdir(mRoot);
+    }
+
+    String8 makeDirectory(const char *name) {
+        String8 path = String8::format("%s/%s", mRoot, name);
+        EXPECT_EQ(0, mkdir(path.string(), 0700));
+        mDirectories.push(path);
+        return path;
+    }
+
+    String8 makeFile(const String8 &directory, const char *name) {
+        String8 path = String8::format("%s/%s", directory.string(), name);
+        int fd = open(path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        EXPECT_GE(fd, 0);
+        close(fd);
+        mFiles.push(path);
+        return path;
+    }
+
+    static ssize_t indexOf(const Vector<String8> &paths, const String8 &path) {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (paths[i] == path) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    char mRoot[64];
+    Vector<String8> mDirectories;
+    Vector<String8> mFiles;
+};
+
+TEST_F(MediaScannerTest, BatchesWantedFiles) {
+    // more than a batch in the top directory, and a few below it
+    String8 top(mRoot);
+    Vector<String8> mp3s, others;
+    for (int i = 0; i < 70; ++i) {
+        String8 name = String8::format("f%02d.%s", i, i % 10 ? "mp3" : "txt");
+        (i % 10 ? mp3s : others).push(makeFile(top, name.string()));
+    }
+    String8 sub = makeDirectory("sub");
+    for (int i = 0; i < 5; ++i) {
+        String8 name = String8::format("g%d.%s", i, i == 2 ? "txt" : "mp3");
+        (i == 2 ? others : mp3s).push(makeFile(sub, name.string()));
+    }
+
+    RecordingScanner scanner;
+    RecordingClient client(true /* batch */);
+    ASSERT_EQ(MEDIA_SCAN_RESULT_OK, scanner.processDirectory(mRoot, client));
+
+    // directories and the files not wanted go through scanFile() as before
+    EXPECT_EQ(1u, client.mDirectories.size());
+    EXPECT_EQ(others.size(), client.mScanned.size());
+    for (size_t i = 0; i < others.size(); ++i) {
+        EXPECT_GE(indexOf(client.mScanned, others[i]), 0) << others[i].string();
+    }
+
+    // the .mp3 files are each processed once, in batches, in the order announced
+    ASSERT_EQ(mp3s.size(), scanner.mProcessed.size());
+    EXPECT_EQ(scanner.mProcessed.size(), client.mBegun.size());
+    for (size_t i = 0; i < mp3s.size(); ++i) {
+        EXPECT_GE(indexOf(scanner.mProcessed, mp3s[i]), 0) << mp3s[i].string();
+    }
+    size_t numProcessed = 0;
+    for (size_t i = 0; i < scanner.mBatches.size(); ++i) {
+        const Vector<String8> &batch = scanner.mBatches[i];
+        EXPECT_FALSE(batch.isEmpty());
+        EXPECT_LE(batch.size(), (size_t)MediaScanner::kMaxBatchSize);
+        for (size_t j = 0; j < batch.size(); ++j, ++numProcessed) {
+            ASSERT_LT(numProcessed, scanner.mProcessed.size());
+            EXPECT_EQ(batch[j], scanner.mProcessed[numProcessed]);
+            EXPECT_EQ(batch[j], client.mBegun[numProcessed]);
+        }
+    }
+    EXPECT_EQ(mp3s.size(), numProcessed);
+    // the 63 in the top directory take at least two batches, the 4 below another
+    EXPECT_GE(scanner.mBatches.size(), 3u);
+
+    // a batch holds files of one directory only
+    for (size_t i = 0; i < scanner.mBatches.size(); ++i) {
+        const Vector<String8> &batch = scanner.mBatches[i];
+        bool inSub = batch[0].getPathDir() == sub;
+        for (size_t j = 1; j < batch.size(); ++j) {
+            EXPECT_EQ(inSub, batch[j].getPathDir() == sub) << batch[j].string();
+        }
+    }
+}
+
+TEST_F(MediaScannerTest, NothingBatchedByDefault) {
+    String8 top(mRoot);
+    for (int i = 0; i < 3; ++i) {
+        makeFile(top, String8::format("f%d.mp3", i).string());
+    }
+
+    RecordingScanner scanner;
+    RecordingClient client(false /* batch */);
+    ASSERT_EQ(MEDIA_SCAN_RESULT_OK, scanner.processDirectory(mRoot, client));
+
+    EXPECT_EQ(3u, client.mScanned.size());
+    EXPECT_TRUE(scanner.mBatches.isEmpty());
+    EXPECT_TRUE(scanner.mProcessed.isEmpty());
+}
+
+TEST_F(MediaScannerTest, FailedBatchEndsTheScan) {
+    String8 top(mRoot);
+    for (int i = 0; i < 40; ++i) {
+        makeFile(top, String8::format("f%02d.mp3", i).string());
+    }
+
+    RecordingScanner scanner;
+    scanner.mFailAt = 2;
+    RecordingClient client(true /* batch */);
+    EXPECT_EQ(MEDIA_SCAN_RESULT_ERROR, scanner.processDirectory(mRoot, client));
+    ASSERT_EQ(1u, scanner.mBatches.size());
+}
+
+}  // namespace android
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ProbeDataSource_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Vector.h>
+
+#include "include/ProbeDataSource.h"
+
+namespace android {
+
+// A source in memory that counts how often it is read.
+struct MemorySource : public DataSource {
+    MemorySource(size_t size)
+        : mNumReads(0) {
+        mData.insertAt((uint8_t)0, 0, size);
+        for (size_t i = 0; i < size; ++i) {
+            mData.editItemAt(i) = (uint8_t)(i * 31 + (i >> 8));
+        }
+    }
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        ++mNumReads;
+        if (offset >= (off64_t)mData.size()) {
+            return 0;
+        }
+        if (size > mData.size() - offset) {
+            size = mData.size() - offset;
+        }
+        memcpy(data, mData.array() + offset, size);
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = mData.size();
+        return OK;
+    }
+
+    Vector<uint8_t> mData;
+    size_t mNumReads;
+};
+
+class ProbeDataSourceTest : public ::testing::Test {
+protected:
+    void expectRead(
+            const sp<ProbeDataSource> &probe, const sp<MemorySource> &source,
+            off64_t offset, size_t size) {
+        Vector<uint8_t> buffer;
+        buffer.insertAt((uint8_t)0, 0, size + 1);
+
+        size_t expected = 0;
+        if (offset < (off64_t)source->mData.size()) {
+            expected = source->mData.size() - offset;
+            if (expected > size) {
+                expected = size;
+            }
+        }
+
+        ASSERT_EQ((ssize_t)expected, probe->readAt(offset, buffer.editArray(), size))
+                << "offset " << offset << " size " << size;
+        EXPECT_EQ(0, memcmp(buffer.array(), source->mData.array() + offset, expected))
+                << "offset " << offset << " size " << size;
+    }
+};
+
+TEST_F(ProbeDataSourceTest, ReadsMatchSource) {
+    static const size_t kSizes[] = {
+        10,
+        ProbeDataSource::kHeadSize,
+        ProbeDataSource::kHeadSize + 1000,
+        ProbeDataSource::kHeadSize + ProbeDataSource::kTailSize + 5,
+        500000,
+    };
+
+    srand(42);
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+        sp<MemorySource> source = new MemorySource(kSizes[i]);
+        sp<ProbeDataSource> probe = new ProbeDataSource(source);
+
+        off64_t size;
+        ASSERT_EQ(OK, probe->getSize(&size));
+        EXPECT_EQ((off64_t)kSizes[i], size);
+
+        for (size_t j = 0; j < 1000; ++j) {
+            off64_t offset = rand() % (kSizes[i] + 100);
+            size_t length = (j % 4 == 0) ? rand() % 100000 : rand() % 300;
+            expectRead(probe, source, offset, length);
+        }
+    }
+}
+
+TEST_F(ProbeDataSourceTest, SniffingReadsHeadAndTailOnce) {
+    static const size_t kSize = 1000000;
+    sp<MemorySource> source = new MemorySource(kSize);
+    sp<ProbeDataSource> probe = new ProbeDataSource(source);
+
+    // What a dozen sniffers looking for headers and trailing tags would do.
+    for (size_t i = 0; i < 12; ++i) {
+        expectRead(probe, source, 0, 12);
+        expectRead(probe, source, 10, 4096);
+        expectRead(probe, source, kSize - 128, 128);
+        expectRead(probe, source, kSize - 4096, 32);
+    }
+    EXPECT_EQ(2u, source->mNumReads);
+
+    // Reads in between go through a read ahead window.
+    for (size_t i = 0; i < 16; ++i) {
+        expectRead(probe, source, kSize / 2 + i * 1000, 100);
+    }
+    EXPECT_EQ(3u, source->mNumReads);
+
+    size_t numReads, numBytesRead;
+    probe->getReadStats(&numReads, &numBytesRead);
+    EXPECT_EQ(source->mNumReads, numReads);
+    EXPECT_EQ((size_t)(ProbeDataSource::kHeadSize + ProbeDataSource::kTailSize
+            + ProbeDataSource::kReadAheadSize), numBytesRead);
+}
+
+TEST_F(ProbeDataSourceTest, DrmInitializationDropsCachedBytes) {
+    sp<MemorySource> source = new MemorySource(100000);
+    sp<ProbeDataSource> probe = new ProbeDataSource(source);
+
+    expectRead(probe, source, 0, 100);
+
+    // From now on, the source hands out different bytes.
+    source->mData.editItemAt(50) ^= 0xff;
+    probe->DrmInitialization();
+
+    expectRead(probe, source, 0, 100);
+}
+
+}  // namespace android
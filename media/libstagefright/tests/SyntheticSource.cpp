@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SyntheticSource"
+#include <utils/Log.h>
+
+#include "SyntheticSource.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+// Baseline SPS/PPS, the writers only copy it.
+static const uint8_t kAVCC[] = {
+    0x01, 0x42, 0xc0, 0x1e, 0xff, 0xe1, 0x00, 0x04,
+    0x67, 0x42, 0xc0, 0x1e, 0x01, 0x00, 0x02, 0x68,
+    0xce,
+};
+
+// AAC LC, 44.1 kHz stereo
+static const uint8_t kESDS[] = {
+    0x03, 0x16, 0x00, 0x00, 0x00,
+    0x04, 0x11, 0x40, 0x15, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x05, 0x02, 0x12, 0x10,
+};
+
+// Identification header for 44.1 kHz stereo; the writer only copies it and
+// the (here empty) codebooks into CodecPrivate.
+static const uint8_t kVorbisInfo[] = {
+    0x01, 'v', 'o', 'r', 'b', 'i', 's', 0x00,
+    0x00, 0x00, 0x00, 0x02, 0x44, 0xac, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xf4, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xb8, 0x01,
+};
+static const uint8_t kVorbisBooks[] = { 0x05, 'v', 'o', 'r', 'b', 'i', 's' };
+
+SyntheticSource::SyntheticSource(
+        const char *mime, int32_t numFrames, int32_t frameRate,
+        size_t frameSize, uint32_t flags)
+    : mFormat(new MetaData),
+      mVideo(!strncasecmp(mime, "video/", 6)),
+      mNumFrames(numFrames),
+      mFrameRate(frameRate),
+      mFrameSize(frameSize),
+      mFlags(flags),
+      mNumFramesOutput(0),
+      mStartTimeUs(-1) {
+    CHECK_GT(frameRate, 0);
+    CHECK(frameSize == 0 || frameSize >= kMinFrameSize);
+
+    mFormat->setCString(kKeyMIMEType, mime);
+    if (!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)) {
+        mFormat->setInt32(kKeyWidth, 320);
+        mFormat->setInt32(kKeyHeight, 240);
+        mFormat->setData(kKeyAVCC, kTypeAVCC, kAVCC, sizeof(kAVCC));
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_VP8)) {
+        mFormat->setInt32(kKeyWidth, 1280);
+        mFormat->setInt32(kKeyHeight, 720);
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_NB)) {
+        mFormat->setInt32(kKeySampleRate, 8000);
+        mFormat->setInt32(kKeyChannelCount, 1);
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AAC)) {
+        mFormat->setInt32(kKeySampleRate, 44100);
+        mFormat->setInt32(kKeyChannelCount, 2);
+        mFormat->setData(kKeyESDS, 0, kESDS, sizeof(kESDS));
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_VORBIS)) {
+        mFormat->setInt32(kKeySampleRate, 44100);
+        mFormat->setInt32(kKeyChannelCount, 2);
+        mFormat->setData(kKeyVorbisInfo, 0, kVorbisInfo, sizeof(kVorbisInfo));
+        mFormat->setData(kKeyVorbisBooks, 0, kVorbisBooks, sizeof(kVorbisBooks));
+    } else {
+        TRESPASS();
+    }
+
+    if (mFlags & kFlagReuseBuffers) {
+        size_t size = mFrameSize > 0 ? mFrameSize : kMinFrameSize + 49;
+        for (size_t i = 0; i < kNumReusedBuffers; ++i) {
+            mGroup.add_buffer(new MediaBuffer(size));
+        }
+    }
+}
+
+SyntheticSource::~SyntheticSource() {
+}
+
+sp<MetaData> SyntheticSource::getFormat() {
+    return mFormat;
+}
+
+status_t SyntheticSource::start(MetaData * /* params */) {
+    mNumFramesOutput = 0;
+    mStartTimeUs = -1;
+    return OK;
+}
+
+status_t SyntheticSource::stop() {
+    return OK;
+}
+
+status_t SyntheticSource::read(
+        MediaBuffer **buffer, const ReadOptions * /* options */) {
+    if (mNumFramesOutput == mNumFrames) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    int32_t index = mNumFramesOutput;
+    int64_t decodingTimeUs = (index * 1000000ll) / mFrameRate;
+    if (mFlags & kFlagRealTime) {
+        if (mStartTimeUs < 0) {
+            mStartTimeUs = ALooper::GetNowUs();
+        }
+        int64_t delayUs = mStartTimeUs + decodingTimeUs - ALooper::GetNowUs();
+        if (delayUs > 0) {
+            usleep(delayUs);
+        }
+    }
+
+    size_t size = mFrameSize > 0 ? mFrameSize : kMinFrameSize + (index * 7) % 50;
+    if (mFlags & kFlagReuseBuffers) {
+        status_t err = mGroup.acquire_buffer(buffer);
+        if (err != OK) {
+            return err;
+        }
+        (*buffer)->set_range(0, size);
+        (*buffer)->meta_data()->clear();
+    } else {
+        *buffer = new MediaBuffer(size);
+    }
+    ++mNumFramesOutput;
+
+    bool isSync = !mVideo || (index % mFrameRate) == 0;
+    const char *mime;
+    CHECK(mFormat->findCString(kKeyMIMEType, &mime));
+
+    uint8_t *data = (uint8_t *)(*buffer)->data();
+    memset(data, 0, size);
+    size_t offset = 0;
+    if (!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)) {
+        // the writers replace the start code as they need to
+        memcpy(data, "\x00\x00\x00\x01", 4);
+        data[4] = isSync ? 0x65 : 0x41;
+        offset = 5;
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_VP8)) {
+        data[0] = isSync ? 0x10 : 0x11;  // frame tag, show_frame
+        offset = 1;
+    } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_NB)) {
+        data[0] = 0x3c;  // 12.2 kbps frame header
+        offset = 1;
+    }
+    data[offset] = index >> 8;
+    data[offset + 1] = index & 0xff;
+
+    int64_t timeUs = decodingTimeUs;
+    if (mVideo && (mFlags & kFlagBFrames)) {
+        if (!isSync) {
+            timeUs += 1000000ll / mFrameRate;
+        }
+        (*buffer)->meta_data()->setInt64(kKeyDecodingTime, decodingTimeUs);
+    }
+    (*buffer)->meta_data()->setInt64(kKeyTime, timeUs);
+    (*buffer)->meta_data()->setInt32(kKeyIsSyncFrame, isSync);
+
+    return OK;
+}
+
+}  // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHETIC_SOURCE_H_
+
+#define SYNTHETIC_SOURCE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/MediaBufferGroup.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+// Hands out made up, encoded looking frames of one of the formats the
+// writers take, for the writer tests and benchmarks.
+//
+// Frames start with what the format needs in front (an AVC start code and
+// NAL unit type, the AMR frame header, the VP8 frame tag), followed by the
+// big endian 16 bit frame index; the rest is zero. Video frames are sync
+// frames once a second, audio frames always are.
+struct SyntheticSource : public MediaSource {
+    enum {
+        // read() doesn't return frames before their time, counted from
+        // the first read(), as an encoder wouldn't.
+        kFlagRealTime       = 1,
+        // Non sync video frames are presented a frame later than they
+        // are decoded, which is carried in kKeyDecodingTime.
+        kFlagBFrames        = 2,
+        // Frames are handed out in a few recycled buffers instead of a
+        // fresh one each; the writer must not hold on to them.
+        kFlagReuseBuffers   = 4,
+    };
+
+    // |mime| is one of AVC, AMR-NB, AAC, VP8 and Vorbis. A |frameSize| of 0
+    // makes the frame sizes vary between 16 and 65 bytes.
+    SyntheticSource(const char *mime, int32_t numFrames, int32_t frameRate,
+            size_t frameSize, uint32_t flags = 0);
+
+    // The format can be amended, e.g. with a different size, before the
+    // source is handed to a writer.
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+protected:
+    virtual ~SyntheticSource();
+
+private:
+    enum {
+        kNumReusedBuffers = 4,
+        kMinFrameSize     = 16,
+    };
+
+    sp<MetaData> mFormat;
+    bool mVideo;
+    int32_t mNumFrames;
+    int32_t mFrameRate;
+    size_t mFrameSize;
+    uint32_t mFlags;
+    MediaBufferGroup mGroup;
+
+    int32_t mNumFramesOutput;
+    int64_t mStartTimeUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SyntheticSource);
+};
+
+}  // namespace android
+
+#endif  // SYNTHETIC_SOURCE_H_
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "WebmWriter_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Condition.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+#include "SyntheticSource.h"
+#include "webm/WebmWriter.h"
+
+namespace android {
+
+static const int32_t kVideoFrameRate = 30;
+static const int32_t kAudioFrameRate = 43;
+static const int32_t kNumVideoFrames = 1200;
+static const int32_t kNumAudioFrames = 50;
+static const int64_t kTimeoutUs = 10000000ll;
+
+// MediaMuxer writes the samples in the order the application hands them
+// over. The audio source here doesn't return its first frame before the
+// video source has returned |leadFrames|, as for a file whose video track
+// starts long before the audio.
+struct LeadState : public RefBase {
+    LeadState(int32_t leadFrames)
+        : mLeadFrames(leadFrames),
+          mNumVideoFrames(0),
+          mStopped(false),
+          mTimedOut(false) {
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    int32_t mLeadFrames;
+    int32_t mNumVideoFrames;
+    bool mStopped;
+    bool mTimedOut;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(LeadState);
+};
+
+struct OrderedSource : public MediaSource {
+    OrderedSource(const sp<MediaSource> &source, bool video, const sp<LeadState> &state)
+        : mSource(source),
+          mVideo(video),
+          mState(state) {
+    }
+
+    virtual sp<MetaData> getFormat() {
+        return mSource->getFormat();
+    }
+
+    virtual status_t start(MetaData *params) {
+        return mSource->start(params);
+    }
+
+    virtual status_t stop() {
+        Mutex::Autolock autoLock(mState->mLock);
+        mState->mStopped = true;
+        mState->mCondition.broadcast();
+        return mSource->stop();
+    }
+
+    virtual status_t read(MediaBuffer **buffer, const ReadOptions *options) {
+        if (mVideo) {
+            status_t err = mSource->read(buffer, options);
+            Mutex::Autolock autoLock(mState->mLock);
+            ++mState->mNumVideoFrames;
+            mState->mCondition.broadcast();
+            return err;
+        }
+
+        {
+            // Rather than hang, give up after a while; the test fails.
+            Mutex::Autolock autoLock(mState->mLock);
+            int64_t deadlineUs = ALooper::GetNowUs() + kTimeoutUs;
+            while (mState->mNumVideoFrames < mState->mLeadFrames
+                    && !mState->mStopped && !mState->mTimedOut) {
+                int64_t nowUs = ALooper::GetNowUs();
+                if (nowUs >= deadlineUs) {
+                    mState->mTimedOut = true;
+                    break;
+                }
+                mState->mCondition.waitRelative(mState->mLock, (deadlineUs - nowUs) * 1000ll);
+            }
+        }
+        return mSource->read(buffer, options);
+    }
+
+private:
+    sp<MediaSource> mSource;
+    bool mVideo;
+    sp<LeadState> mState;
+
+    DISALLOW_EVIL_CONSTRUCTORS(OrderedSource);
+};
+
+// Returns the EBML variable size integer at |*offset|, without the length
+// marker if |mask|.
+static uint64_t readVint(const Vector<uint8_t> &file, size_t *offset, bool mask) {
+    CHECK_LT(*offset, file.size());
+    uint8_t first = file[*offset];
+    size_t length = 1;
+    while (length <= 8 && !(first & (0x80 >> (length - 1)))) {
+        ++length;
+    }
+    CHECK_LE(length, 8u);
+    CHECK_LE(*offset + length, file.size());
+    uint64_t value = mask ? first & (0xff >> length) : first;
+    for (size_t i = 1; i < length; ++i) {
+        value = value << 8 | file[*offset + i];
+    }
+    *offset += length;
+    return value;
+}
+
+struct Block {
+    uint64_t mTrack;
+    int64_t mTimecode;
+    size_t mOffset;  // of the frame data
+};
+
+// Collects the SimpleBlocks of all clusters in file order.
+static void parse(const Vector<uint8_t> &file, Vector<Block> *blocks) {
+    size_t offset = 0;
+    size_t end = file.size();
+    int64_t clusterTimecode = 0;
+    while (offset < end) {
+        uint64_t id = readVint(file, &offset, false /* mask */);
+        size_t sizeOffset = offset;
+        uint64_t size = readVint(file, &offset, true /* mask */);
+        bool unknownSize = size == (1ull << (7 * (offset - sizeOffset))) - 1;
+        if (id == 0x18538067 /* Segment */ || id == 0x1f43b675 /* Cluster */) {
+            // step into it
+            continue;
+        }
+        ASSERT_TRUE(!unknownSize && offset + size <= end);
+
+        if (id == 0xe7 /* Timecode */) {
+            clusterTimecode = 0;
+            for (size_t i = 0; i < size; ++i) {
+                clusterTimecode = clusterTimecode << 8 | file[offset + i];
+            }
+        } else if (id == 0xa3 /* SimpleBlock */) {
+            Block block;
+            size_t blockOffset = offset;
+            block.mTrack = readVint(file, &blockOffset, true /* mask */);
+            block.mTimecode = clusterTimecode
+                    + (int16_t)(file[blockOffset] << 8 | file[blockOffset + 1]);
+            block.mOffset = blockOffset + 3;
+            ASSERT_LE(block.mOffset + 3, offset + size);
+            blocks->push(block);
+        }
+        offset += size;
+    }
+}
+
+TEST(WebmWriterTest, LongVideoLeadDoesNotBlockNonRealTimeClients) {
+    // more video frames before the first audio frame than the queues hold
+    sp<LeadState> state = new LeadState(1000);
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL);
+    sp<WebmWriter> writer = new WebmWriter(fileno(tmp));
+    ASSERT_EQ(OK, writer->addSource(new OrderedSource(
+            new SyntheticSource(MEDIA_MIMETYPE_VIDEO_VP8, kNumVideoFrames, kVideoFrameRate,
+                    64 /* frameSize */),
+            true /* video */, state)));
+    ASSERT_EQ(OK, writer->addSource(new OrderedSource(
+            new SyntheticSource(MEDIA_MIMETYPE_AUDIO_VORBIS, kNumAudioFrames, kAudioFrameRate,
+                    64 /* frameSize */),
+            false /* video */, state)));
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyRealTimeRecording, false);
+    ASSERT_EQ(OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    EXPECT_EQ(OK, writer->stop());
+    EXPECT_FALSE(state->mTimedOut) << "the writer stopped taking video frames";
+
+    Vector<uint8_t> file;
+    off_t size = lseek(fileno(tmp), 0, SEEK_END);
+    ASSERT_GT(size, 0);
+    file.resize(size);
+    ASSERT_EQ(size, pread(fileno(tmp), file.editArray(), size, 0));
+    fclose(tmp);
+
+    Vector<Block> blocks;
+    parse(file, &blocks);
+    ASSERT_FALSE(blocks.isEmpty());
+
+    // every frame is there, in order, and the tracks are interleaved
+    KeyedVector<uint64_t, int32_t> numFrames;
+    int64_t lastTimecode = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const uint8_t *data = file.array() + blocks[i].mOffset;
+        // the video frames start with the frame tag
+        bool video = (data[0] & 0xfe) == 0x10;
+        int32_t index = video ? data[1] << 8 | data[2] : data[0] << 8 | data[1];
+
+        ssize_t track = numFrames.indexOfKey(blocks[i].mTrack);
+        if (track < 0) {
+            track = numFrames.add(blocks[i].mTrack, 0);
+        }
+        EXPECT_EQ(numFrames.valueAt(track), index) << "block " << i;
+        numFrames.editValueAt(track) = index + 1;
+
+        EXPECT_GE(blocks[i].mTimecode, lastTimecode) << "block " << i;
+        lastTimecode = blocks[i].mTimecode;
+    }
+
+    ASSERT_EQ(2u, numFrames.size());
+    EXPECT_EQ(kNumVideoFrames + kNumAudioFrames, numFrames.valueAt(0) + numFrames.valueAt(1));
+    int32_t numVideoFrames = numFrames.valueAt(0) > numFrames.valueAt(1)
+            ? numFrames.valueAt(0) : numFrames.valueAt(1);
+    EXPECT_EQ(kNumVideoFrames, numVideoFrames);
+}
+
+}  // namespace android
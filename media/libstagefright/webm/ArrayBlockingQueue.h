@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ARRAYBLOCKINGQUEUE_H_
+#define ARRAYBLOCKINGQUEUE_H_
+
+#include <cutils/atomic.h>
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+// Bounded queue between exactly one producer and one consumer thread.
+//
+// Items live in a ring and each side only advances its own index, so
+// neither push() nor take() takes a lock while the queue is neither full
+// nor empty. A side that has to wait announces it before sleeping on the
+// condition; the other side only locks to wake it up in that case.
+//
+// An unbounded queue doesn't make the producer wait: what doesn't fit into
+// the ring goes into an overflow list under the lock, and the consumer
+// only takes from that list once the ring is empty.
+template<typename T>
+class ArrayBlockingQueue {
+public:
+    enum {
+        kDefaultCapacity = 256,
+    };
+
+    // |capacity| is rounded up to a power of 2.
+    explicit ArrayBlockingQueue(size_t capacity = kDefaultCapacity)
+        : mCapacity(1),
+          mFront(0),
+          mRear(0),
+          mUnbounded(false),
+          mNumOverflowItems(0),
+          mConsumerWaiting(0),
+          mProducerWaiting(0) {
+        while (mCapacity < capacity) {
+            mCapacity <<= 1;
+        }
+        mItems = new T[mCapacity];
+    }
+
+    ~ArrayBlockingQueue() {
+        delete[] mItems;
+    }
+
+    // Only while neither side is running.
+    void setUnbounded(bool unbounded) {
+        mUnbounded = unbounded;
+    }
+
+    // Consumer side.
+    bool empty() {
+        return size() == 0 && numOverflowItems() == 0;
+    }
+
+    // Consumer side, blocks until there is an item.
+    T peek() {
+        waitForItem();
+        if (size() == 0) {
+            Mutex::Autolock autoLock(mLock);
+            return *mOverflow.begin();
+        }
+        return mItems[mFront & (mCapacity - 1)];
+    }
+
+    // Consumer side, blocks until there is an item.
+    T take() {
+        waitForItem();
+        if (size() == 0) {
+            // The producer only goes back to the ring once the overflow
+            // list is empty, so these items come after the ring's.
+            Mutex::Autolock autoLock(mLock);
+            T e = *mOverflow.begin();
+            mOverflow.erase(mOverflow.begin());
+            android_atomic_dec(&mNumOverflowItems);
+            return e;
+        }
+        uint32_t front = mFront;
+        T e = mItems[front & (mCapacity - 1)];
+        mItems[front & (mCapacity - 1)] = T();
+        android_atomic_release_store(front + 1, (volatile int32_t *)&mFront);
+        wake(&mProducerWaiting);
+        return e;
+    }
+
+    // Consumer side; only safe once the producer is gone.
+    void clear() {
+        while (!empty()) {
+            take();
+        }
+    }
+
+    // Producer side, blocks while a bounded queue is full. Returns false
+    // without queueing |e| if |*cancel| is or becomes true while waiting,
+    // see cancelWait().
+    bool push(const T &e, const volatile bool *cancel = NULL) {
+        if (mUnbounded && (numOverflowItems() > 0 || size() == mCapacity)) {
+            Mutex::Autolock autoLock(mLock);
+            mOverflow.push_back(e);
+            android_atomic_inc(&mNumOverflowItems);
+            mCondition.broadcast();
+            return true;
+        }
+
+        if (size() == mCapacity) {
+            Mutex::Autolock autoLock(mLock);
+            while (size() == mCapacity) {
+                if (cancel != NULL && *cancel) {
+                    return false;
+                }
+                if (!sleep(&mProducerWaiting)) {
+                    break;
+                }
+            }
+            android_atomic_release_store(0, &mProducerWaiting);
+        }
+
+        uint32_t rear = mRear;
+        mItems[rear & (mCapacity - 1)] = e;
+        android_atomic_release_store(rear + 1, (volatile int32_t *)&mRear);
+        wake(&mConsumerWaiting);
+        return true;
+    }
+
+    // Wakes up a producer blocked in push(), so that it checks its cancel
+    // flag again.
+    void cancelWait() {
+        Mutex::Autolock autoLock(mLock);
+        mCondition.broadcast();
+    }
+
+private:
+    T *mItems;
+    uint32_t mCapacity;
+
+    // Free running, the item count is mRear - mFront.
+    volatile uint32_t mFront;  // written by the consumer only
+    volatile uint32_t mRear;   // written by the producer only
+
+    bool mUnbounded;
+    List<T> mOverflow;  // under mLock
+    volatile int32_t mNumOverflowItems;
+
+    volatile int32_t mConsumerWaiting;
+    volatile int32_t mProducerWaiting;
+    Mutex mLock;
+    Condition mCondition;
+
+    uint32_t size() {
+        uint32_t rear = android_atomic_acquire_load((volatile int32_t *)&mRear);
+        uint32_t front = android_atomic_acquire_load((volatile int32_t *)&mFront);
+        return rear - front;
+    }
+
+    int32_t numOverflowItems() {
+        return android_atomic_acquire_load(&mNumOverflowItems);
+    }
+
+    void waitForItem() {
+        if (size() == 0) {
+            Mutex::Autolock autoLock(mLock);
+            while (size() == 0 && numOverflowItems() == 0) {
+                if (!sleep(&mConsumerWaiting)) {
+                    break;
+                }
+            }
+            android_atomic_release_store(0, &mConsumerWaiting);
+        }
+    }
+
+    // Called with mLock held after the caller found it has to wait. Returns
+    // false if the other side made progress in the meantime after all.
+    bool sleep(volatile int32_t *waiting) {
+        android_atomic_release_store(1, waiting);
+        // Pairs with the barrier in wake(): either we see the index the
+        // other side just moved, or it sees our flag.
+        android_memory_barrier();
+        if (waiting == &mConsumerWaiting
+                ? size() != 0 || numOverflowItems() != 0 : size() != mCapacity) {
+            return false;
+        }
+        mCondition.wait(mLock);
+        return true;
+    }
+
+    void wake(volatile int32_t *waiting) {
+        android_memory_barrier();
+        if (android_atomic_acquire_load(waiting)) {
+            Mutex::Autolock autoLock(mLock);
+            mCondition.broadcast();
+        }
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(ArrayBlockingQueue);
+};
+
+} /* namespace android */
+#endif /* ARRAYBLOCKINGQUEUE_H_ */
@@ -27,8 +27,6 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 
 using namespace android;
 using namespace webm;
@@ -108,26 +106,26 @@ uint8_t *WebmElement::serialize(uint64_t& size) {
     return buf;
 }
 
+// Serializes the whole element up front and hands it to the kernel in one
+// go, so that a cluster or the cues cost a single write() call.
 int WebmElement::write(int fd, uint64_t& size) {
-    uint8_t buf[8];
-    size = totalSize();
-    off64_t off = ::lseek64(fd, (size - 1), SEEK_CUR) - (size - 1);
-    ::write(fd, buf, 1); // extend file
-
-    off64_t curOff = off + size;
-    off64_t alignedOff = off & ~(::sysconf(_SC_PAGE_SIZE) - 1);
-    off64_t mapSize = curOff - alignedOff;
-    off64_t pageOff = off - alignedOff;
-    void *dst = ::mmap64(NULL, mapSize, PROT_WRITE, MAP_SHARED, fd, alignedOff);
-    if (dst == MAP_FAILED) {
-        ALOGE("mmap64 failed; errno = %d", errno);
-        ALOGE("fd %d; flags: %o", fd, ::fcntl(fd, F_GETFL, 0));
-        return errno;
-    } else {
-        serializeInto((uint8_t*) dst + pageOff);
-        ::msync(dst, mapSize, MS_SYNC);
-        return ::munmap(dst, mapSize);
+    uint8_t *buf = serialize(size);
+    uint64_t written = 0;
+    int err = 0;
+    while (written < size) {
+        ssize_t n = ::write(fd, buf + written, size - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = errno;
+            ALOGE("write failed; errno = %d", err);
+            break;
+        }
+        written += n;
     }
+    delete[] buf;
+    return err;
 }
 
 //=================================================================================================
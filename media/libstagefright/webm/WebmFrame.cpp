@@ -27,9 +27,20 @@ using namespace android;
 using namespace webm;
 
 namespace {
-sp<ABuffer> toABuffer(MediaBuffer *mbuf) {
-    sp<ABuffer> abuf = new ABuffer(mbuf->range_length());
-    memcpy(abuf->data(), (uint8_t*) mbuf->data() + mbuf->range_offset(), mbuf->range_length());
+// Takes over the caller's reference to |mbuf|. If |hold| is set the payload is
+// wrapped without a copy and |mbuf| is released along with the returned
+// buffer, otherwise it is copied out and |mbuf| released right away.
+sp<ABuffer> toABuffer(MediaBuffer *mbuf, bool hold) {
+    sp<ABuffer> abuf;
+    if (hold) {
+        abuf = new ABuffer(
+                (uint8_t*) mbuf->data() + mbuf->range_offset(), mbuf->range_length());
+        abuf->setMediaBufferBase(mbuf);
+    } else {
+        abuf = new ABuffer(mbuf->range_length());
+        memcpy(abuf->data(), (uint8_t*) mbuf->data() + mbuf->range_offset(), mbuf->range_length());
+        mbuf->release();
+    }
     return abuf;
 }
 }
@@ -46,11 +57,12 @@ WebmFrame::WebmFrame()
       mEos(true) {
 }
 
-WebmFrame::WebmFrame(int type, bool key, uint64_t absTimecode, MediaBuffer *mbuf)
+WebmFrame::WebmFrame(
+        int type, bool key, uint64_t absTimecode, MediaBuffer *mbuf, bool holdBuffer)
     : mType(type),
       mKey(key),
       mAbsTimecode(absTimecode),
-      mData(toABuffer(mbuf)),
+      mData(toABuffer(mbuf, holdBuffer)),
       mEos(false) {
 }
 
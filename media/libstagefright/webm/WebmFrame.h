@@ -30,7 +30,9 @@ public:
     const bool mEos;
 
     WebmFrame();
-    WebmFrame(int type, bool key, uint64_t absTimecode, MediaBuffer *buf);
+    // Takes over the caller's reference to |buf|. With |holdBuffer| the frame
+    // keeps |buf| until it has been written out instead of copying it.
+    WebmFrame(int type, bool key, uint64_t absTimecode, MediaBuffer *buf, bool holdBuffer);
     ~WebmFrame() {}
 
     sp<WebmElement> SimpleBlock(uint64_t baseTimecode) const;
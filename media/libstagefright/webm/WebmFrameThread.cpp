@@ -55,7 +55,7 @@ status_t WebmFrameThread::stop() {
 
 WebmFrameSourceThread::WebmFrameSourceThread(
     int type,
-    LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    ArrayBlockingQueue<sp<WebmFrame> >& sink)
     : mType(type), mSink(sink) {
 }
 
@@ -78,8 +78,8 @@ WebmFrameSinkThread::WebmFrameSinkThread(
 WebmFrameSinkThread::WebmFrameSinkThread(
         const int& fd,
         const uint64_t& off,
-        LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-        LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
+        ArrayBlockingQueue<sp<WebmFrame> >& videoSource,
+        ArrayBlockingQueue<sp<WebmFrame> >& audioSource,
         List<sp<WebmElement> >& cues)
     : mFd(fd),
       mSegmentDataStart(off),
@@ -248,7 +248,7 @@ void WebmFrameMediaSourceThread::clearFlags() {
 WebmFrameMediaSourceThread::WebmFrameMediaSourceThread(
         const sp<MediaSource>& source,
         int type,
-        LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+        ArrayBlockingQueue<sp<WebmFrame> >& sink,
         uint64_t timeCodeScale,
         int64_t startTimeRealUs,
         int32_t startTimeOffsetMs,
@@ -257,6 +257,7 @@ WebmFrameMediaSourceThread::WebmFrameMediaSourceThread(
     : WebmFrameSourceThread(type, sink),
       mSource(source),
       mTimeCodeScale(timeCodeScale),
+      mHoldBuffers(realTimeRecording),
       mTrackDurationUs(0) {
     clearFlags();
     mStartTimeUs = startTimeRealUs;
@@ -314,6 +315,7 @@ status_t WebmFrameMediaSourceThread::stop() {
     if (mStarted) {
         mStarted = false;
         mDone = true;
+        mSink.cancelWait();
         mSource->stop();
         return WebmFrameThread::stop();
     }
@@ -369,13 +371,6 @@ void WebmFrameMediaSourceThread::run() {
 
         int32_t isSync = false;
         md->findInt32(kKeyIsSyncFrame, &isSync);
-        const sp<WebmFrame> f = new WebmFrame(
-            mType,
-            isSync,
-            timestampUs * 1000 / mTimeCodeScale,
-            buffer);
-        mSink.push(f);
-
         ALOGV(
             "%s %s frame at %" PRId64 " size %zu\n",
             mType == kVideoType ? "video" : "audio",
@@ -383,8 +378,18 @@ void WebmFrameMediaSourceThread::run() {
             timestampUs * 1000 / mTimeCodeScale,
             buffer->range_length());
 
-        buffer->release();
+        const sp<WebmFrame> f = new WebmFrame(
+            mType,
+            isSync,
+            timestampUs * 1000 / mTimeCodeScale,
+            buffer,
+            mHoldBuffers);
         buffer = NULL;
+        if (!mSink.push(f, &mDone)) {
+            // stopped while the sink waits for the other track; it gets
+            // its EOS from WebmFrameSinkThread::stop()
+            break;
+        }
 
         if (timestampUs > mTrackDurationUs) {
             mTrackDurationUs = timestampUs;
@@ -394,6 +399,6 @@ void WebmFrameMediaSourceThread::run() {
     }
 
     mTrackDurationUs += lastDurationUs;
-    mSink.push(WebmFrame::EOS);
+    mSink.push(WebmFrame::EOS, &mDone);
 }
 }
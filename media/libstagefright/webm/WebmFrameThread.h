@@ -18,7 +18,7 @@
 #define WEBMFRAMETHREAD_H_
 
 #include "WebmFrame.h"
-#include "LinkedBlockingQueue.h"
+#include "ArrayBlockingQueue.h"
 
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaSource.h>
@@ -66,8 +66,8 @@ public:
     WebmFrameSinkThread(
             const int& fd,
             const uint64_t& off,
-            LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-            LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
+            ArrayBlockingQueue<sp<WebmFrame> >& videoSource,
+            ArrayBlockingQueue<sp<WebmFrame> >& audioSource,
             List<sp<WebmElement> >& cues);
 
     void run();
@@ -80,8 +80,8 @@ public:
 private:
     const int& mFd;
     const uint64_t& mSegmentDataStart;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
+    ArrayBlockingQueue<sp<WebmFrame> >& mVideoFrames;
+    ArrayBlockingQueue<sp<WebmFrame> >& mAudioFrames;
     List<sp<WebmElement> >& mCues;
 
     volatile bool mDone;
@@ -98,11 +98,11 @@ private:
 
 class WebmFrameSourceThread : public WebmFrameThread {
 public:
-    WebmFrameSourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink);
+    WebmFrameSourceThread(int type, ArrayBlockingQueue<sp<WebmFrame> >& sink);
     virtual int64_t getDurationUs() = 0;
 protected:
     const int mType;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mSink;
+    ArrayBlockingQueue<sp<WebmFrame> >& mSink;
 
     friend class WebmFrameSinkThread;
 };
@@ -111,7 +111,7 @@ protected:
 
 class WebmFrameEmptySourceThread : public WebmFrameSourceThread {
 public:
-    WebmFrameEmptySourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameEmptySourceThread(int type, ArrayBlockingQueue<sp<WebmFrame> >& sink)
         : WebmFrameSourceThread(type, sink) {
     }
     void run() { mSink.push(WebmFrame::EOS); }
@@ -125,7 +125,7 @@ public:
     WebmFrameMediaSourceThread(
             const sp<MediaSource>& source,
             int type,
-            LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+            ArrayBlockingQueue<sp<WebmFrame> >& sink,
             uint64_t timeCodeScale,
             int64_t startTimeRealUs,
             int32_t startTimeOffsetMs,
@@ -144,6 +144,10 @@ public:
 private:
     const sp<MediaSource> mSource;
     const uint64_t mTimeCodeScale;
+    // Real time sources (encoders) hand out buffers of their own, which the
+    // frames can keep until they are written. Others, like MediaMuxer's
+    // MediaAdapter, block until each buffer comes back, so those are copied.
+    const bool mHoldBuffers;
     uint64_t mStartTimeUs;
 
     volatile bool mDone;
@@ -67,7 +67,7 @@ WebmWriter::WebmWriter(int fd)
       mPaused(false),
       mStarted(false),
       mIsFileSizeLimitExplicitlyRequested(false),
-      mIsRealTimeRecording(false),
+      mIsRealTimeRecording(true),
       mStreamableFile(true),
       mEstimatedCuesSize(0) {
     mStreams[kAudioIndex] = WebmStream(kAudioType, "Audio", &WebmWriter::audioTrack);
@@ -267,6 +267,10 @@ status_t WebmWriter::reset() {
 
     mSinkThread->stop();
 
+    // drop leftover EOS markers and frames, which hold on to source buffers
+    mStreams[kVideoIndex].mSink.clear();
+    mStreams[kAudioIndex].mSink.clear();
+
     // Do not write out movie header on error.
     if (err != OK) {
         release();
@@ -290,8 +294,6 @@ status_t WebmWriter::reset() {
     }
 
     mCuePoints.clear();
-    mStreams[kVideoIndex].mSink.clear();
-    mStreams[kAudioIndex].mSink.clear();
 
     uint8_t bary[sizeof(uint64_t)];
     uint64_t totalSize = ::lseek(mFd, 0, SEEK_END);
@@ -391,8 +393,9 @@ status_t WebmWriter::start(MetaData *params) {
 
     if (params) {
         int32_t isRealTimeRecording;
-        params->findInt32(kKeyRealTimeRecording, &isRealTimeRecording);
-        mIsRealTimeRecording = isRealTimeRecording;
+        if (params->findInt32(kKeyRealTimeRecording, &isRealTimeRecording)) {
+            mIsRealTimeRecording = isRealTimeRecording;
+        }
     }
 
     if (mStarted) {
@@ -479,6 +482,13 @@ status_t WebmWriter::start(MetaData *params) {
         params->findInt64(kKeyTime, &mStartTimestampUs);
     }
 
+    // A non real time client like MediaMuxer feeds the tracks in its own
+    // order and may only get to the other track after many frames of this
+    // one; the sink can't write those until it has the other track's, so
+    // they have to be queued rather than hold up the client.
+    mStreams[kAudioIndex].mSink.setUnbounded(!mIsRealTimeRecording);
+    mStreams[kVideoIndex].mSink.setUnbounded(!mIsRealTimeRecording);
+
     initStream(kAudioIndex);
     initStream(kVideoIndex);
 
@@ -19,7 +19,7 @@
 
 #include "WebmConstants.h"
 #include "WebmFrameThread.h"
-#include "LinkedBlockingQueue.h"
+#include "ArrayBlockingQueue.h"
 
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaWriter.h>
@@ -88,7 +88,7 @@ private:
         sp<MediaSource> mSource;
         sp<WebmElement> mTrackEntry;
         sp<WebmFrameSourceThread> mThread;
-        LinkedBlockingQueue<const sp<WebmFrame> > mSink;
+        ArrayBlockingQueue<sp<WebmFrame> > mSink;
 
         WebmStream()
             : mType(kInvalidType),
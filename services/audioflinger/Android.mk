@@ -29,7 +29,9 @@ LOCAL_SRC_FILES:=               \
     AudioMixer.cpp.arm          \
     BufferProviders.cpp         \
     PatchPanel.cpp              \
-    StateQueue.cpp
+    StateQueue.cpp              \
+    LatencyTimeline.cpp         \
+    DriftCompensator.cpp
 
 LOCAL_C_INCLUDES := \
     $(TOPDIR)frameworks/av/services/audiopolicy \
@@ -381,6 +381,16 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
 {
     if (!dumpAllowed()) {
         dumpPermissionDenial(fd, args);
+    } else if (args.size() > 0 && args[0] == String16("--latency-trace")) {
+        // only the binary trace of the playback threads' latency timelines, for offline
+        // analysis: see LatencyTimeline::TraceHeader for the format
+        bool locked = dumpTryLock(mLock);
+        for (size_t i = 0; i < mPlaybackThreads.size(); i++) {
+            mPlaybackThreads.valueAt(i)->dumpLatencyTrace(fd);
+        }
+        if (locked) {
+            mLock.unlock();
+        }
     } else {
         // get state of hardware lock
         bool hardwareLocked = dumpTryLock(mHardwareLock);
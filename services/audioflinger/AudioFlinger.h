@@ -54,7 +54,11 @@
 #include "FastCapture.h"
 #include "FastMixer.h"
 #include <media/nbaio/NBAIO.h>
+#include <media/nbaio/MonoPipe.h>
+#include <media/nbaio/MonoPipeReader.h>
 #include "AudioWatchdog.h"
+#include "LatencyTimeline.h"
+#include "DriftCompensator.h"
 #include "AudioMixer.h"
 #include "AudioStreamOut.h"
 #include "SpdifStreamOut.h"
@@ -335,18 +335,25 @@ status_t AudioMixer::track_t::prepareForDownmix()
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
             && DownmixerBufferProvider::isMultichannelCapable()) {
-        DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
-                mMixerChannelMask,
-                AUDIO_FORMAT_PCM_16_BIT /* TODO: use mMixerInFormat, now only PCM 16 */,
-                sampleRate, sessionId, kCopyBufferFrameCount);
-
-        if (pDbp->isValid()) { // if constructor completed properly
-            mDownmixRequiresFormat = AUDIO_FORMAT_PCM_16_BIT; // PCM 16 bit required for downmix
-            downmixerBufferProvider = pDbp;
-            reconfigureBufferProviders();
-            return NO_ERROR;
+        // Downmix in the mixer input format if the downmix effect takes it,
+        // otherwise in PCM 16 bit, which all downmix effects take.
+        const audio_format_t formats[] = { mMixerInFormat, AUDIO_FORMAT_PCM_16_BIT };
+        for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+            if (i > 0 && formats[i] == formats[0]) {
+                break;
+            }
+            DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
+                    mMixerChannelMask, formats[i], sampleRate, sessionId,
+                    kCopyBufferFrameCount);
+
+            if (pDbp->isValid()) { // if constructor completed properly
+                mDownmixRequiresFormat = formats[i];
+                downmixerBufferProvider = pDbp;
+                reconfigureBufferProviders();
+                return NO_ERROR;
+            }
+            delete pDbp;
         }
-        delete pDbp;
     }
 
     // Effect downmixer does not accept the channel conversion.  Let's use our remixer.
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DriftCompensator"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <utils/Log.h>
+#include "DriftCompensator.h"
+
+namespace android {
+
+// the clocks of two devices differ by 100 ppm at most, but the timestamps jitter
+const double ClockRateEstimator::kMaxRateError = 0.02;
+
+ClockRateEstimator::ClockRateEstimator(uint32_t sampleRate)
+    : mSampleRate(sampleRate)
+{
+    reset();
+}
+
+void ClockRateEstimator::reset()
+{
+    mCount = 0;
+    mNext = 0;
+    mLastPosition = 0;
+    mRate = 1.0;
+}
+
+void ClockRateEstimator::addTimestamp(uint32_t position, nsecs_t time)
+{
+    int64_t unwrapped = 0;
+    if (mCount > 0) {
+        const uint32_t last = (mNext - 1) & (kMaxTimestamps - 1);
+        const nsecs_t interval = time - mTimes[last];
+        if (interval >= 0 && interval < kMinIntervalNs) {
+            return;
+        }
+        const int32_t delta = (int32_t) (position - mLastPosition);
+        const double expected = (double) interval * mSampleRate / 1000000000.0;
+        if (interval < 0 || delta <= 0 || fabs(delta - expected) > expected * kMaxRateError) {
+            // standby, underrun, flush or a glitch of the timestamps
+            ALOGV("addTimestamp() discontinuity: %d frames in %lld ns", delta, (long long) interval);
+            reset();
+        } else {
+            unwrapped = mPositions[last] + delta;
+        }
+    }
+    mPositions[mNext] = unwrapped;
+    mTimes[mNext] = time;
+    mNext = (mNext + 1) & (kMaxTimestamps - 1);
+    if (mCount < kMaxTimestamps) {
+        mCount++;
+    }
+    mLastPosition = position;
+
+    if (!isValid()) {
+        mRate = 1.0;
+        return;
+    }
+    // least squares fit, relative to the oldest timestamp to keep the precision of doubles
+    const uint32_t oldest = (mNext - mCount) & (kMaxTimestamps - 1);
+    double meanTime = 0;
+    double meanPosition = 0;
+    for (uint32_t i = 0; i < mCount; i++) {
+        const uint32_t j = (oldest + i) & (kMaxTimestamps - 1);
+        meanTime += (double) (mTimes[j] - mTimes[oldest]);
+        meanPosition += (double) (mPositions[j] - mPositions[oldest]);
+    }
+    meanTime /= mCount;
+    meanPosition /= mCount;
+    double covariance = 0;
+    double variance = 0;
+    for (uint32_t i = 0; i < mCount; i++) {
+        const uint32_t j = (oldest + i) & (kMaxTimestamps - 1);
+        const double dt = (double) (mTimes[j] - mTimes[oldest]) - meanTime;
+        const double dp = (double) (mPositions[j] - mPositions[oldest]) - meanPosition;
+        covariance += dt * dp;
+        variance += dt * dt;
+    }
+    mRate = covariance * 1000000000.0 / (variance * mSampleRate);
+}
+
+bool ClockRateEstimator::isValid() const
+{
+    if (mCount < 2) {
+        return false;
+    }
+    const uint32_t oldest = (mNext - mCount) & (kMaxTimestamps - 1);
+    const uint32_t newest = (mNext - 1) & (kMaxTimestamps - 1);
+    return mTimes[newest] - mTimes[oldest] >= kMinSpanNs;
+}
+
+double ClockRateEstimator::rate() const
+{
+    return mRate;
+}
+
+// ----------------------------------------------------------------------------
+
+// Weight of each new fill level in the average. The fill level seen at one point of the cycle
+// of the producer jumps by up to a period when the cycles of the two sides cross,
+// so the average is over seconds.
+static const double kFilledWeight = 1.0 / 64.0;
+// Time to absorb a fill error: the correction of the sample rate, in Hz, is the error in frames
+// divided by this. The relative rate does most of the work; this only corrects its error.
+static const double kCorrectionSec = 10.0;
+// Bound of the correction, relative to the nominal sample rate, to keep it inaudible
+static const double kMaxCorrection = 0.005;
+
+DriftCompensator::DriftCompensator(uint32_t sampleRate, size_t targetFrames)
+    : mSampleRate(sampleRate), mTargetFrames(targetFrames)
+{
+    reset();
+}
+
+void DriftCompensator::reset()
+{
+    mFilledAvg = mTargetFrames;
+}
+
+uint32_t DriftCompensator::sampleRate(double relativeRate, size_t filled)
+{
+    mFilledAvg += ((double) filled - mFilledAvg) * kFilledWeight;
+    // the consumer takes sampleRate frames per second of its own clock
+    double sampleRate = mSampleRate / relativeRate +
+            (mFilledAvg - (double) mTargetFrames) / kCorrectionSec;
+    const double maxCorrection = mSampleRate * kMaxCorrection;
+    if (sampleRate > mSampleRate + maxCorrection) {
+        sampleRate = mSampleRate + maxCorrection;
+    } else if (sampleRate < mSampleRate - maxCorrection) {
+        sampleRate = mSampleRate - maxCorrection;
+    }
+    return (uint32_t) (sampleRate + 0.5);
+}
+
+}   // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_DRIFT_COMPENSATOR_H
+#define ANDROID_AUDIO_DRIFT_COMPENSATOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Estimates the rate of the clock of an output device relative to CLOCK_MONOTONIC,
+// from the presentation timestamps of the output: a line is fitted to the recent timestamps,
+// which averages out their jitter. The estimate restarts after a discontinuity,
+// such as the output going to standby.
+class ClockRateEstimator {
+public:
+    explicit ClockRateEstimator(uint32_t sampleRate);
+
+    void        reset();
+    // position is the number of frames presented, which may wrap, at the given CLOCK_MONOTONIC
+    // time. Timestamps closer than kMinIntervalNs to the previous one kept are ignored.
+    void        addTimestamp(uint32_t position, nsecs_t time);
+    // whether the timestamps span long enough for rate() to be meaningful
+    bool        isValid() const;
+    // frames presented per second, divided by the nominal sample rate; 1.0 if not valid
+    double      rate() const;
+
+private:
+    static const uint32_t kMaxTimestamps = 32;      // 8 s of timestamps, must be a power of 2
+    static const nsecs_t kMinIntervalNs = 250000000;
+    static const nsecs_t kMinSpanNs = 2000000000;
+    // a timestamp implying a rate further than this from nominal is a discontinuity
+    static const double kMaxRateError;
+
+    uint32_t    mSampleRate;
+    uint32_t    mCount;         // timestamps kept, at most kMaxTimestamps
+    uint32_t    mNext;          // index of the next timestamp to keep
+    uint32_t    mLastPosition;
+    int64_t     mPositions[kMaxTimestamps];     // unwrapped, relative to the first timestamp
+    nsecs_t     mTimes[kMaxTimestamps];
+    double      mRate;
+};
+
+// Computes the sample rate at which a consumer should play frames written at a nominal rate
+// by a producer paced by another clock, so that the frames buffered between them stay
+// at a target: the sample rate is corrected by the relative rate of the two clocks,
+// then by the error of the buffered frames, averaged to hide the jitter of both sides.
+class DriftCompensator {
+public:
+    DriftCompensator(uint32_t sampleRate, size_t targetFrames);
+
+    void        reset();
+    // relativeRate is the rate of the clock of the consumer divided by that of the producer,
+    // and filled the frames buffered between them when called, at similar points of the cycle.
+    uint32_t    sampleRate(double relativeRate, size_t filled);
+
+    uint32_t    nominalSampleRate() const { return mSampleRate; }
+    size_t      targetFrames() const { return mTargetFrames; }
+    double      filledAverage() const { return mFilledAvg; }
+
+private:
+    const uint32_t  mSampleRate;
+    const size_t    mTargetFrames;
+    double          mFilledAvg;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_DRIFT_COMPENSATOR_H
@@ -64,12 +64,21 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
       mThread(thread), mChain(chain), mId(id), mSessionId(sessionId),
       mDescriptor(*desc),
       // mConfig is set by configure() and not used before then
+      mInBuffer(NULL), mOutBuffer(NULL),
+      mBufferFormat(AUDIO_FORMAT_PCM_16_BIT), mConvertsFormat(false),
+      mInConversionBuffer(NULL), mOutConversionBuffer(NULL), mConversionBufferSamples(0),
       mEffectInterface(NULL),
       mStatus(NO_INIT), mState(IDLE),
       // mMaxDisableWaitCnt is set by configure() and not used before then
       // mDisableWaitCnt is set by process() and updateState() and not used before then
       mSuspended(false),
-      mAudioFlinger(thread->mAudioFlinger)
+      mAudioFlinger(thread->mAudioFlinger),
+      mParamRear(0), mParamFront(0), mParamReply(0), mHandleCount(0),
+      // an effect is not processed until its thread says so
+      mProcessMs((int32_t)(ns2ms(systemTime()) - MAX_PROCESS_INTERVAL_MS - 1)),
+      mMaxProcessIntervalMs(MAX_PROCESS_INTERVAL_MS),
+      mProcessLockContended(0), mParamQueued(0), mParamNotProcessed(0), mParamQueueFull(0),
+      mParamRejected(0)
 {
     ALOGV("Constructor %p", this);
     int lStatus;
@@ -102,6 +111,8 @@ AudioFlinger::EffectModule::~EffectModule()
         // release effect engine
         EffectRelease(mEffectInterface);
     }
+    delete[] mInConversionBuffer;
+    delete[] mOutConversionBuffer;
 }
 
 status_t AudioFlinger::EffectModule::addHandle(EffectHandle *handle)
@@ -140,6 +151,7 @@ status_t AudioFlinger::EffectModule::addHandle(EffectHandle *handle)
     }
     ALOGV("addHandle() %p added handle %p in position %d", this, handle, i);
     mHandles.insertAt(handle, i);
+    android_atomic_release_store((int32_t)mHandles.size(), &mHandleCount);
     return status;
 }
 
@@ -159,6 +171,7 @@ size_t AudioFlinger::EffectModule::removeHandle(EffectHandle *handle)
     ALOGV("removeHandle() %p removed handle %p in position %d", this, handle, i);
 
     mHandles.removeAt(i);
+    android_atomic_release_store((int32_t)mHandles.size(), &mHandleCount);
     // if removed from first place, move effect control from this handle to next in line
     if (i == 0) {
         EffectHandle *h = controlHandle_l();
@@ -227,7 +240,7 @@ void AudioFlinger::EffectModule::updateState() {
     case STARTING:
         // clear auxiliary effect input buffer for next accumulation
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
-            memset(mConfig.inputCfg.buffer.raw,
+            memset(mInBuffer,
                    0,
                    mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
         }
@@ -260,20 +273,42 @@ void AudioFlinger::EffectModule::updateState() {
 
 void AudioFlinger::EffectModule::process()
 {
-    Mutex::Autolock _l(mLock);
+    if (mLock.tryLock() != NO_ERROR) {
+        // count how often a binder thread holding the lock delays the audio thread
+        mProcessLockContended++;
+        mLock.lock();
+    }
+    process_l();
+    mLock.unlock();
+}
+
+void AudioFlinger::EffectModule::process_l()
+{
+    android_atomic_release_store((int32_t)ns2ms(systemTime()), &mProcessMs);
 
     if (mState == DESTROYED || mEffectInterface == NULL ||
-            mConfig.inputCfg.buffer.raw == NULL ||
-            mConfig.outputCfg.buffer.raw == NULL) {
+            mInBuffer == NULL ||
+            mOutBuffer == NULL) {
         return;
     }
 
+    // parameters queued while the previous buffer was processed take effect from this one on
+    applyQueuedParams_l();
+
     if (isProcessEnabled()) {
-        // do 32 bit to 16 bit conversion for auxiliary effect input buffer
+        const size_t frameCount = mConfig.inputCfg.buffer.frameCount;
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
-            ditherAndClamp(mConfig.inputCfg.buffer.s32,
-                                        mConfig.inputCfg.buffer.s32,
-                                        mConfig.inputCfg.buffer.frameCount/2);
+            // the auxiliary input buffer is accumulated by the mixer in Q4.27
+            if (mConfig.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+                memcpy_to_float_from_q4_27((float *)mInBuffer, (const int32_t *)mInBuffer,
+                        frameCount);
+            } else {
+                ditherAndClamp((int32_t *)mInBuffer, (const int32_t *)mInBuffer,
+                        frameCount/2);
+            }
+        } else if (mConvertsFormat) {
+            memcpy_to_i16_from_float(mInConversionBuffer, (const float *)mInBuffer,
+                    frameCount * audio_channel_count_from_out_mask(mConfig.inputCfg.channels));
         }
 
         // do the actual processing in the effect engine
@@ -286,22 +321,45 @@ void AudioFlinger::EffectModule::process()
             mDisableWaitCnt = 1;
         }
 
+        // the engine wrote 16 bit samples: convert them back to the chain buffer, which
+        // is accumulated onto here rather than by the engine
+        if (mConvertsFormat) {
+            const int16_t *src = mConfig.outputCfg.buffer.s16;
+            float *dst = (float *)mOutBuffer;
+            const size_t samples =
+                    frameCount * audio_channel_count_from_out_mask(mConfig.outputCfg.channels);
+            if (mInBuffer != mOutBuffer) {
+                for (size_t i = 0; i < samples; i++) {
+                    dst[i] += float_from_i16(src[i]);
+                }
+            } else {
+                memcpy_to_float_from_i16(dst, src, samples);
+            }
+        }
+
         // clear auxiliary effect input buffer for next accumulation
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
-            memset(mConfig.inputCfg.buffer.raw, 0,
-                   mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
+            memset(mInBuffer, 0, frameCount*sizeof(int32_t));
         }
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
-                mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
+                mInBuffer != mOutBuffer) {
         // If an insert effect is idle and input buffer is different from output buffer,
         // accumulate input onto output
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0 && chain->activeTrackCnt() != 0) {
             size_t frameCnt = mConfig.inputCfg.buffer.frameCount * 2;  //always stereo here
-            int16_t *in = mConfig.inputCfg.buffer.s16;
-            int16_t *out = mConfig.outputCfg.buffer.s16;
-            for (size_t i = 0; i < frameCnt; i++) {
-                out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
+            if (mBufferFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                const float *in = (const float *)mInBuffer;
+                float *out = (float *)mOutBuffer;
+                for (size_t i = 0; i < frameCnt; i++) {
+                    out[i] += in[i];
+                }
+            } else {
+                int16_t *in = mInBuffer;
+                int16_t *out = mOutBuffer;
+                for (size_t i = 0; i < frameCnt; i++) {
+                    out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
+                }
             }
         }
     }
@@ -350,8 +408,11 @@ status_t AudioFlinger::EffectModule::configure()
         }
     }
 
-    mConfig.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
-    mConfig.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    mBufferFormat = thread->effectBufferFormat();
+    mConfig.inputCfg.format = mBufferFormat;
+    mConfig.outputCfg.format = mBufferFormat;
+    mConfig.inputCfg.buffer.raw = mInBuffer;
+    mConfig.outputCfg.buffer.raw = mOutBuffer;
     mConfig.inputCfg.samplingRate = thread->sampleRate();
     mConfig.outputCfg.samplingRate = mConfig.inputCfg.samplingRate;
     mConfig.inputCfg.bufferProvider.cookie = NULL;
@@ -380,20 +441,31 @@ status_t AudioFlinger::EffectModule::configure()
     mConfig.inputCfg.buffer.frameCount = thread->frameCount();
     mConfig.outputCfg.buffer.frameCount = mConfig.inputCfg.buffer.frameCount;
 
-    ALOGV("configure() %p thread %p buffer %p framecount %d",
-            this, thread.get(), mConfig.inputCfg.buffer.raw, mConfig.inputCfg.buffer.frameCount);
+    ALOGV("configure() %p thread %p buffer %p framecount %d format %#x",
+            this, thread.get(), mConfig.inputCfg.buffer.raw, mConfig.inputCfg.buffer.frameCount,
+            mBufferFormat);
+
+    mConvertsFormat = false;
+    status = setConfig_l();
+    if (status != 0 && mBufferFormat != AUDIO_FORMAT_PCM_16_BIT) {
+        // The engine does not take the chain format: have it process 16 bit copies of the
+        // chain buffers, always writing its output. process() converts the output back and
+        // accumulates it if needed. The auxiliary input buffer is converted in place.
+        bool isAux = (mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY;
+        allocateConversionBuffers_l(mConfig.inputCfg.buffer.frameCount *
+                audio_channel_count_from_out_mask(mConfig.outputCfg.channels));
+        mConfig.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+        mConfig.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+        mConfig.inputCfg.buffer.s16 = isAux ? mInBuffer : mInConversionBuffer;
+        mConfig.outputCfg.buffer.s16 = (mInBuffer != mOutBuffer) ?
+                mOutConversionBuffer : mInConversionBuffer;
+        mConfig.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        status = setConfig_l();
+        mConvertsFormat = (status == 0);
+        ALOGV("configure() %p converts to and from 16 bit PCM, status %d", this, status);
+    }
 
     status_t cmdStatus;
-    size = sizeof(int);
-    status = (*mEffectInterface)->command(mEffectInterface,
-                                                   EFFECT_CMD_SET_CONFIG,
-                                                   sizeof(effect_config_t),
-                                                   &mConfig,
-                                                   &size,
-                                                   &cmdStatus);
-    if (status == 0) {
-        status = cmdStatus;
-    }
 
     if (status == 0 &&
             (memcmp(&mDescriptor.type, SL_IID_VISUALIZATION, sizeof(effect_uuid_t)) == 0)) {
@@ -423,11 +495,51 @@ status_t AudioFlinger::EffectModule::configure()
     mMaxDisableWaitCnt = (MAX_DISABLE_TIME_MS * mConfig.outputCfg.samplingRate) /
             (1000 * mConfig.outputCfg.buffer.frameCount);
 
+    // setParam() only queues parameters for an effect processed within the last two buffers
+    if (mConfig.outputCfg.samplingRate != 0) {
+        uint32_t intervalMs = (uint32_t)((2000LL * mConfig.outputCfg.buffer.frameCount) /
+                mConfig.outputCfg.samplingRate);
+        if (intervalMs < MIN_PROCESS_INTERVAL_MS) {
+            intervalMs = MIN_PROCESS_INTERVAL_MS;
+        } else if (intervalMs > MAX_PROCESS_INTERVAL_MS) {
+            intervalMs = MAX_PROCESS_INTERVAL_MS;
+        }
+        android_atomic_release_store((int32_t)intervalMs, &mMaxProcessIntervalMs);
+    }
+
 exit:
     mStatus = status;
     return status;
 }
 
+status_t AudioFlinger::EffectModule::setConfig_l()
+{
+    status_t cmdStatus;
+    uint32_t size = sizeof(int);
+    status_t status = (*mEffectInterface)->command(mEffectInterface,
+                                                   EFFECT_CMD_SET_CONFIG,
+                                                   sizeof(effect_config_t),
+                                                   &mConfig,
+                                                   &size,
+                                                   &cmdStatus);
+    if (status == 0) {
+        status = cmdStatus;
+    }
+    return status;
+}
+
+void AudioFlinger::EffectModule::allocateConversionBuffers_l(size_t samples)
+{
+    if (samples == mConversionBufferSamples) {
+        return;
+    }
+    delete[] mInConversionBuffer;
+    delete[] mOutConversionBuffer;
+    mInConversionBuffer = new int16_t[samples];
+    mOutConversionBuffer = new int16_t[samples];
+    mConversionBufferSamples = samples;
+}
+
 status_t AudioFlinger::EffectModule::init()
 {
     Mutex::Autolock _l(mLock);
@@ -549,15 +661,32 @@ status_t AudioFlinger::EffectModule::command(uint32_t cmdCode,
                                              uint32_t *replySize,
                                              void *pReplyData)
 {
-    Mutex::Autolock _l(mLock);
     ALOGVV("command(), cmdCode: %d, mEffectInterface: %p", cmdCode, mEffectInterface);
 
+    if (cmdCode == EFFECT_CMD_SET_PARAM) {
+        return setParam(cmdSize, pCmdData, replySize, pReplyData);
+    }
+
+    Mutex::Autolock _l(mLock);
+    return command_l(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+}
+
+// must be called with EffectModule::mLock held
+status_t AudioFlinger::EffectModule::command_l(uint32_t cmdCode,
+                                               uint32_t cmdSize,
+                                               void *pCmdData,
+                                               uint32_t *replySize,
+                                               void *pReplyData)
+{
     if (mState == DESTROYED || mEffectInterface == NULL) {
         return NO_INIT;
     }
     if (mStatus != NO_ERROR) {
         return mStatus;
     }
+    // parameters queued before this command must reach the engine first
+    applyQueuedParams_l();
+
     status_t status = (*mEffectInterface)->command(mEffectInterface,
                                                    cmdCode,
                                                    cmdSize,
@@ -576,6 +705,90 @@ status_t AudioFlinger::EffectModule::command(uint32_t cmdCode,
     return status;
 }
 
+status_t AudioFlinger::EffectModule::setParam(uint32_t cmdSize,
+                                              void *pCmdData,
+                                              uint32_t *replySize,
+                                              void *pReplyData)
+{
+    Mutex::Autolock _pl(mParamLock);
+
+    // commandExecuted() is a binder call, never sent from process(): with other handles
+    // listening, the parameter is applied here, as any other command
+    const int32_t processMs = android_atomic_acquire_load(&mProcessMs);
+    const bool processed = (int32_t)ns2ms(systemTime()) - processMs <=
+            android_atomic_acquire_load(&mMaxProcessIntervalMs);
+    if (processed && android_atomic_acquire_load(&mHandleCount) <= 1 &&
+            replySize != NULL && *replySize >= sizeof(int32_t) && pReplyData != NULL) {
+        // The audio thread processes the effect: rather than sending the command to the
+        // engine with mLock held, and so making it wait, leave it to the next process().
+        status_t status = queueParam(cmdSize, pCmdData);
+        if (status == NO_ERROR) {
+            mParamQueued++;
+            *replySize = sizeof(int32_t);
+            *(int32_t *)pReplyData = android_atomic_acquire_load(&mParamReply);
+            return NO_ERROR;
+        }
+        if (status == WOULD_BLOCK) {
+            mParamQueueFull++;
+        }
+    } else if (!processed) {
+        // nobody to make wait
+        mParamNotProcessed++;
+    }
+
+    Mutex::Autolock _l(mLock);
+    status_t status = command_l(EFFECT_CMD_SET_PARAM, cmdSize, pCmdData, replySize, pReplyData);
+    if (status == NO_ERROR && replySize != NULL && *replySize >= sizeof(int32_t)) {
+        android_atomic_release_store(*(int32_t *)pReplyData, &mParamReply);
+    }
+    return status;
+}
+
+// must be called with EffectModule::mParamLock held
+status_t AudioFlinger::EffectModule::queueParam(uint32_t cmdSize, const void *pCmdData)
+{
+    if (pCmdData == NULL || cmdSize < sizeof(effect_param_t) || cmdSize > PARAM_MAX_SIZE) {
+        return BAD_VALUE;
+    }
+    const uint32_t rear = (uint32_t)mParamRear;
+    if (rear - (uint32_t)android_atomic_acquire_load(&mParamFront) >= PARAM_QUEUE_SIZE) {
+        return WOULD_BLOCK;
+    }
+    ParamSlot *slot = &mParamQueue[rear & (PARAM_QUEUE_SIZE - 1)];
+    slot->cmdSize = cmdSize;
+    memcpy(slot->data, pCmdData, cmdSize);
+    android_atomic_release_store((int32_t)(rear + 1), &mParamRear);
+    return NO_ERROR;
+}
+
+// must be called with EffectModule::mLock held
+void AudioFlinger::EffectModule::applyQueuedParams_l()
+{
+    const uint32_t rear = (uint32_t)android_atomic_acquire_load(&mParamRear);
+    uint32_t front = (uint32_t)mParamFront;
+    for (; front != rear; front++) {
+        ParamSlot *slot = &mParamQueue[front & (PARAM_QUEUE_SIZE - 1)];
+        int32_t reply = 0;
+        uint32_t replySize = sizeof(reply);
+        status_t status = (*mEffectInterface)->command(mEffectInterface,
+                                                       EFFECT_CMD_SET_PARAM,
+                                                       slot->cmdSize,
+                                                       slot->data,
+                                                       &replySize,
+                                                       &reply);
+        if (status != NO_ERROR || reply != 0) {
+            // the caller has had its reply already
+            mParamRejected++;
+            ALOGW("applyQueuedParams_l(): %s rejected queued parameter, status %d reply %d",
+                    mDescriptor.name, status, reply);
+        }
+        if (status == NO_ERROR) {
+            android_atomic_release_store(reply, &mParamReply);
+        }
+    }
+    android_atomic_release_store((int32_t)front, &mParamFront);
+}
+
 status_t AudioFlinger::EffectModule::setEnabled(bool enabled)
 {
     Mutex::Autolock _l(mLock);
@@ -1008,6 +1221,19 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             mConfig.outputCfg.format,
             formatToString((audio_format_t)mConfig.outputCfg.format));
     result.append(buffer);
+    if (mConvertsFormat) {
+        snprintf(buffer, SIZE, "\t\t- Converted from and to %s chain buffers\n",
+                formatToString(mBufferFormat));
+        result.append(buffer);
+    }
+
+    result.append("\t\t- Lock contention: process queued notProcessed queueFull rejected "
+            "pending\n");
+    snprintf(buffer, SIZE, "\t\t\t%7u %6u %12u %9u %8u %7u\n",
+            mProcessLockContended, mParamQueued, mParamNotProcessed, mParamQueueFull,
+            mParamRejected,
+            (uint32_t)android_atomic_acquire_load(&mParamRear) - (uint32_t)mParamFront);
+    result.append(buffer);
 
     snprintf(buffer, SIZE, "\t\t%zu Clients:\n", mHandles.size());
     result.append(buffer);
@@ -1343,8 +1569,9 @@ void AudioFlinger::EffectHandle::dumpToBuffer(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         int sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
-      mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
-      mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX), mForceVolume(false)
+      mOwnInBuffer(false), mOwnOutBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX),
+      mRightVolume(UINT_MAX), mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX),
+      mForceVolume(false), mProcessCount(0), mProcessTotalNs(0), mProcessMaxNs(0)
 {
     mStrategy = AudioSystem::getStrategyForStream(AUDIO_STREAM_MUSIC);
     if (thread == NULL) {
@@ -1356,10 +1583,13 @@ AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
 
 AudioFlinger::EffectChain::~EffectChain()
 {
+    // owned buffers are allocated by PlaybackThread::addEffectChain_l()
     if (mOwnInBuffer) {
-        delete mInBuffer;
+        free(mInBuffer);
+    }
+    if (mOwnOutBuffer) {
+        free(mOutBuffer);
     }
-
 }
 
 // getEffectFromDesc_l() must be called with ThreadBase::mLock held
@@ -1418,23 +1648,34 @@ void AudioFlinger::EffectChain::clearInputBuffer()
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::clearInputBuffer_l(sp<ThreadBase> thread)
 {
-    // TODO: This will change in the future, depending on multichannel
-    // and sample format changes for effects.
-    // Currently effects processing is only available for stereo, AUDIO_FORMAT_PCM_16_BIT
-    // (4 bytes frame size)
+    // TODO: This will change in the future, depending on multichannel effects.
+    // Currently effects processing is only available for stereo
     const size_t frameSize =
-            audio_bytes_per_sample(AUDIO_FORMAT_PCM_16_BIT) * min(FCC_2, thread->channelCount());
+            audio_bytes_per_sample(thread->effectBufferFormat()) *
+            min(FCC_2, thread->channelCount());
     memset(mInBuffer, 0, thread->frameCount() * frameSize);
 }
 
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::process_l()
+{
+    processEffects_l();
+    updateEffectStates_l();
+}
+
+void AudioFlinger::EffectChain::processEffects_l()
 {
     sp<ThreadBase> thread = mThread.promote();
     if (thread == 0) {
-        ALOGW("process_l(): cannot promote mixer thread");
+        ALOGW("processEffects_l(): cannot promote mixer thread");
         return;
     }
+    nsecs_t startNs = systemTime();
+    // effects accumulate onto the output buffer, so a buffer of our own starts from silence
+    if (mOwnOutBuffer) {
+        memset(mOutBuffer, 0, thread->frameCount() * thread->channelCount() *
+                audio_bytes_per_sample(thread->effectBufferFormat()));
+    }
     bool isGlobalSession = (mSessionId == AUDIO_SESSION_OUTPUT_MIX) ||
             (mSessionId == AUDIO_SESSION_OUTPUT_STAGE);
     // never process effects when:
@@ -1466,6 +1707,18 @@ void AudioFlinger::EffectChain::process_l()
             mEffects[i]->process();
         }
     }
+
+    nsecs_t ns = systemTime() - startNs;
+    mProcessCount++;
+    mProcessTotalNs += ns;
+    if (ns > mProcessMaxNs) {
+        mProcessMaxNs = ns;
+    }
+}
+
+void AudioFlinger::EffectChain::updateEffectStates_l()
+{
+    size_t size = mEffects.size();
     for (size_t i = 0; i < size; i++) {
         mEffects[i]->updateState();
     }
@@ -1743,6 +1996,13 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
                 mOutBuffer,
                 mActiveTrackCnt);
         result.append(buffer);
+        uint32_t processCount = mProcessCount;
+        snprintf(buffer, SIZE, "\tProcess calls %u, mean %.1f us, max %.1f us%s\n",
+                processCount,
+                processCount != 0 ? mProcessTotalNs * 1e-3 / processCount : 0.,
+                mProcessMaxNs * 1e-3,
+                mOwnOutBuffer ? ", in parallel with other sessions" : "");
+        result.append(buffer);
         write(fd, result.string(), result.size());
 
         for (size_t i = 0; i < numEffects; ++i) {
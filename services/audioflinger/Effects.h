@@ -84,10 +84,13 @@ public:
     bool isEnabled() const;
     bool isProcessEnabled() const;
 
-    void        setInBuffer(int16_t *buffer) { mConfig.inputCfg.buffer.s16 = buffer; }
-    int16_t     *inBuffer() { return mConfig.inputCfg.buffer.s16; }
-    void        setOutBuffer(int16_t *buffer) { mConfig.outputCfg.buffer.s16 = buffer; }
-    int16_t     *outBuffer() { return mConfig.outputCfg.buffer.s16; }
+    // The chain buffers hold samples in the thread's effect buffer format (see
+    // ThreadBase::effectBufferFormat()), whatever the pointer type.
+    // They are handed to the effect engine by the next call to configure().
+    void        setInBuffer(int16_t *buffer) { mInBuffer = buffer; }
+    int16_t     *inBuffer() { return mInBuffer; }
+    void        setOutBuffer(int16_t *buffer) { mOutBuffer = buffer; }
+    int16_t     *outBuffer() { return mOutBuffer; }
     void        setChain(const wp<EffectChain>& chain) { mChain = chain; }
     void        setThread(const wp<ThreadBase>& thread) { mThread = thread; }
     const wp<ThreadBase>& thread() { return mThread; }
@@ -136,6 +139,36 @@ protected:
     status_t start_l();
     status_t stop_l();
     status_t remove_effect_from_hal_l();
+    status_t setConfig_l();
+    void     allocateConversionBuffers_l(size_t samples);
+    void     process_l();
+    status_t command_l(uint32_t cmdCode,
+                       uint32_t cmdSize,
+                       void *pCmdData,
+                       uint32_t *replySize,
+                       void *pReplyData);
+    status_t setParam(uint32_t cmdSize,
+                      void *pCmdData,
+                      uint32_t *replySize,
+                      void *pReplyData);
+    status_t queueParam(uint32_t cmdSize, const void *pCmdData);
+    void     applyQueuedParams_l();
+
+    // Parameter mailbox: while the effect is being processed, EFFECT_CMD_SET_PARAM commands
+    // are queued here rather than sent to the engine with mLock held, which would make the
+    // audio thread wait for them. The next holder of mLock applies them: process() before
+    // the next buffer, or command() before any other engine command. setParam() does not
+    // wait for the engine, and replies with the engine reply to the last parameter applied.
+    // An effect which has not been processed within the last couple of buffers, or which
+    // other handles listen to for commandExecuted(), gets its parameters straight away.
+    static const uint32_t PARAM_QUEUE_SIZE = 16;    // must be a power of 2
+    static const uint32_t PARAM_MAX_SIZE = 128;     // larger commands are not queued
+    static const uint32_t MIN_PROCESS_INTERVAL_MS = 10;
+    static const uint32_t MAX_PROCESS_INTERVAL_MS = 100;
+    struct ParamSlot {
+        uint32_t    cmdSize;
+        uint32_t    data[PARAM_MAX_SIZE / sizeof(uint32_t)];
+    };
 
 mutable Mutex               mLock;      // mutex for process, commands and handles list protection
     wp<ThreadBase>      mThread;    // parent thread
@@ -144,6 +177,15 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     const int           mSessionId; // audio session ID
     const effect_descriptor_t mDescriptor;// effect descriptor received from effect engine
     effect_config_t     mConfig;    // input and output audio configuration
+    int16_t             *mInBuffer;  // chain input buffer, or auxiliary input buffer
+    int16_t             *mOutBuffer; // chain buffer the effect writes or accumulates to
+    audio_format_t      mBufferFormat;  // format of the chain buffers
+    // true if the effect engine only takes 16 bit PCM and the chain buffers are float:
+    // process() then converts the chain buffers to and from the conversion buffers below
+    bool                mConvertsFormat;
+    int16_t             *mInConversionBuffer;
+    int16_t             *mOutConversionBuffer;
+    size_t              mConversionBufferSamples;
     effect_handle_t  mEffectInterface; // Effect module C API
     status_t            mStatus;    // initialization status
     effect_state        mState;     // current activation state
@@ -155,6 +197,23 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
     wp<AudioFlinger>    mAudioFlinger;
+
+    Mutex               mParamLock; // serializes binder threads queueing parameters
+    ParamSlot           mParamQueue[PARAM_QUEUE_SIZE];
+    // free running indices into mParamQueue: slots [mParamFront, mParamRear) wait to be applied.
+    // 'volatile' here means these are accessed with atomic operations instead of mutex
+    volatile int32_t    mParamRear;     // written with mParamLock held
+    volatile int32_t    mParamFront;    // written with mLock held
+    volatile int32_t    mParamReply;    // engine reply to the last parameter applied
+    volatile int32_t    mHandleCount;   // mHandles.size(), written with mLock held
+    volatile int32_t    mProcessMs;     // time of the last process(), in ms, wraps around
+    volatile int32_t    mMaxProcessIntervalMs; // process() is this late at most, by configure()
+    // contention statistics, for dumpsys
+    uint32_t            mProcessLockContended;  // process() found mLock held
+    uint32_t            mParamQueued;           // parameters queued for process()
+    uint32_t            mParamNotProcessed;     // parameters applied by setParam() itself
+    uint32_t            mParamQueueFull;        // mailbox full, setParam() waited for mLock
+    uint32_t            mParamRejected;         // queued parameters rejected by the engine
 };
 
 // The EffectHandle class implements the IEffect interface. It provides resources
@@ -255,6 +314,11 @@ public:
     static const int        kProcessTailDurationMs = 1000;
 
     void process_l();
+    // The two halves of process_l().  processEffects_l() only uses the buffers of this chain
+    // and of its effects, so it can run on another thread than the playback thread, in
+    // parallel with other chains.  updateEffectStates_l() must run on the playback thread.
+    void processEffects_l();
+    void updateEffectStates_l();
 
     void lock() {
         mLock.lock();
@@ -285,12 +349,18 @@ public:
     int16_t *inBuffer() const {
         return mInBuffer;
     }
-    void setOutBuffer(int16_t *buffer) {
+    void setOutBuffer(int16_t *buffer, bool ownsBuffer = false) {
         mOutBuffer = buffer;
+        mOwnOutBuffer = ownsBuffer;
     }
     int16_t *outBuffer() const {
         return mOutBuffer;
     }
+    // true if the chain outputs to a buffer of its own, which the playback thread adds
+    // to its mix after processing the chain
+    bool ownsOutBuffer() const {
+        return mOwnOutBuffer;
+    }
 
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
@@ -373,6 +443,7 @@ protected:
     int32_t mTailBufferCount;   // current effect tail buffer count
     int32_t mMaxTailBuffers;    // maximum effect tail buffers
     bool mOwnInBuffer;          // true if the chain owns its input buffer
+    bool mOwnOutBuffer;         // true if the chain owns its output buffer
     int mVolumeCtrlIdx;         // index of insert effect having control over volume
     uint32_t mLeftVolume;       // previous volume on left channel
     uint32_t mRightVolume;      // previous volume on right channel
@@ -385,4 +456,9 @@ protected:
     // Updated by updateSuspendedSessions_l() only.
     KeyedVector< int, sp<SuspendedEffectDesc> > mSuspendedEffects;
     volatile int32_t mForceVolume; // force next volume command because a new effect was enabled
+
+    // processEffects_l() statistics, for dumpsys
+    uint32_t mProcessCount;     // number of calls
+    nsecs_t mProcessTotalNs;    // total time spent in processEffects_l()
+    nsecs_t mProcessMaxNs;      // longest single call
 };
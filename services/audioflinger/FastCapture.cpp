@@ -201,10 +201,14 @@ void FastCapture::onWork()
                 int32_t rear = cblk->u.mStreaming.mRear;
                 android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
                 cblk->mServer += framesWritten;
-                int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-                if (!(old & CBLK_FUTEX_WAKE)) {
-                    // client is never in server process, so don't use FUTEX_WAKE_PRIVATE
-                    (void) syscall(__NR_futex, &cblk->mFutex, FUTEX_WAKE, 1);
+                // only wake the client if it is waiting, see ServerProxy::wakeClient()
+                android_memory_barrier();
+                if (android_atomic_acquire_load(&cblk->mFutexWaiters) > 0) {
+                    int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
+                    if (!(old & CBLK_FUTEX_WAKE)) {
+                        // client is never in server process, so don't use FUTEX_WAKE_PRIVATE
+                        (void) syscall(__NR_futex, &cblk->mFutex, FUTEX_WAKE, 1);
+                    }
                 }
             }
         }
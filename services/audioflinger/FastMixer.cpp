@@ -184,7 +184,8 @@ void FastMixer::onStateChange()
             // FIXME new may block for unbounded time at internal mutex of the heap
             //       implementation; it would be better to have normal mixer allocate for us
             //       to avoid blocking here and to prevent possible priority inversion
-            mMixer = new AudioMixer(frameCount, mSampleRate, FastMixerState::kMaxFastTracks);
+            mMixer = new AudioMixer(frameCount, mSampleRate,
+                    FastMixerState::getMaxFastTracks());
             const size_t mixerFrameSize = mSinkChannelCount
                     * audio_bytes_per_sample(mMixerBufferFormat);
             mMixerBufferSize = mixerFrameSize * frameCount;
@@ -234,7 +235,7 @@ void FastMixer::onStateChange()
         unsigned removedTracks = previousTrackMask & ~currentTrackMask;
         while (removedTracks != 0) {
             int i = __builtin_ctz(removedTracks);
-            removedTracks &= ~(1 << i);
+            removedTracks &= ~(1u << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             ALOG_ASSERT(fastTrack->mBufferProvider == NULL);
             if (mMixer != NULL) {
@@ -253,7 +254,7 @@ void FastMixer::onStateChange()
         unsigned addedTracks = currentTrackMask & ~previousTrackMask;
         while (addedTracks != 0) {
             int i = __builtin_ctz(addedTracks);
-            addedTracks &= ~(1 << i);
+            addedTracks &= ~(1u << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             AudioBufferProvider *bufferProvider = fastTrack->mBufferProvider;
             ALOG_ASSERT(bufferProvider != NULL && mFastTrackNames[i] == -1);
@@ -286,7 +287,7 @@ void FastMixer::onStateChange()
         unsigned modifiedTracks = currentTrackMask & previousTrackMask;
         while (modifiedTracks != 0) {
             int i = __builtin_ctz(modifiedTracks);
-            modifiedTracks &= ~(1 << i);
+            modifiedTracks &= ~(1u << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             if (fastTrack->mGeneration != mGenerations[i]) {
                 // this track was actually modified
@@ -331,14 +332,16 @@ void FastMixer::onWork()
     FastMixerDumpState * const dumpState = (FastMixerDumpState *) mDumpState;
     const FastMixerState::Command command = mCommand;
     const size_t frameCount = current->mFrameCount;
+    uint8_t numTracksMixed = 0;
 
     if ((command & FastMixerState::MIX) && (mMixer != NULL) && mIsWarm) {
         ALOG_ASSERT(mMixerBuffer != NULL);
+        numTracksMixed = popcount(current->mTrackMask);
         // for each track, update volume and check for underrun
         unsigned currentTrackMask = current->mTrackMask;
         while (currentTrackMask != 0) {
             int i = __builtin_ctz(currentTrackMask);
-            currentTrackMask &= ~(1 << i);
+            currentTrackMask &= ~(1u << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
 
             // Refresh the per-track timestamp
@@ -413,6 +416,10 @@ void FastMixer::onWork()
     } else if (mMixerBufferState == MIXED) {
         mMixerBufferState = UNDEFINED;
     }
+#ifdef FAST_THREAD_STATISTICS
+    // FastThread stores this cycle's statistics at the same index after onWork() returns
+    dumpState->mNumTracksMixed[mBounds & (dumpState->mSamplingN - 1)] = numTracksMixed;
+#endif
     //bool didFullWrite = false;    // dumpsys could display a count of partial writes
     if ((command & FastMixerState::WRITE) && (mOutputSink != NULL) && (mMixerBuffer != NULL)) {
         if (mMixerBufferState == UNDEFINED) {
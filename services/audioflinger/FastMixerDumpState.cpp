@@ -86,6 +86,9 @@ void FastMixerDumpState::dump(int fd) const
     // statistics for monotonic (wall clock) time, thread raw CPU load in time, CPU clock frequency,
     // and adjusted CPU load in MHz normalized for CPU clock frequency
     CentralTendencyStatistics wall, loadNs;
+    // the same, broken down by the number of tracks mixed in each cycle
+    CentralTendencyStatistics wallByTracks[FastMixerState::kMaxFastTracks + 1];
+    CentralTendencyStatistics loadNsByTracks[FastMixerState::kMaxFastTracks + 1];
 #ifdef CPU_FREQUENCY_STATISTICS
     CentralTendencyStatistics kHz, loadMHz;
     uint32_t previousCpukHz = 0;
@@ -105,6 +108,11 @@ void FastMixerDumpState::dump(int fd) const
         wall.sample(wallNs);
         uint32_t sampleLoadNs = mLoadNs[i];
         loadNs.sample(sampleLoadNs);
+        uint32_t numTracksMixed = mNumTracksMixed[i];
+        if (numTracksMixed <= FastMixerState::kMaxFastTracks) {
+            wallByTracks[numTracksMixed].sample(wallNs);
+            loadNsByTracks[numTracksMixed].sample(sampleLoadNs);
+        }
 #ifdef CPU_FREQUENCY_STATISTICS
         uint32_t sampleCpukHz = mCpukHz[i];
         // skip bad kHz samples
@@ -130,6 +138,18 @@ void FastMixerDumpState::dump(int fd) const
                     "      mean=%.0f min=%.0f max=%.0f stddev=%.0f\n",
                     loadNs.mean()*1e-3, loadNs.minimum()*1e-3, loadNs.maximum()*1e-3,
                     loadNs.stddev()*1e-3);
+        dprintf(fd, "    by number of tracks mixed:\n"
+                    "      Tracks Cycles  WallMean WallMax  LoadMean LoadMax LoadStddev\n");
+        for (uint32_t k = 0; k <= FastMixerState::kMaxFastTracks; ++k) {
+            const CentralTendencyStatistics& w = wallByTracks[k];
+            const CentralTendencyStatistics& l = loadNsByTracks[k];
+            if (l.n() == 0) {
+                continue;
+            }
+            dprintf(fd, "      %6u %6u %6.2fms %5.2fms %6.0fus %5.0fus %8.0fus\n",
+                        k, l.n(), w.mean()*1e-6, w.maximum()*1e-6,
+                        l.mean()*1e-3, l.maximum()*1e-3, l.stddev()*1e-3);
+        }
     } else {
         dprintf(fd, "  No FastMixer statistics available currently\n");
     }
@@ -73,6 +73,11 @@ struct FastMixerDumpState : FastThreadDumpState {
     size_t   mFrameCount;
     uint32_t mTrackMask;        // mask of active tracks
     FastTrackDump   mTracks[FastMixerState::kMaxFastTracks];
+#ifdef FAST_THREAD_STATISTICS
+    // Number of tracks mixed in each cycle, indexed like the sample arrays of
+    // FastThreadDumpState, so that the cycle statistics can be broken down by track count.
+    uint8_t  mNumTracksMixed[kSamplingN];
+#endif
 };
 
 }   // android
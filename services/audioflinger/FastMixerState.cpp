@@ -14,6 +14,12 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "FastMixerState"
+//#define LOG_NDEBUG 0
+
+#include <stdlib.h>
+#include <cutils/properties.h>
+#include <utils/Log.h>
 #include "FastMixerState.h"
 
 namespace android {
@@ -39,6 +45,54 @@ FastMixerState::~FastMixerState()
 {
 }
 
+FastMixerState& FastMixerState::operator=(const FastMixerState& rhs)
+{
+    if (this == &rhs) {
+        return *this;
+    }
+    FastThreadState::operator=(rhs);
+    if (mFastTracksGen != rhs.mFastTracksGen) {
+        for (unsigned i = 0; i < kMaxFastTracks; ++i) {
+            if (mFastTracks[i].mGeneration != rhs.mFastTracks[i].mGeneration) {
+                mFastTracks[i] = rhs.mFastTracks[i];
+            }
+        }
+        mFastTracksGen = rhs.mFastTracksGen;
+    }
+    mTrackMask = rhs.mTrackMask;
+    mOutputSink = rhs.mOutputSink;
+    mOutputSinkGen = rhs.mOutputSinkGen;
+    mFrameCount = rhs.mFrameCount;
+    mTeeSink = rhs.mTeeSink;
+    return *this;
+}
+
+unsigned FastMixerState::sMaxFastTracks = kDefaultFastTracks;
+pthread_once_t FastMixerState::sMaxFastTracksOnce = PTHREAD_ONCE_INIT;
+
+// static
+void FastMixerState::sMaxFastTracksInit()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.max_fast_tracks", value, NULL) > 0) {
+        char *endptr;
+        unsigned long ul = strtoul(value, &endptr, 0);
+        if (*endptr == '\0' && kMinFastTracks <= ul && ul <= kMaxFastTracks) {
+            sMaxFastTracks = (unsigned) ul;
+        } else {
+            ALOGW("ignoring ro.audio.max_fast_tracks=%s, must be between %u and %u",
+                    value, kMinFastTracks, kMaxFastTracks);
+        }
+    }
+}
+
+// static
+unsigned FastMixerState::getMaxFastTracks()
+{
+    pthread_once(&sMaxFastTracksOnce, sMaxFastTracksInit);
+    return sMaxFastTracks;
+}
+
 // static
 const char *FastMixerState::commandToString(Command command)
 {
@@ -17,6 +17,7 @@
 #ifndef ANDROID_AUDIO_FAST_MIXER_STATE_H
 #define ANDROID_AUDIO_FAST_MIXER_STATE_H
 
+#include <pthread.h>
 #include <audio_utils/minifloat.h>
 #include <system/audio.h>
 #include <media/ExtendedAudioBufferProvider.h>
@@ -54,7 +55,21 @@ struct FastMixerState : FastThreadState {
                 FastMixerState();
     /*virtual*/ ~FastMixerState();
 
-    static const unsigned kMaxFastTracks = 8;   // must be between 2 and 32 inclusive
+    // Copies only the fast tracks whose generation differs; within the states of one queue,
+    // a track with the same generation has the same contents.  This keeps the cost of
+    // StateQueue::push(), which copies the whole state, proportional to the modified tracks.
+    FastMixerState& operator=(const FastMixerState& rhs);
+
+    // These are the minimum, maximum, and default values for maximum number of fast tracks.
+    // The maximum is bounded by the 32-bit track masks here and in AudioMixer.
+    static const unsigned kMinFastTracks = 2;
+    static const unsigned kMaxFastTracks = 32;
+    static const unsigned kDefaultFastTracks = 8;
+
+    // Configured maximum number of fast tracks, from property ro.audio.max_fast_tracks,
+    // between kMinFastTracks and kMaxFastTracks inclusive.  Slots at or above this index
+    // are never used.
+    static unsigned getMaxFastTracks();
 
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
     FastTrack   mFastTracks[kMaxFastTracks];
@@ -76,6 +91,11 @@ struct FastMixerState : FastThreadState {
 
     // never returns NULL; asserts if command is invalid
     static const char *commandToString(Command command);
+
+private:
+    static unsigned sMaxFastTracks;             // Configured maximum number of fast tracks
+    static pthread_once_t sMaxFastTracksOnce;   // Protects initializer for sMaxFastTracks
+    static void sMaxFastTracksInit();
 };  // struct FastMixerState
 
 }   // namespace android
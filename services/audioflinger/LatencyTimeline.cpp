@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LatencyTimeline"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <cpustats/CentralTendencyStatistics.h>
+#include "LatencyTimeline.h"
+
+namespace android {
+
+LatencyHistogram::LatencyHistogram()
+    : mCount(0), mMaxUs(0)
+{
+    memset(mBins, 0, sizeof(mBins));
+}
+
+// static
+uint32_t LatencyHistogram::binOf(nsecs_t ns)
+{
+    if (ns < 0) {
+        return 0;
+    }
+    if (ns < kFineBins * kFineBinNs) {
+        return ns / kFineBinNs;
+    }
+    nsecs_t coarse = (ns - kFineBins * kFineBinNs) / kCoarseBinNs;
+    if (coarse >= kCoarseBins) {
+        coarse = kCoarseBins - 1;
+    }
+    return kFineBins + coarse;
+}
+
+// static
+nsecs_t LatencyHistogram::upperBoundOf(uint32_t bin)
+{
+    if (bin < kFineBins) {
+        return (bin + 1) * kFineBinNs;
+    }
+    return kFineBins * kFineBinNs + (bin - kFineBins + 1) * kCoarseBinNs;
+}
+
+void LatencyHistogram::add(nsecs_t ns)
+{
+    mBins[binOf(ns)]++;
+    mCount++;
+    nsecs_t us = ns / 1000;
+    if (us > UINT32_MAX) {
+        us = UINT32_MAX;
+    }
+    if ((uint32_t) us > mMaxUs) {
+        mMaxUs = (uint32_t) us;
+    }
+}
+
+nsecs_t LatencyHistogram::percentile(double fraction) const
+{
+    // the bins are updated while we read them, so use their own total
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < kFineBins + kCoarseBins; i++) {
+        total += mBins[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (fraction * total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kFineBins + kCoarseBins; i++) {
+        seen += mBins[i];
+        if (seen >= rank) {
+            return upperBoundOf(i);
+        }
+    }
+    return upperBoundOf(kFineBins + kCoarseBins - 1);
+}
+
+// ----------------------------------------------------------------------------
+
+LatencyTimeline::LatencyTimeline()
+    : mRecorded(0), mStage(STAGE_IDLE), mStageStartNs(0), mPipelineNs(0)
+{
+    memset(mCycles, 0, sizeof(mCycles));
+    memset(&mCurrent, 0, sizeof(mCurrent));
+}
+
+void LatencyTimeline::nextStage(stage_t stage)
+{
+    nsecs_t now = systemTime();
+    nsecs_t delta = now - mStageStartNs;
+    uint32_t ns = delta < 0 ? 0 : delta > UINT32_MAX ? UINT32_MAX : (uint32_t) delta;
+    switch (mStage) {
+    case STAGE_MIX:
+        mCurrent.mMixNs += ns;
+        break;
+    case STAGE_EFFECTS:
+        mCurrent.mEffectsNs += ns;
+        break;
+    case STAGE_WRITE:
+        mCurrent.mWriteNs += ns;
+        break;
+    default:
+        break;
+    }
+    mStage = stage;
+    mStageStartNs = now;
+}
+
+void LatencyTimeline::beginMix(size_t activeTracks)
+{
+    memset(&mCurrent, 0, sizeof(mCurrent));
+    mStageStartNs = systemTime();
+    mCurrent.mStartNs = mStageStartNs;
+    mCurrent.mActiveTracks = activeTracks;
+    mStage = STAGE_MIX;
+}
+
+void LatencyTimeline::beginEffects()
+{
+    if (mStage == STAGE_MIX) {
+        nextStage(STAGE_EFFECTS);
+    }
+}
+
+void LatencyTimeline::beginWrite()
+{
+    // a buffer written in several pieces is one write stage, waits in between included
+    if (mStage == STAGE_MIX || mStage == STAGE_EFFECTS) {
+        nextStage(STAGE_WRITE);
+    }
+}
+
+void LatencyTimeline::endWrite(size_t frames, nsecs_t presentationNs)
+{
+    if (mStage != STAGE_WRITE) {
+        return;
+    }
+    nextStage(STAGE_IDLE);
+    mCurrent.mFrames += frames;
+    if (presentationNs < 0) {
+        presentationNs = 0;
+    }
+    mCurrent.mPresentationNs =
+            presentationNs > UINT32_MAX ? UINT32_MAX : (uint32_t) presentationNs;
+    mCycles[mRecorded & (kCycles - 1)] = mCurrent;
+    mRecorded++;
+    mPipelineNs = (nsecs_t) mCurrent.mMixNs + mCurrent.mEffectsNs + mCurrent.mWriteNs +
+            mCurrent.mPresentationNs;
+}
+
+nsecs_t LatencyTimeline::takePipelineNs()
+{
+    nsecs_t pipelineNs = mPipelineNs;
+    mPipelineNs = 0;
+    return pipelineNs;
+}
+
+// helper function called by qsort()
+static int compare_uint32_t(const void *pa, const void *pb)
+{
+    uint32_t a = *(const uint32_t *)pa;
+    uint32_t b = *(const uint32_t *)pb;
+    if (a < b) {
+        return -1;
+    } else if (a > b) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+void LatencyTimeline::dump(int fd) const
+{
+    uint32_t recorded = mRecorded;
+    uint32_t n = recorded < kCycles ? recorded : kCycles;
+    if (n == 0) {
+        dprintf(fd, "  Latency timeline: no cycles recorded\n");
+        return;
+    }
+    static const char * const kStageNames[] = {"mix", "effects", "write", "presentation"};
+    static const size_t kStages = sizeof(kStageNames) / sizeof(kStageNames[0]);
+    uint32_t *samples = new uint32_t[kStages * n];
+    uint32_t known = 0;     // cycles with a known presentation time
+    for (uint32_t j = 0; j < n; j++) {
+        const Cycle *cycle = &mCycles[(recorded - n + j) & (kCycles - 1)];
+        samples[j] = cycle->mMixNs;
+        samples[n + j] = cycle->mEffectsNs;
+        samples[2 * n + j] = cycle->mWriteNs;
+        if (cycle->mPresentationNs != 0) {
+            samples[3 * n + known++] = cycle->mPresentationNs;
+        }
+    }
+    dprintf(fd, "  Latency timeline of the last %u cycles in ms:\n", n);
+    dprintf(fd, "    Stage         Mean    P50    P90    P99    Max\n");
+    for (size_t k = 0; k < kStages; k++) {
+        uint32_t count = k == kStages - 1 ? known : n;
+        if (count == 0) {
+            dprintf(fd, "    %-12s unknown\n", kStageNames[k]);
+            continue;
+        }
+        uint32_t *stage = &samples[k * n];
+        CentralTendencyStatistics stats;
+        for (uint32_t j = 0; j < count; j++) {
+            stats.sample(stage[j]);
+        }
+        qsort(stage, count, sizeof(uint32_t), compare_uint32_t);
+        dprintf(fd, "    %-12s %6.2f %6.2f %6.2f %6.2f %6.2f\n", kStageNames[k],
+                stats.mean() * 1e-6,
+                stage[(count - 1) * 50 / 100] * 1e-6,
+                stage[(count - 1) * 90 / 100] * 1e-6,
+                stage[(count - 1) * 99 / 100] * 1e-6,
+                stage[count - 1] * 1e-6);
+    }
+    delete[] samples;
+}
+
+void LatencyTimeline::dumpTrace(int fd, uint32_t ioHandle, uint32_t sampleRate) const
+{
+    uint32_t recorded = mRecorded;
+    uint32_t n = recorded < kCycles ? recorded : kCycles;
+    TraceHeader header;
+    header.mMagic = kTraceMagic;
+    header.mVersion = kTraceVersion;
+    header.mIoHandle = ioHandle;
+    header.mSampleRate = sampleRate;
+    header.mCycleSize = sizeof(Cycle);
+    header.mCycleCount = n;
+    if (write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+        return;
+    }
+    // oldest first, in at most two pieces
+    uint32_t oldest = (recorded - n) & (kCycles - 1);
+    uint32_t part1 = kCycles - oldest;
+    if (part1 > n) {
+        part1 = n;
+    }
+    if (write(fd, &mCycles[oldest], part1 * sizeof(Cycle)) != (ssize_t) (part1 * sizeof(Cycle))) {
+        return;
+    }
+    if (n > part1) {
+        (void) write(fd, &mCycles[0], (n - part1) * sizeof(Cycle));
+    }
+}
+
+}   // namespace android
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LATENCY_TIMELINE_H
+#define ANDROID_AUDIO_LATENCY_TIMELINE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Histogram of latencies, from which dumpsys reports percentiles.
+// Samples are added by a single thread without lock or barrier, and read racily by dumpsys.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void        add(nsecs_t ns);
+    uint32_t    count() const { return mCount; }
+    // Upper bound of the bin holding the given fraction (0.0 to 1.0) of the samples,
+    // or 0 if there are none.
+    nsecs_t     percentile(double fraction) const;
+    nsecs_t     maximum() const { return (nsecs_t) mMaxUs * 1000; }
+
+private:
+    // 0.5 ms bins up to 64 ms, then 4 ms bins up to 576 ms.
+    // The last bin also counts the longer latencies.
+    static const uint32_t kFineBins = 128;
+    static const uint32_t kCoarseBins = 128;
+    static const nsecs_t kFineBinNs = 500000;
+    static const nsecs_t kCoarseBinNs = 4000000;
+
+    static uint32_t binOf(nsecs_t ns);
+    static nsecs_t  upperBoundOf(uint32_t bin);
+
+    uint32_t    mBins[kFineBins + kCoarseBins];
+    uint32_t    mCount;
+    uint32_t    mMaxUs;
+};
+
+// The LatencyTimeline of a PlaybackThread records how long each stage of each mix cycle took:
+// preparing and mixing the tracks, the effect chains, the write to the sink, and then the time
+// until the HAL presents the last frame written, as reported by the sink's timestamp.
+// The thread calls beginMix(), then beginEffects() if it processes effects, beginWrite(), and
+// endWrite() once the whole mix buffer has been written. A cycle abandoned before endWrite()
+// is not recorded.
+// The recent cycles are kept for dumpsys, which reports statistics of each stage, and can also
+// write them out as a binary trace for offline analysis.
+// Cycles are written without lock or barrier by the thread, and read racily by dumpsys.
+class LatencyTimeline {
+public:
+    // One cycle of the binary trace, in native byte order.
+    struct Cycle {
+        int64_t     mStartNs;       // CLOCK_MONOTONIC at the start of the cycle
+        uint32_t    mMixNs;         // preparing and mixing the tracks
+        uint32_t    mEffectsNs;     // processing the effect chains
+        uint32_t    mWriteNs;       // writing to the sink, blocking included
+        uint32_t    mPresentationNs;    // from the end of the write until the HAL presents the
+                                        // last frame written, or 0 if unknown
+        uint32_t    mFrames;        // frames written
+        uint32_t    mActiveTracks;  // active tracks at the start of the cycle
+    };
+
+    // The binary trace of a thread is a TraceHeader followed by mCycleCount Cycles,
+    // oldest first. The trace of several threads is the concatenation of theirs.
+    static const uint32_t kTraceMagic = 0x544c5441;   // "ATLT"
+    static const uint32_t kTraceVersion = 1;
+    struct TraceHeader {
+        uint32_t    mMagic;
+        uint32_t    mVersion;
+        uint32_t    mIoHandle;      // audio_io_handle_t of the thread
+        uint32_t    mSampleRate;
+        uint32_t    mCycleSize;     // sizeof(Cycle)
+        uint32_t    mCycleCount;
+    };
+
+    LatencyTimeline();
+
+    void        beginMix(size_t activeTracks);
+    void        beginEffects();
+    void        beginWrite();
+    // presentationNs is the time from now until the HAL presents the last frame written,
+    // or 0 if the sink doesn't know.
+    void        endWrite(size_t frames, nsecs_t presentationNs);
+
+    // Returns the time from the start of the last recorded cycle to the presentation of its
+    // last frame, if a cycle was recorded since the previous call, and 0 otherwise.
+    // Added to the time frames wait in a track, this estimates the latency of the track.
+    nsecs_t     takePipelineNs();
+
+    void        dump(int fd) const;
+    // Writes the binary trace of the recorded cycles.
+    void        dumpTrace(int fd, uint32_t ioHandle, uint32_t sampleRate) const;
+
+private:
+    static const uint32_t kCycles = 512;    // must be a power of 2; ~10 s of 20 ms cycles
+
+    enum stage_t {
+        STAGE_IDLE,             // no cycle in progress
+        STAGE_MIX,
+        STAGE_EFFECTS,
+        STAGE_WRITE,
+    };
+
+    // adds the time since the start of the current stage to it, and starts the given stage
+    void        nextStage(stage_t stage);
+
+    Cycle       mCycles[kCycles];
+    uint32_t    mRecorded;      // number of cycles recorded so far, modulo 2^32
+    Cycle       mCurrent;       // cycle in progress
+    stage_t     mStage;         // stage of mCurrent
+    nsecs_t     mStageStartNs;
+    nsecs_t     mPipelineNs;    // of the last cycle recorded, until taken
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_LATENCY_TIMELINE_H
@@ -20,8 +20,11 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <audio_utils/primitives.h>
+#include <media/nbaio/MonoPipe.h>
+#include <media/nbaio/MonoPipeReader.h>
 
 #include "AudioFlinger.h"
 #include "ServiceUtilities.h"
@@ -387,31 +390,79 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
         return status;
     }
 
-    // use a pseudo LCM between input and output framecount
-    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
-    int playbackShift = __builtin_ctz(playbackFrameCount);
-    size_t recordFramecount = patch->mRecordThread->frameCount();
-    int shift = __builtin_ctz(recordFramecount);
-    if (playbackShift < shift) {
-        shift = playbackShift;
-    }
-    size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
-    ALOGV("createPatchConnections() playframeCount %d recordFramecount %d frameCount %d ",
-          playbackFrameCount, recordFramecount, frameCount);
-
-    // create a special record track to capture from record thread
     uint32_t channelCount = patch->mPlaybackThread->channelCount();
     audio_channel_mask_t inChannelMask = audio_channel_in_mask_from_count(channelCount);
     audio_channel_mask_t outChannelMask = patch->mPlaybackThread->channelMask();
     uint32_t sampleRate = patch->mPlaybackThread->sampleRate();
     audio_format_t format = patch->mPlaybackThread->format();
 
+    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
+    size_t recordFramecount = patch->mRecordThread->frameCount();
+    size_t recordTrackFrameCount;
+    size_t playbackTrackFrameCount;
+    size_t targetFrames = 0;
+    sp<MonoPipe> pipe;
+    sp<MonoPipeReader> pipeReader;
+
+    // The direct path needs the resampler of a mixer thread to compensate for the drift
+    // between the clocks of the two devices.
+    if (patch->mPlaybackThread->type() == ThreadBase::MIXER &&
+            property_get_bool("af.patch.direct", true /* default_value */)) {
+        // the record thread writes into a pipe read by the mixer, which only holds the target
+        // latency, instead of a buffer shared by the two tracks which holds a pseudo LCM of
+        // both periods. A record period at the sample rate of the playback thread:
+        size_t recordPeriod = (size_t) (((uint64_t) recordFramecount * sampleRate) /
+                patch->mRecordThread->sampleRate()) + 1;
+        // the pipe must hold a record period written just before the mixer reads a period
+        size_t minFrames = recordPeriod + playbackFrameCount;
+        int32_t latencyMs = property_get_int32("af.patch.latency_ms", 0);
+        if (latencyMs > 0) {
+            targetFrames = ((uint64_t) latencyMs * sampleRate) / 1000;
+        }
+        if (targetFrames < minFrames) {
+            targetFrames = minFrames;
+        }
+
+        // there is room above the target for the jitter of both threads
+        const NBAIO_Format pipeFormat = Format_from_SR_C(sampleRate, channelCount, format);
+        const NBAIO_Format offers[1] = {pipeFormat};
+        size_t numCounterOffers = 0;
+        pipe = new MonoPipe(targetFrames * 2, pipeFormat, false /*writeCanBlock*/);
+        ssize_t index = pipe->negotiate(offers, 1, NULL, numCounterOffers);
+        ALOG_ASSERT(index == 0);
+        pipeReader = new MonoPipeReader(pipe.get());
+        numCounterOffers = 0;
+        index = pipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+        ALOG_ASSERT(index == 0);
+
+        // the record thread converts straight into the pipe and the mixer reads it in place,
+        // so the buffers of the tracks stay unused: the frame count of the playback track
+        // is only the fill level at which it starts
+        recordTrackFrameCount = recordPeriod * 2;
+        playbackTrackFrameCount = targetFrames;
+        ALOGV("createPatchConnections() direct recordPeriod %zu playbackFrameCount %zu "
+              "targetFrames %zu", recordPeriod, playbackFrameCount, targetFrames);
+    } else {
+        // use a pseudo LCM between input and output framecount
+        int playbackShift = __builtin_ctz(playbackFrameCount);
+        int shift = __builtin_ctz(recordFramecount);
+        if (playbackShift < shift) {
+            shift = playbackShift;
+        }
+        size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
+        ALOGV("createPatchConnections() playframeCount %d recordFramecount %d frameCount %d ",
+              playbackFrameCount, recordFramecount, frameCount);
+        recordTrackFrameCount = frameCount;
+        playbackTrackFrameCount = frameCount;
+    }
+
+    // create a special record track to capture from record thread
     patch->mPatchRecord = new RecordThread::PatchRecord(
                                              patch->mRecordThread.get(),
                                              sampleRate,
                                              inChannelMask,
                                              format,
-                                             frameCount,
+                                             recordTrackFrameCount,
                                              NULL,
                                              IAudioFlinger::TRACK_DEFAULT);
     if (patch->mPatchRecord == 0) {
@@ -424,15 +475,15 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     patch->mRecordThread->addPatchRecord(patch->mPatchRecord);
 
     // create a special playback track to render to playback thread.
-    // this track is given the same buffer as the PatchRecord buffer
+    // without a pipe, this track is given the same buffer as the PatchRecord buffer
     patch->mPatchTrack = new PlaybackThread::PatchTrack(
                                            patch->mPlaybackThread.get(),
                                            audioPatch->sources[1].ext.mix.usecase.stream,
                                            sampleRate,
                                            outChannelMask,
                                            format,
-                                           frameCount,
-                                           patch->mPatchRecord->buffer(),
+                                           playbackTrackFrameCount,
+                                           pipe != 0 ? NULL : patch->mPatchRecord->buffer(),
                                            IAudioFlinger::TRACK_DEFAULT);
     if (patch->mPatchTrack == 0) {
         return NO_MEMORY;
@@ -446,6 +497,10 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     // tie playback and record tracks together
     patch->mPatchRecord->setPeerProxy(patch->mPatchTrack.get());
     patch->mPatchTrack->setPeerProxy(patch->mPatchRecord.get());
+    if (pipe != 0) {
+        patch->mPatchRecord->setPipe(pipe);
+        patch->mPatchTrack->setPipe(pipe, pipeReader, targetFrames);
+    }
 
     // start capture and playback
     patch->mPatchRecord->start(AudioSystem::SYNC_EVENT_NONE, 0);
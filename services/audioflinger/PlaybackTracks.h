@@ -40,6 +40,11 @@ public:
 
     static  void        appendDumpHeader(String8& result);
             void        dump(char* buffer, size_t size, bool active);
+    static  void        appendLatencyDumpHeader(String8& result);
+            void        dumpLatency(char* buffer, size_t size);
+            // Adds the frames now queued in the track to pipelineNs, the time the thread's
+            // last cycle took from mix to presentation, as a sample of the track's latency.
+            void        sampleLatency(nsecs_t pipelineNs);
     virtual status_t    start(AudioSystem::sync_event_t event =
                                     AudioSystem::SYNC_EVENT_NONE,
                              int triggerSession = 0);
@@ -155,6 +160,11 @@ private:
     AudioTrackServerProxy*  mAudioTrackServerProxy;
     bool                mResumeToStopping; // track was paused in stopping state.
     bool                mFlushHwPending; // track requests for thread flush
+    LatencyHistogram    mLatency;   // written by sampleLatency() on the thread, read by dumpsys
+    // futex wakes of the client at the previous dump(), to report them per second
+    uint32_t            mDumpFutexWakes;
+    uint32_t            mDumpFutexWakesAvoided;
+    nsecs_t             mDumpNs;
 
 };  // end of Track
 
@@ -272,6 +282,14 @@ public:
             bool        isActive() const { return mActive; }
     const wp<ThreadBase>& thread() const { return mThread; }
 
+            // Adds a timestamp of the output to the estimate of its clock rate, and returns the
+            // rate relative to nominal, or 0 if not known yet.
+            double      updateClock();
+            // Calls updateClock(), and sets the sample rate of the track so that the resampler
+            // of the output consumes the frames at the rate of referenceRate, the clock of the
+            // output pacing the DuplicatingThread, with the frames buffered kept at a target.
+            void        compensateDrift(double referenceRate);
+
 private:
 
     status_t            obtainBuffer(AudioBufferProvider::Buffer* buffer,
@@ -286,6 +304,8 @@ private:
     bool                        mActive;
     DuplicatingThread* const mSourceThread; // for waitTimeMs() in write()
     AudioTrackClientProxy*      mClientProxy;
+    ClockRateEstimator          mClock;
+    DriftCompensator            mDriftCompensator;
 };  // end of OutputTrack
 
 // playback track, used by PatchPanel
@@ -314,8 +334,28 @@ public:
 
             void setPeerProxy(PatchProxyBufferProvider *proxy) { mPeerProxy = proxy; }
 
+            // Reads from a pipe written by the PatchRecord, instead of the buffer shared with it.
+            // The track starts once targetFrames are in the pipe, and then adjusts its sample
+            // rate so that the resampler of the mixer keeps about targetFrames in the pipe.
+            // Must be called before start().
+            void setPipe(const sp<MonoPipe>& pipe, const sp<MonoPipeReader>& pipeReader,
+                         size_t targetFrames);
+
+    virtual size_t      framesReady() const;
+
 private:
+            // compensates the drift between the clocks of the two devices,
+            // given the frames in the pipe before a read
+            void compensateDrift(size_t filled);
+
     sp<ClientProxy>             mProxy;
     PatchProxyBufferProvider*   mPeerProxy;
     struct timespec             mPeerTimeout;
+
+    // only used when reading from a pipe
+    sp<MonoPipe>                mPipe;          // keeps the pipe alive for mPipeReader
+    sp<MonoPipeReader>          mPipeReader;
+    size_t                      mPipeTargetFrames;
+    float                       mPipeFilledAvg; // average frames in the pipe before a read
+    const uint32_t              mNominalSampleRate;
 };  // end of PatchTrack
@@ -110,8 +110,13 @@ public:
 
     void setPeerProxy(PatchProxyBufferProvider *proxy) { mPeerProxy = proxy; }
 
+    // Writes to a pipe read by the PatchTrack, instead of the buffer shared with it.
+    // Must be called before start().
+    void setPipe(const sp<MonoPipe>& pipe) { mPipe = pipe; }
+
 private:
     sp<ClientProxy>             mProxy;
     PatchProxyBufferProvider*   mPeerProxy;
     struct timespec             mPeerTimeout;
+    sp<MonoPipe>                mPipe;
 };  // end of PatchRecord
@@ -1456,7 +1456,7 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mSignalPending(false),
         mScreenState(AudioFlinger::mScreenState),
         // index 0 is reserved for normal mixer's submix
-        mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1),
+        mFastTrackAvailMask((unsigned) ((1ull << FastMixerState::getMaxFastTracks()) - 1) & ~1u),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false),
         // mLatchD, mLatchQ,
         mLatchDValid(false), mLatchQValid(false)
@@ -1491,10 +1491,22 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mStreamTypes[stream].volume = mAudioFlinger->streamVolume_l(stream);
         mStreamTypes[stream].mute = mAudioFlinger->streamMute_l(stream);
     }
+
+    // Effect chains of audio sessions may be processed in parallel on helper threads
+    if (type == MIXER || type == DUPLICATING) {
+        int32_t numThreads = property_get_int32("af.effect.chain_threads", 0);
+        if (numThreads > 0) {
+            mEffectChainPool = new EffectChainPool(
+                    min((size_t) numThreads, (size_t) EffectChainPool::kMaxThreads));
+        }
+    }
 }
 
 AudioFlinger::PlaybackThread::~PlaybackThread()
 {
+    if (mEffectChainPool != 0) {
+        mEffectChainPool->exit();
+    }
     mAudioFlinger->unregisterWriter(mNBLogWriter);
     free(mSinkBuffer);
     free(mMixerBuffer);
@@ -1555,6 +1567,17 @@ void AudioFlinger::PlaybackThread::dumpTracks(int fd, const Vector<String16>& ar
     } else {
         result.append("\n");
     }
+    if (numtracks) {
+        result.append("  Track latency in ms, from queued in the track to presented:\n");
+        Track::appendLatencyDumpHeader(result);
+        for (size_t i = 0; i < numtracks; ++i) {
+            sp<Track> track = mTracks[i];
+            if (track != 0) {
+                track->dumpLatency(buffer, SIZE);
+                result.append(buffer);
+            }
+        }
+    }
     if (numactiveseen != numactive) {
         // some tracks in the active list were not in the tracks list
         snprintf(buffer, SIZE, "  The following tracks are in the active list but"
@@ -1573,6 +1596,20 @@ void AudioFlinger::PlaybackThread::dumpTracks(int fd, const Vector<String16>& ar
     write(fd, result.string(), result.size());
 }
 
+// Time from now until the sink presents the last frame written, from the timestamp latched by
+// threadLoop_write(), or 0 if the sink doesn't know.
+nsecs_t AudioFlinger::PlaybackThread::presentationDelayNs() const
+{
+    if (!mLatchDValid || mSampleRate == 0) {
+        return 0;
+    }
+    const struct timespec& time = mLatchD.mTimestamp.mTime;
+    const nsecs_t timestampNs = (nsecs_t) time.tv_sec * 1000000000LL + time.tv_nsec;
+    const nsecs_t delayNs = (nsecs_t) mLatchD.mUnpresentedFrames * 1000000000LL / mSampleRate
+            - (systemTime() - timestampNs);
+    return delayNs > 0 ? delayNs : 0;
+}
+
 void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>& args)
 {
     dprintf(fd, "\nOutput thread %p type %d (%s):\n", this, type(), threadTypeToString(type()));
@@ -1588,12 +1625,16 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     dprintf(fd, "  Sink buffer : %p\n", mSinkBuffer);
     dprintf(fd, "  Mixer buffer: %p\n", mMixerBuffer);
     dprintf(fd, "  Effect buffer: %p\n", mEffectBuffer);
-    dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+    dprintf(fd, "  Effect chain threads: %zu\n",
+            mEffectChainPool != 0 ? mEffectChainPool->numThreads() : 0);
+    dprintf(fd, "  Fast track availMask=%#x maxFastTracks=%u\n", mFastTrackAvailMask,
+            FastMixerState::getMaxFastTracks());
     dprintf(fd, "  Standby delay ns=%lld\n", (long long)mStandbyDelayNs);
     AudioStreamOut *output = mOutput;
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
     String8 flagsAsString = outputFlagsToString(flags);
     dprintf(fd, "  AudioStreamOut: %p flags %#x (%s)\n", output, flags, flagsAsString.string());
+    mLatencyTimeline.dump(fd);
 }
 
 // Thread virtuals
@@ -1972,8 +2013,8 @@ void AudioFlinger::PlaybackThread::removeTrack_l(const sp<Track>& track)
     if (track->isFastTrack()) {
         int index = track->mFastIndex;
         ALOG_ASSERT(0 < index && index < (int)FastMixerState::kMaxFastTracks);
-        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
-        mFastTrackAvailMask |= 1 << index;
+        ALOG_ASSERT(!(mFastTrackAvailMask & (1u << index)));
+        mFastTrackAvailMask |= 1u << index;
         // redundant as track is about to be destroyed, for dumpsys only
         track->mFastIndex = -1;
     }
@@ -2233,7 +2274,11 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
     free(mEffectBuffer);
     mEffectBuffer = NULL;
     if (mEffectBufferEnabled) {
-        mEffectBufferFormat = AUDIO_FORMAT_PCM_16_BIT; // Note: Effects support 16b only
+        // Effects process float where tracks are mixed, so that session chains and the mix
+        // don't go through 16 bit PCM. Effects that only take 16 bit PCM convert around their
+        // engine, see EffectModule::configure().
+        mEffectBufferFormat = (mType == MIXER || mType == DUPLICATING) ?
+                AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
         mEffectBufferSize = mNormalFrameCount * mChannelCount
                 * audio_bytes_per_sample(mEffectBufferFormat);
         (void)posix_memalign(&mEffectBuffer, 32, mEffectBufferSize);
@@ -2566,17 +2611,29 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     int16_t* buffer = reinterpret_cast<int16_t*>(mEffectBufferEnabled
             ? mEffectBuffer : mSinkBuffer);
     bool ownsBuffer = false;
+    int16_t* outBuffer = buffer;
+    bool ownsOutBuffer = false;
 
     ALOGV("addEffectChain_l() %p on thread %p for session %d", chain.get(), this, session);
     if (session > 0) {
         // Only one effect chain can be present in direct output thread and it uses
         // the sink buffer as input
         if (mType != DIRECT) {
-            size_t numSamples = mNormalFrameCount * mChannelCount;
-            buffer = new int16_t[numSamples];
-            memset(buffer, 0, numSamples * sizeof(int16_t));
+            // the chain buffers are freed by the EffectChain destructor
+            size_t bufferSize = mNormalFrameCount * mChannelCount
+                    * audio_bytes_per_sample(effectBufferFormat());
+            (void)posix_memalign((void **)&buffer, 32, bufferSize);
+            memset(buffer, 0, bufferSize);
             ALOGV("addEffectChain_l() creating new input buffer %p session %d", buffer, session);
             ownsBuffer = true;
+
+            // A chain processed in parallel with others can't accumulate onto the shared
+            // output buffer itself, processEffectChains_l() adds its output to the mix.
+            if (mEffectChainPool != 0) {
+                (void)posix_memalign((void **)&outBuffer, 32, bufferSize);
+                memset(outBuffer, 0, bufferSize);
+                ownsOutBuffer = true;
+            }
         }
 
         // Attach all tracks with same session ID to this chain.
@@ -2604,8 +2661,7 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     }
     chain->setThread(this);
     chain->setInBuffer(buffer, ownsBuffer);
-    chain->setOutBuffer(reinterpret_cast<int16_t*>(mEffectBufferEnabled
-            ? mEffectBuffer : mSinkBuffer));
+    chain->setOutBuffer(outBuffer, ownsOutBuffer);
     // Effect chain for session AUDIO_SESSION_OUTPUT_STAGE is inserted at end of effect
     // chains list in order to be processed last as it contains output stage effects
     // Effect chain for session AUDIO_SESSION_OUTPUT_MIX is inserted before
@@ -2629,6 +2685,45 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     return NO_ERROR;
 }
 
+void AudioFlinger::PlaybackThread::processEffectChains_l(
+        const Vector< sp<EffectChain> >& effectChains)
+{
+    // Chains of audio sessions come first, see addEffectChain_l()
+    size_t numParallel = 0;
+    while (numParallel < effectChains.size() && effectChains[numParallel]->ownsOutBuffer()) {
+        numParallel++;
+    }
+
+    if (numParallel > 0) {
+        ALOG_ASSERT(mEffectChainPool != 0);
+        mEffectChainPool->process(effectChains, numParallel);
+
+        // add the output of each chain in the same order as if it had accumulated it itself
+        void *buffer = mEffectBufferEnabled ? mEffectBuffer : mSinkBuffer;
+        size_t numSamples = mNormalFrameCount * mChannelCount;
+        for (size_t i = 0; i < numParallel; i++) {
+            if (effectBufferFormat() == AUDIO_FORMAT_PCM_FLOAT) {
+                float *dst = (float *)buffer;
+                const float *out = (const float *)effectChains[i]->outBuffer();
+                for (size_t j = 0; j < numSamples; j++) {
+                    dst[j] += out[j];
+                }
+            } else {
+                int16_t *dst = (int16_t *)buffer;
+                const int16_t *out = effectChains[i]->outBuffer();
+                for (size_t j = 0; j < numSamples; j++) {
+                    dst[j] = clamp16((int32_t)dst[j] + (int32_t)out[j]);
+                }
+            }
+            effectChains[i]->updateEffectStates_l();
+        }
+    }
+
+    for (size_t i = numParallel; i < effectChains.size(); i++) {
+        effectChains[i]->process_l();
+    }
+}
+
 size_t AudioFlinger::PlaybackThread::removeEffectChain_l(const sp<EffectChain>& chain)
 {
     int session = chain->sessionId();
@@ -2757,6 +2852,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 logString = NULL;
             }
 
+            // Once per cycle written, sample the latency of the active tracks.
+            const nsecs_t pipelineNs = mLatencyTimeline.takePipelineNs();
+
             // Gather the framesReleased counters for all active tracks,
             // and latch them atomically with the timestamp.
             // FIXME We're using raw pointers as indices. A unique track ID would be a better index.
@@ -2767,6 +2865,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 if (t != 0) {
                     mLatchD.mFramesReleased.add(t.get(),
                             t->mAudioTrackServerProxy->framesReleased());
+                    if (pipelineNs != 0) {
+                        t->sampleLatency(pipelineNs);
+                    }
                 }
             }
             if (mLatchDValid) {
@@ -2849,6 +2950,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     continue;
                 }
             }
+            if (mBytesRemaining == 0) {
+                mLatencyTimeline.beginMix(mActiveTracks.size());
+            }
             // mMixerStatusIgnoringFastTracks is also updated internally
             mMixerStatus = prepareTracks_l(&tracksToRemove);
 
@@ -2884,8 +2988,8 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             // Merge mMixerBuffer data into mEffectBuffer (if any effects are valid)
             // or mSinkBuffer (if there are no effects).
             //
-            // This is done pre-effects computation; if effects change to
-            // support higher precision, this needs to move.
+            // This is done pre-effects computation; on mixer threads mEffectBuffer
+            // is float as well and the merge is lossless.
             //
             // mMixerBufferValid is only set true by MixerThread::prepareTracks_l().
             // TODO use mSleepTimeUs == 0 as an additional condition.
@@ -2907,9 +3011,8 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
             // only process effects if we're going to write
             if (mSleepTimeUs == 0 && mType != OFFLOAD) {
-                for (size_t i = 0; i < effectChains.size(); i ++) {
-                    effectChains[i]->process_l();
-                }
+                mLatencyTimeline.beginEffects();
+                processEffectChains_l(effectChains);
             }
         }
         // Process effect chains for offloaded thread even if no audio
@@ -2940,12 +3043,17 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             if (mSleepTimeUs == 0) {
                 ssize_t ret = 0;
                 if (mBytesRemaining) {
+                    mLatencyTimeline.beginWrite();
                     ret = threadLoop_write();
                     if (ret < 0) {
                         mBytesRemaining = 0;
                     } else {
                         mBytesWritten += ret;
                         mBytesRemaining -= ret;
+                        if (mBytesRemaining == 0) {
+                            mLatencyTimeline.endWrite(mCurrentWriteLength / mFrameSize,
+                                    presentationDelayNs());
+                        }
                     }
                 } else if ((mMixerStatus == MIXER_DRAIN_TRACK) ||
                         (mMixerStatus == MIXER_DRAIN_ALL)) {
@@ -3719,7 +3827,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             // is impossible because the slot isn't marked available until the end of each cycle.
             int j = track->mFastIndex;
             ALOG_ASSERT(0 < j && j < (int)FastMixerState::kMaxFastTracks);
-            ALOG_ASSERT(!(mFastTrackAvailMask & (1 << j)));
+            ALOG_ASSERT(!(mFastTrackAvailMask & (1u << j)));
             FastTrack *fastTrack = &state->mFastTracks[j];
 
             // Determine whether the track is currently in underrun condition,
@@ -3822,7 +3930,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
             if (isActive) {
                 // was it previously inactive?
-                if (!(state->mTrackMask & (1 << j))) {
+                if (!(state->mTrackMask & (1u << j))) {
                     ExtendedAudioBufferProvider *eabp = track;
                     VolumeProvider *vp = track;
                     fastTrack->mBufferProvider = eabp;
@@ -3830,7 +3938,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     fastTrack->mChannelMask = track->mChannelMask;
                     fastTrack->mFormat = track->mFormat;
                     fastTrack->mGeneration++;
-                    state->mTrackMask |= 1 << j;
+                    state->mTrackMask |= 1u << j;
                     didModify = true;
                     // no acknowledgement required for newly active tracks
                 }
@@ -3840,10 +3948,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 ++fastTracks;
             } else {
                 // was it previously active?
-                if (state->mTrackMask & (1 << j)) {
+                if (state->mTrackMask & (1u << j)) {
                     fastTrack->mBufferProvider = NULL;
                     fastTrack->mGeneration++;
-                    state->mTrackMask &= ~(1 << j);
+                    state->mTrackMask &= ~(1u << j);
                     didModify = true;
                     // If any fast tracks were removed, we must wait for acknowledgement
                     // because we're about to decrement the last sp<> on those tracks.
@@ -4077,10 +4185,13 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 // TODO: override track->mainBuffer()?
                 mMixerBufferValid = true;
             } else {
+                // tracks with effects mix in the format of their chain input buffer
+                audio_format_t mixerFormat = (track->mainBuffer() != mSinkBuffer)
+                        ? effectBufferFormat() : AUDIO_FORMAT_PCM_16_BIT;
                 mAudioMixer->setParameter(
                         name,
                         AudioMixer::TRACK,
-                        AudioMixer::MIXER_FORMAT, (void *)AUDIO_FORMAT_PCM_16_BIT);
+                        AudioMixer::MIXER_FORMAT, (void *)mixerFormat);
                 mAudioMixer->setParameter(
                         name,
                         AudioMixer::TRACK,
@@ -5288,11 +5399,99 @@ void AudioFlinger::OffloadThread::flushHw_l()
 
 // ----------------------------------------------------------------------------
 
+AudioFlinger::EffectChainPool::EffectChainPool(size_t numThreads)
+    :   mNumThreads(numThreads),
+        mChains(NULL),
+        mCount(0),
+        mNext(0),
+        mPending(0),
+        mExit(false)
+{
+}
+
+AudioFlinger::EffectChainPool::~EffectChainPool()
+{
+    exit();
+}
+
+void AudioFlinger::EffectChainPool::onFirstRef()
+{
+    for (size_t i = 0; i < mNumThreads; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "AudioEffects_%zu", i);
+        sp<Worker> worker = new Worker(this);
+        worker->run(name, ANDROID_PRIORITY_URGENT_AUDIO);
+        mWorkers.add(worker);
+    }
+}
+
+void AudioFlinger::EffectChainPool::process(const Vector< sp<EffectChain> >& chains, size_t count)
+{
+    Mutex::Autolock _l(mLock);
+    mChains = &chains;
+    mCount = count;
+    mNext = 0;
+    mPending = count;
+    // a single chain isn't worth waking up anybody
+    if (count > 1) {
+        mWorkCond.broadcast();
+    }
+    while (mNext < mCount) {
+        processNext_l();
+    }
+    while (mPending > 0) {
+        mDoneCond.wait(mLock);
+    }
+    mChains = NULL;
+}
+
+void AudioFlinger::EffectChainPool::exit()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        mExit = true;
+        mWorkCond.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->requestExitAndWait();
+    }
+    mWorkers.clear();
+}
+
+bool AudioFlinger::EffectChainPool::work()
+{
+    Mutex::Autolock _l(mLock);
+    while (!mExit && (mChains == NULL || mNext >= mCount)) {
+        mWorkCond.wait(mLock);
+    }
+    if (mExit) {
+        return false;
+    }
+    processNext_l();
+    return true;
+}
+
+void AudioFlinger::EffectChainPool::processNext_l()
+{
+    EffectChain *chain = mChains->itemAt(mNext++).get();
+    mLock.unlock();
+    chain->processEffects_l();
+    mLock.lock();
+    if (--mPending == 0) {
+        mDoneCond.signal();
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audioFlinger,
         AudioFlinger::MixerThread* mainThread, audio_io_handle_t id, bool systemReady)
     :   MixerThread(audioFlinger, mainThread->getOutput(), id, mainThread->outDevice(),
                     systemReady, DUPLICATING),
-        mWaitTimeMs(UINT_MAX)
+        mWaitTimeMs(UINT_MAX),
+        mCompensateDrift(property_get_bool("af.duplicating.compensate_drift",
+                                           true /* default_value */)),
+        mLastDriftUpdateNs(0)
 {
     addOutputTrack(mainThread);
 }
@@ -5347,10 +5546,50 @@ ssize_t AudioFlinger::DuplicatingThread::threadLoop_write()
     for (size_t i = 0; i < outputTracks.size(); i++) {
         outputTracks[i]->write(mSinkBuffer, writeFrames);
     }
+    if (mCompensateDrift && writeFrames != 0) {
+        compensateDrift();
+    }
     mStandby = false;
     return (ssize_t)mSinkBufferSize;
 }
 
+// Often enough for the average fill levels, and rarely enough to not contend
+// for the locks of the outputs
+static const nsecs_t kDriftUpdatePeriodNs = 50000000;
+
+void AudioFlinger::DuplicatingThread::compensateDrift()
+{
+    const nsecs_t now = systemTime();
+    if (now - mLastDriftUpdateNs < kDriftUpdatePeriodNs) {
+        return;
+    }
+    mLastDriftUpdateNs = now;
+
+    // The track of the main output is left at the nominal sample rate, so it fills up and
+    // write() blocks on it: this thread runs at the rate of the clock of the main output.
+    // The other outputs follow it, with their tracks filled to a target and never blocking.
+    ssize_t reference = -1;
+    for (size_t i = 0; i < outputTracks.size(); i++) {
+        sp<ThreadBase> thread = outputTracks[i]->thread().promote();
+        if (thread != 0 && ((PlaybackThread *)thread.get())->getOutput() == mOutput) {
+            reference = i;
+            break;
+        }
+    }
+    if (reference < 0) {
+        return;
+    }
+    const double referenceRate = outputTracks[reference]->updateClock();
+    if (referenceRate == 0) {
+        return;
+    }
+    for (size_t i = 0; i < outputTracks.size(); i++) {
+        if ((ssize_t) i != reference) {
+            outputTracks[i]->compensateDrift(referenceRate);
+        }
+    }
+}
+
 void AudioFlinger::DuplicatingThread::threadLoop_standby()
 {
     // DuplicatingThread implements standby by stopping all tracks
@@ -248,6 +248,9 @@ public:
                 // and returns the [normal mix] buffer's frame count.
     virtual     size_t      frameCount() const = 0;
                 size_t      frameSize() const { return mFrameSize; }
+                // Format of the effect chain buffers, the effects processing them
+                // may still take 16 bit PCM only, see EffectModule::configure()
+    virtual     audio_format_t effectBufferFormat() const { return AUDIO_FORMAT_PCM_16_BIT; }
 
     // Should be "virtual status_t requestExitAndWait()" and override same
     // method in Thread, but Thread::requestExitAndWait() is not yet virtual.
@@ -601,6 +604,9 @@ public:
                         void     invalidateTracks(audio_stream_type_t streamType);
 
     virtual     size_t      frameCount() const { return mNormalFrameCount; }
+    virtual     audio_format_t effectBufferFormat() const {
+                    return mEffectBufferEnabled ? mEffectBufferFormat : AUDIO_FORMAT_PCM_16_BIT;
+                }
 
                 // Return's the HAL's frame count i.e. fast mixer buffer size.
                 size_t      frameCountHAL() const { return mFrameCount; }
@@ -671,7 +677,8 @@ protected:
     // Size of mEffectsBuffer in bytes: mNormalFrameCount * #channels * sampsize.
     size_t                          mEffectBufferSize;
 
-    // The audio format of mEffectsBuffer. Set to AUDIO_FORMAT_PCM_16_BIT only.
+    // The audio format of mEffectsBuffer. AUDIO_FORMAT_PCM_FLOAT for mixer and duplicating
+    // threads, AUDIO_FORMAT_PCM_16_BIT otherwise.
     audio_format_t                  mEffectBufferFormat;
 
     // An internal flag set to true by MixerThread::prepareTracks_l()
@@ -812,6 +819,14 @@ private:
     bool                            mSignalPending;
     sp<AsyncCallbackThread>         mCallbackThread;
 
+    // Processes the effect chains for one mix cycle.  Chains of audio sessions are processed
+    // in parallel on mEffectChainPool, if there is one, and added to the mix afterwards.
+                void        processEffectChains_l(const Vector< sp<EffectChain> >& effectChains);
+
+    // Helper threads for the effect chains of audio sessions, or 0 if they are processed on
+    // this thread.  Only MIXER and DUPLICATING threads can have them.
+    sp<EffectChainPool>             mEffectChainPool;
+
 private:
     // The HAL output sink is treated as non-blocking, but current implementation is blocking
     sp<NBAIO_Sink>          mOutputSink;
@@ -832,6 +847,10 @@ public:
     virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex __unused) const
                                 { FastTrackUnderruns dummy; return dummy; }
 
+                // binary trace of mLatencyTimeline, see LatencyTimeline::dumpTrace()
+                void        dumpLatencyTrace(int fd) const
+                                { mLatencyTimeline.dumpTrace(fd, mId, mSampleRate); }
+
 protected:
                 // accessed by both binder threads and within threadLoop(), lock on mutex needed
                 unsigned    mFastTrackAvailMask;    // bit i set if fast track [i] is available
@@ -851,6 +870,11 @@ private:
                         //     (except for mFramesReleased which is filled in later),
                         //     and clock it into latch at next opportunity
     bool mLatchQValid;  // true means mLatchQ is valid
+
+    nsecs_t     presentationDelayNs() const;
+
+    // stages of each mix cycle, written by threadLoop() and read by dumpsys without lock
+    LatencyTimeline mLatencyTimeline;
 };
 
 class MixerThread : public PlaybackThread {
@@ -1020,6 +1044,54 @@ private:
     Mutex                      mLock;
 };
 
+// Processes the effect chains of independent audio sessions of a PlaybackThread on a few
+// helper threads, in parallel with each other and with the playback thread itself.
+class EffectChainPool : public RefBase {
+public:
+    // upper limit for the number of helper threads, set by property af.effect.chain_threads
+    static const size_t kMaxThreads = 4;
+
+    explicit EffectChainPool(size_t numThreads);
+    virtual ~EffectChainPool();
+
+    // RefBase
+    virtual void onFirstRef();
+
+    // Calls processEffects_l() on the first count chains and returns once all of them are
+    // done.  The caller processes chains too.  The chains must be locked by the caller.
+    void process(const Vector< sp<EffectChain> >& chains, size_t count);
+
+    // Stops the helper threads and waits for them to exit
+    void exit();
+
+    size_t numThreads() const { return mNumThreads; }
+
+private:
+    class Worker : public Thread {
+    public:
+        explicit Worker(EffectChainPool *pool) : Thread(false /*canCallJava*/), mPool(pool) { }
+    private:
+        virtual bool threadLoop() { return mPool->work(); }
+        EffectChainPool * const mPool;  // the pool joins its workers before it is destroyed
+    };
+
+    // Waits for a chain to process and processes it; returns false once the pool exits
+    bool work();
+    // Called with mLock held, releases it while the next chain is processed
+    void processNext_l();
+
+    const size_t                mNumThreads;
+    Vector< sp<Worker> >        mWorkers;
+    Mutex                       mLock;
+    Condition                   mWorkCond;  // signaled when chains are posted, or on exit
+    Condition                   mDoneCond;  // signaled when the last chain is done
+    const Vector< sp<EffectChain> >* mChains; // chains of the current cycle, or NULL
+    size_t                      mCount;     // number of chains to process in mChains
+    size_t                      mNext;      // index of the next chain to start
+    size_t                      mPending;   // number of chains not done yet
+    bool                        mExit;
+};
+
 class DuplicatingThread : public MixerThread {
 public:
     DuplicatingThread(const sp<AudioFlinger>& audioFlinger, MixerThread* mainThread,
@@ -1035,6 +1107,8 @@ protected:
 
 private:
                 bool        outputsReady(const SortedVector< sp<OutputTrack> > &outputTracks);
+                // steers the sample rate of the output tracks to the clock of the main output
+                void        compensateDrift();
 protected:
     // threadLoop snippets
     virtual     void        threadLoop_mix();
@@ -1052,6 +1126,8 @@ protected:
 private:
 
                 uint32_t    mWaitTimeMs;
+                const bool  mCompensateDrift;   // af.duplicating.compensate_drift
+                nsecs_t     mLastDriftUpdateNs;
     SortedVector < sp<OutputTrack> >  outputTracks;
     SortedVector < sp<OutputTrack> >  mOutputTracks;
 public:
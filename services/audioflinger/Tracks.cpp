@@ -404,7 +404,10 @@ AudioFlinger::PlaybackThread::Track::Track(
     mIsInvalid(false),
     mAudioTrackServerProxy(NULL),
     mResumeToStopping(false),
-    mFlushHwPending(false)
+    mFlushHwPending(false),
+    mDumpFutexWakes(0),
+    mDumpFutexWakesAvoided(0),
+    mDumpNs(systemTime())
 {
     // client == 0 implies sharedBuffer == 0
     ALOG_ASSERT(!(client == 0 && sharedBuffer != 0));
@@ -444,7 +447,7 @@ AudioFlinger::PlaybackThread::Track::Track(
         //       this means we are potentially denying other more important fast tracks from
         //       being created.  It would be better to allocate the index dynamically.
         mFastIndex = i;
-        thread->mFastTrackAvailMask &= ~(1 << i);
+        thread->mFastTrackAvailMask &= ~(1u << i);
     }
 }
 
@@ -498,7 +501,7 @@ void AudioFlinger::PlaybackThread::Track::destroy()
 /*static*/ void AudioFlinger::PlaybackThread::Track::appendDumpHeader(String8& result)
 {
     result.append("    Name Active Client Type      Fmt Chn mask Session fCount S F SRate  "
-                  "L dB  R dB    Server Main buf  Aux Buf Flags UndFrmCnt\n");
+                  "L dB  R dB    Server Main buf  Aux Buf Flags UndFrmCnt  Wake/s Skip/s\n");
 }
 
 void AudioFlinger::PlaybackThread::Track::dump(char* buffer, size_t size, bool active)
@@ -564,8 +567,18 @@ void AudioFlinger::PlaybackThread::Track::dump(char* buffer, size_t size, bool a
         nowInUnderrun = '?';
         break;
     }
+    // futex wakes of the client per second since the previous dump
+    const nsecs_t now = systemTime();
+    const uint32_t futexWakes = mAudioTrackServerProxy->getFutexWakes();
+    const uint32_t futexWakesAvoided = mAudioTrackServerProxy->getFutexWakesAvoided();
+    const double seconds = now > mDumpNs ? (now - mDumpNs) * 1e-9 : 1.0;
+    const double wakesPerSec = (futexWakes - mDumpFutexWakes) / seconds;
+    const double wakesAvoidedPerSec = (futexWakesAvoided - mDumpFutexWakesAvoided) / seconds;
+    mDumpFutexWakes = futexWakes;
+    mDumpFutexWakesAvoided = futexWakesAvoided;
+    mDumpNs = now;
     snprintf(&buffer[8], size-8, " %6s %6u %4u %08X %08X %7u %6zu %1c %1d %5u %5.2g %5.2g  "
-                                 "%08X %p %p 0x%03X %9u%c\n",
+                                 "%08X %p %p 0x%03X %9u%c %7.1f %6.1f\n",
             active ? "yes" : "no",
             (mClient == 0) ? getpid_cached : mClient->pid(),
             mStreamType,
@@ -583,7 +596,48 @@ void AudioFlinger::PlaybackThread::Track::dump(char* buffer, size_t size, bool a
             mAuxBuffer,
             mCblk->mFlags,
             mAudioTrackServerProxy->getUnderrunFrames(),
-            nowInUnderrun);
+            nowInUnderrun,
+            wakesPerSec,
+            wakesAvoidedPerSec);
+}
+
+/*static*/ void AudioFlinger::PlaybackThread::Track::appendLatencyDumpHeader(String8& result)
+{
+    result.append("    Name Session    Count    P50    P90    P99    Max\n");
+}
+
+void AudioFlinger::PlaybackThread::Track::dumpLatency(char* buffer, size_t size)
+{
+    if (isFastTrack()) {
+        snprintf(buffer, size, "    F %2d", mFastIndex);
+    } else if (mName >= AudioMixer::TRACK0) {
+        snprintf(buffer, size, "    %4d", mName - AudioMixer::TRACK0);
+    } else {
+        snprintf(buffer, size, "    none");
+    }
+    snprintf(&buffer[8], size-8, " %7u %8u %6.1f %6.1f %6.1f %6.1f\n",
+            mSessionId,
+            mLatency.count(),
+            mLatency.percentile(0.50) * 1e-6,
+            mLatency.percentile(0.90) * 1e-6,
+            mLatency.percentile(0.99) * 1e-6,
+            mLatency.maximum() * 1e-6);
+}
+
+void AudioFlinger::PlaybackThread::Track::sampleLatency(nsecs_t pipelineNs)
+{
+    // the frames of a static track are not queued, and only active tracks are consumed
+    if (mSharedBuffer != 0 || mState != ACTIVE) {
+        return;
+    }
+    uint32_t sampleRate = mAudioTrackServerProxy->getSampleRate();
+    if (sampleRate == 0) {
+        sampleRate = mSampleRate;
+    }
+    if (sampleRate == 0) {
+        return;
+    }
+    mLatency.add(pipelineNs + (nsecs_t) framesReady() * 1000000000LL / sampleRate);
 }
 
 uint32_t AudioFlinger::PlaybackThread::Track::sampleRate() const {
@@ -1649,7 +1703,11 @@ AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
     :   Track(playbackThread, NULL, AUDIO_STREAM_PATCH,
               sampleRate, format, channelMask, frameCount,
               NULL, 0, 0, uid, IAudioFlinger::TRACK_DEFAULT, TYPE_OUTPUT),
-    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL)
+    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL),
+    mClock(playbackThread->sampleRate()),
+    // the track is three periods of the output, and written a period at a time, so two leaves
+    // room for a write without blocking
+    mDriftCompensator(sampleRate, (frameCount * 2) / 3)
 {
 
     if (mCblk != NULL) {
@@ -1697,6 +1755,48 @@ void AudioFlinger::PlaybackThread::OutputTrack::stop()
     clearBufferQueue();
     mOutBuffer.frameCount = 0;
     mActive = false;
+    if (mClientProxy != NULL) {
+        mClientProxy->setSampleRate(mDriftCompensator.nominalSampleRate());
+    }
+    mDriftCompensator.reset();
+}
+
+double AudioFlinger::PlaybackThread::OutputTrack::updateClock()
+{
+    sp<ThreadBase> thread = mThread.promote();
+    if (thread == 0) {
+        return 0;
+    }
+    PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+    AudioTimestamp timestamp;
+    status_t status;
+    {
+        Mutex::Autolock _l(playbackThread->mLock);
+        status = playbackThread->getTimestamp_l(timestamp);
+    }
+    if (status != NO_ERROR) {
+        return 0;
+    }
+    mClock.addTimestamp(timestamp.mPosition,
+            (nsecs_t) timestamp.mTime.tv_sec * 1000000000LL + timestamp.mTime.tv_nsec);
+    return mClock.isValid() ? mClock.rate() : 0;
+}
+
+void AudioFlinger::PlaybackThread::OutputTrack::compensateDrift(double referenceRate)
+{
+    const double rate = updateClock();
+    if (rate == 0 || !mActive || mClientProxy == NULL) {
+        return;
+    }
+    // the frames in overflow buffers are late as well
+    size_t filled = mClientProxy->getFramesFilled();
+    for (size_t i = 0; i < mBufferQueue.size(); i++) {
+        filled += mBufferQueue[i]->frameCount;
+    }
+    const uint32_t sampleRate = mDriftCompensator.sampleRate(rate / referenceRate, filled);
+    ALOGVV("OutputTrack::compensateDrift() %p rate %.6f reference %.6f filled %zu sample rate %u",
+            this, rate, referenceRate, filled, sampleRate);
+    mClientProxy->setSampleRate(sampleRate);
 }
 
 bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frames)
@@ -1835,7 +1935,8 @@ AudioFlinger::PlaybackThread::PatchTrack::PatchTrack(PlaybackThread *playbackThr
     :   Track(playbackThread, NULL, streamType,
               sampleRate, format, channelMask, frameCount,
               buffer, 0, 0, getuid(), flags, TYPE_PATCH),
-              mProxy(new ClientProxy(mCblk, mBuffer, frameCount, mFrameSize, true, true))
+              mProxy(new ClientProxy(mCblk, mBuffer, frameCount, mFrameSize, true, true)),
+              mPipeTargetFrames(0), mPipeFilledAvg(0), mNominalSampleRate(sampleRate)
 {
     uint64_t mixBufferNs = ((uint64_t)2 * playbackThread->frameCount() * 1000000000) /
                                                                     playbackThread->sampleRate();
@@ -1852,10 +1953,76 @@ AudioFlinger::PlaybackThread::PatchTrack::~PatchTrack()
 {
 }
 
+void AudioFlinger::PlaybackThread::PatchTrack::setPipe(const sp<MonoPipe>& pipe,
+                                                       const sp<MonoPipeReader>& pipeReader,
+                                                       size_t targetFrames)
+{
+    mPipe = pipe;
+    mPipeReader = pipeReader;
+    mPipeTargetFrames = targetFrames;
+    mPipeFilledAvg = targetFrames;
+}
+
+size_t AudioFlinger::PlaybackThread::PatchTrack::framesReady() const
+{
+    if (mPipeReader == 0) {
+        return Track::framesReady();
+    }
+    // includes the frames obtained by the mixer and not released yet
+    ssize_t available = mPipeReader->availableToRead();
+    return available > 0 ? available : 0;
+}
+
+// The fill level seen before a read swings by up to a mix buffer within each cycle,
+// so the drift is estimated from a slow average of it.
+static const float kPatchPipeFilledWeight = 1.0f / 64.0f;
+// Time to absorb a fill error: the correction of the sample rate, in Hz, is the error in frames
+// divided by this. The rate of the clocks of two devices differs by 100 ppm at most, a few Hz.
+static const float kPatchDriftCorrectionSec = 2.0f;
+// Bound of the correction, relative to the nominal sample rate, to keep it inaudible
+static const float kPatchMaxDriftCorrection = 0.005f;
+
+void AudioFlinger::PlaybackThread::PatchTrack::compensateDrift(size_t filled)
+{
+    mPipeFilledAvg += ((float) filled - mPipeFilledAvg) * kPatchPipeFilledWeight;
+    float correction = (mPipeFilledAvg - (float) mPipeTargetFrames) / kPatchDriftCorrectionSec;
+    const float maxCorrection = mNominalSampleRate * kPatchMaxDriftCorrection;
+    if (correction > maxCorrection) {
+        correction = maxCorrection;
+    } else if (correction < -maxCorrection) {
+        correction = -maxCorrection;
+    }
+    // a higher sample rate makes the resampler consume the pipe faster.
+    // There is no client, so the sample rate is set here, on the thread that reads it.
+    uint32_t sampleRate = (uint32_t) (mNominalSampleRate + correction + 0.5f);
+    if (sampleRate != mCblk->mSampleRate) {
+        ALOGVV("PatchTrack %p pipe filled %.1f target %zu sample rate %u",
+                this, mPipeFilledAvg, mPipeTargetFrames, sampleRate);
+        mCblk->mSampleRate = sampleRate;
+    }
+}
+
 // AudioBufferProvider interface
 status_t AudioFlinger::PlaybackThread::PatchTrack::getNextBuffer(
         AudioBufferProvider::Buffer* buffer, int64_t pts)
 {
+    if (mPipeReader != 0) {
+        // the mixer reads the frames in place, up to the end of the pipe buffer
+        ssize_t available = mPipeReader->availableToRead();
+        if (available > 0) {
+            compensateDrift(available);
+        }
+        void *raw;
+        ssize_t frameCount = mPipeReader->obtainRead(&raw, buffer->frameCount, pts);
+        if (frameCount <= 0) {
+            buffer->frameCount = 0;
+            buffer->raw = NULL;
+            return WOULD_BLOCK;
+        }
+        buffer->frameCount = frameCount;
+        buffer->raw = raw;
+        return NO_ERROR;
+    }
     ALOG_ASSERT(mPeerProxy != 0, "PatchTrack::getNextBuffer() called without peer proxy");
     Proxy::Buffer buf;
     buf.mFrameCount = buffer->frameCount;
@@ -1871,6 +2038,12 @@ status_t AudioFlinger::PlaybackThread::PatchTrack::getNextBuffer(
 
 void AudioFlinger::PlaybackThread::PatchTrack::releaseBuffer(AudioBufferProvider::Buffer* buffer)
 {
+    if (mPipeReader != 0) {
+        mPipeReader->releaseRead(buffer->frameCount);
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+        return;
+    }
     ALOG_ASSERT(mPeerProxy != 0, "PatchTrack::releaseBuffer() called without peer proxy");
     Proxy::Buffer buf;
     buf.mFrameCount = buffer->frameCount;
@@ -1887,12 +2060,18 @@ status_t AudioFlinger::PlaybackThread::PatchTrack::obtainBuffer(Proxy::Buffer* b
 
 void AudioFlinger::PlaybackThread::PatchTrack::releaseBuffer(Proxy::Buffer* buffer)
 {
-    mProxy->releaseBuffer(buffer);
+    // with a pipe, the peer only tells that it wrote to it
+    if (mPipeReader == 0) {
+        mProxy->releaseBuffer(buffer);
+    }
     if (android_atomic_and(~CBLK_DISABLED, &mCblk->mFlags) & CBLK_DISABLED) {
         ALOGW("PatchTrack::releaseBuffer() disabled due to previous underrun, restarting");
         start();
     }
-    android_atomic_or(CBLK_FORCEREADY, &mCblk->mFlags);
+    // with a pipe, the track waits for the target fill level instead
+    if (mPipeReader == 0) {
+        android_atomic_or(CBLK_FORCEREADY, &mCblk->mFlags);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -2147,6 +2326,20 @@ AudioFlinger::RecordThread::PatchRecord::~PatchRecord()
 status_t AudioFlinger::RecordThread::PatchRecord::getNextBuffer(
                                                   AudioBufferProvider::Buffer* buffer, int64_t pts)
 {
+    if (mPipe != 0) {
+        // the record thread converts in place into the pipe, up to the end of the pipe buffer.
+        // When the pipe is full, the frames stay in the record thread, which reports an overrun.
+        void *raw;
+        ssize_t frameCount = mPipe->obtainWrite(&raw, buffer->frameCount);
+        if (frameCount <= 0) {
+            buffer->frameCount = 0;
+            buffer->raw = NULL;
+            return WOULD_BLOCK;
+        }
+        buffer->frameCount = frameCount;
+        buffer->raw = raw;
+        return NO_ERROR;
+    }
     ALOG_ASSERT(mPeerProxy != 0, "PatchRecord::getNextBuffer() called without peer proxy");
     Proxy::Buffer buf;
     buf.mFrameCount = buffer->frameCount;
@@ -2163,6 +2356,20 @@ status_t AudioFlinger::RecordThread::PatchRecord::getNextBuffer(
 
 void AudioFlinger::RecordThread::PatchRecord::releaseBuffer(AudioBufferProvider::Buffer* buffer)
 {
+    if (mPipe != 0) {
+        size_t frameCount = buffer->frameCount;
+        mPipe->releaseWrite(frameCount);
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+        if (frameCount > 0) {
+            // restarts the peer if it was disabled by an underrun
+            Proxy::Buffer buf;
+            buf.mFrameCount = frameCount;
+            buf.mRaw = NULL;
+            mPeerProxy->releaseBuffer(&buf);
+        }
+        return;
+    }
     ALOG_ASSERT(mPeerProxy != 0, "PatchRecord::releaseBuffer() called without peer proxy");
     Proxy::Buffer buf;
     buf.mFrameCount = buffer->frameCount;
@@ -25,6 +25,29 @@ LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_NATIVE_TEST)
 
+#
+# drift compensation unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libutils \
+	libcutils \
+	libnbaio
+
+LOCAL_C_INCLUDES := \
+	frameworks/av/services/audioflinger
+
+LOCAL_SRC_FILES := \
+	drift_tests.cpp \
+	../DriftCompensator.cpp
+
+LOCAL_MODULE := drift_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
+
 #
 # audio mixer test tool
 #
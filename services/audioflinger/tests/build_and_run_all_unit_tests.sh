@@ -16,6 +16,7 @@ echo "waiting for device"
 adb root && adb wait-for-device remount
 adb push $OUT/system/lib/libaudioresampler.so /system/lib
 adb push $OUT/data/nativetest/resampler_tests /system/bin
+adb push $OUT/data/nativetest/drift_tests /system/bin
 
 sh $ANDROID_BUILD_TOP/frameworks/av/services/audioflinger/tests/run_all_unit_tests.sh
 
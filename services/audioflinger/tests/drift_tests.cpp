@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_drift_tests"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <media/AudioBufferProvider.h>
+#include <media/nbaio/Pipe.h>
+#include <media/nbaio/PipeReader.h>
+#include "DriftCompensator.h"
+
+using namespace android;
+
+static const uint32_t kSourceRate = 48000;
+static const size_t kSourcePeriod = 960;        // 20 ms written by the producer at a time
+static const size_t kPipeFrames = 4096;
+static const double kUpdatePeriodSec = 0.05;    // as in DuplicatingThread::compensateDrift()
+static const double kLatencySec = 0.04;         // from a mix to its presentation
+
+// a deterministic jitter of up to +/- 0.5 ms
+static double jitterSec(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (((*seed >> 16) & 0x7fff) / 32768.0 - 0.5) * 0.001;
+}
+
+static nsecs_t toNs(double sec)
+{
+    return (nsecs_t) (sec * 1000000000.0);
+}
+
+// An output device whose clock runs at clockRate times its nominal rate. Its mixer reads
+// the source frames from the pipe, and plays them at the sample rate given by the compensator,
+// as the resampler of a MixerThread would.
+struct DriftingSink {
+    DriftingSink(Pipe& pipe, uint32_t sampleRate, double clockRate)
+        : mReader(pipe), mSampleRate(sampleRate), mPeriod(sampleRate / 50),
+          mClockRate(clockRate), mClock(sampleRate),
+          mCompensator(kSourceRate, kSourcePeriod * 2),
+          mTrackRate(kSourceRate), mNextMixSec(0), mLastMixSec(0), mMixed(0), mDebt(0),
+          mStarted(false), mUnderruns(0), mOverruns(0), mMinFilled(SIZE_MAX), mMaxFilled(0)
+    {
+        const NBAIO_Format offers[1] = {Format_from_SR_C(kSourceRate, 2, AUDIO_FORMAT_PCM_16_BIT)};
+        size_t numCounterOffers = 0;
+        ssize_t index = mReader.negotiate(offers, 1, NULL, numCounterOffers);
+        EXPECT_EQ(0, index);
+    }
+
+    size_t filled() {
+        ssize_t available = mReader.availableToRead();
+        // the reader skips ahead on an overrun, whose status is not negative on 64-bit
+        if (mReader.overruns() != mOverruns) {
+            mOverruns = mReader.overruns();
+            available = mReader.availableToRead();
+        }
+        return available > 0 ? available : 0;
+    }
+
+    void mix(double now) {
+        size_t available = filled();
+        // the track waits for the target before it starts, as after an underrun
+        if (!mStarted) {
+            if (available < mCompensator.targetFrames()) {
+                mNextMixSec = now + mPeriod / (mSampleRate * mClockRate);
+                return;
+            }
+            mStarted = true;
+        }
+        if (available < mMinFilled) {
+            mMinFilled = available;
+        }
+        if (available > mMaxFilled) {
+            mMaxFilled = available;
+        }
+        mDebt += (double) mPeriod * mTrackRate / mSampleRate;
+        size_t needed = (size_t) mDebt;
+        mDebt -= needed;
+        int16_t buffer[kPipeFrames * 2];
+        ASSERT_LE(needed, kPipeFrames);
+        ssize_t framesRead = mReader.read(buffer, needed, AudioBufferProvider::kInvalidPTS);
+        if (framesRead < (ssize_t) needed) {
+            mUnderruns++;
+            mStarted = false;
+        }
+        mMixed += mPeriod;
+        mLastMixSec = now;
+        mNextMixSec = now + mPeriod / (mSampleRate * mClockRate);
+    }
+
+    // the position presented at the last mix, as reported by getPresentationPosition()
+    void addTimestamp(uint32_t *seed) {
+        const size_t latencyFrames = (size_t) (kLatencySec * mSampleRate);
+        if (mMixed > latencyFrames) {
+            mClock.addTimestamp(mMixed - latencyFrames,
+                    toNs(mLastMixSec + kLatencySec / mClockRate + jitterSec(seed)));
+        }
+    }
+
+    PipeReader          mReader;
+    const uint32_t      mSampleRate;
+    const size_t        mPeriod;
+    const double        mClockRate;
+    ClockRateEstimator  mClock;
+    DriftCompensator    mCompensator;
+    uint32_t            mTrackRate;
+    double              mNextMixSec;
+    double              mLastMixSec;
+    uint32_t            mMixed;
+    double              mDebt;
+    bool                mStarted;
+    uint32_t            mUnderruns;
+    size_t              mOverruns;
+    size_t              mMinFilled;
+    size_t              mMaxFilled;
+};
+
+static sp<Pipe> newPipe()
+{
+    const NBAIO_Format format = Format_from_SR_C(kSourceRate, 2, AUDIO_FORMAT_PCM_16_BIT);
+    sp<Pipe> pipe = new Pipe(kPipeFrames, format);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    ssize_t index = pipe->negotiate(offers, 1, NULL, numCounterOffers);
+    EXPECT_EQ(0, index);
+    return pipe;
+}
+
+// A DuplicatingThread paced by a reference output at the nominal rate, writing to a Pipe read
+// by two outputs which drift by +/- driftPpm, one of them at another sample rate.
+// The sinks must be deleted before the pipe.
+static void simulate(const sp<Pipe>& pipe, double durationSec, double driftPpm, bool compensate,
+        std::vector<DriftingSink *> *sinks)
+{
+    sinks->push_back(new DriftingSink(*pipe, 48000, 1.0 + driftPpm * 1e-6));
+    sinks->push_back(new DriftingSink(*pipe, 44100, 1.0 - driftPpm * 1e-6));
+    ClockRateEstimator reference(kSourceRate);
+    uint32_t seed = 1;
+
+    int16_t silence[kSourcePeriod * 2];
+    memset(silence, 0, sizeof(silence));
+    double nextWriteSec = 0;
+    double nextUpdateSec = 0;
+    uint32_t written = 0;
+    for (;;) {
+        double now = nextWriteSec;
+        DriftingSink *next = NULL;
+        for (size_t i = 0; i < sinks->size(); i++) {
+            if ((*sinks)[i]->mNextMixSec < now) {
+                now = (*sinks)[i]->mNextMixSec;
+                next = (*sinks)[i];
+            }
+        }
+        if (now >= durationSec) {
+            break;
+        }
+        if (next != NULL) {
+            next->mix(now);
+            continue;
+        }
+        ASSERT_EQ((ssize_t) kSourcePeriod, pipe->write(silence, kSourcePeriod));
+        written += kSourcePeriod;
+        nextWriteSec += (double) kSourcePeriod / kSourceRate;
+        if (!compensate || now < nextUpdateSec) {
+            continue;
+        }
+        nextUpdateSec = now + kUpdatePeriodSec;
+        const size_t latencyFrames = (size_t) (kLatencySec * kSourceRate);
+        if (written > latencyFrames) {
+            reference.addTimestamp(written - latencyFrames, toNs(now + jitterSec(&seed)));
+        }
+        if (!reference.isValid()) {
+            continue;
+        }
+        for (size_t i = 0; i < sinks->size(); i++) {
+            DriftingSink *sink = (*sinks)[i];
+            sink->addTimestamp(&seed);
+            if (sink->mStarted && sink->mClock.isValid()) {
+                sink->mTrackRate = sink->mCompensator.sampleRate(
+                        sink->mClock.rate() / reference.rate(), sink->filled());
+            }
+        }
+    }
+}
+
+static void deleteSinks(std::vector<DriftingSink *> *sinks)
+{
+    for (size_t i = 0; i < sinks->size(); i++) {
+        delete (*sinks)[i];
+    }
+    sinks->clear();
+}
+
+TEST(audioflinger_drift, estimator) {
+    // a clock 200 ppm fast, with timestamps jittering by +/- 0.5 ms
+    const uint32_t sampleRate = 44100;
+    const double clockRate = 1.0 + 200e-6;
+    ClockRateEstimator estimator(sampleRate);
+    uint32_t seed = 1;
+    for (double t = 0; t < 10.0; t += 0.05) {
+        estimator.addTimestamp((uint32_t) (t * sampleRate * clockRate), toNs(t + jitterSec(&seed)));
+    }
+    ASSERT_TRUE(estimator.isValid());
+    EXPECT_NEAR(clockRate, estimator.rate(), 30e-6);
+
+    // positions wrap
+    estimator.reset();
+    const uint32_t start = UINT32_MAX - sampleRate;
+    for (double t = 0; t < 10.0; t += 0.05) {
+        estimator.addTimestamp(start + (uint32_t) (t * sampleRate * clockRate), toNs(t));
+    }
+    EXPECT_NEAR(clockRate, estimator.rate(), 1e-6);
+
+    // a standby stops the position, and the estimate starts over
+    for (double t = 10.0; t < 11.0; t += 0.05) {
+        estimator.addTimestamp(start + (uint32_t) (10.0 * sampleRate * clockRate), toNs(t));
+    }
+    EXPECT_FALSE(estimator.isValid());
+    EXPECT_EQ(1.0, estimator.rate());
+}
+
+TEST(audioflinger_drift, uncompensated) {
+    // the simulation must glitch without compensation for the next test to mean anything
+    sp<Pipe> pipe = newPipe();
+    std::vector<DriftingSink *> sinks;
+    simulate(pipe, 600.0, 100.0, false /*compensate*/, &sinks);
+    ASSERT_EQ(2U, sinks.size());
+    EXPECT_GT(sinks[0]->mUnderruns, 0U);
+    EXPECT_GT(sinks[1]->mOverruns, 0U);
+    deleteSinks(&sinks);
+}
+
+TEST(audioflinger_drift, compensated) {
+    sp<Pipe> pipe = newPipe();
+    std::vector<DriftingSink *> sinks;
+    simulate(pipe, 600.0, 100.0, true /*compensate*/, &sinks);
+    ASSERT_EQ(2U, sinks.size());
+    for (size_t i = 0; i < sinks.size(); i++) {
+        DriftingSink *sink = sinks[i];
+        ALOGV("sink %zu filled %zu to %zu average %.1f track rate %u", i, sink->mMinFilled,
+                sink->mMaxFilled, sink->mCompensator.filledAverage(), sink->mTrackRate);
+        EXPECT_EQ(0U, sink->mUnderruns);
+        EXPECT_EQ(0U, sink->mOverruns);
+        // the fill level stays around the target, without extra latency
+        EXPECT_NEAR((double) sink->mCompensator.targetFrames(),
+                sink->mCompensator.filledAverage(), kSourcePeriod / 2);
+        EXPECT_LT(sink->mMaxFilled, sink->mCompensator.targetFrames() + kSourcePeriod * 2);
+    }
+    deleteSinks(&sinks);
+}